@@ -0,0 +1,237 @@
+#include <math.h>
+#include <string.h>
+
+#include "ahrs.h"
+
+#define AHRS_DEG_TO_RAD (3.14159265358979f / 180.0f)
+#define AHRS_RAD_TO_DEG (180.0f / 3.14159265358979f)
+// Longer gaps (first frame after a stall) are not integrated.
+#define AHRS_MAX_DT_US (100000)
+
+#define AHRS_Q30_ONE (1L << 30)
+
+static float ahrs_gyro_rad_res(void) {
+    float acc_res, gyro_res;
+    MPU6886_GetResolution(&acc_res, &gyro_res);
+    return gyro_res * AHRS_DEG_TO_RAD;
+}
+
+static int64_t ahrs_step_us(int64_t *last_us, int64_t now_us) {
+    int64_t dt = now_us - *last_us;
+    bool first = (*last_us == 0);
+    *last_us = now_us;
+    if (first || dt <= 0 || dt > AHRS_MAX_DT_US) {
+        return 0;
+    }
+    return dt;
+}
+
+void Ahrs_FloatInit(ahrs_float_t *ahrs, float kp, float ki) {
+    memset(ahrs, 0, sizeof(*ahrs));
+    ahrs->q[0] = 1.0f;
+    ahrs->kp = kp;
+    ahrs->ki = ki;
+    ahrs->gyro_rad_res = ahrs_gyro_rad_res();
+}
+
+/*
+    Mahony complementary filter: the cross product of measured gravity
+    and the gravity direction predicted by q is the attitude error; it
+    is fed back into the gyro rate (PI) before integrating q.
+*/
+void Ahrs_FloatUpdate(ahrs_float_t *ahrs, const mpu6886_frame_t *frame) {
+    int64_t dt_us = ahrs_step_us(&ahrs->last_us, frame->timestamp_us);
+    if (dt_us == 0) {
+        return ;
+    }
+    float dt = (float)dt_us * 1e-6f;
+    float *q = ahrs->q;
+
+    float gx = (float)frame->gyro[0] * ahrs->gyro_rad_res;
+    float gy = (float)frame->gyro[1] * ahrs->gyro_rad_res;
+    float gz = (float)frame->gyro[2] * ahrs->gyro_rad_res;
+
+    // Accel scale cancels out in the normalization, so raw counts do.
+    float ax = frame->accel[0];
+    float ay = frame->accel[1];
+    float az = frame->accel[2];
+    float norm = sqrtf(ax * ax + ay * ay + az * az);
+    if (norm > 0.0f) {
+        ax /= norm;
+        ay /= norm;
+        az /= norm;
+
+        float vx = 2.0f * (q[1] * q[3] - q[0] * q[2]);
+        float vy = 2.0f * (q[0] * q[1] + q[2] * q[3]);
+        float vz = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+
+        float ex = ay * vz - az * vy;
+        float ey = az * vx - ax * vz;
+        float ez = ax * vy - ay * vx;
+
+        if (ahrs->ki > 0.0f) {
+            ahrs->integral[0] += ahrs->ki * ex * dt;
+            ahrs->integral[1] += ahrs->ki * ey * dt;
+            ahrs->integral[2] += ahrs->ki * ez * dt;
+        }
+        gx += ahrs->kp * ex + ahrs->integral[0];
+        gy += ahrs->kp * ey + ahrs->integral[1];
+        gz += ahrs->kp * ez + ahrs->integral[2];
+    }
+
+    float hx = gx * 0.5f * dt;
+    float hy = gy * 0.5f * dt;
+    float hz = gz * 0.5f * dt;
+    float q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    q[0] = q0 - q1 * hx - q2 * hy - q3 * hz;
+    q[1] = q1 + q0 * hx + q2 * hz - q3 * hy;
+    q[2] = q2 + q0 * hy - q1 * hz + q3 * hx;
+    q[3] = q3 + q0 * hz + q1 * hy - q2 * hx;
+
+    norm = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    q[0] /= norm;
+    q[1] /= norm;
+    q[2] /= norm;
+    q[3] /= norm;
+}
+
+void Ahrs_FloatGetQuat(const ahrs_float_t *ahrs, ahrs_quat_t *quat) {
+    quat->w = ahrs->q[0];
+    quat->x = ahrs->q[1];
+    quat->y = ahrs->q[2];
+    quat->z = ahrs->q[3];
+}
+
+static uint64_t ahrs_isqrt64(uint64_t value) {
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+static inline int32_t ahrs_sat32(int64_t value) {
+    if (value > INT32_MAX) {
+        return INT32_MAX;
+    }
+    if (value < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (int32_t)value;
+}
+
+void Ahrs_FixedInit(ahrs_fixed_t *ahrs, float kp, float ki) {
+    memset(ahrs, 0, sizeof(*ahrs));
+    ahrs->q[0] = AHRS_Q30_ONE;
+    ahrs->kp = (int32_t)lroundf(kp * 65536.0f);
+    ahrs->ki = (int32_t)lroundf(ki * 65536.0f);
+    ahrs->gyro_scale = llroundf(ahrs_gyro_rad_res() * 4294967296.0f);
+}
+
+/*
+    Same filter as Ahrs_FloatUpdate() in integers. Two divisions per
+    update: one reciprocal for the accel norm and one for the quaternion
+    norm; everything else is 32x32->64 multiplies and shifts.
+*/
+void Ahrs_FixedUpdate(ahrs_fixed_t *ahrs, const mpu6886_frame_t *frame) {
+    int64_t dt_us = ahrs_step_us(&ahrs->last_us, frame->timestamp_us);
+    if (dt_us == 0) {
+        return ;
+    }
+    int32_t *q = ahrs->q;
+
+    // Q16 rad/s; a Q32 scale keeps 2000 dps counts at full resolution.
+    int64_t gx = ((int64_t)frame->gyro[0] * ahrs->gyro_scale) >> 16;
+    int64_t gy = ((int64_t)frame->gyro[1] * ahrs->gyro_scale) >> 16;
+    int64_t gz = ((int64_t)frame->gyro[2] * ahrs->gyro_scale) >> 16;
+
+    int64_t ax = frame->accel[0];
+    int64_t ay = frame->accel[1];
+    int64_t az = frame->accel[2];
+    uint64_t norm = ahrs_isqrt64((uint64_t)(ax * ax + ay * ay + az * az));
+    if (norm > 0) {
+        // Reciprocal in Q46 so the products below land in Q30.
+        int64_t recip = (1LL << 46) / (int64_t)norm;
+        ax = (ax * recip) >> 16;
+        ay = (ay * recip) >> 16;
+        az = (az * recip) >> 16;
+
+        int64_t vx = ((int64_t)q[1] * q[3] - (int64_t)q[0] * q[2]) >> 29;
+        int64_t vy = ((int64_t)q[0] * q[1] + (int64_t)q[2] * q[3]) >> 29;
+        int64_t vz = ((int64_t)q[0] * q[0] - (int64_t)q[1] * q[1] - (int64_t)q[2] * q[2] + (int64_t)q[3] * q[3]) >> 30;
+
+        // Q60 cross products; the error is kept in Q16 to meet the gains.
+        int64_t ex = (ay * vz - az * vy) >> 44;
+        int64_t ey = (az * vx - ax * vz) >> 44;
+        int64_t ez = (ax * vy - ay * vx) >> 44;
+
+        if (ahrs->ki > 0) {
+            // ki * e is Q32 rad/s^2; scale by dt in microseconds.
+            ahrs->integral[0] += (ahrs->ki * ex) * dt_us / 1000000;
+            ahrs->integral[1] += (ahrs->ki * ey) * dt_us / 1000000;
+            ahrs->integral[2] += (ahrs->ki * ez) * dt_us / 1000000;
+        }
+        gx += ((ahrs->kp * ex) >> 16) + (ahrs->integral[0] >> 16);
+        gy += ((ahrs->kp * ey) >> 16) + (ahrs->integral[1] >> 16);
+        gz += ((ahrs->kp * ez) >> 16) + (ahrs->integral[2] >> 16);
+    }
+
+    // Half the step in Q32 seconds; rate (Q16) times it gives Q30 radians.
+    int64_t half_dt = (dt_us << 31) / 1000000;
+    int64_t hx = (gx * half_dt) >> 18;
+    int64_t hy = (gy * half_dt) >> 18;
+    int64_t hz = (gz * half_dt) >> 18;
+    int64_t a0 = q[0], a1 = q[1], a2 = q[2], a3 = q[3];
+    int64_t q0 = a0 + ((-a1 * hx - a2 * hy - a3 * hz) >> 30);
+    int64_t q1 = a1 + ((a0 * hx + a2 * hz - a3 * hy) >> 30);
+    int64_t q2 = a2 + ((a0 * hy - a1 * hz + a3 * hx) >> 30);
+    int64_t q3 = a3 + ((a0 * hz + a1 * hy - a2 * hx) >> 30);
+
+    norm = ahrs_isqrt64((uint64_t)(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3));
+    if (norm == 0) {
+        return ;
+    }
+    int64_t recip = (1LL << 60) / (int64_t)norm;
+    q[0] = ahrs_sat32((q0 * recip) >> 30);
+    q[1] = ahrs_sat32((q1 * recip) >> 30);
+    q[2] = ahrs_sat32((q2 * recip) >> 30);
+    q[3] = ahrs_sat32((q3 * recip) >> 30);
+}
+
+void Ahrs_FixedGetQuat(const ahrs_fixed_t *ahrs, ahrs_quat_t *quat) {
+    quat->w = (float)ahrs->q[0] / (float)AHRS_Q30_ONE;
+    quat->x = (float)ahrs->q[1] / (float)AHRS_Q30_ONE;
+    quat->y = (float)ahrs->q[2] / (float)AHRS_Q30_ONE;
+    quat->z = (float)ahrs->q[3] / (float)AHRS_Q30_ONE;
+}
+
+void Ahrs_QuatToEuler(const ahrs_quat_t *quat, ahrs_euler_t *euler) {
+    float w = quat->w, x = quat->x, y = quat->y, z = quat->z;
+    float sinp = 2.0f * (w * y - z * x);
+    if (sinp > 1.0f) {
+        sinp = 1.0f;
+    } else if (sinp < -1.0f) {
+        sinp = -1.0f;
+    }
+    euler->roll = atan2f(2.0f * (w * x + y * z), 1.0f - 2.0f * (x * x + y * y)) * AHRS_RAD_TO_DEG;
+    euler->pitch = asinf(sinp) * AHRS_RAD_TO_DEG;
+    euler->yaw = atan2f(2.0f * (w * z + x * y), 1.0f - 2.0f * (y * y + z * z)) * AHRS_RAD_TO_DEG;
+}
+
+float Ahrs_QuatAngle(const ahrs_quat_t *a, const ahrs_quat_t *b) {
+    float dot = fabsf(a->w * b->w + a->x * b->x + a->y * b->y + a->z * b->z);
+    if (dot > 1.0f) {
+        dot = 1.0f;
+    }
+    return 2.0f * acosf(dot) * AHRS_RAD_TO_DEG;
+}
@@ -0,0 +1,168 @@
+/**
+ * @file ahrs.h
+ * @brief Attitude estimation from MPU6886 frames (Mahony filter).
+ */
+
+#pragma once
+
+#include "stdint.h"
+#include "mpu6886.h"
+
+// Mahony gains: proportional pull towards gravity and gyro bias integral.
+#define AHRS_DEFAULT_KP 1.0f
+#define AHRS_DEFAULT_KI 0.0f
+
+/**
+ * @brief Unit quaternion, w + xi + yj + zk.
+ */
+/* @[declare_ahrs_quat_t] */
+typedef struct {
+    float w;
+    float x;
+    float y;
+    float z;
+} ahrs_quat_t;
+/* @[declare_ahrs_quat_t] */
+
+/**
+ * @brief Euler angles in degrees (aerospace sequence, Z-Y-X).
+ */
+/* @[declare_ahrs_euler_t] */
+typedef struct {
+    float roll;
+    float pitch;
+    float yaw;
+} ahrs_euler_t;
+/* @[declare_ahrs_euler_t] */
+
+/**
+ * @brief Float reference filter state.
+ */
+/* @[declare_ahrs_float_t] */
+typedef struct {
+    float q[4];
+    float integral[3];     // gyro bias estimate, rad/s
+    float kp;
+    float ki;
+    float gyro_rad_res;    // rad/s per gyro count
+    int64_t last_us;
+} ahrs_float_t;
+/* @[declare_ahrs_float_t] */
+
+/**
+ * @brief Fixed-point filter state.
+ *
+ * Quaternion and unit vectors are Q2.30, angular rates Q16.16 rad/s,
+ * so an update needs no floating point at all.
+ */
+/* @[declare_ahrs_fixed_t] */
+typedef struct {
+    int32_t q[4];          // Q30
+    int64_t integral[3];   // Q32 rad/s
+    int32_t kp;            // Q16
+    int32_t ki;            // Q16
+    int64_t gyro_scale;    // Q32 rad/s per gyro count
+    int64_t last_us;
+} ahrs_fixed_t;
+/* @[declare_ahrs_fixed_t] */
+
+/**
+ * @brief Result of Ahrs_Benchmark().
+ */
+/* @[declare_ahrs_bench_t] */
+typedef struct {
+    uint32_t frames;
+    float float_us;          // mean time of one Ahrs_FloatUpdate()
+    float fixed_us;          // mean time of one Ahrs_FixedUpdate()
+    float max_error_deg;     // largest rotation between the two estimates
+    float final_error_deg;   // rotation between the two estimates at the end
+} ahrs_bench_t;
+/* @[declare_ahrs_bench_t] */
+
+/**
+ * @brief Initializes the float filter at the identity attitude.
+ *
+ * The gyro scale is taken from the MPU6886 driver's current full-scale
+ * range; initialize again after MPU6886_SetGyroFSR().
+ *
+ * @param[out] ahrs Filter state.
+ * @param[in] kp Proportional gain.
+ * @param[in] ki Integral gain, 0 disables bias estimation.
+ */
+/* @[declare_ahrs_floatinit] */
+void Ahrs_FloatInit(ahrs_float_t *ahrs, float kp, float ki);
+/* @[declare_ahrs_floatinit] */
+
+/**
+ * @brief Feeds one frame to the float filter.
+ *
+ * The step is the difference of frame timestamps; the first frame only
+ * sets the time base.
+ *
+ * @param[in,out] ahrs Filter state.
+ * @param[in] frame Raw sample from the MPU6886 driver.
+ */
+/* @[declare_ahrs_floatupdate] */
+void Ahrs_FloatUpdate(ahrs_float_t *ahrs, const mpu6886_frame_t *frame);
+/* @[declare_ahrs_floatupdate] */
+
+/**
+ * @brief Retrieves the float filter attitude.
+ */
+/* @[declare_ahrs_floatgetquat] */
+void Ahrs_FloatGetQuat(const ahrs_float_t *ahrs, ahrs_quat_t *quat);
+/* @[declare_ahrs_floatgetquat] */
+
+/**
+ * @brief Initializes the fixed-point filter at the identity attitude.
+ *
+ * Same as Ahrs_FloatInit(); the gains are converted to Q16 here.
+ */
+/* @[declare_ahrs_fixedinit] */
+void Ahrs_FixedInit(ahrs_fixed_t *ahrs, float kp, float ki);
+/* @[declare_ahrs_fixedinit] */
+
+/**
+ * @brief Feeds one frame to the fixed-point filter.
+ */
+/* @[declare_ahrs_fixedupdate] */
+void Ahrs_FixedUpdate(ahrs_fixed_t *ahrs, const mpu6886_frame_t *frame);
+/* @[declare_ahrs_fixedupdate] */
+
+/**
+ * @brief Retrieves the fixed-point filter attitude.
+ */
+/* @[declare_ahrs_fixedgetquat] */
+void Ahrs_FixedGetQuat(const ahrs_fixed_t *ahrs, ahrs_quat_t *quat);
+/* @[declare_ahrs_fixedgetquat] */
+
+/**
+ * @brief Converts an attitude quaternion to Euler angles.
+ */
+/* @[declare_ahrs_quattoeuler] */
+void Ahrs_QuatToEuler(const ahrs_quat_t *quat, ahrs_euler_t *euler);
+/* @[declare_ahrs_quattoeuler] */
+
+/**
+ * @brief Rotation angle between two attitudes, in degrees.
+ */
+/* @[declare_ahrs_quatangle] */
+float Ahrs_QuatAngle(const ahrs_quat_t *a, const ahrs_quat_t *b);
+/* @[declare_ahrs_quatangle] */
+
+/**
+ * @brief Replays recorded frames through both filters.
+ *
+ * Each filter is timed over the whole recording on its own, then both
+ * run again side by side to track how far the fixed-point estimate
+ * strays from the float reference.
+ *
+ * @param[in] frames Recorded frames, e.g. from MPU6886_StreamRead().
+ * @param[in] count Number of frames.
+ * @param[in] kp Proportional gain for both filters.
+ * @param[in] ki Integral gain for both filters.
+ * @param[out] result Timing and accuracy.
+ */
+/* @[declare_ahrs_benchmark] */
+void Ahrs_Benchmark(const mpu6886_frame_t *frames, uint32_t count, float kp, float ki, ahrs_bench_t *result);
+/* @[declare_ahrs_benchmark] */
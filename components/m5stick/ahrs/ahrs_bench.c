@@ -0,0 +1,45 @@
+#include "esp_timer.h"
+
+#include <string.h>
+
+#include "ahrs.h"
+
+void Ahrs_Benchmark(const mpu6886_frame_t *frames, uint32_t count, float kp, float ki, ahrs_bench_t *result) {
+    ahrs_float_t ref;
+    ahrs_fixed_t fixed;
+    ahrs_quat_t q_ref, q_fixed;
+
+    memset(result, 0, sizeof(*result));
+    if (frames == NULL || count == 0) {
+        return ;
+    }
+    result->frames = count;
+
+    Ahrs_FloatInit(&ref, kp, ki);
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < count; i++) {
+        Ahrs_FloatUpdate(&ref, &frames[i]);
+    }
+    result->float_us = (float)(esp_timer_get_time() - start) / count;
+
+    Ahrs_FixedInit(&fixed, kp, ki);
+    start = esp_timer_get_time();
+    for (uint32_t i = 0; i < count; i++) {
+        Ahrs_FixedUpdate(&fixed, &frames[i]);
+    }
+    result->fixed_us = (float)(esp_timer_get_time() - start) / count;
+
+    Ahrs_FloatInit(&ref, kp, ki);
+    Ahrs_FixedInit(&fixed, kp, ki);
+    for (uint32_t i = 0; i < count; i++) {
+        Ahrs_FloatUpdate(&ref, &frames[i]);
+        Ahrs_FixedUpdate(&fixed, &frames[i]);
+        Ahrs_FloatGetQuat(&ref, &q_ref);
+        Ahrs_FixedGetQuat(&fixed, &q_fixed);
+        float error = Ahrs_QuatAngle(&q_ref, &q_fixed);
+        if (error > result->max_error_deg) {
+            result->max_error_deg = error;
+        }
+        result->final_error_deg = error;
+    }
+}
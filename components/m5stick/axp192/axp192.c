@@ -1,6 +1,7 @@
 #include "axp192.h"
 #include "axp192_i2c.h"
 #include "stdio.h"
+#include "string.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
@@ -11,6 +12,37 @@
 
 static const char *TAG = "Axp192";
 
+typedef struct {
+    uint8_t enable_reg;
+    uint8_t enable_bit;
+    uint8_t reg;
+    uint8_t length;
+} axp192_adc_channel_t;
+
+// Indexed by Axp192_PowerChannel_t.
+static const axp192_adc_channel_t axp192_adc_channels[AXP192_POWER_CHANNELS] = {
+    [AXP192_POWER_ACIN_VOLT]    = { AXP192_ADC1_ENABLE_REG, ACIN_VOLT_BIT, AXP192_ACIN_ADC_VOLTAGE_REG, 2 },
+    [AXP192_POWER_ACIN_CURRENT] = { AXP192_ADC1_ENABLE_REG, ACIN_CURRENT_BIT, AXP192_ACIN_ADC_CURRENT_REG, 2 },
+    [AXP192_POWER_VBUS_VOLT]    = { AXP192_ADC1_ENABLE_REG, VBUS_VOLT_BIT, AXP192_VBUS_ADC_VOLTAGE_REG, 2 },
+    [AXP192_POWER_VBUS_CURRENT] = { AXP192_ADC1_ENABLE_REG, VBUS_CURRENT_BIT, AXP192_VBUS_ADC_CURRENT_REG, 2 },
+    [AXP192_POWER_TEMP]         = { AXP192_ADC2_ENABLE_REG, TEMP_BIT, AXP192_TEMP_ADC_REG, 2 },
+    [AXP192_POWER_BAT_POWER]    = { AXP192_ADC1_ENABLE_REG, BAT_VOLT_BIT, AXP192_BAT_ADC_POWER_REG, 3 },
+    [AXP192_POWER_BAT_VOLT]     = { AXP192_ADC1_ENABLE_REG, BAT_VOLT_BIT, AXP192_BAT_ADC_VOLTAGE_REG, 2 },
+    [AXP192_POWER_BAT_CURRENT]  = { AXP192_ADC1_ENABLE_REG, BAT_CURRENT_BIT, AXP192_BAT_ADC_CURRENT_IN_REG, 4 },
+    [AXP192_POWER_APS_VOLT]     = { AXP192_ADC1_ENABLE_REG, APS_VOLT_BIT, AXP192_APS_ADC_VOLTAGE_REG, 2 },
+};
+
+#define AXP192_ADC_FIRST_REG AXP192_ACIN_ADC_VOLTAGE_REG
+#define AXP192_ADC_END_REG (AXP192_APS_ADC_VOLTAGE_REG + 2)
+
+static uint16_t axp192_adc12(const uint8_t *buf) {
+    return (buf[0] << 4) | (buf[1] & 0x0F);
+}
+
+static uint16_t axp192_adc13(const uint8_t *buf) {
+    return (buf[0] << 5) | (buf[1] & 0x1F);
+}
+
 void Axp192_Init() {
     Axp192_I2CInit();
 }
@@ -135,11 +167,103 @@ float Axp192_GetAcinCurrent() {
  
 float Axp192_GetBatCurrent() {
     float ADCLSB = 0.5;
-    uint16_t current_in = Axp192_Read13Bit(AXP192_BAT_ADC_CURRENT_IN_REG);
-    uint16_t current_out = Axp192_Read13Bit(AXP192_BAT_ADC_CURRENT_OUT_REG);
-    return ADCLSB * (current_in - current_out);
+    // Charge and discharge registers are adjacent: one read, one conversion.
+    uint8_t buf[4];
+    if (!Axp192_ReadBytes(AXP192_BAT_ADC_CURRENT_IN_REG, buf, sizeof(buf))) {
+        return 0.0f;
+    }
+    return ADCLSB * (axp192_adc13(&buf[0]) - axp192_adc13(&buf[2]));
 }
  
+float Axp192_GetBatCurrentAvg(uint32_t duration_ms) {
+    // The ADC updates at 25 Hz by default; sample once per conversion.
+    const uint32_t interval_ms = 40;
+    uint32_t samples = duration_ms / interval_ms;
+    if (samples == 0) {
+        samples = 1;
+    }
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < samples; i++) {
+        sum += Axp192_GetBatCurrent();
+        if (i + 1 < samples) {
+            vTaskDelay(pdMS_TO_TICKS(interval_ms));
+        }
+    }
+    return sum / samples;
+}
+ 
+esp_err_t Axp192_ReadPowerSnapshot(Axp192_PowerSnapshot_t *snapshot) {
+    memset(snapshot, 0, sizeof(*snapshot));
+    uint8_t enable[2] = {
+        Axp192_Read8Bit(AXP192_ADC1_ENABLE_REG),
+        Axp192_Read8Bit(AXP192_ADC2_ENABLE_REG),
+    };
+    uint16_t valid = 0;
+    uint8_t first = AXP192_ADC_END_REG;
+    uint8_t end = AXP192_ADC_FIRST_REG;
+    for (uint8_t i = 0; i < AXP192_POWER_CHANNELS; i++) {
+        const axp192_adc_channel_t *channel = &axp192_adc_channels[i];
+        uint8_t bits = enable[channel->enable_reg - AXP192_ADC1_ENABLE_REG];
+        if (!(bits & (1 << channel->enable_bit))) {
+            continue;
+        }
+        if (i == AXP192_POWER_BAT_POWER && !(enable[0] & (1 << BAT_CURRENT_BIT))) {
+            continue;
+        }
+        valid |= 1 << i;
+        if (channel->reg < first) {
+            first = channel->reg;
+        }
+        if (channel->reg + channel->length > end) {
+            end = channel->reg + channel->length;
+        }
+    }
+    if (valid == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint8_t buf[AXP192_ADC_END_REG - AXP192_ADC_FIRST_REG];
+    if (!Axp192_ReadBurst(first, buf, end - first)) {
+        return ESP_FAIL;
+    }
+#define AXP192_ADC_AT(reg) (&buf[(reg) - first])
+    // LSBs: 1.7 mV, 0.625 mA, 1.7 mV, 0.375 mA, 0.1 degC from -144.7,
+    // 0.55 uW, 1.1 mV, 0.5 mA, 1.4 mV.
+    if (valid & (1 << AXP192_POWER_ACIN_VOLT)) {
+        snapshot->acin_mv = (axp192_adc12(AXP192_ADC_AT(AXP192_ACIN_ADC_VOLTAGE_REG)) * 17 + 5) / 10;
+    }
+    if (valid & (1 << AXP192_POWER_ACIN_CURRENT)) {
+        snapshot->acin_ua = axp192_adc12(AXP192_ADC_AT(AXP192_ACIN_ADC_CURRENT_REG)) * 625;
+    }
+    if (valid & (1 << AXP192_POWER_VBUS_VOLT)) {
+        snapshot->vbus_mv = (axp192_adc12(AXP192_ADC_AT(AXP192_VBUS_ADC_VOLTAGE_REG)) * 17 + 5) / 10;
+    }
+    if (valid & (1 << AXP192_POWER_VBUS_CURRENT)) {
+        snapshot->vbus_ua = axp192_adc12(AXP192_ADC_AT(AXP192_VBUS_ADC_CURRENT_REG)) * 375;
+    }
+    if (valid & (1 << AXP192_POWER_TEMP)) {
+        snapshot->temp_centi_c = ((int16_t)axp192_adc12(AXP192_ADC_AT(AXP192_TEMP_ADC_REG)) - 1447) * 10;
+    }
+    if (valid & (1 << AXP192_POWER_BAT_POWER)) {
+        const uint8_t *power = AXP192_ADC_AT(AXP192_BAT_ADC_POWER_REG);
+        uint32_t raw = ((uint32_t)power[0] << 16) | (power[1] << 8) | power[2];
+        snapshot->bat_uw = (raw * 11 + 10) / 20;
+    }
+    if (valid & (1 << AXP192_POWER_BAT_VOLT)) {
+        snapshot->bat_mv = (axp192_adc12(AXP192_ADC_AT(AXP192_BAT_ADC_VOLTAGE_REG)) * 11 + 5) / 10;
+    }
+    if (valid & (1 << AXP192_POWER_BAT_CURRENT)) {
+        snapshot->bat_ua = ((int32_t)axp192_adc13(AXP192_ADC_AT(AXP192_BAT_ADC_CURRENT_IN_REG))
+                            - axp192_adc13(AXP192_ADC_AT(AXP192_BAT_ADC_CURRENT_OUT_REG))) * 500;
+    }
+    if (valid & (1 << AXP192_POWER_APS_VOLT)) {
+        snapshot->aps_mv = (axp192_adc12(AXP192_ADC_AT(AXP192_APS_ADC_VOLTAGE_REG)) * 14 + 5) / 10;
+    }
+#undef AXP192_ADC_AT
+    snapshot->valid = valid;
+    return ESP_OK;
+}
+
 void Axp192_EnableCharge(uint16_t state) {
     uint8_t value = state ? 1 : 0;
     Axp192_WriteBits(AXP192_CHG_CTL1_REG, value, 7, 1);
@@ -5,6 +5,7 @@
 
 #pragma once
 #include "stdint.h"
+#include "esp_err.h"
 
 #define AXP192_DC_VOLT_STEP  25
 #define AXP192_DC_VOLT_MIN   700
@@ -55,16 +56,25 @@
 #define APS_VOLT_BIT        (1)
 #define TS_BIT              (0)
 
+#define AXP192_ADC2_ENABLE_REG      0x83
+#define TEMP_BIT            (7)
+
 #define AXP192_ACIN_ADC_VOLTAGE_REG         0x56
 #define AXP192_ACIN_ADC_CURRENT_REG         0x58
 
 #define AXP192_VBUS_ADC_VOLTAGE_REG         0x5A
 #define AXP192_VBUS_ADC_CURRENT_REG         0x5C
 
+#define AXP192_TEMP_ADC_REG                 0x5E
+
+#define AXP192_BAT_ADC_POWER_REG            0x70
+
 #define AXP192_BAT_ADC_VOLTAGE_REG          0x78
 #define AXP192_BAT_ADC_CURRENT_IN_REG       0x7A
 #define AXP192_BAT_ADC_CURRENT_OUT_REG      0x7C
 
+#define AXP192_APS_ADC_VOLTAGE_REG          0x7E
+
 #define AXP192_GPIO0_CTL_REG                0x90                   
 #define AXP192_GPIO0_VOLT_REG               0x91                   
 #define AXP192_GPIO1_CTL_REG                0x92                   
@@ -123,6 +133,46 @@ typedef enum {
     SPARE_CHARGE_Current_400uA = 0x03,    
 } Axp192_SpareChargeCurrent_t;
 
+/**
+ * @brief Channels of a power snapshot, as bit positions in
+ * Axp192_PowerSnapshot_t.valid.
+ */
+/* @[declare_axp192_powerchannel] */
+typedef enum {
+    AXP192_POWER_ACIN_VOLT = 0,  /**< @brief ACIN voltage. */
+    AXP192_POWER_ACIN_CURRENT,   /**< @brief ACIN current. */
+    AXP192_POWER_VBUS_VOLT,      /**< @brief VBUS voltage. */
+    AXP192_POWER_VBUS_CURRENT,   /**< @brief VBUS current. */
+    AXP192_POWER_TEMP,           /**< @brief Internal temperature. */
+    AXP192_POWER_BAT_POWER,      /**< @brief Battery power, needs battery voltage and current. */
+    AXP192_POWER_BAT_VOLT,       /**< @brief Battery voltage. */
+    AXP192_POWER_BAT_CURRENT,    /**< @brief Battery charge minus discharge current. */
+    AXP192_POWER_APS_VOLT,       /**< @brief APS (system supply) voltage. */
+    AXP192_POWER_CHANNELS,
+} Axp192_PowerChannel_t;
+/* @[declare_axp192_powerchannel] */
+
+/**
+ * @brief ADC results from one read, in integer units.
+ *
+ * Fields of channels whose ADC is disabled are 0 and their bit
+ * in valid is clear.
+ */
+/* @[declare_axp192_powersnapshot] */
+typedef struct {
+    uint16_t valid;       /**< @brief 1 << Axp192_PowerChannel_t for each channel read. */
+    uint16_t acin_mv;
+    uint16_t vbus_mv;
+    uint16_t bat_mv;
+    uint16_t aps_mv;
+    uint32_t acin_ua;
+    uint32_t vbus_ua;
+    int32_t bat_ua;       /**< @brief Positive while charging, negative while discharging. */
+    uint32_t bat_uw;      /**< @brief Battery power, either direction. */
+    int16_t temp_centi_c; /**< @brief Internal temperature in 0.01 degC, 0.1 degC steps. */
+} Axp192_PowerSnapshot_t;
+/* @[declare_axp192_powersnapshot] */
+
 /**
  * @brief List of possible durations the power button must
  * be held to power on the Core2 for AWS IoT EduKit.
@@ -368,6 +418,41 @@ float Axp192_GetAcinCurrent();
 float Axp192_GetBatCurrent();
 /* @[declare_axp192_getbatcurrent] */
 
+/**
+ * @brief Averages the battery current over a period.
+ *
+ * Samples the battery current ADC once per conversion for duration_ms
+ * and blocks the calling task meanwhile. Run on battery (USB unplugged)
+ * to get the load current; the result is negative while discharging,
+ * like Axp192_GetBatCurrent().
+ *
+ * @param[in] duration_ms Averaging period.
+ *
+ * @return Average battery current in mA.
+ */
+/* @[declare_axp192_getbatcurrentavg] */
+float Axp192_GetBatCurrentAvg(uint32_t duration_ms);
+/* @[declare_axp192_getbatcurrentavg] */
+
+/**
+ * @brief Reads every enabled ADC channel in one I2C burst.
+ *
+ * The results sit in one register block (0x56-0x7F); the span
+ * from the first to the last enabled channel is read in a single
+ * transaction and decoded without floating point, where the
+ * Axp192_Get*() functions each take a transaction of their own.
+ * The ADC enables come from the register cache, so they cost no
+ * bus traffic. The ADC updates at 25 Hz by default.
+ *
+ * @param[out] snapshot Decoded results.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_STATE when no channel is
+ * enabled, or ESP_FAIL when the read fails.
+ */
+/* @[declare_axp192_readpowersnapshot] */
+esp_err_t Axp192_ReadPowerSnapshot(Axp192_PowerSnapshot_t *snapshot);
+/* @[declare_axp192_readpowersnapshot] */
+
 /**
  * @brief Enables or disables the battery charging circuit 
  * on the AXP192.
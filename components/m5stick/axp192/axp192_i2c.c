@@ -5,9 +5,30 @@
 #define AXP192_ADDR (0x34)
 
 static I2CDevice_t axp192_device;
+static I2CReadTemplate_t axp192_burst_read;
+static uint8_t axp192_burst_reg;
+static uint16_t axp192_burst_length;
+
+// Registers the AXP192 changes on its own; everything else only holds
+// what the driver last wrote and is served from the shadow cache.
+static const i2c_reg_range_t axp192_volatile_regs[] = {
+    { 0x00, 0x02 }, // power / charge status
+    { 0x44, 0x0C }, // IRQ status 1-5 (plus enable 5 at 0x4A)
+    { 0x56, 0x2A }, // ADC results
+    { 0x8A, 0x01 }, // timer control, bit7 set by hardware
+    { 0x94, 0x01 }, // GPIO0-2 signal status
+    { 0x96, 0x01 }, // GPIO3-4 signal status
+    { 0xB0, 0x0C }, // coulomb counters
+};
 
 void Axp192_I2CInit() {
     axp192_device = i2c_malloc_device(I2C_NUM_0, GPIO_NUM_21, GPIO_NUM_22, 400000, AXP192_ADDR);
+    i2c_device_set_name(axp192_device, "AXP192");
+    i2c_device_enable_cache(axp192_device, axp192_volatile_regs, sizeof(axp192_volatile_regs) / sizeof(axp192_volatile_regs[0]));
+}
+
+void Axp192_GetCacheStats(i2c_reg_cache_stats_t *stats) {
+    i2c_device_get_cache_stats(axp192_device, stats);
 }
 
 bool Axp192_WriteBytes(uint8_t reg_addr, uint8_t *data, uint16_t length) {
@@ -23,20 +44,28 @@ void Axp192_Write8Bit(uint8_t reg_addr, uint8_t value) {
 }
 
 void Axp192_WriteBits(uint8_t reg_addr, uint8_t data, uint8_t bit_pos, uint8_t bit_length) {
-    if ((bit_pos + bit_length) > 8) {
-        return ;
-    }
+    i2c_write_bits(axp192_device, reg_addr, data, bit_pos, bit_length);
+}
 
-    uint8_t value = 0x00;
-    if (Axp192_ReadBytes(reg_addr, &value, 1) == false) {
-        return ;
+// The block only changes when the enabled ADC channels do, so its
+// template is kept until then. The bus lock (recursive for the template
+// read inside) keeps two callers from rebuilding it under each other.
+bool Axp192_ReadBurst(uint8_t reg_addr, uint8_t *data, uint16_t length) {
+    bool ok;
+    i2c_apply_bus(axp192_device);
+    if (axp192_burst_read == NULL || reg_addr != axp192_burst_reg || length != axp192_burst_length) {
+        i2c_free_read_template(axp192_burst_read);
+        axp192_burst_read = i2c_malloc_read_template(axp192_device, reg_addr, length);
+        axp192_burst_reg = reg_addr;
+        axp192_burst_length = length;
     }
-
-    value &= ~(((1 << bit_length) - 1) << bit_pos);
-    data &= (1 << bit_length) - 1;
-    value |= data << bit_pos;
-
-    Axp192_WriteBytes(reg_addr, &value, 1);
+    if (axp192_burst_read != NULL) {
+        ok = (i2c_read_template(axp192_burst_read, data) == ESP_OK);
+    } else {
+        ok = Axp192_ReadBytes(reg_addr, data, length);
+    }
+    i2c_free_bus(axp192_device);
+    return ok;
 }
 
 uint8_t Axp192_Read8Bit(uint8_t reg_addr) {
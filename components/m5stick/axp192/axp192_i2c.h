@@ -4,12 +4,24 @@
 extern "C" {
 #endif
 
+#include "stdbool.h"
 #include "stdint.h"
+#include "i2c_device.h"
+
 void Axp192_I2CInit();
 
-void Axp192_WriteBytes(uint8_t reg_addr, uint8_t *data, uint16_t length);
+void Axp192_GetCacheStats(i2c_reg_cache_stats_t *stats);
+
+bool Axp192_WriteBytes(uint8_t reg_addr, uint8_t *data, uint16_t length);
+
+bool Axp192_ReadBytes(uint8_t reg_addr, uint8_t *data, uint16_t length);
 
-void Axp192_ReadBytes(uint8_t reg_addr, uint8_t *data, uint16_t length);
+/*
+    One transaction from a pre-built read template, for register blocks
+    that are polled, like the ADC results. The template is rebuilt when
+    the block changes.
+*/
+bool Axp192_ReadBurst(uint8_t reg_addr, uint8_t *data, uint16_t length);
 
 void Axp192_Write8Bit(uint8_t reg_addr, uint8_t value);
 
@@ -0,0 +1,240 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+
+#include "i2c_device.h"
+
+#define TAG "I2C-ASYNC"
+
+#define I2C_ASYNC_QUEUE_LEN CONFIG_I2C_ASYNC_QUEUE_LEN
+
+typedef struct _i2c_request_t {
+    bool used;
+    uint32_t seq;
+    I2CDevice_t device;
+    i2c_op_t op;
+    uint32_t reg_addr;
+    uint8_t *data;
+    uint16_t length;
+    uint8_t priority;
+    i2c_done_cb_t callback;
+    void *arg;
+} i2c_request_t;
+
+/*
+    Completion of an i2c_submit_wait(), on the waiting task's stack. The
+    worker only touches it while the waiter is blocked on done.
+*/
+typedef struct {
+    SemaphoreHandle_t done;
+    esp_err_t err;
+} i2c_async_waiter_t;
+
+typedef struct _i2c_async_queue_t {
+    TaskHandle_t worker;
+    uint32_t next_seq;
+    i2c_request_t slot[I2C_ASYNC_QUEUE_LEN];
+} i2c_async_queue_t;
+
+static i2c_async_queue_t i2c_async_queue[I2C_NUM_MAX];
+static portMUX_TYPE i2c_async_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool i2c_request_before(const i2c_request_t *a, const i2c_request_t *b) {
+    if (a->priority != b->priority) {
+        return a->priority > b->priority;
+    }
+    return (int32_t)(a->seq - b->seq) < 0;
+}
+
+/*
+    Remove the next request to run. With device != NULL only a request
+    for that device is taken, and only if nothing of higher priority for
+    another device is waiting; this is what batches back-to-back
+    transfers under one bus acquisition.
+*/
+static bool i2c_async_pop(i2c_async_queue_t *queue, I2CDevice_t device, i2c_request_t *out) {
+    i2c_request_t *best = NULL;
+    i2c_request_t *best_same = NULL;
+
+    portENTER_CRITICAL(&i2c_async_lock);
+    for (uint8_t i = 0; i < I2C_ASYNC_QUEUE_LEN; i++) {
+        i2c_request_t *req = &queue->slot[i];
+        if (!req->used) {
+            continue;
+        }
+        if (best == NULL || i2c_request_before(req, best)) {
+            best = req;
+        }
+        if (req->device == device && (best_same == NULL || i2c_request_before(req, best_same))) {
+            best_same = req;
+        }
+    }
+
+    if (device != NULL) {
+        if (best_same != NULL && best_same->priority < best->priority) {
+            best_same = NULL;
+        }
+        best = best_same;
+    }
+
+    if (best != NULL) {
+        *out = *best;
+        best->used = false;
+    }
+    portEXIT_CRITICAL(&i2c_async_lock);
+    return best != NULL;
+}
+
+static void i2c_async_complete(const i2c_request_t *req, esp_err_t err) {
+    if (req->callback != NULL) {
+        req->callback(req->device, err, req->arg);
+    }
+}
+
+static void i2c_async_wake(I2CDevice_t i2c_device, esp_err_t err, void *arg) {
+    i2c_async_waiter_t *waiter = (i2c_async_waiter_t *)arg;
+    waiter->err = err;
+    xSemaphoreGive(waiter->done);
+}
+
+/* Take a request back out of the queue if the worker has not popped it. */
+static bool i2c_async_cancel(I2CDevice_t i2c_device, void *arg) {
+    i2c_async_queue_t *queue = &i2c_async_queue[i2c_device_get_port(i2c_device)];
+    bool cancelled = false;
+    portENTER_CRITICAL(&i2c_async_lock);
+    for (uint8_t i = 0; i < I2C_ASYNC_QUEUE_LEN; i++) {
+        i2c_request_t *req = &queue->slot[i];
+        if (req->used && req->callback == i2c_async_wake && req->arg == arg) {
+            req->used = false;
+            cancelled = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&i2c_async_lock);
+    return cancelled;
+}
+
+static esp_err_t i2c_async_run(const i2c_request_t *req) {
+    if (req->op == I2C_OP_READ) {
+        return i2c_read_bytes(req->device, req->reg_addr, req->data, req->length);
+    }
+    return i2c_write_bytes(req->device, req->reg_addr, req->data, req->length);
+}
+
+static void i2c_async_worker(void *pvParameters) {
+    i2c_async_queue_t *queue = (i2c_async_queue_t *)pvParameters;
+    i2c_request_t req;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (i2c_async_pop(queue, NULL, &req)) {
+            I2CDevice_t device = req.device;
+            // Hold the bus across every queued transfer for this device.
+            i2c_apply_bus(device);
+            do {
+                i2c_async_complete(&req, i2c_async_run(&req));
+            } while (i2c_async_pop(queue, device, &req));
+            i2c_free_bus(device);
+        }
+    }
+
+    vTaskDelete(NULL); // Should never get to here...
+}
+
+static esp_err_t i2c_async_start_worker(i2c_port_t port) {
+    i2c_async_queue_t *queue = &i2c_async_queue[port];
+    if (queue->worker != NULL) {
+        return ESP_OK;
+    }
+
+    TaskHandle_t worker = NULL;
+    char name[] = "i2c_async_0";
+    name[sizeof(name) - 2] = '0' + port;
+    if (xTaskCreate(i2c_async_worker, name, CONFIG_I2C_ASYNC_TASK_STACK, queue,
+                    CONFIG_I2C_ASYNC_TASK_PRIORITY, &worker) != pdPASS) {
+        ESP_LOGE(TAG, "worker for port %d not created", port);
+        return ESP_ERR_NO_MEM;
+    }
+
+    portENTER_CRITICAL(&i2c_async_lock);
+    bool lost_race = (queue->worker != NULL);
+    if (!lost_race) {
+        queue->worker = worker;
+    }
+    portEXIT_CRITICAL(&i2c_async_lock);
+
+    if (lost_race) {
+        vTaskDelete(worker);
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_submit(I2CDevice_t i2c_device, i2c_op_t op, uint32_t reg_addr, uint8_t *data, uint16_t length, i2c_done_cb_t callback, void *arg) {
+    if (i2c_device == NULL || (length > 0 && data == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    i2c_port_t port = i2c_device_get_port(i2c_device);
+    if (port >= I2C_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = i2c_async_start_worker(port);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    i2c_async_queue_t *queue = &i2c_async_queue[port];
+    err = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&i2c_async_lock);
+    for (uint8_t i = 0; i < I2C_ASYNC_QUEUE_LEN; i++) {
+        i2c_request_t *req = &queue->slot[i];
+        if (req->used) {
+            continue;
+        }
+        req->used = true;
+        req->seq = queue->next_seq++;
+        req->device = i2c_device;
+        req->op = op;
+        req->reg_addr = reg_addr;
+        req->data = data;
+        req->length = length;
+        req->priority = i2c_device_get_priority(i2c_device);
+        req->callback = callback;
+        req->arg = arg;
+        err = ESP_OK;
+        break;
+    }
+    portEXIT_CRITICAL(&i2c_async_lock);
+
+    if (err == ESP_OK) {
+        xTaskNotifyGive(queue->worker);
+    }
+    return err;
+}
+
+esp_err_t i2c_submit_wait(I2CDevice_t i2c_device, i2c_op_t op, uint32_t reg_addr, uint8_t *data, uint16_t length, TickType_t timeout) {
+    StaticSemaphore_t done_buffer;
+    i2c_async_waiter_t waiter = {
+        .done = xSemaphoreCreateBinaryStatic(&done_buffer),
+        .err = ESP_FAIL,
+    };
+    esp_err_t err = i2c_submit(i2c_device, op, reg_addr, data, length, i2c_async_wake, &waiter);
+    if (err == ESP_OK && xSemaphoreTake(waiter.done, timeout) != pdTRUE) {
+        if (i2c_async_cancel(i2c_device, &waiter)) {
+            err = ESP_ERR_TIMEOUT;
+        } else {
+            // Already on the bus, and it owns data and waiter: see it through.
+            xSemaphoreTake(waiter.done, portMAX_DELAY);
+        }
+    }
+    if (err == ESP_OK) {
+        err = waiter.err;
+    }
+    vSemaphoreDelete(waiter.done);
+    return err;
+}
@@ -1,12 +1,21 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/task.h"
 
 #include "driver/i2c.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 #include "esp_err.h"
 
+#include <string.h>
+
 #include "i2c_device.h"
 
+#if CONFIG_I2C_BUS_SIMULATOR
+#include "i2c_sim_driver.h"
+#endif
+
 #define TAG "I2C-DEVICE"
 
 #ifdef CONFIG_I2C_DEVICE_DEBUG_INFO
@@ -29,6 +38,16 @@
 
 #define I2C_TIMEOUT_MS (100)
 
+// Largest chain built by this file: START, addr, reg, START, addr, read, read(NACK), STOP.
+#define I2C_CMD_LINK_SIZE I2C_LINK_RECOMMENDED_SIZE(2)
+#define I2C_CMD_POOL_SIZE CONFIG_I2C_DEVICE_CMD_POOL_SIZE
+#define I2C_CMD_HEAP_SLOT (-1)
+
+// A read segment is at most 7 link entries (START, addr, reg, START, addr,
+// read, read NACK), a write segment 4; plus the closing STOP.
+#define I2C_TRANSFER_MAX_SEGMENTS CONFIG_I2C_TRANSFER_MAX_SEGMENTS
+#define I2C_BURST_LINK_SIZE I2C_LINK_RECOMMENDED_SIZE((7 * I2C_TRANSFER_MAX_SEGMENTS + 4) / 5)
+
 typedef struct _i2c_port_obj_t {
     i2c_port_t port;
     gpio_num_t scl;
@@ -36,46 +55,598 @@ typedef struct _i2c_port_obj_t {
     uint32_t freq;
 } i2c_port_obj_t;
 
+/*
+    Shadow of an 8-bit register map. A bit in cacheable marks a register
+    that only changes when the host writes it; valid marks which of
+    those currently hold a known value.
+*/
+typedef struct _i2c_reg_cache_t {
+    uint32_t cacheable[8];
+    uint32_t valid[8];
+    uint8_t value[256];
+    i2c_reg_cache_stats_t stats;
+} i2c_reg_cache_t;
+
 typedef struct _i2c_device_t {
     i2c_port_obj_t* i2c_port;
     uint8_t addr;
+    uint8_t priority;
+    uint32_t deadline_us;
+    i2c_reg_cache_t* cache;
+    const char* name;
+    i2c_device_stats_t stats;
+    struct _i2c_device_t* next;
 } i2c_device_t;
 
-static SemaphoreHandle_t i2c_mutex[I2C_NUM_MAX];
-static i2c_port_obj_t *i2c_port_used[2] = { NULL, NULL };
+#define I2C_UTIL_SLOTS (10)
+#define I2C_UTIL_SLOT_US (1000000)
+
+/*
+    Bus time is accumulated into I2C_UTIL_SLOTS one-second slots; the
+    utilization figure is the busy share of the last full window.
+*/
+typedef struct _i2c_port_stats_obj_t {
+    i2c_port_stats_t totals;
+    uint32_t slot_busy_us[I2C_UTIL_SLOTS];
+    int64_t slot_start_us;
+    uint8_t slot;
+} i2c_port_stats_obj_t;
+
+typedef struct _i2c_cmd_t {
+    i2c_cmd_handle_t handle;
+    int8_t slot;
+} i2c_cmd_t;
+
+typedef struct _i2c_read_template_t {
+    i2c_device_t* device;
+    uint32_t reg_addr;
+    uint16_t length;
+    WORD_ALIGNED_ATTR uint8_t link[I2C_CMD_LINK_SIZE];
+} i2c_read_template_t;
+
+/*
+    One entry per hardware controller. sda/scl/freq are what the
+    controller is muxed to right now; bus_sda/bus_scl is the physical
+    bus the allocator bound it to (GPIO_NUM_NC while unbound).
+*/
+typedef struct _i2c_controller_t {
+    bool installed;
+    gpio_num_t sda;
+    gpio_num_t scl;
+    uint32_t freq;
+    gpio_num_t bus_sda;
+    gpio_num_t bus_scl;
+    uint16_t bus_refs;
+    i2c_port_counters_t counters;
+} i2c_controller_t;
+
+#define I2C_ARB_AGING_US ((int64_t)CONFIG_I2C_ARB_AGING_MS * 1000)
+
+/*
+    A task blocked in i2c_arb_acquire(). Lives on the waiter's stack and
+    is linked into the port's list until the bus is handed to it.
+*/
+typedef struct _i2c_arb_waiter_t {
+    struct _i2c_arb_waiter_t* next;
+    TaskHandle_t task;
+    SemaphoreHandle_t grant;
+    uint8_t priority;
+    int64_t enqueued_us;
+    int64_t due_us;
+    bool granted;
+} i2c_arb_waiter_t;
+
+/*
+    Bus ownership per controller. Recursive for the owning task; on
+    release the bus is handed straight to the best waiter rather than
+    left for whichever task the scheduler runs first.
+*/
+typedef struct _i2c_arbiter_t {
+    TaskHandle_t owner;
+    uint32_t depth;
+    i2c_arb_waiter_t* waiters;
+    i2c_arb_stats_t stats;
+} i2c_arbiter_t;
+
+static i2c_arbiter_t i2c_arbiter[I2C_NUM_MAX];
+static portMUX_TYPE i2c_arbiter_lock = portMUX_INITIALIZER_UNLOCKED;
+static i2c_controller_t i2c_controller[I2C_NUM_MAX] = {
+    { .sda = GPIO_NUM_NC, .scl = GPIO_NUM_NC, .bus_sda = GPIO_NUM_NC, .bus_scl = GPIO_NUM_NC },
+    { .sda = GPIO_NUM_NC, .scl = GPIO_NUM_NC, .bus_sda = GPIO_NUM_NC, .bus_scl = GPIO_NUM_NC },
+};
+static portMUX_TYPE i2c_controller_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static i2c_device_t* i2c_device_list = NULL;
+static i2c_port_stats_obj_t i2c_port_stats[I2C_NUM_MAX];
+static portMUX_TYPE i2c_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint8_t *i2c_burst_link[I2C_NUM_MAX];
+
+static WORD_ALIGNED_ATTR uint8_t i2c_cmd_pool[(I2C_CMD_POOL_SIZE > 0) ? I2C_CMD_POOL_SIZE : 1][I2C_CMD_LINK_SIZE];
+static uint32_t i2c_cmd_pool_free = (1UL << I2C_CMD_POOL_SIZE) - 1;
+static uint8_t i2c_cmd_pool_in_use = 0;
+static i2c_cmd_pool_stats_t i2c_cmd_stats;
+static portMUX_TYPE i2c_cmd_pool_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/*
+    Take a command link from the static pool. Falls back to the heap
+    only when every slot is busy, which is counted in heap_allocs.
+*/
+static i2c_cmd_t i2c_cmd_acquire(void) {
+    i2c_cmd_t cmd = { .handle = NULL, .slot = I2C_CMD_HEAP_SLOT };
+
+    portENTER_CRITICAL(&i2c_cmd_pool_lock);
+    i2c_cmd_stats.transactions++;
+    if (i2c_cmd_pool_free != 0) {
+        cmd.slot = __builtin_ctz(i2c_cmd_pool_free);
+        i2c_cmd_pool_free &= ~(1UL << cmd.slot);
+        i2c_cmd_pool_in_use++;
+        i2c_cmd_stats.pool_hits++;
+        if (i2c_cmd_pool_in_use > i2c_cmd_stats.in_use_max) {
+            i2c_cmd_stats.in_use_max = i2c_cmd_pool_in_use;
+        }
+    } else {
+        i2c_cmd_stats.heap_allocs++;
+    }
+    portEXIT_CRITICAL(&i2c_cmd_pool_lock);
 
-I2CDevice_t i2c_malloc_device(i2c_port_t i2c_num, gpio_num_t sda, gpio_num_t scl, uint32_t freq, uint8_t device_addr) {
-    if (i2c_num > I2C_NUM_MAX) {
-        i2c_num = I2C_NUM_MAX;
+    if (cmd.slot == I2C_CMD_HEAP_SLOT) {
+        cmd.handle = i2c_cmd_link_create();
+    } else {
+        cmd.handle = i2c_cmd_link_create_static(i2c_cmd_pool[cmd.slot], I2C_CMD_LINK_SIZE);
+    }
+    return cmd;
+}
+
+static void i2c_cmd_release(i2c_cmd_t* cmd) {
+    if (cmd->slot == I2C_CMD_HEAP_SLOT) {
+        i2c_cmd_link_delete(cmd->handle);
+        return ;
     }
 
-    if (i2c_mutex[0] == NULL) {
-        i2c_mutex[0] = xSemaphoreCreateRecursiveMutex();
+    i2c_cmd_link_delete_static(cmd->handle);
+    portENTER_CRITICAL(&i2c_cmd_pool_lock);
+    i2c_cmd_pool_free |= 1UL << cmd->slot;
+    i2c_cmd_pool_in_use--;
+    portEXIT_CRITICAL(&i2c_cmd_pool_lock);
+}
+
+static esp_err_t i2c_build_read(i2c_cmd_handle_t cmd, i2c_device_t* device, uint32_t reg_addr, uint8_t *data, uint16_t length) {
+    esp_err_t err = ESP_OK;
+    if(!(reg_addr & I2C_NO_REG)){
+        err |= i2c_master_start(cmd);
+        err |= i2c_master_write_byte(cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
+        err |= i2c_master_write_byte(cmd, reg_addr, 1);
     }
 
-    if (i2c_mutex[1] == NULL) {
-        i2c_mutex[1] = xSemaphoreCreateRecursiveMutex(); 
+    err |= i2c_master_start(cmd);
+    err |= i2c_master_write_byte(cmd, (device->addr << 1) | I2C_MASTER_READ, 1);
+    if (length > 1) {
+        err |= i2c_master_read(cmd, data, length - 1, I2C_MASTER_ACK);
     }
+    if (length > 0) {
+        err |= i2c_master_read_byte(cmd, &data[length-1], I2C_MASTER_NACK);
+    }
+    err |= i2c_master_stop(cmd);
+    return (err == ESP_OK) ? ESP_OK : ESP_ERR_NO_MEM;
+}
 
+static esp_err_t i2c_build_write(i2c_cmd_handle_t cmd, i2c_device_t* device, uint32_t reg_addr, uint8_t *data, uint16_t length) {
+    esp_err_t err = ESP_OK;
+    err |= i2c_master_start(cmd);
+    err |= i2c_master_write_byte(cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
+    if(!(reg_addr & I2C_NO_REG)){
+        err |= i2c_master_write_byte(cmd, reg_addr, 1);
+    }
+    if (length > 0) {
+        err |= i2c_master_write(cmd, data, length, 1);
+    }
+    err |= i2c_master_stop(cmd);
+    return (err == ESP_OK) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static uint8_t i2c_arb_class(uint8_t priority) {
+    return (priority < I2C_PRIORITY_CLASSES) ? priority : (I2C_PRIORITY_CLASSES - 1);
+}
+
+/*
+    Order of service: waiters past their deadline first, earliest due
+    first; then by class, where every I2C_ARB_AGING_US of waiting lifts
+    a waiter one class so low priority traffic can't starve; then the
+    nearer deadline, then arrival.
+*/
+static bool i2c_arb_before(const i2c_arb_waiter_t* a, const i2c_arb_waiter_t* b, int64_t now) {
+    bool a_overdue = (a->due_us != 0) && (now >= a->due_us);
+    bool b_overdue = (b->due_us != 0) && (now >= b->due_us);
+    if (a_overdue != b_overdue) {
+        return a_overdue;
+    }
+    if (a_overdue) {
+        return a->due_us < b->due_us;
+    }
+
+    int64_t a_rank = a->priority + (now - a->enqueued_us) / I2C_ARB_AGING_US;
+    int64_t b_rank = b->priority + (now - b->enqueued_us) / I2C_ARB_AGING_US;
+    a_rank = (a_rank < I2C_PRIORITY_CLASSES) ? a_rank : (I2C_PRIORITY_CLASSES - 1);
+    b_rank = (b_rank < I2C_PRIORITY_CLASSES) ? b_rank : (I2C_PRIORITY_CLASSES - 1);
+    if (a_rank != b_rank) {
+        return a_rank > b_rank;
+    }
+    if (a->due_us != b->due_us) {
+        return (b->due_us == 0) || (a->due_us != 0 && a->due_us < b->due_us);
+    }
+    return a->enqueued_us <= b->enqueued_us;
+}
+
+static void i2c_arb_account(i2c_arbiter_t* arb, uint8_t priority, uint32_t wait, bool contended) {
+    arb->stats.acquisitions[priority]++;
+    arb->stats.wait_us[priority] += wait;
+    if (contended) {
+        arb->stats.contended[priority]++;
+    }
+    if (wait > arb->stats.wait_max_us[priority]) {
+        arb->stats.wait_max_us[priority] = wait;
+    }
+}
+
+// Called with i2c_arbiter_lock held and the bus just released.
+static i2c_arb_waiter_t* i2c_arb_handoff(i2c_arbiter_t* arb) {
+    int64_t now = esp_timer_get_time();
+    i2c_arb_waiter_t** best = NULL;
+    uint8_t top_priority = 0;
+    for (i2c_arb_waiter_t** it = &arb->waiters; *it != NULL; it = &(*it)->next) {
+        if ((*it)->priority > top_priority) {
+            top_priority = (*it)->priority;
+        }
+        if (best == NULL || i2c_arb_before(*it, *best, now)) {
+            best = it;
+        }
+    }
+    if (best == NULL) {
+        return NULL;
+    }
+
+    i2c_arb_waiter_t* waiter = *best;
+    *best = waiter->next;
+    bool overdue = (waiter->due_us != 0) && (now >= waiter->due_us);
+    if (overdue) {
+        arb->stats.deadline_misses++;
+    }
+    if (waiter->priority < top_priority) {
+        if (overdue) {
+            arb->stats.deadline_grants++;
+        } else {
+            arb->stats.aged_grants++;
+        }
+    }
+    arb->owner = waiter->task;
+    arb->depth = 1;
+    waiter->granted = true;
+    i2c_arb_account(arb, waiter->priority, (uint32_t)(now - waiter->enqueued_us), true);
+    return waiter;
+}
+
+/*
+    Take the bus on port for the calling task. device only supplies the
+    class and deadline; NULL is plain I2C_PRIORITY_NORMAL. wait_us, if
+    given, receives the time spent blocked.
+*/
+static bool i2c_arb_acquire(i2c_port_t port, i2c_device_t* device, TickType_t timeout, uint32_t* wait_us) {
+    i2c_arbiter_t* arb = &i2c_arbiter[port];
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    if (wait_us != NULL) {
+        *wait_us = 0;
+    }
+
+    portENTER_CRITICAL(&i2c_arbiter_lock);
+    uint8_t priority = i2c_arb_class(device ? device->priority : I2C_PRIORITY_NORMAL);
+    if (arb->owner == self) {
+        arb->depth++;
+        portEXIT_CRITICAL(&i2c_arbiter_lock);
+        return true;
+    }
+    if (arb->owner == NULL && arb->waiters == NULL) {
+        arb->owner = self;
+        arb->depth = 1;
+        i2c_arb_account(arb, priority, 0, false);
+        portEXIT_CRITICAL(&i2c_arbiter_lock);
+        return true;
+    }
+    if (timeout == 0) {
+        portEXIT_CRITICAL(&i2c_arbiter_lock);
+        return false;
+    }
+    portEXIT_CRITICAL(&i2c_arbiter_lock);
+
+    StaticSemaphore_t grant_buffer;
+    i2c_arb_waiter_t waiter = {
+        .next = NULL,
+        .task = self,
+        .grant = xSemaphoreCreateBinaryStatic(&grant_buffer),
+        .priority = priority,
+        .enqueued_us = esp_timer_get_time(),
+        .due_us = 0,
+        .granted = false,
+    };
+    if (device != NULL && device->deadline_us != 0) {
+        waiter.due_us = waiter.enqueued_us + device->deadline_us;
+    }
+
+    // waiter.granted is set by the releaser before its give, so only a
+    // grant taken here means no give is coming.
+    bool self_granted = false;
+    portENTER_CRITICAL(&i2c_arbiter_lock);
+    if (arb->owner == NULL) {
+        // Released while the waiter was being set up.
+        arb->owner = self;
+        arb->depth = 1;
+        waiter.granted = true;
+        self_granted = true;
+        i2c_arb_account(arb, priority, 0, false);
+    } else {
+        i2c_arb_waiter_t** tail = &arb->waiters;
+        while (*tail != NULL) {
+            tail = &(*tail)->next;
+        }
+        *tail = &waiter;
+    }
+    portEXIT_CRITICAL(&i2c_arbiter_lock);
+
+    bool signalled = self_granted || (xSemaphoreTake(waiter.grant, timeout) == pdTRUE);
+    if (!signalled) {
+        portENTER_CRITICAL(&i2c_arbiter_lock);
+        if (!waiter.granted) {
+            for (i2c_arb_waiter_t** it = &arb->waiters; *it != NULL; it = &(*it)->next) {
+                if (*it == &waiter) {
+                    *it = waiter.next;
+                    break;
+                }
+            }
+        }
+        portEXIT_CRITICAL(&i2c_arbiter_lock);
+        if (waiter.granted) {
+            // Handed over just as the wait timed out; the give is on its way.
+            xSemaphoreTake(waiter.grant, portMAX_DELAY);
+        }
+    }
+
+    vSemaphoreDelete(waiter.grant);
+    if (wait_us != NULL) {
+        *wait_us = (uint32_t)(esp_timer_get_time() - waiter.enqueued_us);
+    }
+    return waiter.granted;
+}
+
+static bool i2c_arb_release(i2c_port_t port) {
+    i2c_arbiter_t* arb = &i2c_arbiter[port];
+    i2c_arb_waiter_t* next = NULL;
+
+    portENTER_CRITICAL(&i2c_arbiter_lock);
+    if (arb->owner != xTaskGetCurrentTaskHandle() || arb->depth == 0) {
+        portEXIT_CRITICAL(&i2c_arbiter_lock);
+        return false;
+    }
+    if (--arb->depth == 0) {
+        arb->owner = NULL;
+        next = i2c_arb_handoff(arb);
+    }
+    portEXIT_CRITICAL(&i2c_arbiter_lock);
+
+    if (next != NULL) {
+        xSemaphoreGive(next->grant);
+    }
+    return true;
+}
+
+static uint8_t i2c_latency_bucket(uint32_t us) {
+    uint8_t bucket = 0;
+    if (us >= 32) {
+        bucket = (32 - __builtin_clz(us)) - 5;
+    }
+    return (bucket < I2C_STATS_LATENCY_BUCKETS) ? bucket : (I2C_STATS_LATENCY_BUCKETS - 1);
+}
+
+static void i2c_port_util_advance(i2c_port_stats_obj_t* port_stats, int64_t now) {
+    if (port_stats->slot_start_us == 0) {
+        port_stats->slot_start_us = now;
+    }
+    while ((now - port_stats->slot_start_us) >= I2C_UTIL_SLOT_US) {
+        port_stats->slot = (port_stats->slot + 1) % I2C_UTIL_SLOTS;
+        port_stats->slot_busy_us[port_stats->slot] = 0;
+        port_stats->slot_start_us += I2C_UTIL_SLOT_US;
+        if ((now - port_stats->slot_start_us) >= (int64_t)I2C_UTIL_SLOT_US * I2C_UTIL_SLOTS) {
+            memset(port_stats->slot_busy_us, 0, sizeof(port_stats->slot_busy_us));
+            port_stats->slot_start_us = now;
+        }
+    }
+}
+
+static void i2c_stats_record(i2c_device_t* device, esp_err_t err, uint32_t bytes, int64_t start_us, int64_t end_us) {
+    uint32_t busy = (uint32_t)(end_us - start_us);
+    i2c_port_stats_obj_t* port_stats = &i2c_port_stats[device->i2c_port->port];
+
+    portENTER_CRITICAL(&i2c_stats_lock);
+    i2c_device_stats_t* stats = &device->stats;
+    stats->transactions++;
+    stats->bytes += bytes;
+    stats->busy_us += busy;
+    stats->latency_hist[i2c_latency_bucket(busy)]++;
+    if (busy > stats->latency_max_us) {
+        stats->latency_max_us = busy;
+    }
+
+    port_stats->totals.transactions++;
+    port_stats->totals.bytes += bytes;
+    port_stats->totals.busy_us += busy;
+    if (err != ESP_OK) {
+        stats->errors++;
+        port_stats->totals.errors++;
+        if (err == ESP_ERR_TIMEOUT) {
+            stats->timeouts++;
+            port_stats->totals.timeouts++;
+        }
+    }
+    i2c_port_util_advance(port_stats, end_us);
+    port_stats->slot_busy_us[port_stats->slot] += busy;
+    portEXIT_CRITICAL(&i2c_stats_lock);
+}
+
+// Run a built chain with the bus already held, and account for it.
+static esp_err_t i2c_cmd_begin_timed(i2c_device_t* device, i2c_cmd_handle_t cmd, uint32_t bytes) {
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = i2c_master_cmd_begin(device->i2c_port->port, cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
+    i2c_stats_record(device, err, bytes, start, esp_timer_get_time());
+    return err;
+}
+
+/*
+    Build and run one register access. The pool slot is only taken once
+    the arbiter has granted the bus, so tasks queued for the bus don't
+    sit on slots and push the holder onto the heap.
+*/
+static esp_err_t i2c_cmd_run(i2c_device_t* device, i2c_op_t op, uint32_t reg_addr, uint8_t *data, uint16_t length) {
+    esp_err_t err = ESP_ERR_NO_MEM;
+    i2c_apply_bus((I2CDevice_t)device);
+    i2c_cmd_t cmd = i2c_cmd_acquire();
+    if (cmd.handle != NULL) {
+        if (op == I2C_OP_READ) {
+            err = i2c_build_read(cmd.handle, device, reg_addr, data, length);
+        } else {
+            err = i2c_build_write(cmd.handle, device, reg_addr, data, length);
+        }
+        if (err == ESP_OK) {
+            err = i2c_cmd_begin_timed(device, cmd.handle, length);
+        }
+        i2c_cmd_release(&cmd);
+    }
+    i2c_free_bus((I2CDevice_t)device);
+    return err;
+}
+
+static esp_err_t i2c_read_exec(i2c_device_t* device, uint32_t reg_addr, uint8_t *data, uint16_t length) {
+    esp_err_t err = i2c_cmd_run(device, I2C_OP_READ, reg_addr, data, length);
+
+    if (err != ESP_OK) {
+        log_e("I2C Read Error: 0x%02x, reg: 0x%02x, length: %d, Code: 0x%x", device->addr, reg_addr, length, err);
+    } else {
+        log_i("I2C Read Success: 0x%02x, reg: 0x%02x, length: %d", device->addr, reg_addr, length);
+        log_reg(data, length);
+    }
+
+    return err;
+}
+
+#if CONFIG_I2C_STATS_DUMP_PERIOD_S > 0
+static void i2c_stats_dump_cb(void *arg) {
+    i2c_stats_dump();
+}
+#endif
+
+static void i2c_stats_start_dump(void) {
+#if CONFIG_I2C_STATS_DUMP_PERIOD_S > 0
+    static esp_timer_handle_t dump_timer = NULL;
+    if (dump_timer != NULL) {
+        return ;
+    }
+    const esp_timer_create_args_t dump_timer_args = {
+        .callback = &i2c_stats_dump_cb,
+        .name = "i2c_stats"
+    };
+    if (esp_timer_create(&dump_timer_args, &dump_timer) == ESP_OK) {
+        esp_timer_start_periodic(dump_timer, (uint64_t)CONFIG_I2C_STATS_DUMP_PERIOD_S * 1000000);
+    }
+#endif
+}
+
+/*
+    Pick a controller for the bus on sda/scl. A bus that already owns a
+    controller keeps it; otherwise the requested port is used if free,
+    then any free port. Only when both controllers are bound to other
+    buses does the bus share the requested port and get re-muxed.
+*/
+static i2c_port_t i2c_alloc_port(i2c_port_t i2c_num, gpio_num_t sda, gpio_num_t scl) {
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX) {
+        i2c_num = I2C_NUM_0;
+    }
+
+    i2c_port_t port = I2C_NUM_MAX;
+    portENTER_CRITICAL(&i2c_controller_lock);
+    for (i2c_port_t i = 0; i < I2C_NUM_MAX; i++) {
+        if (i2c_controller[i].bus_sda == sda && i2c_controller[i].bus_scl == scl) {
+            port = i;
+            break;
+        }
+    }
+
+    if (port == I2C_NUM_MAX && i2c_controller[i2c_num].bus_refs == 0) {
+        port = i2c_num;
+    }
+
+    for (i2c_port_t i = 0; port == I2C_NUM_MAX && i < I2C_NUM_MAX; i++) {
+        if (i2c_controller[i].bus_refs == 0) {
+            port = i;
+        }
+    }
+
+    if (port == I2C_NUM_MAX) {
+        port = i2c_num;
+    } else {
+        i2c_controller[port].bus_sda = sda;
+        i2c_controller[port].bus_scl = scl;
+    }
+
+    if (i2c_controller[port].bus_sda == sda && i2c_controller[port].bus_scl == scl) {
+        i2c_controller[port].bus_refs++;
+    }
+    portEXIT_CRITICAL(&i2c_controller_lock);
+    return port;
+}
+
+static void i2c_release_port(i2c_port_obj_t* i2c_port) {
+    portENTER_CRITICAL(&i2c_controller_lock);
+    i2c_controller_t* controller = &i2c_controller[i2c_port->port];
+    if (controller->bus_sda == i2c_port->sda && controller->bus_scl == i2c_port->scl && controller->bus_refs > 0) {
+        controller->bus_refs--;
+        if (controller->bus_refs == 0) {
+            controller->bus_sda = GPIO_NUM_NC;
+            controller->bus_scl = GPIO_NUM_NC;
+        }
+    }
+    portEXIT_CRITICAL(&i2c_controller_lock);
+}
+
+I2CDevice_t i2c_malloc_device(i2c_port_t i2c_num, gpio_num_t sda, gpio_num_t scl, uint32_t freq, uint8_t device_addr) {
     i2c_port_obj_t* new_device_port = (i2c_port_obj_t *)malloc(sizeof(i2c_port_obj_t));
     if (new_device_port == NULL) {
         return NULL;
     }
 
-    new_device_port->sda = sda;
-    new_device_port->scl = scl;
-    new_device_port->freq = freq;
-    new_device_port->port = i2c_num;
-
     i2c_device_t* device = (i2c_device_t *)malloc(sizeof(i2c_device_t));
     if (device == NULL) {
+        free(new_device_port);
         return NULL;
     }
 
+    new_device_port->sda = sda;
+    new_device_port->scl = scl;
+    new_device_port->freq = freq;
+    new_device_port->port = i2c_alloc_port(i2c_num, sda, scl);
+
     device->i2c_port = new_device_port;
     device->addr = device_addr;
-    log_i("New device malloc, scl: %d, sda: %d, freq: %d HZ",
-        device->i2c_port->scl, device->i2c_port->sda, device->i2c_port->freq);
+    device->priority = I2C_PRIORITY_NORMAL;
+    device->deadline_us = 0;
+    device->cache = NULL;
+    device->name = NULL;
+    memset(&device->stats, 0, sizeof(device->stats));
+
+    portENTER_CRITICAL(&i2c_stats_lock);
+    device->next = i2c_device_list;
+    i2c_device_list = device;
+    portEXIT_CRITICAL(&i2c_stats_lock);
+    i2c_stats_start_dump();
+    log_i("New device malloc, port: %d, scl: %d, sda: %d, freq: %d HZ",
+        device->i2c_port->port, device->i2c_port->scl, device->i2c_port->sda, device->i2c_port->freq);
 
     return (I2CDevice_t)device;
 }
@@ -84,24 +655,72 @@ void i2c_free_device(I2CDevice_t i2c_device) {
     if (i2c_device == NULL) {
         return ;
     }
+
+    portENTER_CRITICAL(&i2c_stats_lock);
+    for (i2c_device_t** it = &i2c_device_list; *it != NULL; it = &(*it)->next) {
+        if (*it == (i2c_device_t *)i2c_device) {
+            *it = (*it)->next;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&i2c_stats_lock);
+    i2c_release_port(((i2c_device_t *)i2c_device)->i2c_port);
+    free(((i2c_device_t *)i2c_device)->cache);
     free(((i2c_device_t *)i2c_device)->i2c_port);
     free(i2c_device);
 }
 
+i2c_port_t i2c_device_get_port(I2CDevice_t i2c_device) {
+    if (i2c_device == NULL) {
+        return I2C_NUM_MAX;
+    }
+    return ((i2c_device_t *)i2c_device)->i2c_port->port;
+}
+
+void i2c_device_set_priority(I2CDevice_t i2c_device, uint8_t priority) {
+    if (i2c_device == NULL) {
+        return ;
+    }
+    ((i2c_device_t *)i2c_device)->priority = priority;
+}
+
+void i2c_device_set_deadline(I2CDevice_t i2c_device, uint32_t max_wait_us) {
+    if (i2c_device == NULL) {
+        return ;
+    }
+    ((i2c_device_t *)i2c_device)->deadline_us = max_wait_us;
+}
+
+uint8_t i2c_device_get_priority(I2CDevice_t i2c_device) {
+    if (i2c_device == NULL) {
+        return 0;
+    }
+    return ((i2c_device_t *)i2c_device)->priority;
+}
+
+void i2c_get_port_counters(i2c_port_t i2c_num, i2c_port_counters_t *counters) {
+    if (counters == NULL || i2c_num < 0 || i2c_num >= I2C_NUM_MAX) {
+        return ;
+    }
+    portENTER_CRITICAL(&i2c_controller_lock);
+    *counters = i2c_controller[i2c_num].counters;
+    portEXIT_CRITICAL(&i2c_controller_lock);
+}
+
 BaseType_t i2c_take_port(i2c_port_t i2c_num, uint32_t timeout) {
-    if (i2c_mutex[i2c_num] == NULL) {
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX) {
         return pdFAIL;
     }
 
-    return xSemaphoreTakeRecursive(i2c_mutex[i2c_num], timeout);
+    return i2c_arb_acquire(i2c_num, NULL, timeout, NULL) ? pdPASS : pdFAIL;
 }
 
 BaseType_t i2c_free_port(i2c_port_t i2c_num) {
-    if (i2c_mutex[i2c_num] == NULL) {
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX) {
         return pdFAIL;
     }
 
-    return xSemaphoreGiveRecursive(i2c_mutex[i2c_num]);
+    return i2c_arb_release(i2c_num) ? pdPASS : pdFAIL;
 }
 
 esp_err_t i2c_apply_bus(I2CDevice_t i2c_device) {
@@ -110,27 +729,21 @@ esp_err_t i2c_apply_bus(I2CDevice_t i2c_device) {
     }
 
     i2c_device_t* device = (i2c_device_t *)i2c_device;
-    xSemaphoreTakeRecursive(i2c_mutex[device->i2c_port->port], portMAX_DELAY);
-    i2c_port_obj_t* used_port = i2c_port_used[device->i2c_port->port];
-    
-    if (used_port == device->i2c_port) {
-        return ESP_OK;
-    }
-
-    if ((used_port != NULL) && 
-        (device->i2c_port->sda == used_port->sda) && 
-        (device->i2c_port->scl == used_port->scl) && 
-        ((device->i2c_port->freq == used_port->freq))) {
-            i2c_port_used[device->i2c_port->port] = device->i2c_port;
-            return ESP_OK;    
+    uint32_t wait = 0;
+    i2c_arb_acquire(device->i2c_port->port, device, portMAX_DELAY, &wait);
+    portENTER_CRITICAL(&i2c_stats_lock);
+    device->stats.wait_us += wait;
+    if (wait > device->stats.wait_max_us) {
+        device->stats.wait_max_us = wait;
     }
-
-    if (used_port != NULL) {
-        i2c_driver_delete(device->i2c_port->port);
-        if ((device->i2c_port->sda != used_port->sda) || (device->i2c_port->scl != used_port->scl)) {
-            gpio_reset_pin(used_port->sda);
-            gpio_reset_pin(used_port->scl);
-        }
+    portEXIT_CRITICAL(&i2c_stats_lock);
+    i2c_controller_t* controller = &i2c_controller[device->i2c_port->port];
+
+    if (controller->installed &&
+        (device->i2c_port->sda == controller->sda) &&
+        (device->i2c_port->scl == controller->scl) &&
+        (device->i2c_port->freq == controller->freq)) {
+            return ESP_OK;
     }
 
     i2c_config_t conf = {
@@ -142,12 +755,27 @@ esp_err_t i2c_apply_bus(I2CDevice_t i2c_device) {
         .master.clk_speed = device->i2c_port->freq,
     };
 
-    i2c_param_config(device->i2c_port->port, &conf);
-    i2c_driver_install(device->i2c_port->port, I2C_MODE_MASTER, 0, 0, 0);
+    if (controller->installed) {
+        // Shared controller: detach the old pads from the I2C signals and
+        // reprogram pins and timing in place, leaving the driver installed.
+        if ((device->i2c_port->sda != controller->sda) || (device->i2c_port->scl != controller->scl)) {
+            gpio_reset_pin(controller->sda);
+            gpio_reset_pin(controller->scl);
+        }
+        i2c_param_config(device->i2c_port->port, &conf);
+        controller->counters.reconfigs++;
+    } else {
+        i2c_param_config(device->i2c_port->port, &conf);
+        i2c_driver_install(device->i2c_port->port, I2C_MODE_MASTER, 0, 0, 0);
+        controller->installed = true;
+        controller->counters.driver_installs++;
+    }
 
-    i2c_port_used[device->i2c_port->port] = device->i2c_port;
-    log_i("I2C config update, scl: %d, sda: %d, freq: %d HZ",
-            device->i2c_port->scl, device->i2c_port->sda, device->i2c_port->freq);
+    controller->sda = device->i2c_port->sda;
+    controller->scl = device->i2c_port->scl;
+    controller->freq = device->i2c_port->freq;
+    log_i("I2C config update, port: %d, scl: %d, sda: %d, freq: %d HZ",
+            device->i2c_port->port, device->i2c_port->scl, device->i2c_port->sda, device->i2c_port->freq);
     return ESP_OK;
 }
 
@@ -156,93 +784,153 @@ esp_err_t i2c_free_bus(I2CDevice_t i2c_device) {
         return ESP_ERR_INVALID_ARG;
     }
     i2c_device_t* device = (i2c_device_t *)i2c_device;
-    return (xSemaphoreGiveRecursive(i2c_mutex[device->i2c_port->port]) == pdTRUE) ? ESP_OK : ESP_FAIL;
+    return i2c_arb_release(device->i2c_port->port) ? ESP_OK : ESP_FAIL;
 }
 
-esp_err_t i2c_read_bytes(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t *data, uint16_t length) {
-    if (i2c_device == NULL || (length > 0 && data == NULL)) {
-        return ESP_ERR_INVALID_ARG;
+#define I2C_REG_BIT_TEST(map, reg) (((map)[(reg) >> 5] >> ((reg) & 0x1f)) & 0x01)
+#define I2C_REG_BIT_SET(map, reg) ((map)[(reg) >> 5] |= (1UL << ((reg) & 0x1f)))
+#define I2C_REG_BIT_CLEAR(map, reg) ((map)[(reg) >> 5] &= ~(1UL << ((reg) & 0x1f)))
+
+static bool i2c_cache_covers(i2c_reg_cache_t* cache, uint32_t reg_addr, uint16_t length) {
+    if ((reg_addr & I2C_NO_REG) || length == 0 || (reg_addr + length) > 256) {
+        return false;
     }
+    for (uint32_t reg = reg_addr; reg < reg_addr + length; reg++) {
+        if (!I2C_REG_BIT_TEST(cache->cacheable, reg)) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    i2c_device_t* device = (i2c_device_t *)i2c_device;
+static bool i2c_cache_valid(i2c_reg_cache_t* cache, uint32_t reg_addr, uint16_t length) {
+    for (uint32_t reg = reg_addr; reg < reg_addr + length; reg++) {
+        if (!I2C_REG_BIT_TEST(cache->valid, reg)) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+static void i2c_cache_store(i2c_reg_cache_t* cache, uint32_t reg_addr, const uint8_t *data, uint16_t length) {
+    if ((reg_addr & I2C_NO_REG) || data == NULL) {
+        return ;
+    }
+    for (uint32_t i = 0; i < length && (reg_addr + i) < 256; i++) {
+        uint32_t reg = reg_addr + i;
+        if (I2C_REG_BIT_TEST(cache->cacheable, reg)) {
+            cache->value[reg] = data[i];
+            I2C_REG_BIT_SET(cache->valid, reg);
+        }
+    }
+}
 
-    if(!(reg_addr & I2C_NO_REG)){
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
-        i2c_master_write_byte(cmd, reg_addr, 1);
+static void i2c_cache_drop(i2c_reg_cache_t* cache, uint32_t reg_addr, uint16_t length) {
+    if (reg_addr & I2C_NO_REG) {
+        // A register-less transfer may have touched anything.
+        memset(cache->valid, 0, sizeof(cache->valid));
+        return ;
     }
- 
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (device->addr << 1) | I2C_MASTER_READ, 1);
-    if (length > 1) {
-        i2c_master_read(cmd, data, length - 1, I2C_MASTER_ACK);
+    for (uint32_t reg = reg_addr; reg < reg_addr + length && reg < 256; reg++) {
+        I2C_REG_BIT_CLEAR(cache->valid, reg);
     }
-    if (length > 0) {
-        i2c_master_read_byte(cmd, &data[length-1], I2C_MASTER_NACK);
+}
+
+esp_err_t i2c_device_enable_cache(I2CDevice_t i2c_device, const i2c_reg_range_t *volatile_regs, size_t count) {
+    if (i2c_device == NULL || (count > 0 && volatile_regs == NULL)) {
+        return ESP_ERR_INVALID_ARG;
     }
-    i2c_master_stop(cmd);
-    i2c_apply_bus(i2c_device);
-    
-    esp_err_t err = ESP_FAIL;
 
-    err = i2c_master_cmd_begin(device->i2c_port->port, cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
-    i2c_free_bus(i2c_device);
-    i2c_cmd_link_delete(cmd);
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    i2c_reg_cache_t* cache = (i2c_reg_cache_t *)calloc(1, sizeof(i2c_reg_cache_t));
+    if (cache == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
 
-    if (err != ESP_OK) {
-        log_e("I2C Read Error: 0x%02x, reg: 0x%02x, length: %d, Code: 0x%x", device->addr, reg_addr, length, err);
-    } else {
-        log_i("I2C Read Success: 0x%02x, reg: 0x%02x, length: %d", device->addr, reg_addr, length);
-        log_reg(data, length);
+    memset(cache->cacheable, 0xff, sizeof(cache->cacheable));
+    for (size_t i = 0; i < count; i++) {
+        for (uint32_t reg = volatile_regs[i].start; reg < (uint32_t)volatile_regs[i].start + volatile_regs[i].count && reg < 256; reg++) {
+            I2C_REG_BIT_CLEAR(cache->cacheable, reg);
+        }
     }
 
-    return err;
+    i2c_arb_acquire(device->i2c_port->port, device, portMAX_DELAY, NULL);
+    free(device->cache);
+    device->cache = cache;
+    i2c_arb_release(device->i2c_port->port);
+    return ESP_OK;
 }
 
-esp_err_t i2c_read_bytes_no_stop(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t *data, uint16_t length) {
-    if (i2c_device == NULL || (length > 0 && data == NULL)) {
-        return ESP_ERR_INVALID_ARG;
+void i2c_device_cache_invalidate(I2CDevice_t i2c_device, uint32_t reg_addr, uint16_t length) {
+    if (i2c_device == NULL) {
+        return ;
     }
 
     i2c_device_t* device = (i2c_device_t *)i2c_device;
+    i2c_arb_acquire(device->i2c_port->port, device, portMAX_DELAY, NULL);
+    if (device->cache != NULL) {
+        i2c_cache_drop(device->cache, reg_addr, length);
+    }
+    i2c_arb_release(device->i2c_port->port);
+}
 
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    
-    if(!(reg_addr & I2C_NO_REG)){
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
-        i2c_master_write_byte(cmd, reg_addr, 1);
+void i2c_device_cache_invalidate_all(I2CDevice_t i2c_device) {
+    i2c_device_cache_invalidate(i2c_device, I2C_NO_REG, 0);
+}
+
+void i2c_device_get_cache_stats(I2CDevice_t i2c_device, i2c_reg_cache_stats_t *stats) {
+    if (i2c_device == NULL || stats == NULL) {
+        return ;
     }
 
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (device->addr << 1) | I2C_MASTER_READ, 1);
-    if (length > 1) {
-        i2c_master_read(cmd, data, length - 1, I2C_MASTER_ACK);
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    memset(stats, 0, sizeof(i2c_reg_cache_stats_t));
+    i2c_arb_acquire(device->i2c_port->port, device, portMAX_DELAY, NULL);
+    if (device->cache != NULL) {
+        *stats = device->cache->stats;
     }
-    if (length > 0) {
-        i2c_master_read_byte(cmd, &data[length-1], I2C_MASTER_NACK);
+    i2c_arb_release(device->i2c_port->port);
+}
+
+esp_err_t i2c_read_bytes(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t *data, uint16_t length) {
+    if (i2c_device == NULL || (length > 0 && data == NULL)) {
+        return ESP_ERR_INVALID_ARG;
     }
-    i2c_master_stop(cmd);
-    i2c_apply_bus(i2c_device);
 
-    esp_err_t err = ESP_FAIL;
-    
-    err = i2c_master_cmd_begin(device->i2c_port->port, cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
-    i2c_free_bus(i2c_device);
-    i2c_cmd_link_delete(cmd);
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    if (device->cache == NULL) {
+        return i2c_read_exec(device, reg_addr, data, length);
+    }
 
-    if (err != ESP_OK) {
-        log_e("I2C Read Error: 0x%02x, reg: 0x%02x, length: %d, Code: 0x%x", device->addr, reg_addr, length, err);
+    // The bus lock also guards the shadow, so a concurrent write can't
+    // land between the bus read and the cache fill.
+    esp_err_t err = ESP_OK;
+    i2c_arb_acquire(device->i2c_port->port, device, portMAX_DELAY, NULL);
+    if (!i2c_cache_covers(device->cache, reg_addr, length)) {
+        device->cache->stats.bypass++;
+        err = i2c_read_exec(device, reg_addr, data, length);
+    } else if (i2c_cache_valid(device->cache, reg_addr, length)) {
+        device->cache->stats.hits++;
+        memcpy(data, &device->cache->value[reg_addr], length);
     } else {
-        log_i("I2C Read Success: 0x%02x, reg: 0x%02x, length: %d", device->addr, reg_addr, length);
-        log_reg(data, length);
+        device->cache->stats.misses++;
+        err = i2c_read_exec(device, reg_addr, data, length);
+        if (err == ESP_OK) {
+            i2c_cache_store(device->cache, reg_addr, data, length);
+        }
     }
-
+    i2c_arb_release(device->i2c_port->port);
     return err;
 }
 
+esp_err_t i2c_read_bytes_no_stop(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t *data, uint16_t length) {
+    if (i2c_device == NULL || (length > 0 && data == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return i2c_read_exec((i2c_device_t *)i2c_device, reg_addr, data, length);
+}
+
 esp_err_t i2c_read_byte(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t* data) {
     return i2c_read_bytes(i2c_device, reg_addr, data, 1);
 }
@@ -288,24 +976,17 @@ esp_err_t i2c_write_bytes(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t *da
 
     i2c_device_t* device = (i2c_device_t *)i2c_device;
 
-    i2c_cmd_handle_t write_cmd = i2c_cmd_link_create();
-    i2c_master_start(write_cmd);
-    i2c_master_write_byte(write_cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
-    if(!(reg_addr & I2C_NO_REG)){
-        i2c_master_write_byte(write_cmd, reg_addr, 1);
-    }
-    if (length > 0) {
-        i2c_master_write(write_cmd, data, length, 1);
+    i2c_arb_acquire(device->i2c_port->port, device, portMAX_DELAY, NULL);
+    esp_err_t err = i2c_cmd_run(device, I2C_OP_WRITE, reg_addr, data, length);
+    if (device->cache != NULL) {
+        // Write-through; on failure the register state is unknown.
+        if (err == ESP_OK) {
+            i2c_cache_store(device->cache, reg_addr, data, length);
+        } else {
+            i2c_cache_drop(device->cache, reg_addr, length);
+        }
     }
-    i2c_master_stop(write_cmd);
-
-    esp_err_t err = ESP_FAIL;
-
-    i2c_apply_bus(i2c_device);
-    err = i2c_master_cmd_begin(device->i2c_port->port, write_cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
-    i2c_free_bus(i2c_device);
-
-    i2c_cmd_link_delete(write_cmd);
+    i2c_arb_release(device->i2c_port->port);
 
     if (err != ESP_OK) {
         log_e("I2C Write Error, addr: 0x%02x, reg: 0x%02x, length: %d, Code: 0x%x", device->addr, reg_addr, length, err);
@@ -322,35 +1003,132 @@ esp_err_t i2c_write_byte(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t data
 }
 
 esp_err_t i2c_write_bit(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t data, uint8_t bit_pos) {
-    uint8_t value = 0x00;
-    esp_err_t err = ESP_FAIL;
-    err = i2c_read_byte(i2c_device, reg_addr, &value);
-    if (err != ESP_OK) {
-        return err;
-    }
-
-    value &= ~(1 << bit_pos);
-    value |= (data & 0x01) << bit_pos;
-    return i2c_write_byte(i2c_device, reg_addr, value);
+    return i2c_write_bits(i2c_device, reg_addr, data & 0x01, bit_pos, 1);
 }
 
+/*
+    The read and write are done under one port lock so the update is
+    atomic against other tasks. On a cached device the read is usually
+    served from the shadow and only the write reaches the bus.
+*/
 esp_err_t i2c_write_bits(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t data, uint8_t bit_pos, uint8_t bit_length) {
     if ((bit_pos + bit_length) > 8) {
         return ESP_FAIL;
     }
+    if (i2c_device == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
+    i2c_port_t port = ((i2c_device_t *)i2c_device)->i2c_port->port;
     uint8_t value = 0x00;
     esp_err_t err = ESP_FAIL;
+    i2c_arb_acquire(port, (i2c_device_t *)i2c_device, portMAX_DELAY, NULL);
     err = i2c_read_byte(i2c_device, reg_addr, &value);
-    if (err != ESP_OK) {
-        return err;
+    if (err == ESP_OK) {
+        value &= ~(((1 << bit_length) - 1) << bit_pos);
+        data &= (1 << bit_length) - 1;
+        value |= data << bit_pos;
+
+        err = i2c_write_byte(i2c_device, reg_addr, value);
+    }
+    i2c_arb_release(port);
+    return err;
+}
+
+static esp_err_t i2c_build_segments(i2c_cmd_handle_t cmd, i2c_device_t* device, const i2c_segment_t *segments, size_t count) {
+    esp_err_t err = ESP_OK;
+    for (size_t i = 0; i < count; i++) {
+        const i2c_segment_t *seg = &segments[i];
+        bool has_reg = !(seg->reg_addr & I2C_NO_REG);
+
+        // The first START opens the chain; later ones are repeated STARTs.
+        err |= i2c_master_start(cmd);
+        if (seg->op == I2C_OP_WRITE) {
+            err |= i2c_master_write_byte(cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
+            if (has_reg) {
+                err |= i2c_master_write_byte(cmd, seg->reg_addr, 1);
+            }
+            if (seg->length > 0) {
+                err |= i2c_master_write(cmd, seg->data, seg->length, 1);
+            }
+            continue;
+        }
+
+        if (has_reg) {
+            err |= i2c_master_write_byte(cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
+            err |= i2c_master_write_byte(cmd, seg->reg_addr, 1);
+            err |= i2c_master_start(cmd);
+        }
+        err |= i2c_master_write_byte(cmd, (device->addr << 1) | I2C_MASTER_READ, 1);
+        if (seg->length > 1) {
+            err |= i2c_master_read(cmd, seg->data, seg->length - 1, I2C_MASTER_ACK);
+        }
+        if (seg->length > 0) {
+            err |= i2c_master_read_byte(cmd, &seg->data[seg->length - 1], I2C_MASTER_NACK);
+        }
+    }
+    err |= i2c_master_stop(cmd);
+    return (err == ESP_OK) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t i2c_transfer(I2CDevice_t i2c_device, const i2c_segment_t *segments, size_t count) {
+    if (i2c_device == NULL || segments == NULL || count == 0 || count > I2C_TRANSFER_MAX_SEGMENTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if ((segments[i].length > 0 && segments[i].data == NULL) ||
+            (segments[i].op == I2C_OP_READ && segments[i].length == 0)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    i2c_port_t port = device->i2c_port->port;
+    esp_err_t err = ESP_ERR_NO_MEM;
+
+    // The burst link is per controller and only touched with the bus held.
+    i2c_apply_bus(i2c_device);
+    if (i2c_burst_link[port] == NULL) {
+        i2c_burst_link[port] = (uint8_t *)malloc(I2C_BURST_LINK_SIZE);
+    }
+
+    i2c_cmd_handle_t cmd = NULL;
+    if (i2c_burst_link[port] != NULL) {
+        cmd = i2c_cmd_link_create_static(i2c_burst_link[port], I2C_BURST_LINK_SIZE);
+    }
+    if (cmd != NULL) {
+        uint32_t bytes = 0;
+        for (size_t i = 0; i < count; i++) {
+            bytes += segments[i].length;
+        }
+        err = i2c_build_segments(cmd, device, segments, count);
+        if (err == ESP_OK) {
+            err = i2c_cmd_begin_timed(device, cmd, bytes);
+        }
+        i2c_cmd_link_delete_static(cmd);
     }
 
-    value &= ~(((1 << bit_length) - 1) << bit_pos);
-    data &= (1 << bit_length) - 1;
-    value |= data << bit_pos;
+    if (device->cache != NULL) {
+        for (size_t i = 0; i < count; i++) {
+            if (err != ESP_OK) {
+                i2c_cache_drop(device->cache, segments[i].reg_addr, segments[i].length);
+            } else if (segments[i].op == I2C_OP_WRITE || i2c_cache_covers(device->cache, segments[i].reg_addr, segments[i].length)) {
+                i2c_cache_store(device->cache, segments[i].reg_addr, segments[i].data, segments[i].length);
+            }
+        }
+    }
+    i2c_free_bus(i2c_device);
 
-    return i2c_write_byte(i2c_device, reg_addr, value);
+    portENTER_CRITICAL(&i2c_cmd_pool_lock);
+    i2c_cmd_stats.transactions++;
+    portEXIT_CRITICAL(&i2c_cmd_pool_lock);
+
+    if (err != ESP_OK) {
+        log_e("I2C Transfer Error: 0x%02x, segments: %d, Code: 0x%x", device->addr, count, err);
+    } else {
+        log_i("I2C Transfer Success: 0x%02x, segments: %d", device->addr, count);
+    }
+    return err;
 }
 
 esp_err_t i2c_device_change_freq(I2CDevice_t i2c_device, uint32_t freq) {
@@ -358,17 +1136,11 @@ esp_err_t i2c_device_change_freq(I2CDevice_t i2c_device, uint32_t freq) {
         return ESP_FAIL;
     }
     i2c_device_t* device = (i2c_device_t *)i2c_device;
-    xSemaphoreTakeRecursive(i2c_mutex[device->i2c_port->port], portMAX_DELAY);
-    if (device->i2c_port->freq == freq) {
-        xSemaphoreGiveRecursive(i2c_mutex[device->i2c_port->port]);
-        return ESP_OK;
-    }
-
+    // i2c_apply_bus() compares against the controller's live timing, so
+    // the new rate is programmed on this device's next transaction.
+    i2c_arb_acquire(device->i2c_port->port, device, portMAX_DELAY, NULL);
     device->i2c_port->freq = freq;
-    if (i2c_port_used[device->i2c_port->port] == device->i2c_port) {
-        i2c_port_used[device->i2c_port->port] = NULL;
-    }
-    xSemaphoreGiveRecursive(i2c_mutex[device->i2c_port->port]);
+    i2c_arb_release(device->i2c_port->port);
     return ESP_OK;
 }
 
@@ -377,19 +1149,201 @@ esp_err_t i2c_device_valid(I2CDevice_t i2c_device) {
         return ESP_FAIL;
     }
 
-    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    return i2c_cmd_run((i2c_device_t *)i2c_device, I2C_OP_WRITE, I2C_NO_REG, NULL, 0);
+}
 
-    i2c_cmd_handle_t write_cmd = i2c_cmd_link_create();
-    i2c_master_start(write_cmd);
-    i2c_master_write_byte(write_cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
-    i2c_master_stop(write_cmd);
+I2CReadTemplate_t i2c_malloc_read_template(I2CDevice_t i2c_device, uint32_t reg_addr, uint16_t length) {
+    if (i2c_device == NULL || length == 0) {
+        return NULL;
+    }
 
-    esp_err_t err = ESP_FAIL;
+    i2c_read_template_t* tmpl = (i2c_read_template_t *)malloc(sizeof(i2c_read_template_t));
+    if (tmpl == NULL) {
+        return NULL;
+    }
 
-    i2c_apply_bus(i2c_device);
-    err = i2c_master_cmd_begin(device->i2c_port->port, write_cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
-    i2c_free_bus(i2c_device);
+    tmpl->device = (i2c_device_t *)i2c_device;
+    tmpl->reg_addr = reg_addr;
+    tmpl->length = length;
+    return (I2CReadTemplate_t)tmpl;
+}
+
+void i2c_free_read_template(I2CReadTemplate_t i2c_template) {
+    free(i2c_template);
+}
+
+esp_err_t i2c_read_template(I2CReadTemplate_t i2c_template, uint8_t *data) {
+    if (i2c_template == NULL || data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    i2c_read_template_t* tmpl = (i2c_read_template_t *)i2c_template;
+    i2c_device_t* device = tmpl->device;
+
+    // The driver advances per-command cursors while it runs a link, so
+    // a finished chain can't be replayed as-is. Re-emit it into the
+    // template's own storage instead, pointing the read at the caller's
+    // buffer; no heap and no pool slot is touched. The storage is only
+    // written while the bus is held, so concurrent callers serialize.
+    esp_err_t err = ESP_ERR_NO_MEM;
+    i2c_apply_bus((I2CDevice_t)device);
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(tmpl->link, sizeof(tmpl->link));
+    if (cmd != NULL) {
+        err = i2c_build_read(cmd, device, tmpl->reg_addr, data, tmpl->length);
+        if (err == ESP_OK) {
+            err = i2c_cmd_begin_timed(device, cmd, tmpl->length);
+        }
+        i2c_cmd_link_delete_static(cmd);
+    }
+    i2c_free_bus((I2CDevice_t)device);
+
+    portENTER_CRITICAL(&i2c_cmd_pool_lock);
+    i2c_cmd_stats.transactions++;
+    i2c_cmd_stats.template_runs++;
+    portEXIT_CRITICAL(&i2c_cmd_pool_lock);
 
-    i2c_cmd_link_delete(write_cmd);
+    if (err != ESP_OK) {
+        log_e("I2C Read Error: 0x%02x, reg: 0x%02x, length: %d, Code: 0x%x", device->addr, tmpl->reg_addr, tmpl->length, err);
+    }
     return err;
-}
\ No newline at end of file
+}
+
+void i2c_get_cmd_pool_stats(i2c_cmd_pool_stats_t *stats) {
+    if (stats == NULL) {
+        return ;
+    }
+    portENTER_CRITICAL(&i2c_cmd_pool_lock);
+    *stats = i2c_cmd_stats;
+    portEXIT_CRITICAL(&i2c_cmd_pool_lock);
+}
+
+void i2c_reset_cmd_pool_stats(void) {
+    portENTER_CRITICAL(&i2c_cmd_pool_lock);
+    memset(&i2c_cmd_stats, 0, sizeof(i2c_cmd_stats));
+    i2c_cmd_stats.in_use_max = i2c_cmd_pool_in_use;
+    portEXIT_CRITICAL(&i2c_cmd_pool_lock);
+}
+
+void i2c_device_set_name(I2CDevice_t i2c_device, const char *name) {
+    if (i2c_device == NULL) {
+        return ;
+    }
+    ((i2c_device_t *)i2c_device)->name = name;
+}
+
+esp_err_t i2c_device_get_stats(I2CDevice_t i2c_device, i2c_device_stats_t *stats) {
+    if (i2c_device == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&i2c_stats_lock);
+    *stats = ((i2c_device_t *)i2c_device)->stats;
+    portEXIT_CRITICAL(&i2c_stats_lock);
+    return ESP_OK;
+}
+
+esp_err_t i2c_port_get_stats(i2c_port_t i2c_num, i2c_port_stats_t *stats) {
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    i2c_port_stats_obj_t* port_stats = &i2c_port_stats[i2c_num];
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&i2c_stats_lock);
+    i2c_port_util_advance(port_stats, now);
+    *stats = port_stats->totals;
+    // Completed slots count in full, the current one up to now.
+    uint64_t busy = 0;
+    for (uint8_t i = 0; i < I2C_UTIL_SLOTS; i++) {
+        busy += port_stats->slot_busy_us[i];
+    }
+    uint64_t window = (uint64_t)I2C_UTIL_SLOT_US * (I2C_UTIL_SLOTS - 1) + (now - port_stats->slot_start_us);
+    portEXIT_CRITICAL(&i2c_stats_lock);
+
+    stats->window_ms = window / 1000;
+    stats->utilization_permille = (window > 0) ? (uint16_t)((busy * 1000) / window) : 0;
+    return ESP_OK;
+}
+
+esp_err_t i2c_port_get_arb_stats(i2c_port_t i2c_num, i2c_arb_stats_t *stats) {
+    if (i2c_num < 0 || i2c_num >= I2C_NUM_MAX || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&i2c_arbiter_lock);
+    *stats = i2c_arbiter[i2c_num].stats;
+    portEXIT_CRITICAL(&i2c_arbiter_lock);
+    return ESP_OK;
+}
+
+void i2c_stats_reset(void) {
+    portENTER_CRITICAL(&i2c_arbiter_lock);
+    for (i2c_port_t port = 0; port < I2C_NUM_MAX; port++) {
+        memset(&i2c_arbiter[port].stats, 0, sizeof(i2c_arb_stats_t));
+    }
+    portEXIT_CRITICAL(&i2c_arbiter_lock);
+
+    portENTER_CRITICAL(&i2c_stats_lock);
+    for (i2c_device_t* it = i2c_device_list; it != NULL; it = it->next) {
+        memset(&it->stats, 0, sizeof(it->stats));
+    }
+    memset(i2c_port_stats, 0, sizeof(i2c_port_stats));
+    portEXIT_CRITICAL(&i2c_stats_lock);
+}
+
+void i2c_stats_dump(void) {
+    for (i2c_port_t port = 0; port < I2C_NUM_MAX; port++) {
+        i2c_port_stats_t port_stats;
+        i2c_port_get_stats(port, &port_stats);
+        if (port_stats.transactions == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "port %d: %u xfers, %u bytes, %u err, %u timeout, util %u.%u%% over %u ms",
+            port, port_stats.transactions, port_stats.bytes, port_stats.errors, port_stats.timeouts,
+            port_stats.utilization_permille / 10, port_stats.utilization_permille % 10, port_stats.window_ms);
+
+        // Both should stop moving after boot; growth means controllers thrash.
+        i2c_port_counters_t counters;
+        i2c_get_port_counters(port, &counters);
+        ESP_LOGI(TAG, "  controller: %u driver installs, %u reconfigs", counters.driver_installs, counters.reconfigs);
+
+        i2c_arb_stats_t arb;
+        i2c_port_get_arb_stats(port, &arb);
+        for (uint8_t prio = 0; prio < I2C_PRIORITY_CLASSES; prio++) {
+            if (arb.acquisitions[prio] == 0) {
+                continue;
+            }
+            ESP_LOGI(TAG, "  class %u: %u acquisitions, %u contended, wait avg %u us, max %u us",
+                prio, arb.acquisitions[prio], arb.contended[prio],
+                (uint32_t)(arb.wait_us[prio] / arb.acquisitions[prio]), arb.wait_max_us[prio]);
+        }
+        ESP_LOGI(TAG, "  aged grants %u, deadline grants %u, deadline misses %u",
+            arb.aged_grants, arb.deadline_grants, arb.deadline_misses);
+    }
+
+    // Snapshot the list under the lock, log outside it.
+    i2c_device_t* devices[16];
+    uint8_t count = 0;
+    portENTER_CRITICAL(&i2c_stats_lock);
+    for (i2c_device_t* it = i2c_device_list; it != NULL && count < 16; it = it->next) {
+        devices[count++] = it;
+    }
+    portEXIT_CRITICAL(&i2c_stats_lock);
+
+    for (uint8_t i = 0; i < count; i++) {
+        i2c_device_stats_t stats = { 0 };
+        i2c_device_get_stats((I2CDevice_t)devices[i], &stats);
+        if (stats.transactions == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "%s(0x%02x) port %d: %u xfers, %u bytes, %u err, avg %u us, max %u us, wait avg %u us, max %u us",
+            devices[i]->name ? devices[i]->name : "i2c", devices[i]->addr, devices[i]->i2c_port->port,
+            stats.transactions, stats.bytes, stats.errors,
+            (uint32_t)(stats.busy_us / stats.transactions), stats.latency_max_us,
+            (uint32_t)(stats.wait_us / stats.transactions), stats.wait_max_us);
+        char hist[I2C_STATS_LATENCY_BUCKETS * 11 + 1];
+        int len = 0;
+        for (uint8_t b = 0; b < I2C_STATS_LATENCY_BUCKETS; b++) {
+            len += snprintf(&hist[len], sizeof(hist) - len, " %u", stats.latency_hist[b]);
+        }
+        ESP_LOGI(TAG, "  latency <32us..>=32ms:%s", hist);
+    }
+}
@@ -41,16 +41,261 @@ extern "C" {
 typedef void * I2CDevice_t;
 /* @[declare_i2cdevice_t] */
 
+/**
+ * @brief A pre-validated read of a fixed register block on one device.
+ *
+ * Created once per hot register read (e.g. RTC time, ADC results) and
+ * executed with i2c_read_template(); it owns its command link storage
+ * so the read path never touches the heap or the shared link pool.
+ */
+/* @[declare_i2creadtemplate_t] */
+typedef void * I2CReadTemplate_t;
+/* @[declare_i2creadtemplate_t] */
+
+/**
+ * @brief Command link usage counters.
+ *
+ * heap_allocs only moves when every pool slot is busy, so
+ * heap_allocs / transactions is the heap traffic per transaction.
+ */
+/* @[declare_i2c_cmd_pool_stats_t] */
+typedef struct {
+    uint32_t transactions;   /**< @brief Transactions built since the last reset. */
+    uint32_t pool_hits;      /**< @brief Transactions built in a pool slot. */
+    uint32_t heap_allocs;    /**< @brief Transactions that fell back to i2c_cmd_link_create(). */
+    uint32_t template_runs;  /**< @brief Transactions run from an I2CReadTemplate_t. */
+    uint8_t in_use_max;      /**< @brief High-water mark of simultaneously used pool slots. */
+} i2c_cmd_pool_stats_t;
+/* @[declare_i2c_cmd_pool_stats_t] */
+
+/**
+ * @brief Per-controller configuration counters.
+ *
+ * Each physical bus gets its own controller when one is free, so both
+ * values should stop moving after boot. reconfigs counts pin/clock
+ * switches done in place when two buses have to share a controller.
+ */
+/* @[declare_i2c_port_counters_t] */
+typedef struct {
+    uint32_t driver_installs; /**< @brief i2c_driver_install() calls on this controller. */
+    uint32_t reconfigs;       /**< @brief Pin re-mux or clock changes without reinstall. */
+} i2c_port_counters_t;
+/* @[declare_i2c_port_counters_t] */
+
+/**
+ * @brief A run of consecutive 8-bit register addresses.
+ */
+/* @[declare_i2c_reg_range_t] */
+typedef struct {
+    uint8_t start;
+    uint8_t count;
+} i2c_reg_range_t;
+/* @[declare_i2c_reg_range_t] */
+
+/**
+ * @brief Register shadow cache counters for one device.
+ */
+/* @[declare_i2c_reg_cache_stats_t] */
+typedef struct {
+    uint32_t hits;    /**< @brief Reads answered from the shadow without bus traffic. */
+    uint32_t misses;  /**< @brief Reads of cacheable registers that had to go to the bus. */
+    uint32_t bypass;  /**< @brief Reads touching a volatile register, never cached. */
+} i2c_reg_cache_stats_t;
+/* @[declare_i2c_reg_cache_stats_t] */
+
+/**
+ * @brief Number of latency histogram buckets.
+ *
+ * Bucket 0 counts transactions under 32 us, bucket n those under
+ * 32 << n us; the last bucket also takes everything slower.
+ */
+#define I2C_STATS_LATENCY_BUCKETS (11)
+
+/**
+ * @brief Bus counters for one device, see i2c_device_get_stats().
+ *
+ * Latency is the time spent in i2c_master_cmd_begin(); wait is the time
+ * spent blocked on the controller lock before it.
+ */
+/* @[declare_i2c_device_stats_t] */
+typedef struct {
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t errors;
+    uint32_t timeouts;
+    uint64_t busy_us;
+    uint32_t latency_max_us;
+    uint64_t wait_us;
+    uint32_t wait_max_us;
+    uint32_t latency_hist[I2C_STATS_LATENCY_BUCKETS];
+} i2c_device_stats_t;
+/* @[declare_i2c_device_stats_t] */
+
+/**
+ * @brief Bus counters for one controller, see i2c_port_get_stats().
+ */
+/* @[declare_i2c_port_stats_t] */
+typedef struct {
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t errors;
+    uint32_t timeouts;
+    uint64_t busy_us;
+    uint16_t utilization_permille; /**< @brief Busy share of the last window_ms, in 0.1 %. */
+    uint32_t window_ms;
+} i2c_port_stats_t;
+/* @[declare_i2c_port_stats_t] */
+
+/**
+ * @brief Bus arbitration classes, see i2c_device_set_priority().
+ */
+/* @[declare_i2c_priority_t] */
+typedef enum {
+    I2C_PRIORITY_LOW = 0,
+    I2C_PRIORITY_NORMAL,
+    I2C_PRIORITY_HIGH,
+    I2C_PRIORITY_CRITICAL,
+} i2c_priority_t;
+/* @[declare_i2c_priority_t] */
+
+#define I2C_PRIORITY_CLASSES (4)
+
+/**
+ * @brief Bus arbitration counters for one controller, see i2c_port_get_arb_stats().
+ *
+ * Per-class arrays are indexed by i2c_priority_t. Waits are measured from
+ * the request to the grant, so wait_max_us is the worst case seen.
+ */
+/* @[declare_i2c_arb_stats_t] */
+typedef struct {
+    uint32_t acquisitions[I2C_PRIORITY_CLASSES];
+    uint32_t contended[I2C_PRIORITY_CLASSES];   /**< @brief Acquisitions that had to wait. */
+    uint64_t wait_us[I2C_PRIORITY_CLASSES];
+    uint32_t wait_max_us[I2C_PRIORITY_CLASSES];
+    uint32_t aged_grants;       /**< @brief Granted ahead of a higher class after aging. */
+    uint32_t deadline_grants;   /**< @brief Granted ahead of a higher class because overdue. */
+    uint32_t deadline_misses;   /**< @brief Granted after the device's deadline had passed. */
+} i2c_arb_stats_t;
+/* @[declare_i2c_arb_stats_t] */
+
+/**
+ * @brief Operation queued with i2c_submit().
+ */
+/* @[declare_i2c_op_t] */
+typedef enum {
+    I2C_OP_READ = 0,  /**< @brief Read length bytes from reg_addr into data. */
+    I2C_OP_WRITE,     /**< @brief Write length bytes from data to reg_addr. */
+} i2c_op_t;
+/* @[declare_i2c_op_t] */
+
+/**
+ * @brief One register access inside an i2c_transfer() chain.
+ *
+ * reg_addr may be I2C_NO_REG. A read segment with a register address
+ * writes the address and reads back after a repeated START.
+ */
+/* @[declare_i2c_segment_t] */
+typedef struct {
+    i2c_op_t op;        /**< @brief I2C_OP_READ or I2C_OP_WRITE. */
+    uint32_t reg_addr;  /**< @brief First register of the block. */
+    uint8_t *data;      /**< @brief Source (write) or destination (read). */
+    uint16_t length;    /**< @brief Bytes to move; reads need at least one. */
+} i2c_segment_t;
+/* @[declare_i2c_segment_t] */
+
+/**
+ * @brief Completion callback for i2c_submit().
+ *
+ * Runs in the bus worker task, so it must be short and must not
+ * block on the same bus.
+ */
+/* @[declare_i2c_done_cb_t] */
+typedef void (*i2c_done_cb_t)(I2CDevice_t i2c_device, esp_err_t err, void *arg);
+/* @[declare_i2c_done_cb_t] */
+
+/*
+    i2c_num is a preference. Devices on the same sda/scl pair always
+    share a controller; a different pair is moved to the other
+    controller when the preferred one already serves another bus.
+*/
 I2CDevice_t i2c_malloc_device(i2c_port_t i2c_num, gpio_num_t sda, gpio_num_t scl, uint32_t freq, uint8_t device_addr);
 
 void i2c_free_device(I2CDevice_t i2c_device);
 
+i2c_port_t i2c_device_get_port(I2CDevice_t i2c_device);
+
+void i2c_get_port_counters(i2c_port_t i2c_num, i2c_port_counters_t *counters);
+
+/*
+    Turn on the write-through register shadow for a device. Every
+    register is treated as non-volatile except the volatile_regs ranges
+    (status, ADC results, IRQ flags...), which are always read from the
+    bus. Cached registers are filled on first read or write, after which
+    reads and the read half of i2c_write_bit(s) cost no bus traffic.
+*/
+esp_err_t i2c_device_enable_cache(I2CDevice_t i2c_device, const i2c_reg_range_t *volatile_regs, size_t count);
+
+/*
+    Forget cached values, e.g. after a device reset or when a register
+    is known to have changed behind the driver's back.
+*/
+void i2c_device_cache_invalidate(I2CDevice_t i2c_device, uint32_t reg_addr, uint16_t length);
+
+void i2c_device_cache_invalidate_all(I2CDevice_t i2c_device);
+
+void i2c_device_get_cache_stats(I2CDevice_t i2c_device, i2c_reg_cache_stats_t *stats);
+
+/*
+    Arbitration class (i2c_priority_t). When the bus frees up it is handed
+    to the waiting device of the highest class; the async worker orders
+    its queue the same way. Default is I2C_PRIORITY_NORMAL.
+*/
+void i2c_device_set_priority(I2CDevice_t i2c_device, uint8_t priority);
+
+/*
+    Deadline hint: a request that has waited max_wait_us for the bus is
+    served before any class. 0 (the default) means none.
+*/
+void i2c_device_set_deadline(I2CDevice_t i2c_device, uint32_t max_wait_us);
+
+uint8_t i2c_device_get_priority(I2CDevice_t i2c_device);
+
+/*
+    Queue a transfer on the device's bus worker and return at once.
+    data must stay valid until completion. The callback, if any, is
+    called from the worker; with NULL the result is dropped. Returns
+    ESP_ERR_NO_MEM when the bus queue is full.
+*/
+esp_err_t i2c_submit(I2CDevice_t i2c_device, i2c_op_t op, uint32_t reg_addr, uint8_t *data, uint16_t length, i2c_done_cb_t callback, void *arg);
+
+/*
+    Queue a transfer and block until it completes. It is batched with
+    the other queued transfers for the device like i2c_submit(), and
+    leaves the task notification alone. A transfer still queued after
+    timeout is withdrawn and ESP_ERR_TIMEOUT returned; one already on
+    the bus is waited out, since it is writing into data.
+*/
+esp_err_t i2c_submit_wait(I2CDevice_t i2c_device, i2c_op_t op, uint32_t reg_addr, uint8_t *data, uint16_t length, TickType_t timeout);
+
 esp_err_t i2c_apply_bus(I2CDevice_t i2c_device);
 
 esp_err_t i2c_free_bus(I2CDevice_t i2c_device);
 
 esp_err_t i2c_device_change_freq(I2CDevice_t i2c_device, uint32_t freq);
 
+/*
+    Run several register accesses as one command chain: one bus
+    acquisition, one STOP at the end and repeated STARTs in between.
+    Segments run in order; at most CONFIG_I2C_TRANSFER_MAX_SEGMENTS.
+
+    i2c_segment_t seg[] = {
+        { I2C_OP_WRITE, 0x09, alarm, 4 },
+        { I2C_OP_WRITE, 0x01, &ctrl, 1 },
+    };
+    i2c_transfer(device, seg, 2);
+*/
+esp_err_t i2c_transfer(I2CDevice_t i2c_device, const i2c_segment_t *segments, size_t count);
+
 esp_err_t i2c_read_bytes(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t *data, uint16_t length);
 
 esp_err_t i2c_read_byte(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t* data);
@@ -87,6 +332,35 @@ esp_err_t i2c_write_bits(I2CDevice_t i2c_device, uint32_t reg_addr, uint8_t data
 
 esp_err_t i2c_device_valid(I2CDevice_t i2c_device);
 
+I2CReadTemplate_t i2c_malloc_read_template(I2CDevice_t i2c_device, uint32_t reg_addr, uint16_t length);
+
+void i2c_free_read_template(I2CReadTemplate_t i2c_template);
+
+esp_err_t i2c_read_template(I2CReadTemplate_t i2c_template, uint8_t *data);
+
+void i2c_get_cmd_pool_stats(i2c_cmd_pool_stats_t *stats);
+
+void i2c_reset_cmd_pool_stats(void);
+
+/*
+    Label used by i2c_stats_dump(). The string is not copied.
+*/
+void i2c_device_set_name(I2CDevice_t i2c_device, const char *name);
+
+esp_err_t i2c_device_get_stats(I2CDevice_t i2c_device, i2c_device_stats_t *stats);
+
+esp_err_t i2c_port_get_stats(i2c_port_t i2c_num, i2c_port_stats_t *stats);
+
+esp_err_t i2c_port_get_arb_stats(i2c_port_t i2c_num, i2c_arb_stats_t *stats);
+
+void i2c_stats_reset(void);
+
+/*
+    Log port utilization and per-device counters. Also runs every
+    CONFIG_I2C_STATS_DUMP_PERIOD_S seconds when that is non-zero.
+*/
+void i2c_stats_dump(void);
+
 BaseType_t i2c_take_port(i2c_port_t i2c_num, uint32_t timeout);
 
 BaseType_t i2c_free_port(i2c_port_t i2c_num);
@@ -0,0 +1,343 @@
+#include "sdkconfig.h"
+
+#if CONFIG_I2C_BUS_SIMULATOR
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_rom_sys.h"
+#include "esp_log.h"
+#include "esp_err.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "i2c_sim_driver.h"
+
+#define TAG "I2C-SIM"
+
+#define I2C_SIM_HEAP_LINK_OPS (64)
+#define I2C_SIM_MAX_FAULTS (4)
+
+typedef enum {
+    I2C_SIM_OP_START = 0,
+    I2C_SIM_OP_STOP,
+    I2C_SIM_OP_WRITE,
+    I2C_SIM_OP_READ,
+} i2c_sim_op_type_t;
+
+typedef struct _i2c_sim_op_t {
+    uint8_t type;
+    uint8_t byte;
+    uint16_t length;
+    uint8_t *data;
+} i2c_sim_op_t;
+
+/*
+    A command link is a flat op list laid out in the caller's buffer.
+    An op is smaller than the driver's internal link entry, so any buffer
+    sized with I2C_LINK_RECOMMENDED_SIZE holds at least as many.
+*/
+typedef struct _i2c_sim_link_t {
+    uint16_t count;
+    uint16_t capacity;
+    i2c_sim_op_t op[];
+} i2c_sim_link_t;
+
+typedef struct _i2c_sim_fault_entry_t {
+    uint8_t addr;
+    i2c_sim_fault_t fault;
+    uint32_t every;
+    uint32_t count;
+} i2c_sim_fault_entry_t;
+
+static uint32_t i2c_sim_freq[I2C_NUM_MAX] = { 100000, 100000 };
+static uint32_t i2c_sim_byte_ns = 0;
+static uint32_t i2c_sim_overhead_us = 10;
+static i2c_sim_fault_entry_t i2c_sim_faults[I2C_SIM_MAX_FAULTS];
+static i2c_sim_stats_t i2c_sim_stats;
+static portMUX_TYPE i2c_sim_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static i2c_sim_link_t* i2c_sim_link_init(uint8_t *buffer, uint32_t size) {
+    if (buffer == NULL || size < sizeof(i2c_sim_link_t) + sizeof(i2c_sim_op_t)) {
+        return NULL;
+    }
+    i2c_sim_link_t* link = (i2c_sim_link_t *)buffer;
+    link->count = 0;
+    link->capacity = (size - sizeof(i2c_sim_link_t)) / sizeof(i2c_sim_op_t);
+    return link;
+}
+
+static i2c_sim_op_t* i2c_sim_link_push(i2c_cmd_handle_t cmd_handle, i2c_sim_op_type_t type) {
+    i2c_sim_link_t* link = (i2c_sim_link_t *)cmd_handle;
+    if (link == NULL || link->count >= link->capacity) {
+        return NULL;
+    }
+    i2c_sim_op_t* op = &link->op[link->count++];
+    memset(op, 0, sizeof(i2c_sim_op_t));
+    op->type = type;
+    return op;
+}
+
+i2c_cmd_handle_t i2c_sim_cmd_link_create_static(uint8_t *buffer, uint32_t size) {
+    return (i2c_cmd_handle_t)i2c_sim_link_init(buffer, size);
+}
+
+void i2c_sim_cmd_link_delete_static(i2c_cmd_handle_t cmd_handle) {
+}
+
+i2c_cmd_handle_t i2c_sim_cmd_link_create(void) {
+    uint32_t size = sizeof(i2c_sim_link_t) + I2C_SIM_HEAP_LINK_OPS * sizeof(i2c_sim_op_t);
+    return (i2c_cmd_handle_t)i2c_sim_link_init(malloc(size), size);
+}
+
+void i2c_sim_cmd_link_delete(i2c_cmd_handle_t cmd_handle) {
+    free(cmd_handle);
+}
+
+esp_err_t i2c_sim_master_start(i2c_cmd_handle_t cmd_handle) {
+    return i2c_sim_link_push(cmd_handle, I2C_SIM_OP_START) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t i2c_sim_master_stop(i2c_cmd_handle_t cmd_handle) {
+    return i2c_sim_link_push(cmd_handle, I2C_SIM_OP_STOP) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t i2c_sim_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en) {
+    i2c_sim_op_t* op = i2c_sim_link_push(cmd_handle, I2C_SIM_OP_WRITE);
+    if (op == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    op->byte = data;
+    op->data = &op->byte;
+    op->length = 1;
+    return ESP_OK;
+}
+
+esp_err_t i2c_sim_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t *data, size_t data_len, bool ack_en) {
+    if (data == NULL || data_len == 0 || data_len > UINT16_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_sim_op_t* op = i2c_sim_link_push(cmd_handle, I2C_SIM_OP_WRITE);
+    if (op == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    op->data = (uint8_t *)data;
+    op->length = data_len;
+    return ESP_OK;
+}
+
+esp_err_t i2c_sim_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t *data, i2c_ack_type_t ack) {
+    return i2c_sim_master_read(cmd_handle, data, 1, ack);
+}
+
+esp_err_t i2c_sim_master_read(i2c_cmd_handle_t cmd_handle, uint8_t *data, size_t data_len, i2c_ack_type_t ack) {
+    if (data == NULL || data_len == 0 || data_len > UINT16_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_sim_op_t* op = i2c_sim_link_push(cmd_handle, I2C_SIM_OP_READ);
+    if (op == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    op->data = data;
+    op->length = data_len;
+    return ESP_OK;
+}
+
+esp_err_t i2c_sim_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf) {
+    if (i2c_num >= I2C_NUM_MAX || i2c_conf == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_sim_freq[i2c_num] = i2c_conf->master.clk_speed;
+    return ESP_OK;
+}
+
+esp_err_t i2c_sim_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags) {
+    return (i2c_num < I2C_NUM_MAX) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+// Called with i2c_sim_lock held, once per transaction.
+static i2c_sim_fault_t i2c_sim_take_fault(uint8_t addr) {
+    for (uint8_t i = 0; i < I2C_SIM_MAX_FAULTS; i++) {
+        i2c_sim_fault_entry_t* entry = &i2c_sim_faults[i];
+        if (entry->fault == I2C_SIM_FAULT_NONE || entry->addr != addr) {
+            continue;
+        }
+        if (++entry->count >= entry->every) {
+            entry->count = 0;
+            i2c_sim_stats.faults++;
+            return entry->fault;
+        }
+    }
+    return I2C_SIM_FAULT_NONE;
+}
+
+static void i2c_sim_spend(uint32_t us) {
+    uint32_t tick_us = portTICK_PERIOD_MS * 1000;
+    if (us >= tick_us) {
+        vTaskDelay(us / tick_us);
+        us %= tick_us;
+    }
+    if (us > 0) {
+        esp_rom_delay_us(us);
+    }
+}
+
+/*
+    Play the op list against the models, then hold the caller for the
+    modelled wire time so latency and utilization figures stay realistic.
+*/
+esp_err_t i2c_sim_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait) {
+    i2c_sim_link_t* link = (i2c_sim_link_t *)cmd_handle;
+    if (i2c_num >= I2C_NUM_MAX || link == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = ESP_OK;
+    i2c_sim_model_t* model = NULL;
+    i2c_sim_fault_t fault = I2C_SIM_FAULT_NONE;
+    bool first_addr = true;
+    bool expect_addr = false;
+    bool corrupted = false;
+    uint32_t bytes = 0;
+    uint32_t starts = 0;
+
+    portENTER_CRITICAL(&i2c_sim_lock);
+    for (uint16_t i = 0; i < link->count && err == ESP_OK; i++) {
+        i2c_sim_op_t* op = &link->op[i];
+        switch (op->type) {
+        case I2C_SIM_OP_START:
+            starts++;
+            expect_addr = true;
+            break;
+        case I2C_SIM_OP_STOP:
+            if (model != NULL && model->stop != NULL) {
+                model->stop(model);
+            }
+            model = NULL;
+            break;
+        case I2C_SIM_OP_WRITE:
+            for (uint16_t n = 0; n < op->length && err == ESP_OK; n++) {
+                uint8_t data = op->data[n];
+                bytes++;
+                if (!expect_addr) {
+                    if (model != NULL && model->write != NULL) {
+                        model->write(model, data);
+                    }
+                    continue;
+                }
+                expect_addr = false;
+                if (first_addr) {
+                    first_addr = false;
+                    fault = i2c_sim_take_fault(data >> 1);
+                }
+                if (fault == I2C_SIM_FAULT_TIMEOUT) {
+                    err = ESP_ERR_TIMEOUT;
+                    break;
+                }
+                i2c_sim_model_t* next = i2c_sim_model_find(data >> 1);
+                if (model != NULL && model != next && model->stop != NULL) {
+                    model->stop(model);
+                }
+                model = next;
+                if (model == NULL || fault == I2C_SIM_FAULT_NACK
+                    || (model->start != NULL && !model->start(model, data & I2C_MASTER_READ))) {
+                    if (model == NULL) {
+                        i2c_sim_stats.nacks++;
+                    }
+                    err = ESP_FAIL;
+                }
+            }
+            break;
+        case I2C_SIM_OP_READ:
+            for (uint16_t n = 0; n < op->length; n++) {
+                op->data[n] = (model != NULL && model->read != NULL) ? model->read(model) : 0xFF;
+                if (fault == I2C_SIM_FAULT_CORRUPT && !corrupted) {
+                    op->data[n] ^= 0x01;
+                    corrupted = true;
+                }
+            }
+            bytes += op->length;
+            break;
+        }
+    }
+    // An aborted transaction still ends with STOP on the wire.
+    if (model != NULL && model->stop != NULL && err != ESP_OK) {
+        model->stop(model);
+    }
+
+    uint32_t byte_ns = i2c_sim_byte_ns;
+    if (byte_ns == 0) {
+        byte_ns = 9000000000ULL / (i2c_sim_freq[i2c_num] ? i2c_sim_freq[i2c_num] : 100000);
+    }
+    uint32_t bus_us = starts * i2c_sim_overhead_us + (uint32_t)(((uint64_t)bytes * byte_ns) / 1000);
+    if (err == ESP_ERR_TIMEOUT) {
+        bus_us = ticks_to_wait * portTICK_PERIOD_MS * 1000;
+    }
+    i2c_sim_stats.transactions++;
+    i2c_sim_stats.bytes += bytes;
+    i2c_sim_stats.bus_time_us += bus_us;
+    portEXIT_CRITICAL(&i2c_sim_lock);
+
+    i2c_sim_spend(bus_us);
+    return err;
+}
+
+void i2c_sim_set_timing(uint32_t byte_ns, uint32_t overhead_us) {
+    portENTER_CRITICAL(&i2c_sim_lock);
+    i2c_sim_byte_ns = byte_ns;
+    i2c_sim_overhead_us = overhead_us;
+    portEXIT_CRITICAL(&i2c_sim_lock);
+}
+
+esp_err_t i2c_sim_set_fault(uint8_t addr, i2c_sim_fault_t fault, uint32_t every) {
+    if (fault != I2C_SIM_FAULT_NONE && every == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&i2c_sim_lock);
+    i2c_sim_fault_entry_t* slot = NULL;
+    for (uint8_t i = 0; i < I2C_SIM_MAX_FAULTS; i++) {
+        i2c_sim_fault_entry_t* entry = &i2c_sim_faults[i];
+        if (entry->fault != I2C_SIM_FAULT_NONE && entry->addr == addr) {
+            slot = entry;
+            break;
+        }
+        if (slot == NULL && entry->fault == I2C_SIM_FAULT_NONE) {
+            slot = entry;
+        }
+    }
+    if (slot != NULL) {
+        slot->addr = addr;
+        slot->fault = fault;
+        slot->every = every;
+        slot->count = 0;
+        err = ESP_OK;
+    } else if (fault == I2C_SIM_FAULT_NONE) {
+        err = ESP_OK;
+    }
+    portEXIT_CRITICAL(&i2c_sim_lock);
+
+    if (err == ESP_OK && fault != I2C_SIM_FAULT_NONE) {
+        ESP_LOGI(TAG, "fault %d on 0x%02x every %u", fault, addr, every);
+    }
+    return err;
+}
+
+void i2c_sim_get_stats(i2c_sim_stats_t *stats) {
+    if (stats == NULL) {
+        return ;
+    }
+    portENTER_CRITICAL(&i2c_sim_lock);
+    *stats = i2c_sim_stats;
+    portEXIT_CRITICAL(&i2c_sim_lock);
+}
+
+void i2c_sim_reset_stats(void) {
+    portENTER_CRITICAL(&i2c_sim_lock);
+    memset(&i2c_sim_stats, 0, sizeof(i2c_sim_stats));
+    portEXIT_CRITICAL(&i2c_sim_lock);
+}
+
+#endif
@@ -0,0 +1,65 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/*
+    Simulated I2C bus, built when CONFIG_I2C_BUS_SIMULATOR is set. The
+    driver calls made by i2c_device.c are routed here instead of the
+    hardware controller, and answered by register-level models of the
+    AXP192 (0x34), MPU6886 (0x68), PCF8563 (0x51), two SHT3x (0x44 and
+    0x45) and a PaHub channel switch (0x70).
+    Models are looked up by address only, so every port sees all of them.
+*/
+
+/**
+ * @brief Fault injected into transactions addressed to one device.
+ */
+/* @[declare_i2c_sim_fault_t] */
+typedef enum {
+    I2C_SIM_FAULT_NONE = 0,
+    I2C_SIM_FAULT_NACK,     /**< @brief Address is not acknowledged, cmd_begin returns ESP_FAIL. */
+    I2C_SIM_FAULT_TIMEOUT,  /**< @brief Bus hangs for the full timeout, cmd_begin returns ESP_ERR_TIMEOUT. */
+    I2C_SIM_FAULT_CORRUPT,  /**< @brief Transaction succeeds but the first byte read has bit 0 flipped. */
+} i2c_sim_fault_t;
+/* @[declare_i2c_sim_fault_t] */
+
+/**
+ * @brief Counters of the simulated bus, see i2c_sim_get_stats().
+ */
+/* @[declare_i2c_sim_stats_t] */
+typedef struct {
+    uint32_t transactions;
+    uint32_t bytes;          /**< @brief Bytes on the wire, address bytes included. */
+    uint64_t bus_time_us;    /**< @brief Modelled bus time of all transactions. */
+    uint32_t nacks;          /**< @brief Transactions to an address with no model. */
+    uint32_t faults;         /**< @brief Injected faults. */
+} i2c_sim_stats_t;
+/* @[declare_i2c_sim_stats_t] */
+
+/*
+    Wire timing. byte_ns is the time of one byte including its ACK bit;
+    0 derives it from the configured clock (9 bit times). overhead_us is
+    added once per START condition.
+*/
+void i2c_sim_set_timing(uint32_t byte_ns, uint32_t overhead_us);
+
+/*
+    Inject fault into every nth transaction to addr; every = 1 faults all
+    of them, I2C_SIM_FAULT_NONE clears it.
+*/
+esp_err_t i2c_sim_set_fault(uint8_t addr, i2c_sim_fault_t fault, uint32_t every);
+
+void i2c_sim_get_stats(i2c_sim_stats_t *stats);
+
+void i2c_sim_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+
+/*
+    Included by i2c_device.c after driver/i2c.h when the simulated bus is
+    selected. Maps the driver calls that file makes onto i2c_sim.c; the
+    signatures match driver/i2c.h so nothing else changes.
+*/
+
+#include "driver/i2c.h"
+
+#include "i2c_sim.h"
+
+/**
+ * @brief Device model attached to the simulated bus.
+ *
+ * start() is called for every address byte, with read set for a read
+ * transfer; returning false NACKs it. write() and read() then carry the
+ * data bytes until the next START or the STOP, which calls stop().
+ */
+/* @[declare_i2c_sim_model_t] */
+typedef struct _i2c_sim_model_t {
+    const char *name;
+    uint8_t addr;
+    bool (*start)(struct _i2c_sim_model_t *model, bool read);
+    void (*write)(struct _i2c_sim_model_t *model, uint8_t data);
+    uint8_t (*read)(struct _i2c_sim_model_t *model);
+    void (*stop)(struct _i2c_sim_model_t *model);
+    void *ctx;
+} i2c_sim_model_t;
+/* @[declare_i2c_sim_model_t] */
+
+/* Provided by i2c_sim_models.c; NULL when nothing answers at addr. */
+i2c_sim_model_t *i2c_sim_model_find(uint8_t addr);
+
+i2c_cmd_handle_t i2c_sim_cmd_link_create_static(uint8_t *buffer, uint32_t size);
+void i2c_sim_cmd_link_delete_static(i2c_cmd_handle_t cmd_handle);
+i2c_cmd_handle_t i2c_sim_cmd_link_create(void);
+void i2c_sim_cmd_link_delete(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_sim_master_start(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_sim_master_stop(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_sim_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en);
+esp_err_t i2c_sim_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t *data, size_t data_len, bool ack_en);
+esp_err_t i2c_sim_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t *data, i2c_ack_type_t ack);
+esp_err_t i2c_sim_master_read(i2c_cmd_handle_t cmd_handle, uint8_t *data, size_t data_len, i2c_ack_type_t ack);
+esp_err_t i2c_sim_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait);
+esp_err_t i2c_sim_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf);
+esp_err_t i2c_sim_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags);
+
+#define i2c_cmd_link_create_static i2c_sim_cmd_link_create_static
+#define i2c_cmd_link_delete_static i2c_sim_cmd_link_delete_static
+#define i2c_cmd_link_create i2c_sim_cmd_link_create
+#define i2c_cmd_link_delete i2c_sim_cmd_link_delete
+#define i2c_master_start i2c_sim_master_start
+#define i2c_master_stop i2c_sim_master_stop
+#define i2c_master_write_byte i2c_sim_master_write_byte
+#define i2c_master_write i2c_sim_master_write
+#define i2c_master_read_byte i2c_sim_master_read_byte
+#define i2c_master_read i2c_sim_master_read
+#define i2c_master_cmd_begin i2c_sim_master_cmd_begin
+#define i2c_param_config i2c_sim_param_config
+#define i2c_driver_install i2c_sim_driver_install
@@ -0,0 +1,492 @@
+#include "sdkconfig.h"
+
+#if CONFIG_I2C_BUS_SIMULATOR
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_timer.h"
+
+#include <string.h>
+#include <time.h>
+
+#include "i2c_sim_driver.h"
+
+/*
+    Register-level models behind the simulated bus. Values are synthetic
+    but stay in the ranges the drivers expect: a battery at 4.0 V, the IMU
+    lying flat with a small vibration on X, a room at about 23.5 C.
+*/
+
+/*
+    Plain 8-bit register file with an auto-incrementing pointer, as on
+    the AXP192, MPU6886 and PCF8563. The first byte of a write sets the
+    pointer; refresh() runs when a read starts, written() after each
+    stored byte and stopped() on STOP.
+*/
+typedef struct _i2c_sim_regmap_t {
+    uint8_t reg[256];
+    uint8_t ptr;
+    bool addressed;
+    bool dirty;
+    void (*refresh)(struct _i2c_sim_regmap_t *map);
+    void (*written)(struct _i2c_sim_regmap_t *map, uint8_t reg);
+    void (*stopped)(struct _i2c_sim_regmap_t *map);
+} i2c_sim_regmap_t;
+
+static bool i2c_sim_regmap_start(i2c_sim_model_t *model, bool read) {
+    i2c_sim_regmap_t* map = (i2c_sim_regmap_t *)model->ctx;
+    map->addressed = read;
+    if (read && map->refresh != NULL) {
+        map->refresh(map);
+    }
+    return true;
+}
+
+static void i2c_sim_regmap_write(i2c_sim_model_t *model, uint8_t data) {
+    i2c_sim_regmap_t* map = (i2c_sim_regmap_t *)model->ctx;
+    if (!map->addressed) {
+        map->ptr = data;
+        map->addressed = true;
+        return ;
+    }
+    uint8_t reg = map->ptr++;
+    map->reg[reg] = data;
+    if (map->written != NULL) {
+        map->written(map, reg);
+    }
+}
+
+static uint8_t i2c_sim_regmap_read(i2c_sim_model_t *model) {
+    i2c_sim_regmap_t* map = (i2c_sim_regmap_t *)model->ctx;
+    return map->reg[map->ptr++];
+}
+
+static void i2c_sim_regmap_stop(i2c_sim_model_t *model) {
+    i2c_sim_regmap_t* map = (i2c_sim_regmap_t *)model->ctx;
+    if (map->stopped != NULL) {
+        map->stopped(map);
+    }
+    map->dirty = false;
+}
+
+// Triangle wave in [-amplitude, amplitude] with the given period.
+static int32_t i2c_sim_wave(int64_t now_us, uint32_t period_ms, int32_t amplitude) {
+    int64_t period = (int64_t)period_ms * 1000;
+    int64_t phase = now_us % period;
+    int64_t half = period / 2;
+    int64_t ramp = (phase < half) ? phase : (period - phase);
+    return (int32_t)((ramp * 4 * amplitude) / period) - amplitude;
+}
+
+/* ---------------------------------------------------------------- AXP192 */
+
+static i2c_sim_regmap_t i2c_sim_axp192_map;
+
+static void i2c_sim_axp192_put12(uint8_t reg, uint16_t value) {
+    i2c_sim_axp192_map.reg[reg] = value >> 4;
+    i2c_sim_axp192_map.reg[reg + 1] = value & 0x0F;
+}
+
+static void i2c_sim_axp192_put13(uint8_t reg, uint16_t value) {
+    i2c_sim_axp192_map.reg[reg] = value >> 5;
+    i2c_sim_axp192_map.reg[reg + 1] = value & 0x1F;
+}
+
+static void i2c_sim_axp192_refresh(i2c_sim_regmap_t *map) {
+    int64_t now = esp_timer_get_time();
+    i2c_sim_axp192_put12(0x56, 2941);                                   // ACIN 5.0 V
+    i2c_sim_axp192_put12(0x58, 160);                                    // ACIN 100 mA
+    i2c_sim_axp192_put12(0x5A, 2941);                                   // VBUS 5.0 V
+    i2c_sim_axp192_put12(0x5C, 266);                                    // VBUS 100 mA
+    i2c_sim_axp192_put12(0x5E, 1847);                                   // 40 C
+    i2c_sim_axp192_put12(0x78, 3636 + i2c_sim_wave(now, 60000, 9));     // 4.0 V
+    i2c_sim_axp192_put13(0x7A, 0);
+    i2c_sim_axp192_put13(0x7C, 120 + i2c_sim_wave(now, 7000, 20));      // 60 mA out
+    i2c_sim_axp192_put12(0x7E, 3000);                                   // APS 4.2 V
+}
+
+static void i2c_sim_axp192_reset(void) {
+    memset(&i2c_sim_axp192_map, 0, sizeof(i2c_sim_axp192_map));
+    i2c_sim_axp192_map.reg[0x00] = 0xF0;   // ACIN and VBUS present and usable
+    i2c_sim_axp192_map.reg[0x01] = 0x20;   // battery connected
+    i2c_sim_axp192_map.reg[0x03] = 0x03;
+    i2c_sim_axp192_map.reg[0x12] = 0x4D;
+    i2c_sim_axp192_map.reg[0x82] = 0x83;
+    i2c_sim_axp192_map.refresh = i2c_sim_axp192_refresh;
+}
+
+/* --------------------------------------------------------------- MPU6886 */
+
+/*
+    Samples are a pure function of time, so the FIFO only tracks how many
+    have been produced since it was reset and how many were read out.
+    It holds 1 KB and, as with CONFIG.FIFO_MODE = 0, overwrites the
+    oldest records when full and raises FIFO_OFLOW_INT.
+*/
+#define I2C_SIM_MPU6886_FIFO_FRAMES (1024 / 14)
+
+static i2c_sim_regmap_t i2c_sim_mpu6886_map;
+static int64_t i2c_sim_mpu6886_fifo_start_us;
+static int64_t i2c_sim_mpu6886_fifo_read;
+static uint8_t i2c_sim_mpu6886_fifo_byte;
+static uint8_t i2c_sim_mpu6886_fifo_frame[14];
+
+static void i2c_sim_mpu6886_put16(uint8_t *out, int16_t value) {
+    out[0] = (uint16_t)value >> 8;
+    out[1] = value & 0xFF;
+}
+
+// Accel XYZ, temp, gyro XYZ as laid out from ACCEL_XOUT_H.
+static void i2c_sim_mpu6886_sample(const uint8_t *reg, int64_t at_us, uint8_t *out) {
+    int32_t acc_lsb = 16384 >> ((reg[0x1C] >> 3) & 0x03);
+    int32_t gyro_lsb10 = 1310 >> ((reg[0x1B] >> 3) & 0x03);
+    i2c_sim_mpu6886_put16(&out[0], i2c_sim_wave(at_us, 20, acc_lsb / 50));
+    i2c_sim_mpu6886_put16(&out[2], i2c_sim_wave(at_us, 3000, acc_lsb / 200));
+    i2c_sim_mpu6886_put16(&out[4], acc_lsb);
+    i2c_sim_mpu6886_put16(&out[6], 326 * 3);    // 28 C
+    i2c_sim_mpu6886_put16(&out[8], (gyro_lsb10 * i2c_sim_wave(at_us, 500, 5)) / 10);
+    i2c_sim_mpu6886_put16(&out[10], 0);
+    i2c_sim_mpu6886_put16(&out[12], 0);
+}
+
+static uint32_t i2c_sim_mpu6886_period_us(const uint8_t *reg) {
+    return 1000 * (1 + reg[0x19]);
+}
+
+static bool i2c_sim_mpu6886_fifo_on(const uint8_t *reg) {
+    return (reg[0x6A] & 0x40) && (reg[0x23] & 0x18) == 0x18;
+}
+
+// Frames waiting in the FIFO; drops overwritten ones.
+static uint32_t i2c_sim_mpu6886_fifo_level(i2c_sim_regmap_t *map, int64_t now) {
+    if (!i2c_sim_mpu6886_fifo_on(map->reg)) {
+        return 0;
+    }
+    int64_t produced = (now - i2c_sim_mpu6886_fifo_start_us) / i2c_sim_mpu6886_period_us(map->reg);
+    if (produced - i2c_sim_mpu6886_fifo_read > I2C_SIM_MPU6886_FIFO_FRAMES) {
+        i2c_sim_mpu6886_fifo_read = produced - I2C_SIM_MPU6886_FIFO_FRAMES;
+        i2c_sim_mpu6886_fifo_byte = 0;
+        map->reg[0x3A] |= 0x10;
+    }
+    return (uint32_t)(produced - i2c_sim_mpu6886_fifo_read);
+}
+
+static void i2c_sim_mpu6886_reset(void);
+
+static void i2c_sim_mpu6886_refresh(i2c_sim_regmap_t *map) {
+    int64_t now = esp_timer_get_time();
+    if (map->ptr <= 0x48) {
+        i2c_sim_mpu6886_sample(map->reg, now, &map->reg[0x3B]);
+    }
+    if (map->ptr <= 0x73) {
+        uint32_t bytes = i2c_sim_mpu6886_fifo_level(map, now) * 14 - i2c_sim_mpu6886_fifo_byte;
+        map->reg[0x72] = (bytes >> 8) & 0x0F;
+        map->reg[0x73] = bytes & 0xFF;
+    }
+}
+
+static void i2c_sim_mpu6886_written(i2c_sim_regmap_t *map, uint8_t reg) {
+    if (reg == 0x6B && (map->reg[0x6B] & 0x80)) {
+        i2c_sim_mpu6886_reset();
+    } else if (reg == 0x6A && (map->reg[0x6A] & 0x04)) {
+        map->reg[0x6A] &= ~0x04;
+        i2c_sim_mpu6886_fifo_start_us = esp_timer_get_time();
+        i2c_sim_mpu6886_fifo_read = 0;
+        i2c_sim_mpu6886_fifo_byte = 0;
+    }
+}
+
+// FIFO_R_W does not advance the register pointer; INT_STATUS clears on read.
+static uint8_t i2c_sim_mpu6886_read(i2c_sim_model_t *model) {
+    i2c_sim_regmap_t* map = (i2c_sim_regmap_t *)model->ctx;
+    if (map->ptr == 0x74) {
+        int64_t now = esp_timer_get_time();
+        if (i2c_sim_mpu6886_fifo_level(map, now) == 0) {
+            return 0xFF;
+        }
+        if (i2c_sim_mpu6886_fifo_byte == 0) {
+            int64_t at = i2c_sim_mpu6886_fifo_start_us + (i2c_sim_mpu6886_fifo_read + 1) * i2c_sim_mpu6886_period_us(map->reg);
+            i2c_sim_mpu6886_sample(map->reg, at, i2c_sim_mpu6886_fifo_frame);
+        }
+        uint8_t data = i2c_sim_mpu6886_fifo_frame[i2c_sim_mpu6886_fifo_byte++];
+        if (i2c_sim_mpu6886_fifo_byte == 14) {
+            i2c_sim_mpu6886_fifo_byte = 0;
+            i2c_sim_mpu6886_fifo_read++;
+        }
+        return data;
+    }
+    if (map->ptr == 0x3A) {
+        uint8_t data = map->reg[0x3A];
+        map->reg[0x3A] = 0;
+        map->ptr++;
+        return data;
+    }
+    return i2c_sim_regmap_read(model);
+}
+
+static void i2c_sim_mpu6886_reset(void) {
+    memset(&i2c_sim_mpu6886_map, 0, sizeof(i2c_sim_mpu6886_map));
+    i2c_sim_mpu6886_map.reg[0x6B] = 0x40;  // asleep after reset
+    i2c_sim_mpu6886_map.reg[0x75] = 0x19;
+    i2c_sim_mpu6886_map.refresh = i2c_sim_mpu6886_refresh;
+    i2c_sim_mpu6886_map.written = i2c_sim_mpu6886_written;
+    i2c_sim_mpu6886_fifo_read = 0;
+    i2c_sim_mpu6886_fifo_byte = 0;
+}
+
+/* --------------------------------------------------------------- PCF8563 */
+
+/*
+    Time runs from base_time at base_us, CONFIG_I2C_SIM_PCF8563_DRIFT_PPM
+    fast. The alarm and timer registers are plain storage; nothing fires.
+*/
+static i2c_sim_regmap_t i2c_sim_pcf8563_map;
+static int64_t i2c_sim_pcf8563_base_time;
+static int64_t i2c_sim_pcf8563_base_us;
+
+static uint8_t i2c_sim_bcd(uint8_t value) {
+    return ((value / 10) << 4) | (value % 10);
+}
+
+static uint8_t i2c_sim_unbcd(uint8_t value) {
+    return (value >> 4) * 10 + (value & 0x0F);
+}
+
+static int64_t i2c_sim_days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (int64_t)era * 146097 + doe - 719468;
+}
+
+static void i2c_sim_pcf8563_refresh(i2c_sim_regmap_t *map) {
+    if (map->ptr > 0x08) {
+        return ;
+    }
+    int64_t elapsed_us = esp_timer_get_time() - i2c_sim_pcf8563_base_us;
+    elapsed_us += elapsed_us * CONFIG_I2C_SIM_PCF8563_DRIFT_PPM / 1000000;
+    time_t now = i2c_sim_pcf8563_base_time + elapsed_us / 1000000;
+    struct tm timeinfo;
+    gmtime_r(&now, &timeinfo);
+    map->reg[0x02] = (map->reg[0x02] & 0x80) | i2c_sim_bcd(timeinfo.tm_sec);
+    map->reg[0x03] = i2c_sim_bcd(timeinfo.tm_min);
+    map->reg[0x04] = i2c_sim_bcd(timeinfo.tm_hour);
+    map->reg[0x05] = i2c_sim_bcd(timeinfo.tm_mday);
+    map->reg[0x06] = timeinfo.tm_wday;
+    map->reg[0x07] = i2c_sim_bcd(timeinfo.tm_mon + 1) | (timeinfo.tm_year < 100 ? 0x80 : 0x00);
+    map->reg[0x08] = i2c_sim_bcd(timeinfo.tm_year % 100);
+}
+
+static void i2c_sim_pcf8563_written(i2c_sim_regmap_t *map, uint8_t reg) {
+    if (reg >= 0x02 && reg <= 0x08) {
+        map->dirty = true;
+    }
+}
+
+static void i2c_sim_pcf8563_stopped(i2c_sim_regmap_t *map) {
+    if (!map->dirty) {
+        return ;
+    }
+    int year = i2c_sim_unbcd(map->reg[0x08]) + ((map->reg[0x07] & 0x80) ? 1900 : 2000);
+    int64_t days = i2c_sim_days_from_civil(year, i2c_sim_unbcd(map->reg[0x07] & 0x1F), i2c_sim_unbcd(map->reg[0x05] & 0x3F));
+    i2c_sim_pcf8563_base_time = days * 86400
+        + i2c_sim_unbcd(map->reg[0x04] & 0x3F) * 3600
+        + i2c_sim_unbcd(map->reg[0x03] & 0x7F) * 60
+        + i2c_sim_unbcd(map->reg[0x02] & 0x7F);
+    i2c_sim_pcf8563_base_us = esp_timer_get_time();
+}
+
+static void i2c_sim_pcf8563_reset(void) {
+    memset(&i2c_sim_pcf8563_map, 0, sizeof(i2c_sim_pcf8563_map));
+    i2c_sim_pcf8563_map.reg[0x02] = 0x80;  // VL: never set since power-up
+    i2c_sim_pcf8563_base_time = 946684800; // 2000-01-01 00:00:00
+    i2c_sim_pcf8563_base_us = esp_timer_get_time();
+    i2c_sim_pcf8563_map.refresh = i2c_sim_pcf8563_refresh;
+    i2c_sim_pcf8563_map.written = i2c_sim_pcf8563_written;
+    i2c_sim_pcf8563_map.stopped = i2c_sim_pcf8563_stopped;
+}
+
+/* ----------------------------------------------------------------- SHT3x */
+
+/*
+    Command-driven: a write carries one 16-bit command, a read returns
+    what the last command produced. Single shot without clock stretching
+    NACKs reads until the measurement time has passed; periodic mode
+    serves one fresh sample per period through FETCH (0xE000).
+*/
+typedef struct _i2c_sim_sht3x_t {
+    uint8_t cmd[2];
+    uint8_t cmd_len;
+    uint8_t out[6];
+    uint8_t out_len;
+    uint8_t out_pos;
+    int64_t ready_us;
+    bool pending;
+    uint32_t period_us;
+    int64_t period_start_us;
+    int64_t fetched;
+    uint16_t status;
+} i2c_sim_sht3x_t;
+
+static i2c_sim_sht3x_t i2c_sim_sht3x;
+static i2c_sim_sht3x_t i2c_sim_sht3x_alt;
+
+static uint8_t i2c_sim_crc8(const uint8_t *data, uint8_t length) {
+    uint8_t crc = 0xFF;
+    for (uint8_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void i2c_sim_sht3x_put(uint8_t *out, uint16_t value) {
+    out[0] = value >> 8;
+    out[1] = value & 0xFF;
+    out[2] = i2c_sim_crc8(out, 2);
+}
+
+static void i2c_sim_sht3x_sample(i2c_sim_sht3x_t *sht, int64_t now) {
+    int32_t centi_c = 2350 + i2c_sim_wave(now, 600000, 50);
+    int32_t centi_rh = 4500 + i2c_sim_wave(now, 900000, 200);
+    i2c_sim_sht3x_put(&sht->out[0], ((centi_c + 4500) * 65535) / 17500);
+    i2c_sim_sht3x_put(&sht->out[3], (centi_rh * 65535) / 10000);
+    sht->out_len = 6;
+    sht->out_pos = 0;
+}
+
+static void i2c_sim_sht3x_command(i2c_sim_sht3x_t *sht, uint16_t cmd) {
+    int64_t now = esp_timer_get_time();
+    uint8_t msb = cmd >> 8;
+    sht->out_len = 0;
+    sht->pending = false;
+
+    if (msb == 0x2C || msb == 0x24) {
+        // Repeatability in the LSB: high 15 ms, medium 6 ms, low 4 ms.
+        uint8_t lsb = cmd & 0xFF;
+        uint32_t duration = (lsb == 0x06 || lsb == 0x00) ? 15000 : (lsb == 0x0D || lsb == 0x0B) ? 6000 : 4000;
+        sht->pending = true;
+        sht->ready_us = (msb == 0x2C) ? now : now + duration;
+        sht->period_us = 0;
+    } else if ((msb >= 0x20 && msb <= 0x27 && msb != 0x24) || cmd == 0x2B32) {
+        static const uint32_t period_us[] = { 2000000, 1000000, 500000, 250000, 0, 0, 0, 100000 };
+        // ART runs at 4 mps.
+        sht->period_us = (cmd == 0x2B32) ? 250000 : period_us[msb - 0x20];
+        sht->period_start_us = now;
+        sht->fetched = 0;
+    } else if (cmd == 0xE000) {
+        if (sht->period_us != 0) {
+            int64_t available = (now - sht->period_start_us) / sht->period_us;
+            if (available > sht->fetched) {
+                sht->fetched = available;
+                i2c_sim_sht3x_sample(sht, now);
+            }
+        }
+    } else if (cmd == 0x3093 || cmd == 0x30A2) {
+        sht->period_us = 0;
+        sht->status = 0;
+    } else if (cmd == 0xF32D) {
+        i2c_sim_sht3x_put(sht->out, sht->status);
+        sht->out_len = 3;
+        sht->out_pos = 0;
+    } else if (cmd == 0x3041) {
+        sht->status = 0;
+    }
+}
+
+static bool i2c_sim_sht3x_start(i2c_sim_model_t *model, bool read) {
+    i2c_sim_sht3x_t* sht = (i2c_sim_sht3x_t *)model->ctx;
+    if (!read) {
+        sht->cmd_len = 0;
+        return true;
+    }
+    if (sht->pending) {
+        int64_t now = esp_timer_get_time();
+        if (now < sht->ready_us) {
+            return false;
+        }
+        sht->pending = false;
+        i2c_sim_sht3x_sample(sht, now);
+    }
+    return sht->out_len > 0;
+}
+
+static void i2c_sim_sht3x_write(i2c_sim_model_t *model, uint8_t data) {
+    i2c_sim_sht3x_t* sht = (i2c_sim_sht3x_t *)model->ctx;
+    if (sht->cmd_len < 2) {
+        sht->cmd[sht->cmd_len++] = data;
+        if (sht->cmd_len == 2) {
+            i2c_sim_sht3x_command(sht, (sht->cmd[0] << 8) | sht->cmd[1]);
+        }
+    }
+}
+
+static uint8_t i2c_sim_sht3x_read(i2c_sim_model_t *model) {
+    i2c_sim_sht3x_t* sht = (i2c_sim_sht3x_t *)model->ctx;
+    if (sht->out_pos >= sht->out_len) {
+        return 0xFF;
+    }
+    uint8_t data = sht->out[sht->out_pos++];
+    if (sht->out_pos == sht->out_len) {
+        sht->out_len = 0;
+    }
+    return data;
+}
+
+/* ----------------------------------------------------------------- PaHub */
+
+/*
+    PCA9548A channel switch: one control byte, written and read back
+    without a register address. Channels are not modelled; devices
+    behind the hub answer on the main bus by address.
+*/
+static uint8_t i2c_sim_pahub_mask;
+
+static bool i2c_sim_pahub_start(i2c_sim_model_t *model, bool read) {
+    return true;
+}
+
+static void i2c_sim_pahub_write(i2c_sim_model_t *model, uint8_t data) {
+    *(uint8_t *)model->ctx = data;
+}
+
+static uint8_t i2c_sim_pahub_read(i2c_sim_model_t *model) {
+    return *(uint8_t *)model->ctx;
+}
+
+/* ------------------------------------------------------------------ bus */
+
+static i2c_sim_model_t i2c_sim_models[] = {
+    { "AXP192", 0x34, i2c_sim_regmap_start, i2c_sim_regmap_write, i2c_sim_regmap_read, i2c_sim_regmap_stop, &i2c_sim_axp192_map },
+    { "MPU6886", 0x68, i2c_sim_regmap_start, i2c_sim_regmap_write, i2c_sim_mpu6886_read, i2c_sim_regmap_stop, &i2c_sim_mpu6886_map },
+    { "PCF8563", 0x51, i2c_sim_regmap_start, i2c_sim_regmap_write, i2c_sim_regmap_read, i2c_sim_regmap_stop, &i2c_sim_pcf8563_map },
+    { "SHT3X", 0x44, i2c_sim_sht3x_start, i2c_sim_sht3x_write, i2c_sim_sht3x_read, NULL, &i2c_sim_sht3x },
+    { "SHT3X", 0x45, i2c_sim_sht3x_start, i2c_sim_sht3x_write, i2c_sim_sht3x_read, NULL, &i2c_sim_sht3x_alt },
+    { "PAHUB", 0x70, i2c_sim_pahub_start, i2c_sim_pahub_write, i2c_sim_pahub_read, NULL, &i2c_sim_pahub_mask },
+};
+
+i2c_sim_model_t *i2c_sim_model_find(uint8_t addr) {
+    static bool initialized = false;
+    if (!initialized) {
+        initialized = true;
+        i2c_sim_axp192_reset();
+        i2c_sim_mpu6886_reset();
+        i2c_sim_pcf8563_reset();
+        memset(&i2c_sim_sht3x, 0, sizeof(i2c_sim_sht3x));
+        memset(&i2c_sim_sht3x_alt, 0, sizeof(i2c_sim_sht3x_alt));
+        i2c_sim_pahub_mask = 0;
+    }
+
+    for (uint8_t i = 0; i < sizeof(i2c_sim_models) / sizeof(i2c_sim_models[0]); i++) {
+        if (i2c_sim_models[i].addr == addr) {
+            return &i2c_sim_models[i];
+        }
+    }
+    return NULL;
+}
+
+#endif
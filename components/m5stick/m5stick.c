@@ -9,8 +9,11 @@
 #include "esp_system.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
 
 #include "m5stick.h"
+#include "axp192_i2c.h"
 
 #if CONFIG_SOFTWARE_UI_SUPPORT
 #include "lvgl.h"
@@ -30,15 +33,46 @@
 
 static const char *TAG = "M5StickCPlus";
 
+static m5stick_boot_t m5stick_boot;
+
+// Once for everyone: the drivers and the app only nvs_open().
+static void m5stick_nvs_init(void) {
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(err);
+}
+
 void M5Stick_Init(void) {
 ESP_LOGI(TAG, "M5Stick_Init Init().");
+    m5stick_boot.start_us = esp_timer_get_time();
 
 #if CONFIG_SOFTWARE_UI_SUPPORT
     M5Stick_PMU_Init(3300, 0, 0, 2700);
-    M5Stick_Display_Init();
 #else
     M5Stick_PMU_Init(0, 0, 0, 0);
 #endif
+    m5stick_boot.pmu_us = esp_timer_get_time();
+
+    // The RTC restore and the IMU read their calibration from NVS.
+    m5stick_nvs_init();
+
+#if CONFIG_SOFTWARE_RTC_SUPPORT
+    // First after the PMU, ahead of the slow display bring-up, so that
+    // everything after gets a real timestamp.
+    PCF8563_Init();
+    m5stick_boot.rtc_err = TimeSvc_RestoreFromRtc();
+#else
+    m5stick_boot.rtc_err = ESP_ERR_NOT_SUPPORTED;
+#endif
+    m5stick_boot.rtc_us = esp_timer_get_time();
+
+#if CONFIG_SOFTWARE_UI_SUPPORT
+    M5Stick_Display_Init();
+#endif
+    m5stick_boot.display_us = esp_timer_get_time();
 
 #if CONFIG_SOFTWARE_BUTTON_SUPPORT
     M5Stick_Button_Init();
@@ -48,14 +82,14 @@ ESP_LOGI(TAG, "M5Stick_Init Init().");
     M5Stick_Led_Init();
 #endif
 
-#if CONFIG_SOFTWARE_RTC_SUPPORT
-    PCF8563_Init();
-#endif
-
 #if CONFIG_SOFTWARE_MPU6886_SUPPORT
     MPU6886_Init();
 #endif
+    m5stick_boot.done_us = esp_timer_get_time();
+}
 
+void M5Stick_GetBootTimes(m5stick_boot_t *times) {
+    *times = m5stick_boot;
 }
 
 /* ===================================================================================================*/
@@ -217,6 +251,11 @@ void M5Stick_PMU_Init(uint16_t ldo2_volt, uint16_t ldo3_volt, uint16_t dc2_volt,
     Axp192_SetAdc1Enable(0xfe);
     Axp192_SetGPIO1Mode(1);
     M5Stick_PMU_SetPowerIn(0);
+
+    i2c_reg_cache_stats_t cache_stats;
+    Axp192_GetCacheStats(&cache_stats);
+    ESP_LOGI(TAG, "PMU init register cache hits: %u, misses: %u, uncached: %u",
+        cache_stats.hits, cache_stats.misses, cache_stats.bypass);
 }
 /* ----------------------------------------------- End -----------------------------------------------*/
 /* ===================================================================================================*/
@@ -9,6 +9,7 @@
 
 #if CONFIG_SOFTWARE_RTC_SUPPORT
 #include "pcf8563.h"
+#include "timesvc.h"
 #endif
 
 #if CONFIG_SOFTWARE_MPU6886_SUPPORT
@@ -56,7 +57,21 @@ extern SemaphoreHandle_t xGuiSemaphore;
 #endif
 
 
+/*
+    esp_timer stamps of M5Stick_Init(), each taken at the end of its
+    stage, in order. Stages not built in repeat the previous stamp.
+*/
+typedef struct {
+    int64_t start_us;
+    int64_t pmu_us;
+    int64_t rtc_us;         // system clock restored from the RTC, or not
+    esp_err_t rtc_err;      // TimeSvc_RestoreFromRtc() result
+    int64_t display_us;
+    int64_t done_us;        // buttons, LED, IMU
+} m5stick_boot_t;
+
 void M5Stick_Init(void);
+void M5Stick_GetBootTimes(m5stick_boot_t *times);
 
 #if CONFIG_SOFTWARE_BUTTON_SUPPORT
 extern Button_t* button_a;
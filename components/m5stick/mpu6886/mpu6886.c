@@ -1,24 +1,48 @@
 #include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
 #include "i2c_device.h"
 #include "mpu6886.h"
+#include "mpu6886_i2c.h"
 
 static I2CDevice_t mpu6886_device;
+static I2CReadTemplate_t mpu6886_accel_read;
+static I2CReadTemplate_t mpu6886_gyro_read;
+static I2CReadTemplate_t mpu6886_frame_read;
 static gyro_scale_t gyro_scale = MPU6886_GFS_2000DPS;
 static acc_scale_t acc_scale = MPU6886_AFS_8G;
 static float acc_res, gyro_res;
 
 static void MPU6886_I2CInit() {
     mpu6886_device = i2c_malloc_device(I2C_NUM_0, GPIO_NUM_21, GPIO_NUM_22, 400000, MPU6886_ADDRESS);
+    i2c_device_set_name(mpu6886_device, "MPU6886");
+    // Sample reads are time-sensitive; let them jump the bus queue.
+    i2c_device_set_priority(mpu6886_device, I2C_PRIORITY_HIGH);
+    i2c_device_set_deadline(mpu6886_device, 2000);
+    mpu6886_accel_read = i2c_malloc_read_template(mpu6886_device, MPU6886_ACCEL_XOUT_H, 6);
+    mpu6886_gyro_read = i2c_malloc_read_template(mpu6886_device, MPU6886_GYRO_XOUT_H, 6);
+    mpu6886_frame_read = i2c_malloc_read_template(mpu6886_device, MPU6886_ACCEL_XOUT_H, MPU6886_FIFO_FRAME_SIZE);
 }
 
-static void MPU6886_I2CReadBytes(uint8_t start_Addr, uint8_t number_Bytes, uint8_t *read_Buffer) {
+I2CDevice_t MPU6886_I2CDevice(void) {
+    return mpu6886_device;
+}
+
+void MPU6886_I2CReadBytes(uint8_t start_Addr, uint8_t number_Bytes, uint8_t *read_Buffer) {
     i2c_read_bytes(mpu6886_device, start_Addr, read_Buffer, number_Bytes);
 }
 
-static void MPU6886_I2CWriteBytes(uint8_t start_Addr, uint8_t number_Bytes, uint8_t *write_Buffer) {
+void MPU6886_I2CWriteBytes(uint8_t start_Addr, uint8_t number_Bytes, uint8_t *write_Buffer) {
     i2c_write_bytes(mpu6886_device, start_Addr, write_Buffer, number_Bytes);
 }
 
+void MPU6886_DecodeFrame(const uint8_t *raw, mpu6886_frame_t *frame) {
+    for (uint8_t axis = 0; axis < 3; axis++) {
+        frame->accel[axis] = ((uint16_t)raw[axis * 2] << 8) | raw[axis * 2 + 1];
+        frame->gyro[axis] = ((uint16_t)raw[8 + axis * 2] << 8) | raw[8 + axis * 2 + 1];
+    }
+    frame->temp = ((uint16_t)raw[6] << 8) | raw[7];
+}
+
 int MPU6886_Init(void) {
     unsigned char tempdata[1];
     unsigned char regdata;
@@ -42,44 +66,32 @@ int MPU6886_Init(void) {
     MPU6886_I2CWriteBytes(MPU6886_PWR_MGMT_1, 1, &regdata);
     vTaskDelay(10);
 
-    regdata = 0x10;
-    MPU6886_I2CWriteBytes(MPU6886_ACCEL_CONFIG, 1, &regdata);
-    vTaskDelay(1);
-
-    regdata = 0x18;
-    MPU6886_I2CWriteBytes(MPU6886_GYRO_CONFIG, 1, &regdata);
-    vTaskDelay(1);
-
-    regdata = 0x01;
-    MPU6886_I2CWriteBytes(MPU6886_CONFIG, 1, &regdata);
-    vTaskDelay(1);
-
-    regdata = 0x05;
-    MPU6886_I2CWriteBytes(MPU6886_SMPLRT_DIV, 1, &regdata);
-    vTaskDelay(1);
-
-    regdata = 0x00;
-    MPU6886_I2CWriteBytes(MPU6886_INT_ENABLE, 1, &regdata);
-    vTaskDelay(1);
-
-    regdata = 0x00;
-    MPU6886_I2CWriteBytes(MPU6886_ACCEL_CONFIG2, 1, &regdata);
-    vTaskDelay(1);
-
-    regdata = 0x00;
-    MPU6886_I2CWriteBytes(MPU6886_USER_CTRL, 1, &regdata);
-    vTaskDelay(1);
-
-    regdata = 0x00;
-    MPU6886_I2CWriteBytes(MPU6886_FIFO_EN, 1, &regdata);
-    vTaskDelay(1);
-
-    regdata = 0x22;
-    MPU6886_I2CWriteBytes(MPU6886_INT_PIN_CFG, 1, &regdata);
-    vTaskDelay(1);
-
-    regdata = 0x01;
-    MPU6886_I2CWriteBytes(MPU6886_INT_ENABLE, 1, &regdata);
+    // Register configuration goes out as one chain: a single bus
+    // acquisition instead of a START/STOP and a tick delay per register.
+    uint8_t accel_config = 0x10;
+    uint8_t gyro_config = 0x18;
+    uint8_t config = 0x01;
+    uint8_t smplrt_div = 0x05;
+    uint8_t int_pin_cfg = 0x22;
+    uint8_t int_enable = 0x01;
+    uint8_t zero = 0x00;
+    i2c_segment_t config_seq[] = {
+        { I2C_OP_WRITE, MPU6886_ACCEL_CONFIG, &accel_config, 1 },
+        { I2C_OP_WRITE, MPU6886_GYRO_CONFIG, &gyro_config, 1 },
+        { I2C_OP_WRITE, MPU6886_CONFIG, &config, 1 },
+        { I2C_OP_WRITE, MPU6886_SMPLRT_DIV, &smplrt_div, 1 },
+        { I2C_OP_WRITE, MPU6886_INT_ENABLE, &zero, 1 },
+        { I2C_OP_WRITE, MPU6886_ACCEL_CONFIG2, &zero, 1 },
+        { I2C_OP_WRITE, MPU6886_USER_CTRL, &zero, 1 },
+        { I2C_OP_WRITE, MPU6886_FIFO_EN, &zero, 1 },
+        { I2C_OP_WRITE, MPU6886_INT_PIN_CFG, &int_pin_cfg, 1 },
+        { I2C_OP_WRITE, MPU6886_INT_ENABLE, &int_enable, 1 },
+    };
+    if (i2c_transfer(mpu6886_device, config_seq, sizeof(config_seq) / sizeof(config_seq[0])) != ESP_OK) {
+        return -1;
+    }
+    // The reset above also cleared the user offsets.
+    MPU6886_RestoreCalibration();
     vTaskDelay(100);
 
     gyro_res = MPU6886_GetGyroRes(gyro_scale);
@@ -88,8 +100,8 @@ int MPU6886_Init(void) {
 }
 
 void MPU6886_GetAccelAdc(int16_t *ax, int16_t *ay, int16_t *az) {
-    uint8_t buf[6];
-    MPU6886_I2CReadBytes(MPU6886_ACCEL_XOUT_H, 6, buf);
+    uint8_t buf[6] = {0};
+    i2c_read_template(mpu6886_accel_read, buf);
 
     *ax = ((int16_t)buf[0] << 8) | buf[1];
     *ay = ((int16_t)buf[2] << 8) | buf[3];
@@ -97,14 +109,42 @@ void MPU6886_GetAccelAdc(int16_t *ax, int16_t *ay, int16_t *az) {
 }
 
 void MPU6886_GetGyroAdc(int16_t *gx, int16_t *gy, int16_t *gz) {
-    uint8_t buf[6];
-    MPU6886_I2CReadBytes(MPU6886_GYRO_XOUT_H, 6, buf);
+    uint8_t buf[6] = {0};
+    i2c_read_template(mpu6886_gyro_read, buf);
 
     *gx = ((uint16_t)buf[0] << 8) | buf[1];
     *gy = ((uint16_t)buf[2] << 8) | buf[3];
     *gz = ((uint16_t)buf[4] << 8) | buf[5];
 }
 
+esp_err_t MPU6886_GetFrame(mpu6886_frame_t *frame, mpu6886_frame_scaled_t *scaled) {
+    uint8_t buf[MPU6886_FIFO_FRAME_SIZE];
+    mpu6886_frame_t raw;
+    if (frame == NULL) {
+        frame = &raw;
+    }
+
+    // The sensor copies all output registers into its read buffer when
+    // the burst starts, so one timestamp taken here covers every field.
+    int64_t timestamp = esp_timer_get_time();
+    esp_err_t err = i2c_read_template(mpu6886_frame_read, buf);
+    if (err != ESP_OK) {
+        return err;
+    }
+    MPU6886_DecodeFrame(buf, frame);
+    frame->timestamp_us = timestamp;
+
+    if (scaled != NULL) {
+        scaled->timestamp_us = timestamp;
+        for (uint8_t axis = 0; axis < 3; axis++) {
+            scaled->accel[axis] = (float)frame->accel[axis] * acc_res;
+            scaled->gyro[axis] = (float)frame->gyro[axis] * gyro_res;
+        }
+        scaled->temp = (float)frame->temp / 326.8 + 25.0;
+    }
+    return ESP_OK;
+}
+
 void MPU6886_GetTempAdc(int16_t *t) {
     uint8_t buf[2];
     MPU6886_I2CReadBytes(MPU6886_TEMP_OUT_H, 2, buf);
@@ -142,6 +182,11 @@ float MPU6886_GetAccRes(acc_scale_t scale) {
     }
 }
 
+void MPU6886_GetResolution(float *acc, float *gyro) {
+    *acc = acc_res;
+    *gyro = gyro_res;
+}
+
 void MPU6886_SetGyroFSR(gyro_scale_t scale) {
     unsigned char regdata;
     regdata = (scale << 3);
@@ -6,9 +6,15 @@
 #pragma once
 
 #include "stdint.h"
+#include "stdbool.h"
+#include "esp_err.h"
 
 #define MPU6886_ADDRESS           0x68 
 #define MPU6886_WHOAMI            0x75
+#define MPU6886_XG_OFFS_USRH      0x13
+#define MPU6886_XA_OFFSET_H       0x77
+#define MPU6886_YA_OFFSET_H       0x7A
+#define MPU6886_ZA_OFFSET_H       0x7D
 #define MPU6886_ACCEL_INTEL_CTRL  0x69
 #define MPU6886_SMPLRT_DIV        0x19
 #define MPU6886_INT_PIN_CFG       0x37
@@ -38,6 +44,19 @@
 #define MPU6886_ACCEL_CONFIG      0x1C
 #define MPU6886_ACCEL_CONFIG2     0x1D
 #define MPU6886_FIFO_EN           0x23
+#define MPU6886_ACCEL_WOM_X_THR   0x20
+#define MPU6886_ACCEL_WOM_Y_THR   0x21
+#define MPU6886_ACCEL_WOM_Z_THR   0x22
+#define MPU6886_FIFO_WM_INT_STATUS 0x39
+#define MPU6886_INT_STATUS        0x3A
+#define MPU6886_FIFO_WM_TH1       0x60
+#define MPU6886_FIFO_WM_TH2       0x61
+#define MPU6886_FIFO_COUNTH       0x72
+#define MPU6886_FIFO_COUNTL       0x73
+#define MPU6886_FIFO_R_W          0x74
+
+// One FIFO record with accel and gyro enabled: accel XYZ, temp, gyro XYZ.
+#define MPU6886_FIFO_FRAME_SIZE   14
 
 /**
  * @brief List of possible accelerometer scalars in Gs.
@@ -133,6 +152,16 @@ float MPU6886_GetGyroRes(gyro_scale_t scale);
 float MPU6886_GetAccRes(acc_scale_t scale);
 /* @[declare_mpu6886_getaccres] */
 
+/**
+ * @brief Retrieves the scale factors for the current full-scale ranges.
+ *
+ * @param[out] acc The G per accelerometer count.
+ * @param[out] gyro The degrees per second per gyroscope count.
+ */
+/* @[declare_mpu6886_getresolution] */
+void MPU6886_GetResolution(float *acc, float *gyro);
+/* @[declare_mpu6886_getresolution] */
+
 /**
  * @brief Sets the full-scale range of the gyroscope on the MPU6886.
  * 
@@ -210,3 +239,287 @@ void MPU6886_GetGyroData(float *roll, float *yaw, float *pitch);
 /* @[declare_mpu6886_gettempdata] */
 void MPU6886_GetTempData(float *t);
 /* @[declare_mpu6886_gettempdata] */
+
+/**
+ * @brief One timestamped IMU sample, in raw ADC counts.
+ */
+/* @[declare_mpu6886_frame_t] */
+typedef struct {
+    int64_t timestamp_us;   // esp_timer time the sample was taken
+    int16_t accel[3];
+    int16_t temp;
+    int16_t gyro[3];
+} mpu6886_frame_t;
+/* @[declare_mpu6886_frame_t] */
+
+/**
+ * @brief One timestamped IMU sample in physical units.
+ */
+/* @[declare_mpu6886_frame_scaled_t] */
+typedef struct {
+    int64_t timestamp_us;   // esp_timer time the sample was taken
+    float accel[3];         // G
+    float temp;             // degrees Celsius
+    float gyro[3];          // degrees per second
+} mpu6886_frame_scaled_t;
+/* @[declare_mpu6886_frame_scaled_t] */
+
+/**
+ * @brief Reads accel, temperature and gyro in one burst.
+ *
+ * ACCEL_XOUT_H through GYRO_ZOUT_L are read in a single transaction, so
+ * all seven values come from the same sample and share one timestamp.
+ * Costs one bus acquisition instead of the three taken by
+ * MPU6886_GetAccelData(), MPU6886_GetGyroData() and MPU6886_GetTempData().
+ *
+ * **Example:**
+ *
+ * @code{c}
+ *  mpu6886_frame_scaled_t imu;
+ *  if (MPU6886_GetFrame(NULL, &imu) == ESP_OK) {
+ *      printf("%lld: %.2f G\n", imu.timestamp_us, imu.accel[2]);
+ *  }
+ * @endcode
+ *
+ * @param[out] frame Raw ADC counts, may be NULL.
+ * @param[out] scaled Values scaled by the current full-scale ranges, may be NULL.
+ *
+ * @return ESP_OK, or the I2C error.
+ */
+/* @[declare_mpu6886_getframe] */
+esp_err_t MPU6886_GetFrame(mpu6886_frame_t *frame, mpu6886_frame_scaled_t *scaled);
+/* @[declare_mpu6886_getframe] */
+
+/**
+ * @brief Counters of the FIFO streaming mode.
+ */
+/* @[declare_mpu6886_stream_stats_t] */
+typedef struct {
+    uint32_t frames;          // frames read out of the sensor FIFO
+    uint32_t ring_drops;      // frames lost because the consumer fell behind
+    uint32_t fifo_overflows;  // sensor FIFO overruns; the FIFO is reset each time
+    uint32_t drains;          // bulk FIFO reads
+    uint16_t fifo_max_bytes;  // highest FIFO fill seen at drain time
+    float rate_hz;            // achieved sample rate since MPU6886_StreamStart()
+} mpu6886_stream_stats_t;
+/* @[declare_mpu6886_stream_stats_t] */
+
+/**
+ * @brief Starts FIFO streaming of accel and gyro samples.
+ *
+ * The sample-rate divider is set for rate_hz (1 kHz / n, 4 to 1000 Hz)
+ * and a drain task reads the FIFO in bulk every time it holds
+ * watermark frames. Frames go into a single-producer single-consumer
+ * ring of CONFIG_MPU6886_STREAM_RING_FRAMES entries, read back with
+ * MPU6886_StreamRead() from one consumer task.
+ *
+ * @param[in] rate_hz Sample rate.
+ * @param[in] watermark Frames per bulk read.
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE if already streaming.
+ */
+/* @[declare_mpu6886_streamstart] */
+esp_err_t MPU6886_StreamStart(uint16_t rate_hz, uint16_t watermark);
+/* @[declare_mpu6886_streamstart] */
+
+/**
+ * @brief Stops streaming and disables the sensor FIFO.
+ */
+/* @[declare_mpu6886_streamstop] */
+void MPU6886_StreamStop(void);
+/* @[declare_mpu6886_streamstop] */
+
+/**
+ * @brief Takes the oldest frame out of the stream ring.
+ *
+ * @param[out] frame Frame storage.
+ *
+ * @return true if a frame was available.
+ */
+/* @[declare_mpu6886_streamread] */
+bool MPU6886_StreamRead(mpu6886_frame_t *frame);
+/* @[declare_mpu6886_streamread] */
+
+/**
+ * @brief Retrieves the streaming counters.
+ *
+ * @param[out] stats Counter snapshot.
+ */
+/* @[declare_mpu6886_streamgetstats] */
+void MPU6886_StreamGetStats(mpu6886_stream_stats_t *stats);
+/* @[declare_mpu6886_streamgetstats] */
+
+/**
+ * @brief How MPU6886_AcquireStart() paces single-sample reads.
+ */
+/* @[declare_mpu6886_acq_mode_t] */
+typedef enum {
+    MPU6886_ACQ_POLL = 0,     // task wakes on the FreeRTOS tick
+    MPU6886_ACQ_DATA_READY,   // task wakes on the INT pin data-ready edge
+} mpu6886_acq_mode_t;
+/* @[declare_mpu6886_acq_mode_t] */
+
+/**
+ * @brief Inter-sample interval statistics of MPU6886_AcquireStart().
+ */
+/* @[declare_mpu6886_jitter_stats_t] */
+typedef struct {
+    uint32_t samples;     // samples read
+    uint32_t missed;      // data-ready edges that fired before the reader ran
+    uint32_t timeouts;    // data-ready waits that saw no edge at all
+    uint32_t min_us;
+    uint32_t max_us;
+    float mean_us;
+    float stddev_us;
+} mpu6886_jitter_stats_t;
+/* @[declare_mpu6886_jitter_stats_t] */
+
+/**
+ * @brief Starts one-sample-at-a-time acquisition into the stream ring.
+ *
+ * A reader task reads accel, temp and gyro in one burst per sample and
+ * pushes the frame into the same ring MPU6886_StreamRead() drains. In
+ * MPU6886_ACQ_DATA_READY mode the sensor's data-ready interrupt on
+ * CONFIG_MPU6886_INT_GPIO wakes the task and the frame carries the
+ * interrupt time; MPU6886_ACQ_POLL paces it with the tick instead, as a
+ * reference for MPU6886_GetJitterStats().
+ *
+ * @param[in] mode Pacing.
+ * @param[in] rate_hz Sample rate, 4 to 1000 Hz (1 kHz / n).
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_STATE if acquisition or streaming is
+ * running, ESP_ERR_NOT_SUPPORTED for data-ready without an INT pin.
+ */
+/* @[declare_mpu6886_acquirestart] */
+esp_err_t MPU6886_AcquireStart(mpu6886_acq_mode_t mode, uint16_t rate_hz);
+/* @[declare_mpu6886_acquirestart] */
+
+/**
+ * @brief Stops acquisition and disables the data-ready interrupt.
+ */
+/* @[declare_mpu6886_acquirestop] */
+void MPU6886_AcquireStop(void);
+/* @[declare_mpu6886_acquirestop] */
+
+/**
+ * @brief Retrieves the interval statistics since the last reset.
+ *
+ * @param[out] stats Statistics snapshot.
+ */
+/* @[declare_mpu6886_getjitterstats] */
+void MPU6886_GetJitterStats(mpu6886_jitter_stats_t *stats);
+/* @[declare_mpu6886_getjitterstats] */
+
+/**
+ * @brief Clears the interval statistics; MPU6886_AcquireStart() does too.
+ */
+/* @[declare_mpu6886_resetjitterstats] */
+void MPU6886_ResetJitterStats(void);
+/* @[declare_mpu6886_resetjitterstats] */
+
+/**
+ * @brief Wake-on-motion settings for MPU6886_WomStart().
+ */
+/* @[declare_mpu6886_wom_config_t] */
+typedef struct {
+    uint16_t threshold_mg;     // change between samples that counts as motion, 4 mg steps up to 1020
+    uint16_t wake_rate_hz;     // accel sample rate while duty-cycled, 4 to 500 Hz
+    uint16_t stream_rate_hz;   // non-zero: a motion event leaves WoM and starts streaming at this rate
+} mpu6886_wom_config_t;
+/* @[declare_mpu6886_wom_config_t] */
+
+/**
+ * @brief One wake-on-motion event.
+ */
+/* @[declare_mpu6886_wom_event_t] */
+typedef struct {
+    int64_t timestamp_us;
+    uint8_t axes;              // bit 0 X, bit 1 Y, bit 2 Z over the threshold
+} mpu6886_wom_event_t;
+/* @[declare_mpu6886_wom_event_t] */
+
+/**
+ * @brief Puts the MPU6886 into duty-cycled wake-on-motion mode.
+ *
+ * The gyro is put in standby and the accelerometer runs in low-power
+ * cycle mode at wake_rate_hz, comparing each sample with the previous
+ * one. A change above the threshold on any axis raises the WoM
+ * interrupt on CONFIG_MPU6886_INT_GPIO, which wakes the task that
+ * called this function from MPU6886_WomWait(). Without an INT pin
+ * MPU6886_WomWait() polls INT_STATUS instead.
+ *
+ * @param[in] config Wake-on-motion settings.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_STATE while streaming or acquiring.
+ */
+/* @[declare_mpu6886_womstart] */
+esp_err_t MPU6886_WomStart(const mpu6886_wom_config_t *config);
+/* @[declare_mpu6886_womstart] */
+
+/**
+ * @brief Waits for a motion event.
+ *
+ * Call from the task that called MPU6886_WomStart(). When the config
+ * has a stream_rate_hz, the event also restores full power and starts
+ * MPU6886_StreamStart(); call MPU6886_StreamStop() and
+ * MPU6886_WomStart() again to go back to sleep.
+ *
+ * @param[out] event Event details, may be NULL.
+ * @param[in] timeout_ms Maximum wait.
+ *
+ * @return ESP_OK on motion, ESP_ERR_TIMEOUT, ESP_ERR_INVALID_STATE if
+ * wake-on-motion is not active.
+ */
+/* @[declare_mpu6886_womwait] */
+esp_err_t MPU6886_WomWait(mpu6886_wom_event_t *event, uint32_t timeout_ms);
+/* @[declare_mpu6886_womwait] */
+
+/**
+ * @brief Leaves wake-on-motion and restores the MPU6886_Init()
+ * configuration: full-power accel and gyro, and the data-ready
+ * interrupt on a latched INT pin.
+ *
+ * @return ESP_OK, or the I2C error; wake-on-motion has ended either
+ * way, but the chip may still be in cycle mode.
+ */
+/* @[declare_mpu6886_womstop] */
+esp_err_t MPU6886_WomStop(void);
+/* @[declare_mpu6886_womstop] */
+
+/**
+ * @brief Result of MPU6886_Calibrate().
+ */
+/* @[declare_mpu6886_calibration_t] */
+typedef struct {
+    int16_t gyro_offset[3];    // XG/YG/ZG_OFFS_USR register values
+    int16_t accel_offset[3];   // XA/YA/ZA_OFFSET register values, factory trim included
+    float gyro_bias_dps[3];    // bias measured before correction
+    float accel_bias_mg[3];    // error from 0/0/1 G measured before correction
+} mpu6886_calibration_t;
+/* @[declare_mpu6886_calibration_t] */
+
+/**
+ * @brief Calibrates the gyro and accelerometer offsets.
+ *
+ * The device must lie still with one axis vertical (either way up)
+ * during the capture. The gyro bias and the accelerometer error are
+ * averaged over samples readings, written into the hardware offset
+ * registers and saved in NVS. MPU6886_Init() restores them from NVS in
+ * one burst, so samples come out corrected at no per-sample cost.
+ *
+ * @param[in] samples Number of readings to average, about 100 per second.
+ * @param[out] calibration Result, may be NULL.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_STATE if the device moved during the
+ * capture or streaming is running, or the NVS error if saving failed.
+ */
+/* @[declare_mpu6886_calibrate] */
+esp_err_t MPU6886_Calibrate(uint16_t samples, mpu6886_calibration_t *calibration);
+/* @[declare_mpu6886_calibrate] */
+
+/**
+ * @brief Forgets the saved calibration; the factory offsets return at the next boot.
+ */
+/* @[declare_mpu6886_clearcalibration] */
+esp_err_t MPU6886_ClearCalibration(void);
+/* @[declare_mpu6886_clearcalibration] */
@@ -0,0 +1,199 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "nvs.h"
+#include "esp_log.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "i2c_device.h"
+#include "mpu6886.h"
+#include "mpu6886_i2c.h"
+
+#define TAG "MPU6886"
+
+#define MPU6886_CALIB_NAMESPACE "mpu6886"
+#define MPU6886_CALIB_KEY "calib"
+#define MPU6886_CALIB_VERSION (1)
+// A still sensor stays well inside this gyro spread (dps).
+#define MPU6886_CALIB_MAX_SPREAD_DPS (3.0f)
+// Accel offset register LSB, independent of the full-scale range.
+#define MPU6886_ACCEL_OFFSET_MG (0.98f)
+
+/*
+    Register images as written: gyro XG_OFFS_USRH..ZG_OFFS_USRL in one
+    run, accel as three H/L pairs (they are not contiguous). The accel
+    L registers keep bit 0 as read, it is reserved.
+*/
+typedef struct {
+    uint8_t version;
+    uint8_t gyro_regs[6];
+    uint8_t accel_regs[6];
+} mpu6886_calib_blob_t;
+
+static esp_err_t mpu6886_calib_write(const mpu6886_calib_blob_t *blob) {
+    i2c_segment_t offset_seq[] = {
+        { I2C_OP_WRITE, MPU6886_XG_OFFS_USRH, (uint8_t *)blob->gyro_regs, 6 },
+        { I2C_OP_WRITE, MPU6886_XA_OFFSET_H, (uint8_t *)&blob->accel_regs[0], 2 },
+        { I2C_OP_WRITE, MPU6886_YA_OFFSET_H, (uint8_t *)&blob->accel_regs[2], 2 },
+        { I2C_OP_WRITE, MPU6886_ZA_OFFSET_H, (uint8_t *)&blob->accel_regs[4], 2 },
+    };
+    return i2c_transfer(MPU6886_I2CDevice(), offset_seq, sizeof(offset_seq) / sizeof(offset_seq[0]));
+}
+
+// NVS is initialized by M5Stick_Init().
+static esp_err_t mpu6886_calib_open(nvs_open_mode_t mode, nvs_handle_t *handle) {
+    return nvs_open(MPU6886_CALIB_NAMESPACE, mode, handle);
+}
+
+esp_err_t MPU6886_RestoreCalibration(void) {
+    nvs_handle_t handle;
+    esp_err_t err = mpu6886_calib_open(NVS_READONLY, &handle);
+    if (err != ESP_OK) {
+        return (err == ESP_ERR_NVS_NOT_FOUND) ? ESP_ERR_NOT_FOUND : err;
+    }
+    mpu6886_calib_blob_t blob;
+    size_t length = sizeof(blob);
+    err = nvs_get_blob(handle, MPU6886_CALIB_KEY, &blob, &length);
+    nvs_close(handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (length != sizeof(blob) || blob.version != MPU6886_CALIB_VERSION) {
+        ESP_LOGW(TAG, "ignoring saved calibration (version %u)", blob.version);
+        return ESP_ERR_INVALID_VERSION;
+    }
+    err = mpu6886_calib_write(&blob);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "calibration restored");
+    }
+    return err;
+}
+
+esp_err_t MPU6886_Calibrate(uint16_t samples, mpu6886_calibration_t *calibration) {
+    if (MPU6886_StreamActive() || MPU6886_AcquireActive() || MPU6886_WomActive()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (samples == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Measure the gyro without any user offset; keep the accel trim.
+    mpu6886_calib_blob_t blob;
+    memset(&blob, 0, sizeof(blob));
+    blob.version = MPU6886_CALIB_VERSION;
+    i2c_segment_t read_seq[] = {
+        { I2C_OP_WRITE, MPU6886_XG_OFFS_USRH, blob.gyro_regs, 6 },
+        { I2C_OP_READ, MPU6886_XA_OFFSET_H, &blob.accel_regs[0], 2 },
+        { I2C_OP_READ, MPU6886_YA_OFFSET_H, &blob.accel_regs[2], 2 },
+        { I2C_OP_READ, MPU6886_ZA_OFFSET_H, &blob.accel_regs[4], 2 },
+    };
+    esp_err_t err = i2c_transfer(MPU6886_I2CDevice(), read_seq, sizeof(read_seq) / sizeof(read_seq[0]));
+    if (err != ESP_OK) {
+        return err;
+    }
+    vTaskDelay(pdMS_TO_TICKS(20));
+
+    float acc_res, gyro_res;
+    MPU6886_GetResolution(&acc_res, &gyro_res);
+    int32_t accel_sum[3] = {0}, gyro_sum[3] = {0};
+    int16_t gyro_min[3] = {INT16_MAX, INT16_MAX, INT16_MAX};
+    int16_t gyro_max[3] = {INT16_MIN, INT16_MIN, INT16_MIN};
+    mpu6886_frame_t frame;
+    for (uint16_t i = 0; i < samples; i++) {
+        err = MPU6886_GetFrame(&frame, NULL);
+        if (err != ESP_OK) {
+            return err;
+        }
+        for (uint8_t axis = 0; axis < 3; axis++) {
+            accel_sum[axis] += frame.accel[axis];
+            gyro_sum[axis] += frame.gyro[axis];
+            if (frame.gyro[axis] < gyro_min[axis]) {
+                gyro_min[axis] = frame.gyro[axis];
+            }
+            if (frame.gyro[axis] > gyro_max[axis]) {
+                gyro_max[axis] = frame.gyro[axis];
+            }
+        }
+        vTaskDelay(1);
+    }
+
+    mpu6886_calibration_t result;
+    float accel_g[3];
+    uint8_t vertical = 0;
+    for (uint8_t axis = 0; axis < 3; axis++) {
+        if ((gyro_max[axis] - gyro_min[axis]) * gyro_res > MPU6886_CALIB_MAX_SPREAD_DPS) {
+            ESP_LOGW(TAG, "calibration aborted, device moved");
+            return ESP_ERR_INVALID_STATE;
+        }
+        result.gyro_bias_dps[axis] = (float)gyro_sum[axis] / samples * gyro_res;
+        accel_g[axis] = (float)accel_sum[axis] / samples * acc_res;
+        if (fabsf(accel_g[axis]) > fabsf(accel_g[vertical])) {
+            vertical = axis;
+        }
+    }
+
+    for (uint8_t axis = 0; axis < 3; axis++) {
+        // One gyro offset LSB is 1/32.8 dps whatever the full-scale
+        // range (4 counts at 250 dps); it is added to the output.
+        int32_t gyro_offset = -lroundf(result.gyro_bias_dps[axis] * 32.8f);
+        result.gyro_offset[axis] = (int16_t)gyro_offset;
+        blob.gyro_regs[axis * 2] = (gyro_offset >> 8) & 0xFF;
+        blob.gyro_regs[axis * 2 + 1] = gyro_offset & 0xFF;
+
+        float expected = (axis == vertical) ? ((accel_g[axis] > 0.0f) ? 1.0f : -1.0f) : 0.0f;
+        result.accel_bias_mg[axis] = (accel_g[axis] - expected) * 1000.0f;
+        uint8_t *regs = &blob.accel_regs[axis * 2];
+        int16_t trim = (int16_t)(((uint16_t)regs[0] << 8) | regs[1]) >> 1;
+        int32_t accel_offset = trim - lroundf(result.accel_bias_mg[axis] / MPU6886_ACCEL_OFFSET_MG);
+        if (accel_offset > 16383) {
+            accel_offset = 16383;
+        } else if (accel_offset < -16384) {
+            accel_offset = -16384;
+        }
+        result.accel_offset[axis] = (int16_t)accel_offset;
+        regs[0] = (accel_offset >> 7) & 0xFF;
+        regs[1] = ((accel_offset << 1) & 0xFE) | (regs[1] & 0x01);
+    }
+
+    err = mpu6886_calib_write(&blob);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (calibration != NULL) {
+        *calibration = result;
+    }
+
+    nvs_handle_t handle;
+    err = mpu6886_calib_open(NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(handle, MPU6886_CALIB_KEY, &blob, sizeof(blob));
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    ESP_LOGI(TAG, "calibrated: gyro bias %.2f/%.2f/%.2f dps, accel error %.1f/%.1f/%.1f mg",
+             result.gyro_bias_dps[0], result.gyro_bias_dps[1], result.gyro_bias_dps[2],
+             result.accel_bias_mg[0], result.accel_bias_mg[1], result.accel_bias_mg[2]);
+    return err;
+}
+
+esp_err_t MPU6886_ClearCalibration(void) {
+    nvs_handle_t handle;
+    esp_err_t err = mpu6886_calib_open(NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_erase_key(handle, MPU6886_CALIB_KEY);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return (err == ESP_ERR_NVS_NOT_FOUND) ? ESP_OK : err;
+}
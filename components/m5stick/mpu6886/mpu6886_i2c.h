@@ -0,0 +1,48 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stdint.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "i2c_device.h"
+#include "mpu6886.h"
+
+I2CDevice_t MPU6886_I2CDevice(void);
+
+void MPU6886_I2CReadBytes(uint8_t start_Addr, uint8_t number_Bytes, uint8_t *read_Buffer);
+
+void MPU6886_I2CWriteBytes(uint8_t start_Addr, uint8_t number_Bytes, uint8_t *write_Buffer);
+
+/* Decodes one 14-byte accel/temp/gyro record; timestamp is left to the caller. */
+void MPU6886_DecodeFrame(const uint8_t *raw, mpu6886_frame_t *frame);
+
+/* Stream ring, mpu6886_stream.c. One producer at a time pushes. */
+bool MPU6886_RingPush(const mpu6886_frame_t *frame);
+
+void MPU6886_RingReset(void);
+
+bool MPU6886_StreamActive(void);
+
+/*
+    INT pin, mpu6886_irq.c. Each rising edge is timestamped and notifies
+    task; ESP_ERR_NOT_SUPPORTED when CONFIG_MPU6886_INT_GPIO is -1.
+*/
+esp_err_t MPU6886_IrqAttach(TaskHandle_t task);
+
+void MPU6886_IrqDetach(void);
+
+int64_t MPU6886_IrqTimestamp(void);
+
+bool MPU6886_AcquireActive(void);
+
+bool MPU6886_WomActive(void);
+
+/* Writes the offsets saved by MPU6886_Calibrate(); ESP_ERR_NOT_FOUND if none. */
+esp_err_t MPU6886_RestoreCalibration(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,293 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "i2c_device.h"
+#include "mpu6886.h"
+#include "mpu6886_i2c.h"
+
+#define TAG "MPU6886"
+
+#define MPU6886_INT_GPIO CONFIG_MPU6886_INT_GPIO
+// Data-ready edges should come every sample period; this long without
+// one means the interrupt line is not wired or not configured.
+#define MPU6886_IRQ_TIMEOUT_MS (100)
+
+static TaskHandle_t mpu6886_irq_task;
+static volatile int64_t mpu6886_irq_time_us;
+#if MPU6886_INT_GPIO >= 0
+static bool mpu6886_irq_installed;
+#endif
+
+static TaskHandle_t mpu6886_acq_task_handle;
+static volatile bool mpu6886_acq_running;
+static mpu6886_acq_mode_t mpu6886_acq_mode;
+static uint16_t mpu6886_acq_rate_hz;
+
+/*
+    Inter-sample intervals are accumulated as sums so the snapshot can
+    derive mean and standard deviation without a division per sample.
+*/
+static struct {
+    uint32_t samples;
+    uint32_t missed;
+    uint32_t timeouts;
+    uint32_t intervals;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint64_t sum_sq_us;
+    int64_t last_us;
+} mpu6886_jitter;
+static portMUX_TYPE mpu6886_jitter_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if MPU6886_INT_GPIO >= 0
+static void IRAM_ATTR mpu6886_isr(void *arg) {
+    BaseType_t woken = pdFALSE;
+    mpu6886_irq_time_us = esp_timer_get_time();
+    if (mpu6886_irq_task != NULL) {
+        vTaskNotifyGiveFromISR(mpu6886_irq_task, &woken);
+    }
+    if (woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+#endif
+
+esp_err_t MPU6886_IrqAttach(TaskHandle_t task) {
+#if MPU6886_INT_GPIO < 0
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    if (!mpu6886_irq_installed) {
+        // GPIO35 is input-only without internal pulls; INT is push-pull.
+        gpio_config_t io_conf = {
+            .pin_bit_mask = (1ULL << MPU6886_INT_GPIO),
+            .mode = GPIO_MODE_INPUT,
+            .pull_up_en = GPIO_PULLUP_DISABLE,
+            .pull_down_en = GPIO_PULLDOWN_DISABLE,
+            .intr_type = GPIO_INTR_POSEDGE,
+        };
+        esp_err_t err = gpio_config(&io_conf);
+        if (err != ESP_OK) {
+            return err;
+        }
+        // Another driver may already own the shared ISR service.
+        err = gpio_install_isr_service(0);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+            return err;
+        }
+        err = gpio_isr_handler_add((gpio_num_t)MPU6886_INT_GPIO, mpu6886_isr, NULL);
+        if (err != ESP_OK) {
+            return err;
+        }
+        mpu6886_irq_installed = true;
+    }
+    mpu6886_irq_task = task;
+    return ESP_OK;
+#endif
+}
+
+void MPU6886_IrqDetach(void) {
+    mpu6886_irq_task = NULL;
+}
+
+int64_t MPU6886_IrqTimestamp(void) {
+    return mpu6886_irq_time_us;
+}
+
+bool MPU6886_AcquireActive(void) {
+    return mpu6886_acq_task_handle != NULL;
+}
+
+static void mpu6886_jitter_record(int64_t timestamp_us, uint32_t missed) {
+    portENTER_CRITICAL(&mpu6886_jitter_lock);
+    mpu6886_jitter.samples++;
+    mpu6886_jitter.missed += missed;
+    // An interval spanning a missed sample is not a sample interval.
+    if (mpu6886_jitter.last_us != 0 && missed == 0) {
+        uint32_t interval = (uint32_t)(timestamp_us - mpu6886_jitter.last_us);
+        if (mpu6886_jitter.intervals == 0 || interval < mpu6886_jitter.min_us) {
+            mpu6886_jitter.min_us = interval;
+        }
+        if (interval > mpu6886_jitter.max_us) {
+            mpu6886_jitter.max_us = interval;
+        }
+        mpu6886_jitter.intervals++;
+        mpu6886_jitter.sum_us += interval;
+        mpu6886_jitter.sum_sq_us += (uint64_t)interval * interval;
+    }
+    mpu6886_jitter.last_us = timestamp_us;
+    portEXIT_CRITICAL(&mpu6886_jitter_lock);
+}
+
+static void mpu6886_acq_sample(int64_t timestamp_us) {
+    mpu6886_frame_t frame;
+    if (MPU6886_GetFrame(&frame, NULL) != ESP_OK) {
+        return ;
+    }
+    frame.timestamp_us = timestamp_us;
+    MPU6886_RingPush(&frame);
+}
+
+/*
+    Polled reference: the task wakes on the FreeRTOS tick, so the period
+    is rounded to whole ticks and every interval carries the wake-up
+    latency of the scheduler.
+*/
+static void mpu6886_poll_task(void *pvParameters) {
+    TickType_t period = pdMS_TO_TICKS(1000 / mpu6886_acq_rate_hz);
+    if (period == 0) {
+        period = 1;
+    }
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (mpu6886_acq_running) {
+        vTaskDelayUntil(&last_wake, period);
+        if (!mpu6886_acq_running) {
+            break;
+        }
+        int64_t now = esp_timer_get_time();
+        mpu6886_jitter_record(now, 0);
+        mpu6886_acq_sample(now);
+    }
+
+    mpu6886_acq_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+/*
+    Data-ready: the sensor paces the reads. The ISR stamps the edge, so
+    the sample time does not depend on when this task gets scheduled; it
+    only has to read the registers before the next sample replaces them.
+*/
+static void mpu6886_drdy_task(void *pvParameters) {
+    while (mpu6886_acq_running) {
+        uint32_t edges = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MPU6886_IRQ_TIMEOUT_MS));
+        if (!mpu6886_acq_running) {
+            break;
+        }
+        if (edges == 0) {
+            portENTER_CRITICAL(&mpu6886_jitter_lock);
+            mpu6886_jitter.timeouts++;
+            portEXIT_CRITICAL(&mpu6886_jitter_lock);
+            continue;
+        }
+        int64_t timestamp = MPU6886_IrqTimestamp();
+        mpu6886_jitter_record(timestamp, edges - 1);
+        mpu6886_acq_sample(timestamp);
+    }
+
+    mpu6886_acq_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+esp_err_t MPU6886_AcquireStart(mpu6886_acq_mode_t mode, uint16_t rate_hz) {
+    if (mpu6886_acq_task_handle != NULL || MPU6886_StreamActive() || MPU6886_WomActive()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (rate_hz < 4 || rate_hz > 1000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t smplrt_div = (1000 / rate_hz) - 1;
+    mpu6886_acq_rate_hz = 1000 / (smplrt_div + 1);
+    mpu6886_acq_mode = mode;
+
+    uint8_t config = 0x01;       // DLPF 176 Hz, 1 kHz internal rate
+    uint8_t int_pin_cfg = 0x00;  // active high, push-pull, 50 us pulse per sample
+    uint8_t int_enable = (mode == MPU6886_ACQ_DATA_READY) ? 0x01 : 0x00;  // DATA_RDY_INT_EN
+    i2c_segment_t acq_seq[] = {
+        { I2C_OP_WRITE, MPU6886_SMPLRT_DIV, &smplrt_div, 1 },
+        { I2C_OP_WRITE, MPU6886_CONFIG, &config, 1 },
+        { I2C_OP_WRITE, MPU6886_INT_PIN_CFG, &int_pin_cfg, 1 },
+        { I2C_OP_WRITE, MPU6886_INT_ENABLE, &int_enable, 1 },
+    };
+
+    TaskFunction_t task = mpu6886_poll_task;
+    if (mode == MPU6886_ACQ_DATA_READY) {
+        if (MPU6886_INT_GPIO < 0) {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        task = mpu6886_drdy_task;
+    }
+
+    esp_err_t err = i2c_transfer(MPU6886_I2CDevice(), acq_seq, sizeof(acq_seq) / sizeof(acq_seq[0]));
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    MPU6886_ResetJitterStats();
+    MPU6886_RingReset();
+
+    mpu6886_acq_running = true;
+    if (xTaskCreatePinnedToCore(task, "mpu6886_acq", 3072, NULL,
+                                CONFIG_MPU6886_STREAM_TASK_PRIORITY, &mpu6886_acq_task_handle, 1) != pdPASS) {
+        mpu6886_acq_running = false;
+        mpu6886_acq_task_handle = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    if (mode == MPU6886_ACQ_DATA_READY) {
+        err = MPU6886_IrqAttach(mpu6886_acq_task_handle);
+        if (err != ESP_OK) {
+            MPU6886_AcquireStop();
+            return err;
+        }
+    }
+    ESP_LOGI(TAG, "%s acquisition at %u Hz", (mode == MPU6886_ACQ_DATA_READY) ? "data-ready" : "polled", mpu6886_acq_rate_hz);
+    return ESP_OK;
+}
+
+void MPU6886_AcquireStop(void) {
+    if (mpu6886_acq_task_handle == NULL) {
+        return ;
+    }
+    if (mpu6886_acq_mode == MPU6886_ACQ_DATA_READY) {
+        MPU6886_IrqDetach();
+    }
+    mpu6886_acq_running = false;
+    xTaskNotifyGive(mpu6886_acq_task_handle);
+    while (mpu6886_acq_task_handle != NULL) {
+        vTaskDelay(1);
+    }
+
+    uint8_t zero = 0x00;
+    MPU6886_I2CWriteBytes(MPU6886_INT_ENABLE, 1, &zero);
+}
+
+void MPU6886_ResetJitterStats(void) {
+    portENTER_CRITICAL(&mpu6886_jitter_lock);
+    memset(&mpu6886_jitter, 0, sizeof(mpu6886_jitter));
+    portEXIT_CRITICAL(&mpu6886_jitter_lock);
+}
+
+void MPU6886_GetJitterStats(mpu6886_jitter_stats_t *stats) {
+    if (stats == NULL) {
+        return ;
+    }
+    portENTER_CRITICAL(&mpu6886_jitter_lock);
+    uint32_t intervals = mpu6886_jitter.intervals;
+    uint64_t sum = mpu6886_jitter.sum_us;
+    uint64_t sum_sq = mpu6886_jitter.sum_sq_us;
+    stats->samples = mpu6886_jitter.samples;
+    stats->missed = mpu6886_jitter.missed;
+    stats->timeouts = mpu6886_jitter.timeouts;
+    stats->min_us = mpu6886_jitter.min_us;
+    stats->max_us = mpu6886_jitter.max_us;
+    portEXIT_CRITICAL(&mpu6886_jitter_lock);
+
+    stats->mean_us = 0.0f;
+    stats->stddev_us = 0.0f;
+    if (intervals > 0) {
+        double mean = (double)sum / intervals;
+        double variance = (double)sum_sq / intervals - mean * mean;
+        stats->mean_us = (float)mean;
+        stats->stddev_us = (variance > 0.0) ? (float)sqrt(variance) : 0.0f;
+    }
+}
@@ -0,0 +1,252 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include <string.h>
+
+#include "i2c_device.h"
+#include "mpu6886.h"
+#include "mpu6886_i2c.h"
+
+#define TAG "MPU6886"
+
+#define MPU6886_STREAM_RING_FRAMES CONFIG_MPU6886_STREAM_RING_FRAMES
+#define MPU6886_STREAM_RING_MASK (MPU6886_STREAM_RING_FRAMES - 1)
+#define MPU6886_STREAM_BURST_FRAMES (32)
+#define MPU6886_FIFO_BYTES (1024)
+
+#if (MPU6886_STREAM_RING_FRAMES & MPU6886_STREAM_RING_MASK) != 0
+#error "CONFIG_MPU6886_STREAM_RING_FRAMES must be a power of two"
+#endif
+
+/*
+    Single-producer single-consumer ring. The drain task only writes
+    head, the consumer only writes tail; each side publishes its index
+    with release ordering after touching the slot, so no lock is needed.
+*/
+static mpu6886_frame_t mpu6886_ring[MPU6886_STREAM_RING_FRAMES];
+static uint32_t mpu6886_ring_head;
+static uint32_t mpu6886_ring_tail;
+
+static TaskHandle_t mpu6886_stream_task_handle;
+static volatile bool mpu6886_stream_running;
+static volatile bool mpu6886_stream_irq;
+static uint16_t mpu6886_stream_rate_hz;
+static uint16_t mpu6886_stream_watermark;
+static int64_t mpu6886_stream_start_us;
+static mpu6886_stream_stats_t mpu6886_stream_stats;
+static portMUX_TYPE mpu6886_stream_lock = portMUX_INITIALIZER_UNLOCKED;
+
+bool MPU6886_RingPush(const mpu6886_frame_t *frame) {
+    uint32_t head = __atomic_load_n(&mpu6886_ring_head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&mpu6886_ring_tail, __ATOMIC_ACQUIRE);
+    if ((head - tail) >= MPU6886_STREAM_RING_FRAMES) {
+        return false;
+    }
+    mpu6886_ring[head & MPU6886_STREAM_RING_MASK] = *frame;
+    __atomic_store_n(&mpu6886_ring_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+void MPU6886_RingReset(void) {
+    __atomic_store_n(&mpu6886_ring_tail, __atomic_load_n(&mpu6886_ring_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+bool MPU6886_StreamRead(mpu6886_frame_t *frame) {
+    uint32_t tail = __atomic_load_n(&mpu6886_ring_tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&mpu6886_ring_head, __ATOMIC_ACQUIRE);
+    if (frame == NULL || head == tail) {
+        return false;
+    }
+    *frame = mpu6886_ring[tail & MPU6886_STREAM_RING_MASK];
+    __atomic_store_n(&mpu6886_ring_tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static void mpu6886_fifo_reset(void) {
+    uint8_t user_ctrl = 0x44; // FIFO_EN | FIFO_RST
+    MPU6886_I2CWriteBytes(MPU6886_USER_CTRL, 1, &user_ctrl);
+}
+
+/*
+    One drain: read the fill level and overflow flag, then pull every
+    whole frame out in bursts. The FIFO fill is sampled once, so frame k
+    of n is stamped n - 1 - k sample periods before that read.
+*/
+static void mpu6886_stream_drain(void) {
+    I2CDevice_t device = MPU6886_I2CDevice();
+    static uint8_t burst[MPU6886_STREAM_BURST_FRAMES * MPU6886_FIFO_FRAME_SIZE];
+    uint8_t int_status = 0;
+    uint8_t fifo_count[2] = {0};
+
+    // INT_STATUS is clear-on-read and carries FIFO_OFLOW_INT (bit 4).
+    i2c_read_bytes(device, MPU6886_INT_STATUS, &int_status, 1);
+    i2c_read_bytes(device, MPU6886_FIFO_COUNTH, fifo_count, 2);
+    int64_t now = esp_timer_get_time();
+    uint16_t count = ((uint16_t)(fifo_count[0] & 0x0F) << 8) | fifo_count[1];
+
+    uint32_t overflowed = (int_status & 0x10) ? 1 : 0;
+    if (overflowed) {
+        // Frame alignment is lost once the FIFO wraps; start clean.
+        mpu6886_fifo_reset();
+        count = 0;
+    }
+
+    uint32_t period_us = 1000000 / mpu6886_stream_rate_hz;
+    uint16_t total = count / MPU6886_FIFO_FRAME_SIZE;
+    uint16_t done = 0;
+    uint32_t dropped = 0;
+    while (done < total) {
+        uint16_t n = total - done;
+        if (n > MPU6886_STREAM_BURST_FRAMES) {
+            n = MPU6886_STREAM_BURST_FRAMES;
+        }
+        if (i2c_read_bytes(device, MPU6886_FIFO_R_W, burst, n * MPU6886_FIFO_FRAME_SIZE) != ESP_OK) {
+            break;
+        }
+        for (uint16_t i = 0; i < n; i++) {
+            const uint8_t *raw = &burst[i * MPU6886_FIFO_FRAME_SIZE];
+            mpu6886_frame_t frame;
+            MPU6886_DecodeFrame(raw, &frame);
+            frame.timestamp_us = now - (int64_t)(total - 1 - (done + i)) * period_us;
+            if (!MPU6886_RingPush(&frame)) {
+                dropped++;
+            }
+        }
+        done += n;
+    }
+
+    portENTER_CRITICAL(&mpu6886_stream_lock);
+    mpu6886_stream_stats.drains++;
+    mpu6886_stream_stats.frames += done;
+    mpu6886_stream_stats.ring_drops += dropped;
+    mpu6886_stream_stats.fifo_overflows += overflowed;
+    if (count > mpu6886_stream_stats.fifo_max_bytes) {
+        mpu6886_stream_stats.fifo_max_bytes = count;
+    }
+    portEXIT_CRITICAL(&mpu6886_stream_lock);
+}
+
+static void mpu6886_stream_task(void *pvParameters) {
+    // Time for the FIFO to reach the watermark. With the INT line the
+    // watermark interrupt wakes the drain and the timer is only a backstop.
+    TickType_t period = pdMS_TO_TICKS(((uint32_t)mpu6886_stream_watermark * 1000) / mpu6886_stream_rate_hz);
+    if (period == 0) {
+        period = 1;
+    }
+
+    while (mpu6886_stream_running) {
+        ulTaskNotifyTake(pdTRUE, mpu6886_stream_irq ? period * 2 : period);
+        if (!mpu6886_stream_running) {
+            break;
+        }
+        mpu6886_stream_drain();
+    }
+
+    mpu6886_stream_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+bool MPU6886_StreamActive(void) {
+    return mpu6886_stream_task_handle != NULL;
+}
+
+esp_err_t MPU6886_StreamStart(uint16_t rate_hz, uint16_t watermark) {
+    if (mpu6886_stream_task_handle != NULL || MPU6886_AcquireActive() || MPU6886_WomActive()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (rate_hz < 4 || rate_hz > 1000 || watermark == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Leave room for one more watermark worth of samples while draining.
+    uint16_t max_watermark = MPU6886_FIFO_BYTES / MPU6886_FIFO_FRAME_SIZE / 2;
+    if (watermark > max_watermark) {
+        watermark = max_watermark;
+    }
+
+    uint8_t smplrt_div = (1000 / rate_hz) - 1;
+    mpu6886_stream_rate_hz = 1000 / (smplrt_div + 1);
+    mpu6886_stream_watermark = watermark;
+
+    uint16_t watermark_bytes = watermark * MPU6886_FIFO_FRAME_SIZE;
+    uint8_t zero = 0x00;
+    uint8_t config = 0x01;       // DLPF 176 Hz, 1 kHz internal rate, FIFO overwrites when full
+    uint8_t fifo_en = 0x18;      // GYRO_FIFO_EN | ACCEL_FIFO_EN
+    uint8_t fifo_reset = 0x04;   // FIFO_RST
+    uint8_t fifo_enable = 0x40;  // FIFO_EN
+    uint8_t wm_th1 = (watermark_bytes >> 8) & 0x03;
+    uint8_t wm_th2 = watermark_bytes & 0xFF;
+    uint8_t int_pin_cfg = 0x00;  // active high, push-pull, pulsed
+    // Data-ready off; the FIFO watermark interrupt follows FIFO_WM_TH.
+    i2c_segment_t stream_seq[] = {
+        { I2C_OP_WRITE, MPU6886_INT_ENABLE, &zero, 1 },
+        { I2C_OP_WRITE, MPU6886_INT_PIN_CFG, &int_pin_cfg, 1 },
+        { I2C_OP_WRITE, MPU6886_USER_CTRL, &zero, 1 },
+        { I2C_OP_WRITE, MPU6886_FIFO_EN, &zero, 1 },
+        { I2C_OP_WRITE, MPU6886_SMPLRT_DIV, &smplrt_div, 1 },
+        { I2C_OP_WRITE, MPU6886_CONFIG, &config, 1 },
+        { I2C_OP_WRITE, MPU6886_FIFO_WM_TH1, &wm_th1, 1 },
+        { I2C_OP_WRITE, MPU6886_FIFO_WM_TH2, &wm_th2, 1 },
+        { I2C_OP_WRITE, MPU6886_USER_CTRL, &fifo_reset, 1 },
+        { I2C_OP_WRITE, MPU6886_FIFO_EN, &fifo_en, 1 },
+        { I2C_OP_WRITE, MPU6886_USER_CTRL, &fifo_enable, 1 },
+    };
+    esp_err_t err = i2c_transfer(MPU6886_I2CDevice(), stream_seq, sizeof(stream_seq) / sizeof(stream_seq[0]));
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    portENTER_CRITICAL(&mpu6886_stream_lock);
+    memset(&mpu6886_stream_stats, 0, sizeof(mpu6886_stream_stats));
+    mpu6886_stream_start_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&mpu6886_stream_lock);
+    MPU6886_RingReset();
+
+    mpu6886_stream_running = true;
+    if (xTaskCreatePinnedToCore(mpu6886_stream_task, "mpu6886_stream", 3072, NULL,
+                                CONFIG_MPU6886_STREAM_TASK_PRIORITY, &mpu6886_stream_task_handle, 1) != pdPASS) {
+        mpu6886_stream_running = false;
+        mpu6886_stream_task_handle = NULL;
+        MPU6886_I2CWriteBytes(MPU6886_USER_CTRL, 1, &zero);
+        return ESP_ERR_NO_MEM;
+    }
+    // Without the INT line the drain falls back to its watermark timer.
+    mpu6886_stream_irq = (MPU6886_IrqAttach(mpu6886_stream_task_handle) == ESP_OK);
+    ESP_LOGI(TAG, "streaming at %u Hz, %u frames per drain%s", mpu6886_stream_rate_hz, watermark,
+             mpu6886_stream_irq ? ", INT driven" : "");
+    return ESP_OK;
+}
+
+void MPU6886_StreamStop(void) {
+    if (mpu6886_stream_task_handle == NULL) {
+        return ;
+    }
+    MPU6886_IrqDetach();
+    mpu6886_stream_irq = false;
+    mpu6886_stream_running = false;
+    xTaskNotifyGive(mpu6886_stream_task_handle);
+    while (mpu6886_stream_task_handle != NULL) {
+        vTaskDelay(1);
+    }
+
+    uint8_t zero = 0x00;
+    i2c_segment_t stop_seq[] = {
+        { I2C_OP_WRITE, MPU6886_USER_CTRL, &zero, 1 },
+        { I2C_OP_WRITE, MPU6886_FIFO_EN, &zero, 1 },
+    };
+    i2c_transfer(MPU6886_I2CDevice(), stop_seq, sizeof(stop_seq) / sizeof(stop_seq[0]));
+}
+
+void MPU6886_StreamGetStats(mpu6886_stream_stats_t *stats) {
+    if (stats == NULL) {
+        return ;
+    }
+    portENTER_CRITICAL(&mpu6886_stream_lock);
+    *stats = mpu6886_stream_stats;
+    int64_t elapsed = esp_timer_get_time() - mpu6886_stream_start_us;
+    portEXIT_CRITICAL(&mpu6886_stream_lock);
+
+    stats->rate_hz = (elapsed > 0 && mpu6886_stream_start_us != 0) ? (float)stats->frames * 1000000.0f / (float)elapsed : 0.0f;
+}
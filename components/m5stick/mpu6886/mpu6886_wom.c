@@ -0,0 +1,155 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "i2c_device.h"
+#include "mpu6886.h"
+#include "mpu6886_i2c.h"
+
+#define TAG "MPU6886"
+
+static bool mpu6886_wom_active;
+static bool mpu6886_wom_irq;
+static uint16_t mpu6886_wom_rate_hz;
+static uint16_t mpu6886_wom_stream_rate_hz;
+
+bool MPU6886_WomActive(void) {
+    return mpu6886_wom_active;
+}
+
+esp_err_t MPU6886_WomStart(const mpu6886_wom_config_t *config) {
+    if (mpu6886_wom_active || MPU6886_StreamActive() || MPU6886_AcquireActive()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (config == NULL || config->wake_rate_hz < 4 || config->wake_rate_hz > 500 || config->threshold_mg > 1020) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t smplrt_div = (1000 / config->wake_rate_hz) - 1;
+    uint8_t threshold = config->threshold_mg / 4;
+    uint8_t pwr_mgmt_1 = 0x01;     // awake, auto clock; cycle is set last
+    uint8_t pwr_mgmt_2 = 0x07;     // STBY_XG | STBY_YG | STBY_ZG
+    uint8_t accel_config2 = 0x01;  // 4-sample averaging, A_DLPF_CFG 1
+    uint8_t int_pin_cfg = 0x00;    // active high, push-pull, pulsed
+    uint8_t int_enable = 0xE0;     // WOM_X/Y/Z_INT_EN
+    uint8_t intel_ctrl = 0xC0;     // ACCEL_INTEL_EN | ACCEL_INTEL_MODE (compare to previous sample)
+    uint8_t cycle = 0x21;          // CYCLE | CLKSEL auto
+    uint8_t int_status = 0;
+    i2c_segment_t wom_seq[] = {
+        { I2C_OP_WRITE, MPU6886_PWR_MGMT_1, &pwr_mgmt_1, 1 },
+        { I2C_OP_WRITE, MPU6886_PWR_MGMT_2, &pwr_mgmt_2, 1 },
+        { I2C_OP_WRITE, MPU6886_ACCEL_CONFIG2, &accel_config2, 1 },
+        { I2C_OP_WRITE, MPU6886_INT_PIN_CFG, &int_pin_cfg, 1 },
+        { I2C_OP_WRITE, MPU6886_INT_ENABLE, &int_enable, 1 },
+        { I2C_OP_WRITE, MPU6886_ACCEL_WOM_X_THR, &threshold, 1 },
+        { I2C_OP_WRITE, MPU6886_ACCEL_WOM_Y_THR, &threshold, 1 },
+        { I2C_OP_WRITE, MPU6886_ACCEL_WOM_Z_THR, &threshold, 1 },
+        { I2C_OP_WRITE, MPU6886_ACCEL_INTEL_CTRL, &intel_ctrl, 1 },
+        { I2C_OP_WRITE, MPU6886_SMPLRT_DIV, &smplrt_div, 1 },
+        { I2C_OP_WRITE, MPU6886_PWR_MGMT_1, &cycle, 1 },
+        { I2C_OP_READ, MPU6886_INT_STATUS, &int_status, 1 },
+    };
+    esp_err_t err = i2c_transfer(MPU6886_I2CDevice(), wom_seq, sizeof(wom_seq) / sizeof(wom_seq[0]));
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    mpu6886_wom_rate_hz = 1000 / (smplrt_div + 1);
+    mpu6886_wom_stream_rate_hz = config->stream_rate_hz;
+    mpu6886_wom_irq = (MPU6886_IrqAttach(xTaskGetCurrentTaskHandle()) == ESP_OK);
+    // Drop an edge left over from before the switch.
+    ulTaskNotifyTake(pdTRUE, 0);
+    mpu6886_wom_active = true;
+    ESP_LOGI(TAG, "wake-on-motion at %u Hz, %u mg%s", mpu6886_wom_rate_hz, threshold * 4,
+             mpu6886_wom_irq ? ", INT driven" : "");
+    return ESP_OK;
+}
+
+esp_err_t MPU6886_WomWait(mpu6886_wom_event_t *event, uint32_t timeout_ms) {
+    if (!mpu6886_wom_active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+    // Without the INT line, check once per duty cycle (at least a tick).
+    TickType_t poll = pdMS_TO_TICKS(1000 / mpu6886_wom_rate_hz);
+    if (poll == 0) {
+        poll = 1;
+    }
+
+    while (1) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout) {
+            return ESP_ERR_TIMEOUT;
+        }
+        TickType_t wait = timeout - elapsed;
+        if (mpu6886_wom_irq) {
+            if (ulTaskNotifyTake(pdTRUE, wait) == 0) {
+                return ESP_ERR_TIMEOUT;
+            }
+        } else {
+            vTaskDelay((poll < wait) ? poll : wait);
+        }
+
+        uint8_t int_status = 0;
+        if (i2c_read_bytes(MPU6886_I2CDevice(), MPU6886_INT_STATUS, &int_status, 1) != ESP_OK) {
+            continue;
+        }
+        uint8_t axes = (int_status >> 5) & 0x07;
+        if (axes == 0) {
+            continue;
+        }
+        if (event != NULL) {
+            event->timestamp_us = mpu6886_wom_irq ? MPU6886_IrqTimestamp() : esp_timer_get_time();
+            event->axes = axes;
+        }
+        if (mpu6886_wom_stream_rate_hz != 0) {
+            esp_err_t err = MPU6886_WomStop();
+            if (err != ESP_OK) {
+                return err;
+            }
+            return MPU6886_StreamStart(mpu6886_wom_stream_rate_hz, (mpu6886_wom_stream_rate_hz + 49) / 50);
+        }
+        return ESP_OK;
+    }
+}
+
+esp_err_t MPU6886_WomStop(void) {
+    if (!mpu6886_wom_active) {
+        return ESP_OK;
+    }
+    if (mpu6886_wom_irq) {
+        MPU6886_IrqDetach();
+        mpu6886_wom_irq = false;
+    }
+
+    // Back to the MPU6886_Init() configuration, INT pin and data-ready
+    // interrupt included.
+    uint8_t pwr_mgmt_1 = 0x01;
+    uint8_t smplrt_div = 0x05;
+    uint8_t int_pin_cfg = 0x22;
+    uint8_t int_enable = 0x01;
+    uint8_t zero = 0x00;
+    i2c_segment_t wake_seq[] = {
+        { I2C_OP_WRITE, MPU6886_PWR_MGMT_1, &pwr_mgmt_1, 1 },
+        { I2C_OP_WRITE, MPU6886_ACCEL_INTEL_CTRL, &zero, 1 },
+        { I2C_OP_WRITE, MPU6886_INT_ENABLE, &zero, 1 },
+        { I2C_OP_WRITE, MPU6886_ACCEL_CONFIG2, &zero, 1 },
+        { I2C_OP_WRITE, MPU6886_SMPLRT_DIV, &smplrt_div, 1 },
+        { I2C_OP_WRITE, MPU6886_PWR_MGMT_2, &zero, 1 },
+        { I2C_OP_WRITE, MPU6886_INT_PIN_CFG, &int_pin_cfg, 1 },
+        { I2C_OP_WRITE, MPU6886_INT_ENABLE, &int_enable, 1 },
+    };
+    // The INT line is released either way, so WoM is over even on error.
+    mpu6886_wom_active = false;
+    esp_err_t err = i2c_transfer(MPU6886_I2CDevice(), wake_seq, sizeof(wake_seq) / sizeof(wake_seq[0]));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "leaving wake-on-motion failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    // The gyro needs ~35 ms to start up from standby.
+    vTaskDelay(pdMS_TO_TICKS(50));
+    return ESP_OK;
+}
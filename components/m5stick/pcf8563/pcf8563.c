@@ -7,9 +7,12 @@
 #define PCF8563_ADDR 0x51
 
 static I2CDevice_t pcf8563_device;
+static I2CReadTemplate_t pcf8563_time_read;
 
 static void I2CInit() {
     pcf8563_device = i2c_malloc_device(I2C_NUM_0, GPIO_NUM_21, GPIO_NUM_22, 400000, PCF8563_ADDR);
+    i2c_device_set_name(pcf8563_device, "PCF8563");
+    pcf8563_time_read = i2c_malloc_read_template(pcf8563_device, 0x02, 7);
 }
 
 static void I2CWrite(uint8_t addr, uint8_t* buf, uint8_t len) {
@@ -34,9 +37,13 @@ static uint8_t BCD2Byte(uint8_t data) {
 
 void PCF8563_Init() {
     I2CInit();
-    I2CWriteByte(0x00, 0x00);
-    I2CWriteByte(0x01, 0x00);
-    I2CWriteByte(0x0D, 0x00);
+    uint8_t zero = 0x00;
+    i2c_segment_t init_seq[] = {
+        { I2C_OP_WRITE, 0x00, &zero, 1 },
+        { I2C_OP_WRITE, 0x01, &zero, 1 },
+        { I2C_OP_WRITE, 0x0D, &zero, 1 },
+    };
+    i2c_transfer(pcf8563_device, init_seq, sizeof(init_seq) / sizeof(init_seq[0]));
 }
 
 void PCF8563_SetTime(rtc_date_t* data) {
@@ -53,12 +60,7 @@ void PCF8563_SetTime(rtc_date_t* data) {
     I2CWrite(0x02, time_buf, 7);
 }
 
-void PCF8563_GetTime(rtc_date_t* data) {
-    if (data == NULL) {
-        return ;
-    }
-    uint8_t time_buf[7];
-    I2CRead(0x02, time_buf, 7);
+static void pcf8563_decode(const uint8_t *time_buf, rtc_date_t* data) {
     data->second = BCD2Byte(time_buf[0] & 0x7f);
     data->minute = BCD2Byte(time_buf[1] & 0x7f);
     data->hour = BCD2Byte(time_buf[2] & 0x3f);
@@ -67,6 +69,36 @@ void PCF8563_GetTime(rtc_date_t* data) {
     data->year = BCD2Byte(time_buf[6]) + (time_buf[5] & 0x80 ? 1900 : 2000);
 }
 
+static esp_err_t pcf8563_read_time(uint8_t *time_buf) {
+    if (pcf8563_time_read != NULL) {
+        return i2c_read_template(pcf8563_time_read, time_buf);
+    }
+    return i2c_read_bytes_no_stop(pcf8563_device, 0x02, time_buf, 7);
+}
+
+void PCF8563_GetTime(rtc_date_t* data) {
+    if (data == NULL) {
+        return ;
+    }
+    uint8_t time_buf[7];
+    pcf8563_read_time(time_buf);
+    pcf8563_decode(time_buf, data);
+}
+
+esp_err_t PCF8563_ReadTime(rtc_date_t* data) {
+    if (data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t time_buf[7];
+    esp_err_t err = pcf8563_read_time(time_buf);
+    if (err != ESP_OK) {
+        return err;
+    }
+    pcf8563_decode(time_buf, data);
+    // VL: the oscillator stopped (supply too low) since the time was set.
+    return (time_buf[0] & 0x80) ? ESP_ERR_INVALID_STATE : ESP_OK;
+}
+
 // -1 :disable
 void PCF8563_SetAlarmIRQ(int8_t minute, int8_t hour, int8_t day, int8_t week) {
     uint8_t irq_enable = false;
@@ -99,8 +131,11 @@ void PCF8563_SetAlarmIRQ(int8_t minute, int8_t hour, int8_t day, int8_t week) {
         reg_value &= ~(1 << 1);
     }
 
-    I2CWrite(0x09, out_buf, 4);
-    I2CWrite(0x01, &reg_value, 1);
+    i2c_segment_t alarm_seq[] = {
+        { I2C_OP_WRITE, 0x09, out_buf, 4 },
+        { I2C_OP_WRITE, 0x01, &reg_value, 1 },
+    };
+    i2c_transfer(pcf8563_device, alarm_seq, 2);
 }
 
 // -1: disable
@@ -110,9 +145,12 @@ int16_t PCF8563_SetTimerIRQ(int16_t value) {
 
     if (value < 0) {
         reg_value &= ~(1 << 0);
-        I2CWrite(0x01, &reg_value, 1);
-        reg_value = 0x03;
-        I2CWrite(0x0E, &reg_value, 1);
+        uint8_t timer_off = 0x03;
+        i2c_segment_t disable_seq[] = {
+            { I2C_OP_WRITE, 0x01, &reg_value, 1 },
+            { I2C_OP_WRITE, 0x0E, &timer_off, 1 },
+        };
+        i2c_transfer(pcf8563_device, disable_seq, 2);
         return -1;
     }
 
@@ -125,20 +163,27 @@ int16_t PCF8563_SetTimerIRQ(int16_t value) {
         type_value = 0x82;
     }
     value = (value / div) & 0xFF;
-    I2CWrite(0x0F, (uint8_t *)&value, 1);
-    I2CWrite(0x0E, &type_value, 1);
+    uint8_t count = value;
 
     reg_value |= (1 << 0);
     reg_value &= ~(1 << 7);
-    I2CWrite(0x01, &reg_value, 1);
+    i2c_segment_t timer_seq[] = {
+        { I2C_OP_WRITE, 0x0F, &count, 1 },
+        { I2C_OP_WRITE, 0x0E, &type_value, 1 },
+        { I2C_OP_WRITE, 0x01, &reg_value, 1 },
+    };
+    i2c_transfer(pcf8563_device, timer_seq, 3);
     return value * div;
 }
 
 int16_t PCF8563_GetTimerTime() {
     uint8_t value = 0;
     uint8_t type_value = 0;
-    I2CRead(0x0f, &value, 1);
-    I2CRead(0x0e, &type_value, 1);
+    i2c_segment_t read_seq[] = {
+        { I2C_OP_READ, 0x0f, &value, 1 },
+        { I2C_OP_READ, 0x0e, &type_value, 1 },
+    };
+    i2c_transfer(pcf8563_device, read_seq, 2);
 
     if ((type_value & 0x03) == 3) {
         return value * 60;
@@ -5,6 +5,7 @@
 
 #pragma once
 #include "esp_log.h"
+#include "esp_err.h"
 
 typedef struct _rtc_data_t {
     uint16_t year;  //Date year.
@@ -18,6 +19,9 @@ typedef struct _rtc_data_t {
 void PCF8563_Init();
 void PCF8563_SetTime(rtc_date_t* data);
 void PCF8563_GetTime(rtc_date_t* data);
+// ESP_ERR_INVALID_STATE when the VL flag says the time cannot be trusted;
+// data is filled in anyway. Setting the time clears the flag.
+esp_err_t PCF8563_ReadTime(rtc_date_t* data);
 void PCF8563_SetAlarmIRQ(int8_t minute, int8_t hour, int8_t day, int8_t week);
 int16_t PCF8563_SetTimerIRQ(int16_t value);
 int16_t PCF8563_GetTimerTime();
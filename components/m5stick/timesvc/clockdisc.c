@@ -0,0 +1,217 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "clockdisc.h"
+
+#define CLOCKDISC_GAIN_SHIFT (2)            // filter weight 1/4
+#define CLOCKDISC_ERROR_FLOOR_PPB (100)     // never trust it past 0.1 ppm
+#define CLOCKDISC_OUTLIER_RUN (3)           // this many in a row is a new rate
+#define CLOCKDISC_WANDER_SHIFT (4)          // wander forgets over 16 samples
+#define CLOCKDISC_WANDER_SPREAD (3)         // worst next wander in mean ones
+
+void ClockDisc_Init(clockdisc_t *cd) {
+    memset(cd, 0, sizeof(*cd));
+}
+
+static int32_t clockdisc_clamp(int64_t value) {
+    return (value > INT32_MAX) ? INT32_MAX : (value < INT32_MIN) ? INT32_MIN : (int32_t)value;
+}
+
+static uint64_t clockdisc_isqrt(uint64_t value) {
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+/*
+    A wandering rate walks away from the estimate by about the square
+    root of the time: wander_ppb is scaled to and from one hour with it.
+*/
+static int64_t clockdisc_wander_scale(int64_t ppb, int64_t from_s, int64_t to_s) {
+    return ppb * (int64_t)clockdisc_isqrt((uint64_t)to_s * 1000000 / (uint64_t)from_s) / 1000;
+}
+
+bool ClockDisc_Sample(clockdisc_t *cd, int64_t ref_us, int64_t local_us, uint32_t resolution_us) {
+    if (!cd->anchored) {
+        ClockDisc_Step(cd, ref_us, local_us);
+        return false;
+    }
+    cd->offset_us = clockdisc_clamp(ClockDisc_Correct(cd, local_us) - ref_us);
+    int64_t elapsed_us = ref_us - cd->anchor_ref_us;
+    if (elapsed_us < (int64_t)CONFIG_CLOCKDISC_MIN_INTERVAL_S * 1000000) {
+        return false;
+    }
+
+    // Two readings at each end, each off by up to resolution_us.
+    int64_t measured = ((local_us - cd->anchor_local_us) - elapsed_us) * 1000000000LL / elapsed_us;
+    int32_t floor_ppb = clockdisc_clamp(2LL * resolution_us * 1000000000LL / elapsed_us);
+    int64_t elapsed_s = elapsed_us / 1000000;
+    if (cd->samples == 0) {
+        cd->freq_ppb = clockdisc_clamp(measured);
+        cd->wander_ppb = 0;
+        cd->noise_ppb = floor_ppb;
+    } else {
+        int64_t residual = measured - cd->freq_ppb;
+        int64_t moving = clockdisc_wander_scale(cd->wander_ppb, 3600, elapsed_s);
+        int64_t limit = 4LL * moving + floor_ppb + cd->noise_ppb + CLOCKDISC_ERROR_FLOOR_PPB;
+        if (llabs(residual) > limit && ++cd->outlier_run < CLOCKDISC_OUTLIER_RUN) {
+            // Likely a reference step; keep the anchor and wait for more.
+            cd->outliers++;
+            return false;
+        }
+        if (cd->outlier_run >= CLOCKDISC_OUTLIER_RUN) {
+            // Persistent: the oscillator really changed, start over.
+            cd->freq_ppb = clockdisc_clamp(measured);
+            cd->wander_ppb = clockdisc_clamp(clockdisc_wander_scale(llabs(residual), elapsed_s, 3600));
+            cd->noise_ppb = floor_ppb;
+            cd->samples = 0;
+        } else {
+            // What the readings cannot explain is the oscillator moving.
+            // Rises at once, decays slowly: the next interval stays short
+            // until the oscillator has settled again.
+            int64_t deviation = llabs(residual) > floor_ppb ? llabs(residual) - floor_ppb : 0;
+            int64_t wander = clockdisc_wander_scale(deviation, elapsed_s, 3600);
+            if (wander > cd->wander_ppb) {
+                cd->wander_ppb = clockdisc_clamp(wander);
+            } else {
+                cd->wander_ppb = clockdisc_clamp(cd->wander_ppb + (wander - cd->wander_ppb) / (1 << CLOCKDISC_WANDER_SHIFT));
+            }
+            cd->noise_ppb = clockdisc_clamp(cd->noise_ppb + ((int64_t)floor_ppb - cd->noise_ppb) / (1 << CLOCKDISC_GAIN_SHIFT));
+            // Follow a moving oscillator as closely as the reading noise
+            // allows, rather than lagging it at the settled weight.
+            moving = clockdisc_wander_scale(cd->wander_ppb, 3600, elapsed_s);
+            if (moving * (1 << CLOCKDISC_GAIN_SHIFT) > moving + floor_ppb) {
+                cd->freq_ppb = clockdisc_clamp(cd->freq_ppb + residual * moving / (moving + floor_ppb));
+            } else {
+                cd->freq_ppb = clockdisc_clamp(cd->freq_ppb + residual / (1 << CLOCKDISC_GAIN_SHIFT));
+            }
+        }
+    }
+    cd->outlier_run = 0;
+    cd->resolution_us = resolution_us;
+    cd->samples++;
+    cd->anchor_ref_us = ref_us;
+    cd->anchor_local_us = local_us;
+    return true;
+}
+
+void ClockDisc_Step(clockdisc_t *cd, int64_t ref_us, int64_t local_us) {
+    cd->anchor_ref_us = ref_us;
+    cd->anchor_local_us = local_us;
+    cd->anchored = true;
+    cd->outlier_run = 0;
+}
+
+int64_t ClockDisc_Correct(const clockdisc_t *cd, int64_t local_us) {
+    if (!cd->anchored) {
+        return local_us;
+    }
+    int64_t elapsed_us = local_us - cd->anchor_local_us;
+    return cd->anchor_ref_us + elapsed_us - elapsed_us * cd->freq_ppb / 1000000000LL;
+}
+
+/*
+    Error expected interval_s after the anchor: both ends of the pair
+    read to within resolution_us, the estimate's own noise, and the
+    oscillator wandering off it.
+*/
+static int64_t clockdisc_predict_us(const clockdisc_t *cd, int64_t interval_s) {
+    int64_t rate_ppb = CLOCKDISC_WANDER_SPREAD * clockdisc_wander_scale(cd->wander_ppb, 3600, interval_s)
+                     + cd->noise_ppb + CLOCKDISC_ERROR_FLOOR_PPB;
+    return 2LL * cd->resolution_us + rate_ppb * interval_s / 1000;
+}
+
+uint32_t ClockDisc_SyncInterval(const clockdisc_t *cd, uint32_t max_error_ms) {
+    int64_t interval_s = CONFIG_CLOCKDISC_MIN_INTERVAL_S;
+    // A rejected pair left the anchor further back than the estimate
+    // assumes, so check again soon.
+    if (cd->samples > 0 && cd->outlier_run == 0) {
+        int64_t settling_s = (int64_t)CONFIG_CLOCKDISC_MIN_INTERVAL_S << (cd->samples < 16 ? cd->samples : 16);
+        int64_t low_s = CONFIG_CLOCKDISC_MIN_INTERVAL_S;
+        int64_t high_s = (settling_s < CONFIG_CLOCKDISC_MAX_INTERVAL_S) ? settling_s : CONFIG_CLOCKDISC_MAX_INTERVAL_S;
+        // The longest interval whose predicted error fits.
+        while (low_s < high_s) {
+            int64_t mid_s = (low_s + high_s + 1) / 2;
+            if (clockdisc_predict_us(cd, mid_s) <= (int64_t)max_error_ms * 1000) {
+                low_s = mid_s;
+            } else {
+                high_s = mid_s - 1;
+            }
+        }
+        interval_s = low_s;
+    }
+    if (interval_s < CONFIG_CLOCKDISC_MIN_INTERVAL_S) {
+        interval_s = CONFIG_CLOCKDISC_MIN_INTERVAL_S;
+    }
+    if (interval_s > CONFIG_CLOCKDISC_MAX_INTERVAL_S) {
+        interval_s = CONFIG_CLOCKDISC_MAX_INTERVAL_S;
+    }
+    return (uint32_t)interval_s;
+}
+
+static uint32_t clockdisc_random(uint32_t *state) {
+    *state = *state * 1103515245 + 12345;
+    return *state >> 8;
+}
+
+static int32_t clockdisc_uniform(uint32_t *state, int32_t range) {
+    if (range <= 0) {
+        return 0;
+    }
+    return (int32_t)(clockdisc_random(state) % (2 * (uint32_t)range + 1)) - range;
+}
+
+void ClockDisc_Simulate(int32_t drift_ppb, int32_t wander_ppb, uint32_t jitter_us,
+                        uint32_t days, uint32_t max_error_ms, clockdisc_sim_t *result) {
+    memset(result, 0, sizeof(*result));
+    clockdisc_t cd;
+    ClockDisc_Init(&cd);
+    uint32_t seed = 1;
+    const int64_t hour_us = 3600LL * 1000000;
+    const int64_t end_us = (int64_t)days * 24 * hour_us;
+    int64_t true_us = 0;
+    int64_t local_us = 0;
+    int64_t rate_ppb = drift_ppb;
+    int64_t next_hour_us = hour_us;
+    uint64_t interval_sum_s = 0;
+
+    while (true_us < end_us) {
+        uint32_t interval_s = ClockDisc_SyncInterval(&cd, max_error_ms);
+        int64_t sync_us = true_us + (int64_t)interval_s * 1000000;
+        // Integrate the oscillator up to the sync, its rate wandering hourly.
+        while (true_us < sync_us) {
+            int64_t step_us = ((next_hour_us < sync_us) ? next_hour_us : sync_us) - true_us;
+            local_us += step_us + step_us * rate_ppb / 1000000000LL;
+            true_us += step_us;
+            if (true_us == next_hour_us) {
+                rate_ppb += clockdisc_uniform(&seed, wander_ppb);
+                next_hour_us += hour_us;
+            }
+        }
+        int64_t read_us = local_us + clockdisc_uniform(&seed, (int32_t)jitter_us);
+        if (cd.anchored) {
+            int64_t error_us = llabs(ClockDisc_Correct(&cd, read_us) - true_us);
+            if (error_us > result->max_error_us) {
+                result->max_error_us = (error_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)error_us;
+            }
+            interval_sum_s += interval_s;
+            result->syncs++;
+        }
+        ClockDisc_Sample(&cd, true_us, read_us, jitter_us);
+    }
+    result->mean_interval_s = (result->syncs > 0) ? (uint32_t)(interval_sum_s / result->syncs) : 0;
+    result->freq_ppb = cd.freq_ppb;
+}
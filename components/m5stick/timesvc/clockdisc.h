@@ -0,0 +1,70 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+    Frequency discipline of a free-running clock against a reference
+    (NTP). Each sync gives a pair of readings; the rate error over the
+    interval since the previous accepted pair feeds a first-order filter,
+    and the filtered residual bounds how long the next interval may be.
+    Pure arithmetic on caller timestamps, so it runs anywhere.
+*/
+typedef struct {
+    int64_t anchor_ref_us;      // reference time of the last accepted pair
+    int64_t anchor_local_us;    // local clock at the same moment
+    int32_t freq_ppb;           // rate error estimate, positive when fast
+    int32_t wander_ppb;         // filtered |measurement - estimate| beyond reading noise, per hour
+    int32_t noise_ppb;          // rate error the reading resolution alone leaves
+    int32_t offset_us;          // corrected local minus reference at the last sample
+    uint32_t samples;           // measurements folded into freq_ppb
+    uint32_t outliers;
+    uint32_t resolution_us;     // of the last accepted pair
+    uint8_t outlier_run;
+    bool anchored;
+} clockdisc_t;
+
+void ClockDisc_Init(clockdisc_t *cd);
+
+/*
+    Fold in a reading pair. resolution_us is how precisely the two were
+    taken together. Pairs closer than CONFIG_CLOCKDISC_MIN_INTERVAL_S to
+    the anchor only update offset_us. Returns true when freq_ppb changed.
+*/
+bool ClockDisc_Sample(clockdisc_t *cd, int64_t ref_us, int64_t local_us, uint32_t resolution_us);
+
+/* The local clock was set: re-anchor without measuring. */
+void ClockDisc_Step(clockdisc_t *cd, int64_t ref_us, int64_t local_us);
+
+/* Reference time for a local reading, using the rate estimate. */
+int64_t ClockDisc_Correct(const clockdisc_t *cd, int64_t local_us);
+
+/*
+    Seconds until the predicted error can reach max_error_ms, clamped to
+    CONFIG_CLOCKDISC_MIN_INTERVAL_S .. CONFIG_CLOCKDISC_MAX_INTERVAL_S.
+    It doubles at most per accepted sample while the filter settles.
+*/
+uint32_t ClockDisc_SyncInterval(const clockdisc_t *cd, uint32_t max_error_ms);
+
+typedef struct {
+    uint32_t syncs;
+    uint32_t mean_interval_s;
+    uint32_t max_error_us;      // worst prediction error seen at a sync
+    int32_t freq_ppb;           // final estimate
+} clockdisc_sim_t;
+
+/*
+    Run the discipline for days against an oscillator off by drift_ppb,
+    wandering by up to wander_ppb per hour, with reading jitter of
+    jitter_us. Deterministic.
+*/
+void ClockDisc_Simulate(int32_t drift_ppb, int32_t wander_ppb, uint32_t jitter_us,
+                        uint32_t days, uint32_t max_error_ms, clockdisc_sim_t *result);
+
+#ifdef __cplusplus
+}
+#endif
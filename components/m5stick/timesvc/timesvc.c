@@ -0,0 +1,488 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+#include "clockdisc.h"
+#include "pcf8563.h"
+#include "timesvc.h"
+
+#define TAG "TIMESVC"
+
+#define TIMESVC_EDGE_POLL_MS (5)
+#define TIMESVC_EDGE_TIMEOUT_MS (1100)
+#define TIMESVC_VALID_YEAR (2020)
+#define TIMESVC_RESTORE_ERROR_MS (500)  // a restore reads the RTC second, not its edge
+// How closely an SNTP update and the esp_timer reading after it agree.
+#define TIMESVC_NTP_RESOLUTION_US (20000)
+#define TIMESVC_SLEW_MIN_US (500)
+
+#define TIMESVC_NVS_NAMESPACE "timesvc"
+#define TIMESVC_NVS_KEY "disc"
+
+static TaskHandle_t timesvc_task_handle;
+static esp_timer_handle_t timesvc_timer;
+static timesvc_tick_cb_t timesvc_tick_cb;
+static void *timesvc_tick_arg;
+static time_t timesvc_target;       // second the armed timer is waiting for
+static time_t timesvc_next_check;
+static timesvc_stats_t timesvc_stats;
+static portMUX_TYPE timesvc_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/*
+    Two disciplined clocks: the system clock, which runs from esp_timer
+    and is slewed with adjtime(), and the PCF8563, which has no trim
+    register, so its readings are corrected instead. Both are kept in
+    NVS so the estimates survive a reboot; the esp_timer anchor does not.
+*/
+static clockdisc_t timesvc_xtal;
+static clockdisc_t timesvc_rtc;
+static int64_t timesvc_slew_base_us;    // esp_timer when the system clock was last set
+static int64_t timesvc_slew_total_us;   // correction requested from adjtime() since
+static time_t timesvc_next_slew;
+static bool timesvc_disc_loaded;
+
+/*
+    The disciplines and the slew state are shared by the service task and
+    TimeSvc_NtpSynced(), which runs in the caller's task and spends
+    seconds between its updates. Until TimeSvc_Init() starts the service
+    there is no second user and no lock. Recursive, as the RTC check
+    resyncs through TimeSvc_SyncFromRtc().
+*/
+static SemaphoreHandle_t timesvc_disc_mutex;
+static StaticSemaphore_t timesvc_disc_mutex_buffer;
+
+static bool timesvc_disc_lock(TickType_t timeout) {
+    return (timesvc_disc_mutex == NULL) || (xSemaphoreTakeRecursive(timesvc_disc_mutex, timeout) == pdTRUE);
+}
+
+static void timesvc_disc_unlock(void) {
+    if (timesvc_disc_mutex != NULL) {
+        xSemaphoreGiveRecursive(timesvc_disc_mutex);
+    }
+}
+
+static int64_t timesvc_now_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static time_t timesvc_rtc_to_time(const rtc_date_t *rtc) {
+    struct tm tm = {
+        .tm_year = rtc->year - 1900,
+        .tm_mon = rtc->month - 1,
+        .tm_mday = rtc->day,
+        .tm_hour = rtc->hour,
+        .tm_min = rtc->minute,
+        .tm_sec = rtc->second,
+        .tm_isdst = -1,
+    };
+    return mktime(&tm);
+}
+
+static time_t timesvc_read_rtc(void) {
+    rtc_date_t rtc;
+    esp_err_t err = PCF8563_ReadTime(&rtc);
+    portENTER_CRITICAL(&timesvc_lock);
+    timesvc_stats.rtc_reads++;
+    portEXIT_CRITICAL(&timesvc_lock);
+    if (err != ESP_OK || rtc.year < TIMESVC_VALID_YEAR) {
+        return 0;
+    }
+    return timesvc_rtc_to_time(&rtc);
+}
+
+static void timesvc_set_source(timesvc_source_t source) {
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&timesvc_lock);
+    if (timesvc_stats.source == TIMESVC_SOURCE_NONE) {
+        timesvc_stats.valid_us = now_us;
+    }
+    if (source == TIMESVC_SOURCE_NTP && timesvc_stats.ntp_us == 0) {
+        timesvc_stats.ntp_us = now_us;
+    }
+    timesvc_stats.source = source;
+    portEXIT_CRITICAL(&timesvc_lock);
+}
+
+/*
+    The timer is one-shot and re-armed for every edge: esp_timer runs on
+    the monotonic clock, so a periodic one would slide off the edges
+    whenever the system clock is set.
+*/
+static void timesvc_arm(void) {
+    int64_t now_us = timesvc_now_us();
+    time_t now = now_us / 1000000;
+    // A clock step either way restarts from the next edge.
+    if (timesvc_target <= now - 1 || timesvc_target > now + 1) {
+        timesvc_target = now + 1;
+    }
+    int64_t wait_us = (int64_t)timesvc_target * 1000000 - now_us;
+    esp_timer_start_once(timesvc_timer, (wait_us > 0) ? wait_us : 0);
+}
+
+static void timesvc_timer_cb(void *arg) {
+    time_t now = timesvc_now_us() / 1000000;
+    if (now < timesvc_target) {
+        // Early by the timer's granularity.
+        timesvc_arm();
+        return ;
+    }
+    // Late, or the clock was stepped forward: tick the current second.
+    timesvc_target = now;
+    xTaskNotify(timesvc_task_handle, (uint32_t)timesvc_target, eSetValueWithOverwrite);
+    timesvc_target++;
+    timesvc_arm();
+}
+
+/*
+    The RTC has no sub-second register: its edge is where it ticks over.
+    Returns the RTC time and the system time at that edge, taken as the
+    middle of the last poll interval; resolution_us, if given, gets that
+    interval as it actually was, ticks and I2C included.
+*/
+static esp_err_t timesvc_rtc_edge(int64_t *rtc_us, int64_t *sys_us, uint32_t *resolution_us) {
+    int64_t read_us = timesvc_now_us();
+    time_t start = timesvc_read_rtc();
+    if (start == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    time_t rtc = start;
+    int64_t last_us = read_us;
+    int64_t deadline_us = esp_timer_get_time() + TIMESVC_EDGE_TIMEOUT_MS * 1000;
+    while (rtc == start && esp_timer_get_time() < deadline_us) {
+        // At least one tick: 5 ms is 0 ticks at 100 Hz.
+        vTaskDelay(pdMS_TO_TICKS(TIMESVC_EDGE_POLL_MS) + 1);
+        last_us = read_us;
+        read_us = timesvc_now_us();
+        rtc = timesvc_read_rtc();
+    }
+    if (rtc == start) {
+        ESP_LOGE(TAG, "RTC is not counting");
+        return ESP_ERR_TIMEOUT;
+    }
+    *sys_us = last_us + (read_us - last_us) / 2;
+    *rtc_us = (int64_t)rtc * 1000000;
+    if (resolution_us != NULL) {
+        *resolution_us = (uint32_t)(read_us - last_us);
+    }
+    return ESP_OK;
+}
+
+static void timesvc_slew_reset(void) {
+    timesvc_slew_base_us = esp_timer_get_time();
+    timesvc_slew_total_us = 0;
+}
+
+/*
+    Cancel the predicted esp_timer rate error since the clock was set.
+    adjtime() replaces a pending adjustment, so what it had not applied
+    yet is taken back out of the total first.
+*/
+static void timesvc_slew(void) {
+    if (timesvc_xtal.samples == 0) {
+        return ;
+    }
+    int64_t elapsed_us = esp_timer_get_time() - timesvc_slew_base_us;
+    int64_t wanted_us = -(elapsed_us * timesvc_xtal.freq_ppb / 1000000000LL);
+    struct timeval pending;
+    if (adjtime(NULL, &pending) != 0) {
+        return ;
+    }
+    int64_t applied_us = timesvc_slew_total_us - ((int64_t)pending.tv_sec * 1000000 + pending.tv_usec);
+    int64_t delta_us = wanted_us - applied_us;
+    if (delta_us < TIMESVC_SLEW_MIN_US && delta_us > -TIMESVC_SLEW_MIN_US) {
+        return ;
+    }
+    struct timeval adjust = {
+        .tv_sec = delta_us / 1000000,
+        .tv_usec = delta_us % 1000000,
+    };
+    if (adjtime(&adjust, NULL) == 0) {
+        timesvc_slew_total_us = applied_us + delta_us;
+        portENTER_CRITICAL(&timesvc_lock);
+        timesvc_stats.slewed_us = timesvc_slew_total_us;
+        portEXIT_CRITICAL(&timesvc_lock);
+    }
+}
+
+static void timesvc_load_discipline(void) {
+    timesvc_disc_loaded = true;
+    nvs_handle_t handle;
+    if (nvs_open(TIMESVC_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return ;
+    }
+    clockdisc_t blob[2];
+    size_t length = sizeof(blob);
+    if (nvs_get_blob(handle, TIMESVC_NVS_KEY, blob, &length) == ESP_OK && length == sizeof(blob)) {
+        timesvc_xtal = blob[0];
+        timesvc_xtal.anchored = false;  // esp_timer restarted
+        timesvc_rtc = blob[1];
+        ESP_LOGI(TAG, "discipline restored: system %d ppb, RTC %d ppb",
+                 timesvc_xtal.freq_ppb, timesvc_rtc.freq_ppb);
+    }
+    nvs_close(handle);
+}
+
+static void timesvc_save_discipline(void) {
+    nvs_handle_t handle;
+    if (nvs_open(TIMESVC_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return ;
+    }
+    clockdisc_t blob[2] = { timesvc_xtal, timesvc_rtc };
+    if (nvs_set_blob(handle, TIMESVC_NVS_KEY, blob, sizeof(blob)) == ESP_OK) {
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+}
+
+static void timesvc_check_rtc(time_t now) {
+    time_t rtc = timesvc_read_rtc();
+    if (rtc == 0) {
+        return ;
+    }
+    rtc = ClockDisc_Correct(&timesvc_rtc, (int64_t)rtc * 1000000) / 1000000;
+    int32_t drift_s = (int32_t)(rtc - now);
+    portENTER_CRITICAL(&timesvc_lock);
+    timesvc_stats.drift_s = drift_s;
+    timesvc_stats.last_check = now;
+    portEXIT_CRITICAL(&timesvc_lock);
+    // Read right after the system edge, a second of difference is
+    // within reading granularity.
+    if (drift_s >= CONFIG_TIMESVC_RESYNC_THRESHOLD_S || drift_s <= -CONFIG_TIMESVC_RESYNC_THRESHOLD_S) {
+        ESP_LOGW(TAG, "RTC differs by %d s, resyncing", drift_s);
+        TimeSvc_SyncFromRtc();
+    }
+}
+
+static void timesvc_task(void *arg) {
+    time_t last = 0;
+    while (1) {
+        uint32_t second;
+        if (xTaskNotifyWait(0, UINT32_MAX, &second, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        time_t now = (time_t)second;
+        int64_t late_us = timesvc_now_us() - (int64_t)now * 1000000;
+        portENTER_CRITICAL(&timesvc_lock);
+        timesvc_stats.ticks++;
+        if (last != 0 && now > last + 1) {
+            timesvc_stats.missed += now - last - 1;
+        }
+        if (late_us > timesvc_stats.late_max_us && late_us < 1000000) {
+            timesvc_stats.late_max_us = late_us;
+        }
+        portEXIT_CRITICAL(&timesvc_lock);
+        last = now;
+
+        if (timesvc_tick_cb != NULL) {
+            timesvc_tick_cb(now, timesvc_tick_arg);
+        }
+        bool slew_due = (now >= timesvc_next_slew);
+        bool check_due = (now >= timesvc_next_check);
+        // An NTP sync in progress holds the discipline: retry next second
+        // rather than miss ticks waiting for it.
+        if ((slew_due || check_due) && timesvc_disc_lock(0)) {
+            if (slew_due) {
+                timesvc_next_slew = now + CONFIG_CLOCKDISC_SLEW_PERIOD_S;
+                timesvc_slew();
+            }
+            if (check_due) {
+                timesvc_next_check = now + CONFIG_TIMESVC_RTC_CHECK_S;
+                timesvc_check_rtc(now);
+            }
+            timesvc_disc_unlock();
+        }
+    }
+}
+
+esp_err_t TimeSvc_SyncFromRtc(void) {
+    int64_t rtc_us, sys_us;
+    timesvc_disc_lock(portMAX_DELAY);
+    esp_err_t err = timesvc_rtc_edge(&rtc_us, &sys_us, NULL);
+    if (err != ESP_OK) {
+        timesvc_disc_unlock();
+        return err;
+    }
+    int64_t now_us = ClockDisc_Correct(&timesvc_rtc, rtc_us) + (timesvc_now_us() - sys_us);
+    struct timeval tv = {
+        .tv_sec = now_us / 1000000,
+        .tv_usec = now_us % 1000000,
+    };
+    settimeofday(&tv, NULL);
+    timesvc_slew_reset();
+    timesvc_disc_unlock();
+    timesvc_set_source(TIMESVC_SOURCE_RTC);
+    portENTER_CRITICAL(&timesvc_lock);
+    timesvc_stats.resyncs++;
+    timesvc_stats.drift_s = 0;
+    if (timesvc_stats.edge_sync_us == 0) {
+        timesvc_stats.edge_sync_us = esp_timer_get_time();
+    }
+    portEXIT_CRITICAL(&timesvc_lock);
+    return ESP_OK;
+}
+
+esp_err_t TimeSvc_RestoreFromRtc(void) {
+    setenv("TZ", CONFIG_TIMESVC_TZ, 1);
+    tzset();
+    rtc_date_t rtc;
+    esp_err_t err = PCF8563_ReadTime(&rtc);
+    if (err == ESP_OK && rtc.year < TIMESVC_VALID_YEAR) {
+        err = ESP_ERR_INVALID_STATE;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    // Somewhere in the read second, corrected by the RTC rate estimate;
+    // TimeSvc_Init() finds the edge later.
+    if (!timesvc_disc_loaded) {
+        timesvc_load_discipline();
+    }
+    int64_t rtc_us = ClockDisc_Correct(&timesvc_rtc, (int64_t)timesvc_rtc_to_time(&rtc) * 1000000 + 500000);
+    if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_UNDEFINED) {
+        // Back from deep sleep the system clock has kept running on the
+        // ESP32 RTC timer, with the sub-second the RTC cannot give.
+        int64_t off_us = timesvc_now_us() - rtc_us;
+        if (off_us >= -TIMESVC_RESTORE_ERROR_MS * 1000 && off_us <= TIMESVC_RESTORE_ERROR_MS * 1000) {
+            timesvc_set_source(TIMESVC_SOURCE_RTC);
+            return ESP_OK;
+        }
+    }
+    struct timeval tv = {
+        .tv_sec = rtc_us / 1000000,
+        .tv_usec = rtc_us % 1000000,
+    };
+    settimeofday(&tv, NULL);
+    timesvc_set_source(TIMESVC_SOURCE_RTC);
+    return ESP_OK;
+}
+
+uint32_t TimeSvc_NtpSynced(void) {
+    // Held to the end, so the service task never sees half an update.
+    timesvc_disc_lock(portMAX_DELAY);
+    if (!timesvc_disc_loaded) {
+        // Duty-cycle mode syncs without the tick service.
+        timesvc_load_discipline();
+    }
+    // SNTP has just set the system clock: it is the reference now.
+    timesvc_set_source(TIMESVC_SOURCE_NTP);
+    ClockDisc_Sample(&timesvc_xtal, timesvc_now_us(), esp_timer_get_time(), TIMESVC_NTP_RESOLUTION_US);
+    timesvc_slew_reset();
+
+    int64_t rtc_us, sys_us;
+    uint32_t edge_us;
+    if (timesvc_rtc_edge(&rtc_us, &sys_us, &edge_us) == ESP_OK) {
+        ClockDisc_Sample(&timesvc_rtc, sys_us, rtc_us, edge_us);
+    }
+    // Writing may not restart the RTC divider, so measure where its
+    // edge ended up rather than assume it.
+    if (TimeSvc_SyncToRtc() == ESP_OK && timesvc_rtc_edge(&rtc_us, &sys_us, NULL) == ESP_OK) {
+        ClockDisc_Step(&timesvc_rtc, sys_us, rtc_us);
+    }
+    timesvc_save_discipline();
+
+    // Without the tick service the system clock is restored from the
+    // corrected RTC after every deep sleep, to within half a second: the
+    // RTC gets what is left of the error budget.
+    uint32_t next_s;
+    if (timesvc_task_handle != NULL) {
+        next_s = ClockDisc_SyncInterval(&timesvc_xtal, CONFIG_CLOCKDISC_MAX_ERROR_MS);
+    } else {
+        uint32_t budget_ms = 0;
+        if (CONFIG_CLOCKDISC_MAX_ERROR_MS > TIMESVC_RESTORE_ERROR_MS) {
+            budget_ms = CONFIG_CLOCKDISC_MAX_ERROR_MS - TIMESVC_RESTORE_ERROR_MS;
+        } else {
+            ESP_LOGW(TAG, "RTC restores are only good to %u ms, syncing at the minimum interval",
+                     TIMESVC_RESTORE_ERROR_MS);
+        }
+        next_s = ClockDisc_SyncInterval(&timesvc_rtc, budget_ms);
+    }
+    portENTER_CRITICAL(&timesvc_lock);
+    timesvc_stats.ntp_syncs++;
+    timesvc_stats.xtal_ppb = timesvc_xtal.freq_ppb;
+    timesvc_stats.rtc_ppb = timesvc_rtc.freq_ppb;
+    timesvc_stats.holdover_us = timesvc_xtal.offset_us;
+    timesvc_stats.rtc_holdover_us = timesvc_rtc.offset_us;
+    timesvc_stats.next_sync_s = next_s;
+    timesvc_stats.drift_s = 0;
+    portEXIT_CRITICAL(&timesvc_lock);
+    ESP_LOGI(TAG, "NTP sync: system %d ppb (off %d us), RTC %d ppb (off %d us), next in %u s",
+             timesvc_xtal.freq_ppb, timesvc_xtal.offset_us, timesvc_rtc.freq_ppb, timesvc_rtc.offset_us, next_s);
+    timesvc_disc_unlock();
+    return next_s;
+}
+
+esp_err_t TimeSvc_SyncToRtc(void) {
+    // Write on the edge so the RTC starts its second with the system.
+    int64_t now_us = timesvc_now_us();
+    vTaskDelay(pdMS_TO_TICKS(1000 - (now_us % 1000000) / 1000));
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    if (tm.tm_year + 1900 < TIMESVC_VALID_YEAR) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    rtc_date_t rtc = {
+        .year = tm.tm_year + 1900,
+        .month = tm.tm_mon + 1,
+        .day = tm.tm_mday,
+        .hour = tm.tm_hour,
+        .minute = tm.tm_min,
+        .second = tm.tm_sec,
+    };
+    PCF8563_SetTime(&rtc);
+    return ESP_OK;
+}
+
+esp_err_t TimeSvc_Init(timesvc_tick_cb_t tick_cb, void *arg) {
+    if (timesvc_task_handle != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!timesvc_disc_loaded) {
+        timesvc_load_discipline();
+    }
+    if (timesvc_disc_mutex == NULL) {
+        timesvc_disc_mutex = xSemaphoreCreateRecursiveMutexStatic(&timesvc_disc_mutex_buffer);
+    }
+    esp_err_t sync = TimeSvc_SyncFromRtc();
+    if (sync != ESP_OK) {
+        ESP_LOGW(TAG, "system clock not set from the RTC (%s)", esp_err_to_name(sync));
+    }
+
+    timesvc_tick_cb = tick_cb;
+    timesvc_tick_arg = arg;
+    timesvc_next_check = time(NULL) + CONFIG_TIMESVC_RTC_CHECK_S;
+    if (xTaskCreatePinnedToCore(timesvc_task, "timesvc", 4096, NULL,
+                                CONFIG_TIMESVC_TASK_PRIORITY, &timesvc_task_handle, 1) != pdPASS) {
+        timesvc_task_handle = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    const esp_timer_create_args_t timer_args = {
+        .callback = &timesvc_timer_cb,
+        .name = "timesvc",
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &timesvc_timer);
+    if (err != ESP_OK) {
+        vTaskDelete(timesvc_task_handle);
+        timesvc_task_handle = NULL;
+        return err;
+    }
+    timesvc_arm();
+    return sync;
+}
+
+void TimeSvc_GetStats(timesvc_stats_t *stats) {
+    portENTER_CRITICAL(&timesvc_lock);
+    *stats = timesvc_stats;
+    portEXIT_CRITICAL(&timesvc_lock);
+}
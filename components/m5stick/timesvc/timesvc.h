@@ -0,0 +1,104 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <time.h>
+
+#include "esp_err.h"
+
+/*
+    System time service on top of the PCF8563. The RTC is read once at
+    start to set the system clock, which then keeps time on its own; the
+    RTC is only read again every CONFIG_TIMESVC_RTC_CHECK_S to measure
+    drift. Ticks are timed to the system second edge, so a clock display
+    changes when the second does. See TimeSvc_NtpSynced() for the rate
+    discipline between NTP updates.
+*/
+
+/*
+    Called from the service task right after each second edge with the
+    second that just started. It may block briefly (LVGL, I2C); a tick
+    that takes more than a second makes the next ones coalesce.
+*/
+typedef void (*timesvc_tick_cb_t)(time_t now, void *arg);
+
+typedef enum {
+    TIMESVC_SOURCE_NONE = 0,    // system clock not set since boot
+    TIMESVC_SOURCE_RTC,
+    TIMESVC_SOURCE_NTP,
+} timesvc_source_t;
+
+typedef struct {
+    timesvc_source_t source;    // what last set the system clock
+    int64_t valid_us;           // esp_timer when the time first became valid, 0 if not yet
+    int64_t edge_sync_us;       // first second-edge aligned set from the RTC
+    int64_t ntp_us;             // first NTP sync
+    uint32_t ticks;
+    uint32_t missed;            // seconds skipped because a tick ran late
+    uint32_t late_max_us;       // worst tick delivery after its edge
+    uint32_t rtc_reads;
+    uint32_t resyncs;           // system clock set from the RTC
+    int32_t drift_s;            // RTC minus system time at the last check
+    time_t last_check;          // 0 before the first check
+    uint32_t ntp_syncs;
+    int32_t xtal_ppb;           // system clock rate error estimate
+    int32_t rtc_ppb;            // RTC rate error estimate
+    int32_t holdover_us;        // disciplined system clock error found at the last NTP sync
+    int32_t rtc_holdover_us;    // same for the corrected RTC
+    int64_t slewed_us;          // adjtime() correction since the clock was last set
+    uint32_t next_sync_s;       // NTP interval that keeps the error in bounds
+} timesvc_stats_t;
+
+/*
+    Set TZ to CONFIG_TIMESVC_TZ, the zone the RTC is kept in, and the
+    system clock from one RTC read corrected by the saved RTC rate
+    estimate, to within half a second. Meant for early boot, before
+    anything timestamps, but after NVS is up; ESP_ERR_INVALID_STATE when
+    the VL flag is set or the RTC was never set, and the clock is left
+    alone. After a deep-sleep wake the system clock is kept when it is
+    within that half second, since it still has its sub-second.
+*/
+esp_err_t TimeSvc_RestoreFromRtc(void);
+
+/*
+    Set the system clock from the RTC on its second edge and start
+    ticking. M5Stick_Init() has already called TimeSvc_RestoreFromRtc(),
+    so TZ is set. An RTC that was never set (year before 2020, or VL
+    set) leaves the system clock alone and returns
+    ESP_ERR_INVALID_STATE, but the service still runs.
+*/
+esp_err_t TimeSvc_Init(timesvc_tick_cb_t tick_cb, void *arg);
+
+/*
+    Wait for the RTC seconds to roll over and set the system clock to
+    that edge. Blocks for up to a second.
+*/
+esp_err_t TimeSvc_SyncFromRtc(void);
+
+/* Write the system time into the RTC, e.g. after an NTP update. */
+esp_err_t TimeSvc_SyncToRtc(void);
+
+/*
+    Call after SNTP has set the system clock. Measures how far the
+    system clock and the RTC had drifted since the previous sync, updates
+    their rate estimates, rewrites the RTC and saves the estimates to NVS.
+    Between syncs the system clock is slewed by its estimate and RTC
+    readings are corrected by theirs. Blocks for up to two seconds, during
+    which the service task puts off its slew and RTC check.
+
+    Returns the seconds until the next sync should be needed to keep the
+    error within CONFIG_CLOCKDISC_MAX_ERROR_MS: of the system clock once
+    TimeSvc_Init() has run. Otherwise the clock is restored from the RTC
+    after each deep sleep, so the RTC gets the budget less the half
+    second of a restore, and the minimum interval when nothing is left.
+*/
+uint32_t TimeSvc_NtpSynced(void);
+
+void TimeSvc_GetStats(timesvc_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
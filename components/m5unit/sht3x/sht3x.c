@@ -1,54 +1,434 @@
 // https://github.com/m5stack/M5Unit-ENV/blob/master/src/SHT3X.cpp
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
 #include "sht3x.h"
 
-#define SHT3X_ADDR (0x44)
+// Single shot, high repeatability, no clock stretching.
+#define SHT3X_CMD_MEASURE (0x2400)
+#define SHT3X_CMD_FETCH (0xE000)
+#define SHT3X_CMD_BREAK (0x3093)
+// Datasheet maximum for high repeatability is 15.5 ms.
+#define SHT3X_MEASURE_US (16000)
+// NACKed reads are retried until this long after the expected end.
+#define SHT3X_OVERDUE_US (50000)
+
+static const struct {
+    uint16_t cmd;
+    uint32_t period_us;
+} sht3x_periodic[] = {
+    [SHT3X_PERIODIC_0_5_MPS] = { 0x2032, 2000000 },
+    [SHT3X_PERIODIC_1_MPS]   = { 0x2130, 1000000 },
+    [SHT3X_PERIODIC_2_MPS]   = { 0x2236, 500000 },
+    [SHT3X_PERIODIC_4_MPS]   = { 0x2334, 250000 },
+    [SHT3X_PERIODIC_10_MPS]  = { 0x2737, 100000 },
+    [SHT3X_PERIODIC_ART]     = { 0x2B32, 250000 },
+};
+
+// CRC-8, polynomial 0x31 (x^8 + x^5 + x^4 + 1), init 0xFF.
+static const uint8_t sht3x_crc_table[256] = {
+    0x00, 0x31, 0x62, 0x53, 0xC4, 0xF5, 0xA6, 0x97, 0xB9, 0x88, 0xDB, 0xEA, 0x7D, 0x4C, 0x1F, 0x2E,
+    0x43, 0x72, 0x21, 0x10, 0x87, 0xB6, 0xE5, 0xD4, 0xFA, 0xCB, 0x98, 0xA9, 0x3E, 0x0F, 0x5C, 0x6D,
+    0x86, 0xB7, 0xE4, 0xD5, 0x42, 0x73, 0x20, 0x11, 0x3F, 0x0E, 0x5D, 0x6C, 0xFB, 0xCA, 0x99, 0xA8,
+    0xC5, 0xF4, 0xA7, 0x96, 0x01, 0x30, 0x63, 0x52, 0x7C, 0x4D, 0x1E, 0x2F, 0xB8, 0x89, 0xDA, 0xEB,
+    0x3D, 0x0C, 0x5F, 0x6E, 0xF9, 0xC8, 0x9B, 0xAA, 0x84, 0xB5, 0xE6, 0xD7, 0x40, 0x71, 0x22, 0x13,
+    0x7E, 0x4F, 0x1C, 0x2D, 0xBA, 0x8B, 0xD8, 0xE9, 0xC7, 0xF6, 0xA5, 0x94, 0x03, 0x32, 0x61, 0x50,
+    0xBB, 0x8A, 0xD9, 0xE8, 0x7F, 0x4E, 0x1D, 0x2C, 0x02, 0x33, 0x60, 0x51, 0xC6, 0xF7, 0xA4, 0x95,
+    0xF8, 0xC9, 0x9A, 0xAB, 0x3C, 0x0D, 0x5E, 0x6F, 0x41, 0x70, 0x23, 0x12, 0x85, 0xB4, 0xE7, 0xD6,
+    0x7A, 0x4B, 0x18, 0x29, 0xBE, 0x8F, 0xDC, 0xED, 0xC3, 0xF2, 0xA1, 0x90, 0x07, 0x36, 0x65, 0x54,
+    0x39, 0x08, 0x5B, 0x6A, 0xFD, 0xCC, 0x9F, 0xAE, 0x80, 0xB1, 0xE2, 0xD3, 0x44, 0x75, 0x26, 0x17,
+    0xFC, 0xCD, 0x9E, 0xAF, 0x38, 0x09, 0x5A, 0x6B, 0x45, 0x74, 0x27, 0x16, 0x81, 0xB0, 0xE3, 0xD2,
+    0xBF, 0x8E, 0xDD, 0xEC, 0x7B, 0x4A, 0x19, 0x28, 0x06, 0x37, 0x64, 0x55, 0xC2, 0xF3, 0xA0, 0x91,
+    0x47, 0x76, 0x25, 0x14, 0x83, 0xB2, 0xE1, 0xD0, 0xFE, 0xCF, 0x9C, 0xAD, 0x3A, 0x0B, 0x58, 0x69,
+    0x04, 0x35, 0x66, 0x57, 0xC0, 0xF1, 0xA2, 0x93, 0xBD, 0x8C, 0xDF, 0xEE, 0x79, 0x48, 0x1B, 0x2A,
+    0xC1, 0xF0, 0xA3, 0x92, 0x05, 0x34, 0x67, 0x56, 0x78, 0x49, 0x1A, 0x2B, 0xBC, 0x8D, 0xDE, 0xEF,
+    0x82, 0xB3, 0xE0, 0xD1, 0x46, 0x77, 0x24, 0x15, 0x3B, 0x0A, 0x59, 0x68, 0xFF, 0xCE, 0x9D, 0xAC,
+};
+
+struct _sht3x_t {
+    I2CDevice_t device;
+    i2c_port_t i2c_num;
+    gpio_num_t sda;
+    gpio_num_t scl;
+    int8_t hub_channel;
+    sht3x_state_t state;
+    int64_t ready_us;
+    uint32_t period_us;             // non-zero in periodic mode
+    int64_t last_sample_us;
+    bool first_sample;
+    sht3x_stats_t stats;
+    int32_t temperature;            // 0.01 degC
+    int32_t humidity;               // 0.01 %RH
+};
+
+/*
+    One PaHub per port, shared by the sensors behind it. The selected
+    channel mask is cached so that consecutive accesses to the same
+    channel do not rewrite it; this assumes nothing else drives the hub.
+*/
+typedef struct {
+    I2CDevice_t device;
+    uint8_t users;
+    bool known;
+    uint8_t mask;
+} sht3x_hub_t;
+
+static sht3x_hub_t sht3x_hub[I2C_NUM_MAX];
+
+static uint8_t sht3x_crc8(const uint8_t *data) {
+    uint8_t crc = sht3x_crc_table[0xFF ^ data[0]];
+    return sht3x_crc_table[crc ^ data[1]];
+}
+
+static esp_err_t sht3x_select(sht3x_t *sensor) {
+    uint8_t mask = (sensor->hub_channel == SHT3X_NO_HUB) ? 0 : (1 << sensor->hub_channel);
+    sht3x_hub_t *hub = &sht3x_hub[sensor->i2c_num];
+    if (hub->device == NULL) {
+        return ESP_OK;
+    }
+    // A sensor on the main bus only needs the hub closed if it was
+    // opened, in case the same address sits behind it.
+    if ((hub->known && hub->mask == mask) || (mask == 0 && hub->known == false)) {
+        return ESP_OK;
+    }
+    esp_err_t ret = i2c_write_bytes(hub->device, I2C_NO_REG, &mask, 1);
+    hub->known = (ret == ESP_OK);
+    hub->mask = mask;
+    return ret;
+}
+
+static esp_err_t sht3x_command(sht3x_t *sensor, uint16_t command) {
+    esp_err_t ret = sht3x_select(sensor);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    uint8_t cmd[2] = { command >> 8, command & 0xFF };
+    return i2c_write_bytes(sensor->device, (uint32_t)I2C_NO_REG, cmd, (uint16_t)2);
+}
+
+static esp_err_t sht3x_decode(sht3x_t *sensor, const uint8_t *data) {
+    if (sht3x_crc8(&data[0]) != data[2] || sht3x_crc8(&data[3]) != data[5]) {
+        sensor->stats.invalid++;
+        return ESP_ERR_INVALID_CRC;
+    }
+    // T = -45 + 175 * raw / 65535, RH = 100 * raw / 65535, rounded.
+    uint32_t raw_t = ((uint32_t)data[0] << 8) | data[1];
+    uint32_t raw_rh = ((uint32_t)data[3] << 8) | data[4];
+    sensor->temperature = (int32_t)((raw_t * 17500 + 32767) / 65535) - 4500;
+    sensor->humidity = (int32_t)((raw_rh * 10000 + 32767) / 65535);
+    sensor->stats.samples++;
+    return ESP_OK;
+}
 
-#define Sht3x_COMMAND_MEASURE {0x2C, 0x06}
-static I2CDevice_t sht3x_device;
-static float temperature = 0.0;
-static float humidity = 0.0;
+int32_t Sht3x_GetCentiTemperature(sht3x_t *sensor) {
+    return sensor->temperature;
+}
 
-float Sht3x_GetTemperature() {
-    return temperature;
+int32_t Sht3x_GetCentiHumidity(sht3x_t *sensor) {
+    return sensor->humidity;
 }
 
-int32_t Sht3x_GetIntTemperature() {
-    return (int32_t)temperature;
+float Sht3x_GetTemperature(sht3x_t *sensor) {
+    return sensor->temperature / 100.0f;
 }
 
-float Sht3x_GetHumidity() {
-    return humidity;
+int32_t Sht3x_GetIntTemperature(sht3x_t *sensor) {
+    return sensor->temperature / 100;
 }
 
-int32_t Sht3x_GetIntHumidity() {
-    return (int32_t)humidity;
+float Sht3x_GetHumidity(sht3x_t *sensor) {
+    return sensor->humidity / 100.0f;
 }
 
-esp_err_t Sht3x_Read() {
-    esp_err_t ret = ESP_OK;
-    uint8_t cmd[2] = Sht3x_COMMAND_MEASURE;
-    uint8_t tempdata[6] = {0};
+int32_t Sht3x_GetIntHumidity(sht3x_t *sensor) {
+    return sensor->humidity / 100;
+}
 
-    ret = i2c_write_bytes(sht3x_device, (uint32_t)I2C_NO_REG, cmd, (uint16_t)2);
-    vTaskDelay(100/portTICK_RATE_MS);
+int64_t Sht3x_ReadyAt(sht3x_t *sensor) {
+    return sensor->ready_us;
+}
+
+sht3x_state_t Sht3x_GetState(sht3x_t *sensor) {
+    return sensor->state;
+}
+
+void Sht3x_GetStats(sht3x_t *sensor, sht3x_stats_t *stats) {
+    *stats = sensor->stats;
+}
+
+esp_err_t Sht3x_Trigger(sht3x_t *sensor) {
+    if (sensor->state == SHT3X_STATE_MEASURING || sensor->period_us != 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t ret = sht3x_command(sensor, SHT3X_CMD_MEASURE);
+    if (ret != ESP_OK) {
+        sensor->state = SHT3X_STATE_ERROR;
+        return ret;
+    }
+    sensor->ready_us = esp_timer_get_time() + SHT3X_MEASURE_US;
+    sensor->state = SHT3X_STATE_MEASURING;
+    return ESP_OK;
+}
+
+esp_err_t Sht3x_Fetch(sht3x_t *sensor) {
+    if (sensor->state != SHT3X_STATE_MEASURING) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (esp_timer_get_time() < sensor->ready_us) {
+        return ESP_ERR_NOT_FINISHED;
+    }
 
+    uint8_t tempdata[6] = {0};
+    esp_err_t ret = sht3x_select(sensor);
     if (ret == ESP_OK) {
-        ret = i2c_read_bytes(sht3x_device, (uint32_t)I2C_NO_REG, tempdata, (uint16_t)6);
-        vTaskDelay(10);
+        ret = i2c_read_bytes(sensor->device, (uint32_t)I2C_NO_REG, tempdata, (uint16_t)6);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = sht3x_decode(sensor, tempdata);
+    sensor->state = (ret == ESP_OK) ? SHT3X_STATE_DONE : SHT3X_STATE_ERROR;
+    return ret;
+}
 
-        humidity = ((((tempdata[3] * 256.0) + tempdata[4]) * 100) / 65535.0);
-        temperature = ((((tempdata[0] * 256.0) + tempdata[1]) * 175) / 65535.0) - 45;
+esp_err_t Sht3x_StartPeriodic(sht3x_t *sensor, sht3x_rate_t rate) {
+    if (rate > SHT3X_PERIODIC_ART) {
+        return ESP_ERR_INVALID_ARG;
     }
+    if (sensor->state == SHT3X_STATE_MEASURING) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (sensor->period_us != 0) {
+        // A new mode only takes after a break.
+        Sht3x_StopPeriodic(sensor);
+    }
+    esp_err_t ret = sht3x_command(sensor, sht3x_periodic[rate].cmd);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    int64_t now = esp_timer_get_time();
+    sensor->period_us = sht3x_periodic[rate].period_us;
+    sensor->last_sample_us = now;
+    sensor->first_sample = true;
+    sensor->ready_us = now + sensor->period_us;
+    sensor->state = SHT3X_STATE_PERIODIC;
+    return ESP_OK;
+}
 
+esp_err_t Sht3x_StopPeriodic(sht3x_t *sensor) {
+    if (sensor->period_us == 0) {
+        return ESP_OK;
+    }
+    esp_err_t ret = sht3x_command(sensor, SHT3X_CMD_BREAK);
+    sensor->period_us = 0;
+    sensor->state = SHT3X_STATE_IDLE;
+    // The sensor takes 1 ms to accept the next command.
+    vTaskDelay(pdMS_TO_TICKS(1) + 1);
     return ret;
 }
 
-esp_err_t Sht3x_Init(i2c_port_t i2c_num, gpio_num_t sda, gpio_num_t scl, uint32_t baud) {
-    sht3x_device = i2c_malloc_device(i2c_num, sda, scl, baud, SHT3X_ADDR);
-    if (sht3x_device == NULL) {
+esp_err_t Sht3x_FetchPeriodic(sht3x_t *sensor) {
+    if (sensor->period_us == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t ret = sht3x_select(sensor);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    uint8_t cmd[2] = { SHT3X_CMD_FETCH >> 8, SHT3X_CMD_FETCH & 0xFF };
+    uint8_t tempdata[6] = {0};
+    i2c_segment_t fetch_seq[] = {
+        { I2C_OP_WRITE, I2C_NO_REG, cmd, 2 },
+        { I2C_OP_READ, I2C_NO_REG, tempdata, 6 },
+    };
+    ret = i2c_transfer(sensor->device, fetch_seq, 2);
+    int64_t now = esp_timer_get_time();
+    if (ret != ESP_OK) {
+        // Read header NACKed: no sample since the last fetch. Look again
+        // after an eighth of a period.
+        sensor->stats.not_ready++;
+        sensor->ready_us = now + sensor->period_us / 8;
         return ESP_ERR_NOT_FOUND;
     }
 
-    return ESP_OK;
-}
\ No newline at end of file
+    // Samples the sensor produced since the previous fetch beyond this
+    // one were overwritten.
+    if (!sensor->first_sample) {
+        uint32_t periods = (now - sensor->last_sample_us + sensor->period_us / 2) / sensor->period_us;
+        if (periods > 1) {
+            sensor->stats.dropped += periods - 1;
+        }
+    }
+    sensor->first_sample = false;
+    sensor->last_sample_us = now;
+    sensor->ready_us = now + sensor->period_us;
+    return sht3x_decode(sensor, tempdata);
+}
+
+sht3x_state_t Sht3x_Poll(sht3x_t *sensor) {
+    int64_t now = esp_timer_get_time();
+    if (sensor->period_us != 0) {
+        if (now >= sensor->ready_us && Sht3x_FetchPeriodic(sensor) == ESP_OK) {
+            sensor->state = SHT3X_STATE_DONE;
+        } else if (now - sensor->last_sample_us > 3 * (int64_t)sensor->period_us) {
+            sensor->state = SHT3X_STATE_ERROR;
+        } else {
+            sensor->state = SHT3X_STATE_PERIODIC;
+        }
+        return sensor->state;
+    }
+
+    if (sensor->state != SHT3X_STATE_MEASURING) {
+        return sensor->state;
+    }
+    esp_err_t ret = Sht3x_Fetch(sensor);
+    if (ret != ESP_OK && ret != ESP_ERR_NOT_FINISHED && ret != ESP_ERR_INVALID_CRC
+        && now > sensor->ready_us + SHT3X_OVERDUE_US) {
+        sensor->state = SHT3X_STATE_ERROR;
+    }
+    return sensor->state;
+}
+
+static bool sht3x_same_bus(const sht3x_t *a, const sht3x_t *b) {
+    return a->i2c_num == b->i2c_num && a->sda == b->sda && a->scl == b->scl;
+}
+
+/*
+    Run step on every sensor (up to 32), one bus at a time: the first sensor of a
+    bus takes it and the rest of that bus is served before it is let go.
+    Returns how many step calls returned true.
+*/
+static uint8_t sht3x_for_each_bus(sht3x_t **sensors, uint8_t count, bool (*step)(sht3x_t *sensor, int64_t now)) {
+    uint8_t hits = 0;
+    uint32_t done = 0;
+    for (uint8_t i = 0; i < count && i < 32; i++) {
+        if (done & (1UL << i)) {
+            continue;
+        }
+        i2c_apply_bus(sensors[i]->device);
+        int64_t now = esp_timer_get_time();
+        for (uint8_t j = i; j < count && j < 32; j++) {
+            if (!(done & (1UL << j)) && sht3x_same_bus(sensors[i], sensors[j])) {
+                done |= 1UL << j;
+                hits += step(sensors[j], now) ? 1 : 0;
+            }
+        }
+        i2c_free_bus(sensors[i]->device);
+    }
+    return hits;
+}
+
+static bool sht3x_trigger_step(sht3x_t *sensor, int64_t now) {
+    if (sensor->period_us != 0 || sensor->state == SHT3X_STATE_MEASURING) {
+        return false;
+    }
+    return Sht3x_Trigger(sensor) == ESP_OK;
+}
+
+static bool sht3x_poll_step(sht3x_t *sensor, int64_t now) {
+    if (sensor->period_us == 0 && sensor->state != SHT3X_STATE_MEASURING) {
+        return false;
+    }
+    if (sensor->period_us != 0 && now < sensor->ready_us) {
+        // Not due: only refresh the state, without touching the bus.
+        sensor->state = (now - sensor->last_sample_us > 3 * (int64_t)sensor->period_us)
+                        ? SHT3X_STATE_ERROR : SHT3X_STATE_PERIODIC;
+        return false;
+    }
+    if (sensor->period_us == 0 && now < sensor->ready_us) {
+        return false;
+    }
+    return Sht3x_Poll(sensor) == SHT3X_STATE_DONE;
+}
+
+uint8_t Sht3x_TriggerAll(sht3x_t **sensors, uint8_t count) {
+    return sht3x_for_each_bus(sensors, count, sht3x_trigger_step);
+}
+
+uint8_t Sht3x_PollAll(sht3x_t **sensors, uint8_t count) {
+    return sht3x_for_each_bus(sensors, count, sht3x_poll_step);
+}
+
+int64_t Sht3x_NextReadyAt(sht3x_t **sensors, uint8_t count) {
+    int64_t next = INT64_MAX;
+    for (uint8_t i = 0; i < count; i++) {
+        if ((sensors[i]->period_us != 0 || sensors[i]->state == SHT3X_STATE_MEASURING)
+            && sensors[i]->ready_us < next) {
+            next = sensors[i]->ready_us;
+        }
+    }
+    return next;
+}
+
+esp_err_t Sht3x_Read(sht3x_t *sensor) {
+    esp_err_t ret = Sht3x_Trigger(sensor);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    while (Sht3x_Poll(sensor) == SHT3X_STATE_MEASURING) {
+        int64_t wait_us = sensor->ready_us - esp_timer_get_time();
+        TickType_t ticks = (wait_us > 0) ? pdMS_TO_TICKS((wait_us + 999) / 1000) : 0;
+        vTaskDelay((ticks > 0) ? ticks : 1);
+    }
+    return (sensor->state == SHT3X_STATE_DONE) ? ESP_OK : ESP_FAIL;
+}
+
+sht3x_t *Sht3x_Init(const sht3x_config_t *config) {
+    if (config == NULL || config->i2c_num < 0 || config->i2c_num >= I2C_NUM_MAX || config->hub_channel > 7) {
+        return NULL;
+    }
+    sht3x_t *sensor = calloc(1, sizeof(sht3x_t));
+    if (sensor == NULL) {
+        return NULL;
+    }
+    sensor->device = i2c_malloc_device(config->i2c_num, config->sda, config->scl, config->baud, config->addr);
+    if (sensor->device == NULL) {
+        free(sensor);
+        return NULL;
+    }
+    i2c_device_set_name(sensor->device, (config->name != NULL) ? config->name : "SHT3X");
+    i2c_device_set_priority(sensor->device, I2C_PRIORITY_LOW);
+    sensor->i2c_num = config->i2c_num;
+    sensor->sda = config->sda;
+    sensor->scl = config->scl;
+    sensor->hub_channel = (config->hub_channel < 0) ? SHT3X_NO_HUB : config->hub_channel;
+    sensor->state = SHT3X_STATE_IDLE;
+
+    if (sensor->hub_channel != SHT3X_NO_HUB) {
+        sht3x_hub_t *hub = &sht3x_hub[config->i2c_num];
+        if (hub->device == NULL) {
+            hub->device = i2c_malloc_device(config->i2c_num, config->sda, config->scl, config->baud, config->hub_addr);
+            if (hub->device == NULL) {
+                i2c_free_device(sensor->device);
+                free(sensor);
+                return NULL;
+            }
+            i2c_device_set_name(hub->device, "PAHUB");
+            i2c_device_set_priority(hub->device, I2C_PRIORITY_LOW);
+            hub->known = false;
+        }
+        hub->users++;
+    }
+
+    return sensor;
+}
+
+void Sht3x_Free(sht3x_t *sensor) {
+    if (sensor == NULL) {
+        return ;
+    }
+    Sht3x_StopPeriodic(sensor);
+    if (sensor->hub_channel != SHT3X_NO_HUB) {
+        sht3x_hub_t *hub = &sht3x_hub[sensor->i2c_num];
+        if (--hub->users == 0) {
+            i2c_free_device(hub->device);
+            hub->device = NULL;
+        }
+    }
+    i2c_free_device(sensor->device);
+    free(sensor);
+}
@@ -10,12 +10,144 @@ extern "C" {
 #include "driver/gpio.h"
 #include "i2c_device.h"
 
-esp_err_t Sht3x_Init(i2c_port_t i2c_num, gpio_num_t sda, gpio_num_t scl, uint32_t baud);
-esp_err_t Sht3x_Read();
-float Sht3x_GetTemperature();
-int32_t Sht3x_GetIntTemperature();
-float Sht3x_GetHumidity();
-int32_t Sht3x_GetIntHumidity();
+#define SHT3X_ADDR_DEFAULT (0x44)
+#define SHT3X_ADDR_ALT (0x45)       // ADDR pin high
+#define SHT3X_HUB_ADDR (0x70)       // PaHub (PCA9548A) on Port A
+#define SHT3X_NO_HUB (-1)
+
+/*
+    Measurement state, see Sht3x_Poll(). A new measurement can be
+    triggered from any state except SHT3X_STATE_MEASURING.
+*/
+typedef enum {
+    SHT3X_STATE_IDLE = 0,   // nothing requested yet
+    SHT3X_STATE_MEASURING,  // command sent, conversion running
+    SHT3X_STATE_DONE,       // a new sample is in the getters
+    SHT3X_STATE_ERROR,      // the command or the read failed
+    SHT3X_STATE_PERIODIC,   // periodic mode, no new sample this poll
+} sht3x_state_t;
+
+/* Periodic acquisition rates, all at high repeatability. */
+typedef enum {
+    SHT3X_PERIODIC_0_5_MPS = 0,
+    SHT3X_PERIODIC_1_MPS,
+    SHT3X_PERIODIC_2_MPS,
+    SHT3X_PERIODIC_4_MPS,
+    SHT3X_PERIODIC_10_MPS,
+    SHT3X_PERIODIC_ART,     // accelerated response time, 4 mps
+} sht3x_rate_t;
+
+typedef struct {
+    uint32_t samples;       // valid samples decoded
+    uint32_t dropped;       // periodic samples overwritten before a fetch
+    uint32_t invalid;       // reads rejected by the CRC check
+    uint32_t not_ready;     // fetches NACKed because no new sample was there
+} sht3x_stats_t;
+
+/*
+    Where one sensor sits. hub_channel selects a PaHub port (0-5, or 0-7
+    on a bare PCA9548A) that is switched to before every access, or SHT3X_NO_HUB for a sensor
+    wired straight to the bus.
+*/
+typedef struct {
+    i2c_port_t i2c_num;
+    gpio_num_t sda;
+    gpio_num_t scl;
+    uint32_t baud;
+    uint8_t addr;           // SHT3X_ADDR_DEFAULT or SHT3X_ADDR_ALT
+    int8_t hub_channel;
+    uint8_t hub_addr;       // SHT3X_HUB_ADDR unless re-strapped
+    const char *name;       // i2c stats label, not copied; NULL for "SHT3X"
+} sht3x_config_t;
+
+typedef struct _sht3x_t sht3x_t;
+
+sht3x_t *Sht3x_Init(const sht3x_config_t *config);
+
+void Sht3x_Free(sht3x_t *sensor);
+
+/*
+    Start a single shot measurement without clock stretching and return
+    at once. The conversion takes about 15 ms; the bus is free meanwhile.
+*/
+esp_err_t Sht3x_Trigger(sht3x_t *sensor);
+
+/*
+    Read the result of the last Sht3x_Trigger(). ESP_ERR_NOT_FINISHED
+    while the conversion is still running.
+*/
+esp_err_t Sht3x_Fetch(sht3x_t *sensor);
+
+/*
+    Let the sensor measure on its own clock at rate. Samples are then
+    collected with Sht3x_FetchPeriodic() (or Sht3x_Poll()), which costs
+    one fetch command and a read, with no conversion wait.
+*/
+esp_err_t Sht3x_StartPeriodic(sht3x_t *sensor, sht3x_rate_t rate);
+
+/* Break command, back to single shot mode. */
+esp_err_t Sht3x_StopPeriodic(sht3x_t *sensor);
+
+/*
+    Fetch the latest periodic sample (0xE000). ESP_ERR_NOT_FOUND when the
+    sensor had no new sample (it NACKs), ESP_ERR_INVALID_CRC when either
+    word fails its checksum.
+*/
+esp_err_t Sht3x_FetchPeriodic(sht3x_t *sensor);
+
+/*
+    Advance the state machine; call it from a scheduler tick. Single
+    shot: fetches once the conversion time has passed and retries a
+    NACKed read on the next call until the measurement is overdue.
+    Periodic: fetches when the next sample is due and returns
+    SHT3X_STATE_DONE for a new sample, SHT3X_STATE_PERIODIC otherwise,
+    or SHT3X_STATE_ERROR after three periods without one.
+*/
+sht3x_state_t Sht3x_Poll(sht3x_t *sensor);
+
+/* State left by the last trigger, fetch or poll. */
+sht3x_state_t Sht3x_GetState(sht3x_t *sensor);
+
+/*
+    esp_timer time at which the running conversion should be complete,
+    or in periodic mode when the next sample is due.
+*/
+int64_t Sht3x_ReadyAt(sht3x_t *sensor);
+
+/*
+    Shared scheduler helpers for a set of up to 32 sensors. Sensors are
+    grouped by bus and each group is served inside one bus acquisition,
+    so other devices cannot slip in between the sensors (or between a
+    hub channel switch and the access behind it).
+
+    Sht3x_TriggerAll() starts a single shot on every sensor that is not
+    busy or in periodic mode, so the conversions run in parallel.
+    Sht3x_PollAll() polls every sensor that is due and returns how many
+    produced a new sample; Sht3x_GetState() tells which.
+*/
+uint8_t Sht3x_TriggerAll(sht3x_t **sensors, uint8_t count);
+
+uint8_t Sht3x_PollAll(sht3x_t **sensors, uint8_t count);
+
+/*
+    Earliest Sht3x_ReadyAt() among sensors that are measuring or in
+    periodic mode, INT64_MAX when there is none.
+*/
+int64_t Sht3x_NextReadyAt(sht3x_t **sensors, uint8_t count);
+
+/* Blocking trigger, wait and fetch. */
+esp_err_t Sht3x_Read(sht3x_t *sensor);
+
+void Sht3x_GetStats(sht3x_t *sensor, sht3x_stats_t *stats);
+
+/* In 0.01 degC and 0.01 %RH. */
+int32_t Sht3x_GetCentiTemperature(sht3x_t *sensor);
+int32_t Sht3x_GetCentiHumidity(sht3x_t *sensor);
+
+float Sht3x_GetTemperature(sht3x_t *sensor);
+int32_t Sht3x_GetIntTemperature(sht3x_t *sensor);
+float Sht3x_GetHumidity(sht3x_t *sensor);
+int32_t Sht3x_GetIntHumidity(sht3x_t *sensor);
 
 #ifdef __cplusplus
 }
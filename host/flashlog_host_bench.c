@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "flashlog.h"
+#include "flashlog_part.h"
+
+static const char *TAG = "MY-BENCH";
+
+/*
+    flashlog_benchmark() on the host, the run CONFIG_FLASHLOG_BENCHMARK
+    does at start, on the image file port/flashlog_part_file.c keeps:
+
+        flashlog_host_bench [records]
+
+    The default fills the emulated partition once, as main.c does. The
+    rates are the host's file I/O, not flash; the bytes programmed and
+    erased per logical byte are the log's own. Exits non-zero when the
+    benchmark fails, the one-day query reads back the wrong number of
+    records, or the log programs or erases more than its layout needs:
+    a 16-byte header and an erase per segment, 8 bytes per record.
+*/
+
+#define BENCH_RECORDS_PER_SEGMENT ((FLASHLOG_SECTOR_SIZE - 16) / 8)
+
+int main(int argc, char **argv) {
+    uint32_t records = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : CONFIG_FLASHLOG_SIM_SIZE_KB * 1024 / 8;
+
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+
+    flashlog_bench_t bench;
+    esp_err_t err = flashlog_benchmark(records, &bench);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "flashlog_benchmark() failed: %s", esp_err_to_name(err));
+        return 1;
+    }
+    ESP_LOGI(TAG, "flashlog: %u appends at %u/s, query %u records at %u/s, remount %u us, programmed %u.%03u erased %u.%03u bytes per byte",
+             bench.records, bench.append_per_s, bench.query_records, bench.query_per_s, bench.mount_us,
+             bench.program_permille / 1000, bench.program_permille % 1000,
+             bench.erase_permille / 1000, bench.erase_permille % 1000);
+
+    // Records are a minute apart; the query covers the last day of them.
+    uint32_t expected = (records > 86400 / 60) ? 86400 / 60 + 1 : records;
+    int failed = 0;
+    if (bench.query_records != expected) {
+        ESP_LOGE(TAG, "one-day query read back %u records, expected %u", bench.query_records, expected);
+        failed++;
+    }
+    uint64_t segments = (records + BENCH_RECORDS_PER_SEGMENT - 1) / BENCH_RECORDS_PER_SEGMENT;
+    uint64_t logical = (uint64_t)records * sizeof(flashlog_record_t);
+    uint32_t program_permille = (uint32_t)((logical + segments * 16) * 1000 / logical);
+    uint32_t erase_permille = (uint32_t)(segments * FLASHLOG_SECTOR_SIZE * 1000 / logical);
+    if (bench.program_permille != program_permille || bench.erase_permille != erase_permille) {
+        ESP_LOGE(TAG, "programmed %u erased %u per mille, the layout needs %u and %u",
+                 bench.program_permille, bench.erase_permille, program_permille, erase_permille);
+        failed++;
+    }
+    return (failed == 0) ? 0 : 1;
+}
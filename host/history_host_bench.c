@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "history.h"
+
+static const char *TAG = "MY-BENCH";
+
+/*
+    history_benchmark() on the host, the run CONFIG_HISTORY_BENCHMARK
+    does at start:
+
+        history_host_bench [inserts]
+
+    The default is a day of readings. Exits non-zero when the benchmark
+    fails or a tier reads back a different number of buckets than the
+    readings fill.
+*/
+
+// The epoch history_benchmark() starts its readings at.
+#define BENCH_START_S (1700000000)
+
+static uint32_t bench_expected(uint32_t inserts, uint32_t period_s, uint32_t slots) {
+    uint32_t last_s = BENCH_START_S + (inserts - 1) * CONFIG_HISTORY_RAW_PERIOD_S;
+    uint32_t buckets = last_s / period_s - BENCH_START_S / period_s + 1;
+    return (buckets < slots) ? buckets : slots;
+}
+
+int main(int argc, char **argv) {
+    uint32_t inserts = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 86400 / CONFIG_HISTORY_RAW_PERIOD_S;
+
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+
+    history_bench_t bench;
+    esp_err_t err = history_benchmark(inserts, &bench);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "history_benchmark() failed: %s", esp_err_to_name(err));
+        return 1;
+    }
+    ESP_LOGI(TAG, "history: %u inserts at %u ns, query %u/%u/%u points/s (raw/mid/long)",
+             bench.inserts, bench.insert_ns, bench.query_points_per_s[0],
+             bench.query_points_per_s[1], bench.query_points_per_s[2]);
+
+    const uint32_t expected[HISTORY_TIERS] = {
+        bench_expected(inserts, CONFIG_HISTORY_RAW_PERIOD_S, CONFIG_HISTORY_RAW_SLOTS),
+        bench_expected(inserts, CONFIG_HISTORY_MID_PERIOD_S, CONFIG_HISTORY_MID_SLOTS),
+        bench_expected(inserts, CONFIG_HISTORY_LONG_PERIOD_S, CONFIG_HISTORY_LONG_SLOTS),
+    };
+    int failed = 0;
+    for (uint8_t t = 0; t < HISTORY_TIERS; t++) {
+        if (bench.query_points[t] != expected[t]) {
+            ESP_LOGE(TAG, "tier %u: read back %u buckets, expected %u", t, bench.query_points[t], expected[t]);
+            failed++;
+        }
+    }
+    return (failed == 0) ? 0 : 1;
+}
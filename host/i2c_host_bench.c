@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "m5stick.h"
+#include "i2c_sim.h"
+#include "i2c_bench.h"
+
+static const char *TAG = "MY-BENCH";
+
+/*
+    i2c_bench_run() on the host, after the same driver bring-up as
+    M5Stick_Init(). Options set the wire timing and inject faults:
+
+        i2c_host_bench [-b byte_ns] [-o overhead_us] [-f addr,nack|timeout|corrupt,every]...
+
+    Exits non-zero when the replay put nothing on the bus or addressed a
+    device no model answers.
+*/
+
+static int bench_fault(const char *arg) {
+    char kind[16] = { 0 };
+    unsigned addr = 0;
+    unsigned every = 0;
+    if (sscanf(arg, "%x,%15[a-z],%u", &addr, kind, &every) != 3) {
+        return -1;
+    }
+    i2c_sim_fault_t fault = I2C_SIM_FAULT_NONE;
+    if (strcmp(kind, "nack") == 0) {
+        fault = I2C_SIM_FAULT_NACK;
+    } else if (strcmp(kind, "timeout") == 0) {
+        fault = I2C_SIM_FAULT_TIMEOUT;
+    } else if (strcmp(kind, "corrupt") == 0) {
+        fault = I2C_SIM_FAULT_CORRUPT;
+    } else {
+        return -1;
+    }
+    return (i2c_sim_set_fault((uint8_t)addr, fault, every) == ESP_OK) ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+    uint32_t byte_ns = 0;
+    uint32_t overhead_us = 10;
+    int opt;
+
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+    esp_log_level_set("I2C-DEVICE", ESP_LOG_INFO);
+    esp_log_level_set("I2C-SIM", ESP_LOG_INFO);
+
+    while ((opt = getopt(argc, argv, "b:o:f:")) != -1) {
+        switch (opt) {
+        case 'b':
+            byte_ns = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'o':
+            overhead_us = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'f':
+            if (bench_fault(optarg) != 0) {
+                fprintf(stderr, "bad fault '%s', want addr,nack|timeout|corrupt,every\n", optarg);
+                return 2;
+            }
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-b byte_ns] [-o overhead_us] [-f addr,kind,every]...\n", argv[0]);
+            return 2;
+        }
+    }
+    i2c_sim_set_timing(byte_ns, overhead_us);
+
+    Axp192_Init();
+    PCF8563_Init();
+    if (MPU6886_Init() != 0) {
+        ESP_LOGE(TAG, "MPU6886_Init() failed");
+        return 1;
+    }
+
+    i2c_bench_run();
+
+    i2c_sim_stats_t sim;
+    i2c_sim_get_stats(&sim);
+    if (sim.transactions == 0 || sim.nacks != 0) {
+        ESP_LOGE(TAG, "replay failed: %u xfers, %u to absent devices", sim.transactions, sim.nacks);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define WORD_ALIGNED_ATTR __attribute__((aligned(4)))
@@ -0,0 +1,53 @@
+#pragma once
+
+/*
+    Configuration of the host build: the drivers on the simulated I2C
+    bus, no display, buttons, LEDs or GPIO interrupts. Values are the
+    Kconfig defaults unless noted.
+*/
+
+#define CONFIG_SOFTWARE_RTC_SUPPORT 1
+#define CONFIG_SOFTWARE_MPU6886_SUPPORT 1
+#define CONFIG_SOFTWARE_UNIT_ENV2_SUPPORT 1
+
+#ifndef CONFIG_I2C_DEVICE_CMD_POOL_SIZE
+#define CONFIG_I2C_DEVICE_CMD_POOL_SIZE 4       // the heap-only baseline builds with 0
+#endif
+#define CONFIG_I2C_TRANSFER_MAX_SEGMENTS 12
+#define CONFIG_I2C_ARB_AGING_MS 20
+#define CONFIG_I2C_STATS_DUMP_PERIOD_S 0
+#define CONFIG_I2C_BUS_SIMULATOR 1
+#define CONFIG_I2C_SIM_PCF8563_DRIFT_PPM 0
+#define CONFIG_I2C_SIM_BENCHMARK 1
+#define CONFIG_I2C_SIM_BENCHMARK_SECONDS 60
+#define CONFIG_I2C_ASYNC_QUEUE_LEN 8
+#define CONFIG_I2C_ASYNC_TASK_PRIORITY 3
+#define CONFIG_I2C_ASYNC_TASK_STACK 3072
+
+#define CONFIG_MPU6886_STREAM_RING_FRAMES 512
+#define CONFIG_MPU6886_STREAM_TASK_PRIORITY 5
+#define CONFIG_MPU6886_INT_GPIO -1              // no GPIO interrupts on the host
+
+#define CONFIG_CLOCKDISC_MAX_ERROR_MS 100
+#define CONFIG_CLOCKDISC_MIN_INTERVAL_S 1800
+#define CONFIG_CLOCKDISC_MAX_INTERVAL_S 86400
+
+#define CONFIG_HISTORY_SUPPORT 1
+#define CONFIG_HISTORY_RAW_PERIOD_S 5
+#define CONFIG_HISTORY_RAW_SLOTS 720
+#define CONFIG_HISTORY_MID_PERIOD_S 60
+#define CONFIG_HISTORY_MID_SLOTS 1440
+#define CONFIG_HISTORY_LONG_PERIOD_S 3600
+#define CONFIG_HISTORY_LONG_SLOTS 720
+
+#define CONFIG_VIBRATION_SUPPORT 1
+#define CONFIG_VIBRATION_RATE_HZ 1000
+#define CONFIG_VIBRATION_WINDOW 256
+#define CONFIG_VIBRATION_HOP 128
+#define CONFIG_VIBRATION_BAND_EDGES_HZ "0,10,50,100,200,500"
+#define CONFIG_VIBRATION_QUEUE_LEN 4
+
+#define CONFIG_FLASHLOG_SUPPORT 1
+#define CONFIG_FLASHLOG_PERIOD_S 60
+#define CONFIG_FLASHLOG_SIM 1                   // an image file, see port/flashlog_part_file.c
+#define CONFIG_FLASHLOG_SIM_SIZE_KB 64
@@ -0,0 +1,351 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "nvs.h"
+
+/* esp_timer, logging, NVS and GPIO for the host build. */
+
+static int64_t host_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t host_boot_us;
+
+__attribute__((constructor)) static void host_boot(void) {
+    host_boot_us = host_now_us();
+}
+
+int64_t esp_timer_get_time(void) {
+    return host_now_us() - host_boot_us;
+}
+
+void esp_rom_delay_us(uint32_t us) {
+    int64_t end_us = host_now_us() + us;
+    while (host_now_us() < end_us) {
+    }
+}
+
+/*
+    A timer is a thread that sleeps to each expiry; stopping or
+    restarting bumps the generation so a sleeping thread lets go.
+*/
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    bool running;
+    bool deleted;
+    uint32_t generation;
+    int64_t due_us;
+    uint64_t period_us;
+};
+
+static void *host_timer_thread(void *arg) {
+    esp_timer_handle_t timer = (esp_timer_handle_t)arg;
+    pthread_mutex_lock(&timer->lock);
+    while (!timer->deleted) {
+        if (!timer->running) {
+            pthread_cond_wait(&timer->cond, &timer->lock);
+            continue;
+        }
+        int64_t abs_us = host_boot_us + timer->due_us;
+        struct timespec deadline = {
+            .tv_sec = abs_us / 1000000,
+            .tv_nsec = (abs_us % 1000000) * 1000,
+        };
+        uint32_t generation = timer->generation;
+        pthread_cond_timedwait(&timer->cond, &timer->lock, &deadline);
+        if (!timer->running || timer->generation != generation || esp_timer_get_time() < timer->due_us) {
+            continue;
+        }
+        if (timer->period_us != 0) {
+            timer->due_us += timer->period_us;
+        } else {
+            timer->running = false;
+        }
+        pthread_mutex_unlock(&timer->lock);
+        timer->callback(timer->arg);
+        pthread_mutex_lock(&timer->lock);
+    }
+    pthread_mutex_unlock(&timer->lock);
+    free(timer);
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle) {
+    if (create_args == NULL || create_args->callback == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_timer_handle_t timer = calloc(1, sizeof(struct esp_timer));
+    if (timer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->callback = create_args->callback;
+    timer->arg = create_args->arg;
+    pthread_mutex_init(&timer->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&timer->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    if (pthread_create(&timer->thread, NULL, host_timer_thread, timer) != 0) {
+        free(timer);
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_detach(timer->thread);
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t host_timer_start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us) {
+    pthread_mutex_lock(&timer->lock);
+    if (timer->running) {
+        pthread_mutex_unlock(&timer->lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->running = true;
+    timer->generation++;
+    timer->due_us = esp_timer_get_time() + (int64_t)timeout_us;
+    timer->period_us = period_us;
+    pthread_cond_signal(&timer->cond);
+    pthread_mutex_unlock(&timer->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return host_timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    return host_timer_start(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    pthread_mutex_lock(&timer->lock);
+    esp_err_t err = timer->running ? ESP_OK : ESP_ERR_INVALID_STATE;
+    timer->running = false;
+    timer->generation++;
+    pthread_cond_signal(&timer->cond);
+    pthread_mutex_unlock(&timer->lock);
+    return err;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    pthread_mutex_lock(&timer->lock);
+    timer->deleted = true;
+    timer->running = false;
+    pthread_cond_signal(&timer->cond);
+    pthread_mutex_unlock(&timer->lock);
+    return ESP_OK;
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+    case ESP_ERR_NOT_FINISHED: return "ESP_ERR_NOT_FINISHED";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+#define HOST_LOG_TAGS (32)
+
+typedef struct {
+    char tag[24];
+    esp_log_level_t level;
+} host_log_tag_t;
+
+static host_log_tag_t host_log_tags[HOST_LOG_TAGS];
+static esp_log_level_t host_log_default = ESP_LOG_INFO;
+static pthread_mutex_t host_log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level) {
+    pthread_mutex_lock(&host_log_lock);
+    if (strcmp(tag, "*") == 0) {
+        host_log_default = level;
+        memset(host_log_tags, 0, sizeof(host_log_tags));
+    } else {
+        for (int i = 0; i < HOST_LOG_TAGS; i++) {
+            if (host_log_tags[i].tag[0] == '\0' || strcmp(host_log_tags[i].tag, tag) == 0) {
+                snprintf(host_log_tags[i].tag, sizeof(host_log_tags[i].tag), "%s", tag);
+                host_log_tags[i].level = level;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&host_log_lock);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+    pthread_mutex_lock(&host_log_lock);
+    esp_log_level_t limit = host_log_default;
+    for (int i = 0; i < HOST_LOG_TAGS && host_log_tags[i].tag[0] != '\0'; i++) {
+        if (strcmp(host_log_tags[i].tag, tag) == 0) {
+            limit = host_log_tags[i].level;
+            break;
+        }
+    }
+    if (level <= limit) {
+        va_list args;
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+        fflush(stdout);
+    }
+    pthread_mutex_unlock(&host_log_lock);
+}
+
+/*
+    NVS as a small table of blobs keyed by namespace and key. The handle
+    is the namespace index plus one.
+*/
+#define HOST_NVS_NAMESPACES (8)
+#define HOST_NVS_ENTRIES (16)
+
+typedef struct {
+    uint8_t ns;
+    char key[16];
+    void *value;
+    size_t length;
+} host_nvs_entry_t;
+
+static char host_nvs_namespaces[HOST_NVS_NAMESPACES][16];
+static host_nvs_entry_t host_nvs_entries[HOST_NVS_ENTRIES];
+static pthread_mutex_t host_nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    pthread_mutex_lock(&host_nvs_lock);
+    for (int i = 0; i < HOST_NVS_NAMESPACES; i++) {
+        if (strcmp(host_nvs_namespaces[i], name) == 0
+            || (host_nvs_namespaces[i][0] == '\0' && open_mode == NVS_READWRITE)) {
+            snprintf(host_nvs_namespaces[i], sizeof(host_nvs_namespaces[i]), "%s", name);
+            *out_handle = i + 1;
+            err = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&host_nvs_lock);
+    return err;
+}
+
+void nvs_close(nvs_handle_t handle) {
+}
+
+static host_nvs_entry_t *host_nvs_find(nvs_handle_t handle, const char *key) {
+    for (int i = 0; i < HOST_NVS_ENTRIES; i++) {
+        if (host_nvs_entries[i].value != NULL && host_nvs_entries[i].ns == handle
+            && strcmp(host_nvs_entries[i].key, key) == 0) {
+            return &host_nvs_entries[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    pthread_mutex_lock(&host_nvs_lock);
+    host_nvs_entry_t *entry = host_nvs_find(handle, key);
+    if (entry != NULL) {
+        if (out_value == NULL) {
+            *length = entry->length;
+            err = ESP_OK;
+        } else if (*length < entry->length) {
+            err = ESP_ERR_NVS_INVALID_LENGTH;
+        } else {
+            memcpy(out_value, entry->value, entry->length);
+            *length = entry->length;
+            err = ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&host_nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    esp_err_t err = ESP_ERR_NVS_NO_FREE_PAGES;
+    pthread_mutex_lock(&host_nvs_lock);
+    host_nvs_entry_t *entry = host_nvs_find(handle, key);
+    for (int i = 0; entry == NULL && i < HOST_NVS_ENTRIES; i++) {
+        if (host_nvs_entries[i].value == NULL) {
+            entry = &host_nvs_entries[i];
+        }
+    }
+    if (entry != NULL) {
+        void *copy = malloc(length ? length : 1);
+        if (copy != NULL) {
+            memcpy(copy, value, length);
+            free(entry->value);
+            entry->ns = (uint8_t)handle;
+            snprintf(entry->key, sizeof(entry->key), "%s", key);
+            entry->value = copy;
+            entry->length = length;
+            err = ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&host_nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    pthread_mutex_lock(&host_nvs_lock);
+    host_nvs_entry_t *entry = host_nvs_find(handle, key);
+    if (entry != NULL) {
+        free(entry->value);
+        memset(entry, 0, sizeof(*entry));
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&host_nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num) {
+    return ESP_OK;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
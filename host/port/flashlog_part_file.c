@@ -0,0 +1,110 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "flashlog_part.h"
+
+/*
+    The log partition for the host build: an image file with the NOR
+    semantics of the RAM image in main/flashlog_part.c, named by
+    $FLASHLOG_IMAGE (default flashlog.img). It outlives the process, so
+    a later run mounts what an earlier one wrote; an image of the wrong
+    size is erased.
+*/
+
+#define FLASHLOG_PART_DEFAULT_IMAGE "flashlog.img"
+
+static const char *TAG = "MY-FLOG";
+
+static int flashlog_file_fd = -1;
+static uint32_t flashlog_file_size;
+static size_t flashlog_file_tear = SIZE_MAX;
+
+void flashlog_sim_tear_next_write(size_t bytes) {
+    flashlog_file_tear = bytes;
+}
+
+static esp_err_t flashlog_file_fill(uint32_t offset, size_t length) {
+    uint8_t erased[FLASHLOG_SECTOR_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    for (size_t done = 0; done < length; done += sizeof(erased)) {
+        size_t chunk = (length - done < sizeof(erased)) ? length - done : sizeof(erased);
+        if (pwrite(flashlog_file_fd, erased, chunk, offset + done) != (ssize_t)chunk) {
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t flashlog_part_open(uint32_t *size) {
+    if (flashlog_file_fd < 0) {
+        const char *path = getenv("FLASHLOG_IMAGE");
+        if (path == NULL || *path == '\0') {
+            path = FLASHLOG_PART_DEFAULT_IMAGE;
+        }
+        flashlog_file_fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (flashlog_file_fd < 0) {
+            ESP_LOGE(TAG, "cannot open %s", path);
+            return ESP_ERR_NOT_FOUND;
+        }
+        flashlog_file_size = CONFIG_FLASHLOG_SIM_SIZE_KB * 1024;
+        struct stat st;
+        if (fstat(flashlog_file_fd, &st) != 0 || st.st_size != flashlog_file_size) {
+            if (ftruncate(flashlog_file_fd, flashlog_file_size) != 0
+                || flashlog_file_fill(0, flashlog_file_size) != ESP_OK) {
+                close(flashlog_file_fd);
+                flashlog_file_fd = -1;
+                return ESP_FAIL;
+            }
+        }
+    }
+    *size = flashlog_file_size;
+    return ESP_OK;
+}
+
+esp_err_t flashlog_part_read(uint32_t offset, void *data, size_t length) {
+    if (offset + length > flashlog_file_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return (pread(flashlog_file_fd, data, length, offset) == (ssize_t)length) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t flashlog_part_write(uint32_t offset, const void *data, size_t length) {
+    if (offset + length > flashlog_file_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // Programming only clears bits: merge with what is there.
+    uint8_t cells[FLASHLOG_SECTOR_SIZE];
+    size_t programmed = (length < flashlog_file_tear) ? length : flashlog_file_tear;
+    const uint8_t *src = data;
+    for (size_t done = 0; done < programmed; done += sizeof(cells)) {
+        size_t chunk = (programmed - done < sizeof(cells)) ? programmed - done : sizeof(cells);
+        if (pread(flashlog_file_fd, cells, chunk, offset + done) != (ssize_t)chunk) {
+            return ESP_FAIL;
+        }
+        for (size_t i = 0; i < chunk; i++) {
+            cells[i] &= src[done + i];
+        }
+        if (pwrite(flashlog_file_fd, cells, chunk, offset + done) != (ssize_t)chunk) {
+            return ESP_FAIL;
+        }
+    }
+    if (programmed < length) {
+        flashlog_file_tear = SIZE_MAX;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t flashlog_part_erase(uint32_t offset, size_t length) {
+    if ((offset % FLASHLOG_SECTOR_SIZE) != 0 || (length % FLASHLOG_SECTOR_SIZE) != 0
+        || offset + length > flashlog_file_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return flashlog_file_fill(offset, length);
+}
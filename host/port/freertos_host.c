@@ -0,0 +1,457 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+
+#include "esp_timer.h"
+
+/*
+    Tasks are detached threads with a control block for their
+    notification. Blocking calls wait on condition variables against
+    CLOCK_MONOTONIC, the clock esp_timer_get_time() reads too.
+*/
+
+struct tskTaskControlBlock {
+    pthread_t thread;
+    TaskFunction_t function;
+    void *arg;
+    char name[16];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify_value;
+    bool notify_pending;
+};
+
+typedef enum {
+    HOST_SEM_BINARY = 0,
+    HOST_SEM_COUNTING,
+    HOST_SEM_MUTEX,
+    HOST_SEM_RECURSIVE,
+    HOST_QUEUE,
+} host_sem_type_t;
+
+/* Semaphores and queues, as in FreeRTOS; count is the items waiting. */
+struct QueueDefinition {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    host_sem_type_t type;
+    bool is_static;
+    UBaseType_t count;
+    UBaseType_t max_count;
+    TaskHandle_t holder;
+    UBaseType_t depth;
+    uint8_t *items;
+    UBaseType_t item_size;
+    UBaseType_t head;
+};
+
+_Static_assert(sizeof(struct QueueDefinition) <= sizeof(StaticSemaphore_t), "StaticSemaphore_t too small");
+
+static pthread_mutex_t host_critical_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static __thread TaskHandle_t host_current_task;
+
+void vPortEnterCritical(portMUX_TYPE *mux) {
+    pthread_mutex_lock(&host_critical_lock);
+}
+
+void vPortExitCritical(portMUX_TYPE *mux) {
+    pthread_mutex_unlock(&host_critical_lock);
+}
+
+static void host_cond_init(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void host_deadline(TickType_t ticks, struct timespec *deadline) {
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    uint64_t ns = (uint64_t)ticks * portTICK_PERIOD_MS * 1000000ULL + (uint64_t)deadline->tv_nsec;
+    deadline->tv_sec += ns / 1000000000ULL;
+    deadline->tv_nsec = ns % 1000000000ULL;
+}
+
+/* Waits on cond until done() or the ticks run out; lock is held. */
+static bool host_wait(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks,
+                      bool (*done)(void *ctx), void *ctx) {
+    if (ticks == portMAX_DELAY) {
+        while (!done(ctx)) {
+            pthread_cond_wait(cond, lock);
+        }
+        return true;
+    }
+    struct timespec deadline;
+    host_deadline(ticks, &deadline);
+    while (!done(ctx)) {
+        if (pthread_cond_timedwait(cond, lock, &deadline) == ETIMEDOUT) {
+            return done(ctx);
+        }
+    }
+    return true;
+}
+
+static TaskHandle_t host_task_alloc(const char *name) {
+    TaskHandle_t task = calloc(1, sizeof(struct tskTaskControlBlock));
+    if (task == NULL) {
+        return NULL;
+    }
+    snprintf(task->name, sizeof(task->name), "%s", name);
+    pthread_mutex_init(&task->lock, NULL);
+    host_cond_init(&task->cond);
+    return task;
+}
+
+static void *host_task_entry(void *arg) {
+    TaskHandle_t task = (TaskHandle_t)arg;
+    host_current_task = task;
+    pthread_setname_np(pthread_self(), task->name);
+    task->function(task->arg);
+    // A FreeRTOS task must not return; treat it as vTaskDelete(NULL).
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *created_task, BaseType_t core_id) {
+    TaskHandle_t task = host_task_alloc(name);
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    task->function = function;
+    task->arg = arg;
+    // Published before the thread runs, as the task may look itself up.
+    if (created_task != NULL) {
+        *created_task = task;
+    }
+    if (pthread_create(&task->thread, NULL, host_task_entry, task) != 0) {
+        if (created_task != NULL) {
+            *created_task = NULL;
+        }
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *created_task) {
+    return xTaskCreatePinnedToCore(function, name, stack_depth, arg, priority, created_task, tskNO_AFFINITY);
+}
+
+/*
+    The control block is never freed: a deleted task's handle may still
+    be notified, as on the target until its TCB is reused.
+*/
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == host_current_task) {
+        pthread_exit(NULL);
+    }
+    pthread_cancel(task->thread);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    if (host_current_task == NULL) {
+        // The main thread, or any thread not made by xTaskCreate().
+        host_current_task = host_task_alloc("main");
+        host_current_task->thread = pthread_self();
+    }
+    return host_current_task;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(esp_timer_get_time() / (portTICK_PERIOD_MS * 1000));
+}
+
+static void host_sleep_until_tick(TickType_t tick) {
+    int64_t wake_us = (int64_t)tick * portTICK_PERIOD_MS * 1000;
+    int64_t now_us = esp_timer_get_time();
+    if (wake_us > now_us) {
+        struct timespec ts = {
+            .tv_sec = (wake_us - now_us) / 1000000,
+            .tv_nsec = ((wake_us - now_us) % 1000000) * 1000,
+        };
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+        }
+    }
+}
+
+void vTaskDelay(TickType_t ticks) {
+    if (ticks == 0) {
+        sched_yield();
+        return ;
+    }
+    // Like the target, a delay ends on a tick edge.
+    host_sleep_until_tick(xTaskGetTickCount() + ticks);
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t increment) {
+    *previous_wake += increment;
+    host_sleep_until_tick(*previous_wake);
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    BaseType_t ret = pdPASS;
+    pthread_mutex_lock(&task->lock);
+    switch (action) {
+    case eSetBits:
+        task->notify_value |= value;
+        break;
+    case eIncrement:
+        task->notify_value++;
+        break;
+    case eSetValueWithOverwrite:
+        task->notify_value = value;
+        break;
+    case eSetValueWithoutOverwrite:
+        if (task->notify_pending) {
+            ret = pdFAIL;
+        } else {
+            task->notify_value = value;
+        }
+        break;
+    case eNoAction:
+        break;
+    }
+    task->notify_pending = true;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return ret;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken) {
+    xTaskNotify(task, 0, eIncrement);
+    if (higher_priority_task_woken != NULL) {
+        *higher_priority_task_woken = pdFALSE;
+    }
+}
+
+static bool host_notify_counted(void *ctx) {
+    return ((TaskHandle_t)ctx)->notify_value != 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&task->lock);
+    host_wait(&task->cond, &task->lock, ticks_to_wait, host_notify_counted, task);
+    uint32_t value = task->notify_value;
+    if (value != 0) {
+        task->notify_value = clear_on_exit ? 0 : value - 1;
+    }
+    task->notify_pending = false;
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+static bool host_notify_pending(void *ctx) {
+    return ((TaskHandle_t)ctx)->notify_pending;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks_to_wait) {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&task->lock);
+    if (!task->notify_pending) {
+        task->notify_value &= ~clear_on_entry;
+    }
+    bool notified = host_wait(&task->cond, &task->lock, ticks_to_wait, host_notify_pending, task);
+    if (value != NULL) {
+        *value = task->notify_value;
+    }
+    if (notified) {
+        task->notify_value &= ~clear_on_exit;
+        task->notify_pending = false;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return notified ? pdTRUE : pdFALSE;
+}
+
+static SemaphoreHandle_t host_sem_init(SemaphoreHandle_t sem, host_sem_type_t type, UBaseType_t max_count, UBaseType_t count) {
+    if (sem == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&sem->lock, NULL);
+    host_cond_init(&sem->cond);
+    sem->type = type;
+    sem->max_count = max_count;
+    sem->count = count;
+    sem->holder = NULL;
+    sem->depth = 0;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return host_sem_init(calloc(1, sizeof(struct QueueDefinition)), HOST_SEM_BINARY, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer) {
+    SemaphoreHandle_t sem = host_sem_init((SemaphoreHandle_t)buffer, HOST_SEM_BINARY, 1, 0);
+    sem->is_static = true;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return host_sem_init(calloc(1, sizeof(struct QueueDefinition)), HOST_SEM_MUTEX, 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer) {
+    SemaphoreHandle_t sem = host_sem_init((SemaphoreHandle_t)buffer, HOST_SEM_MUTEX, 1, 1);
+    sem->is_static = true;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) {
+    return host_sem_init(calloc(1, sizeof(struct QueueDefinition)), HOST_SEM_RECURSIVE, 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+    return host_sem_init(calloc(1, sizeof(struct QueueDefinition)), HOST_SEM_COUNTING, max_count, initial_count);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->lock);
+    if (!sem->is_static) {
+        free(sem);
+    }
+}
+
+static bool host_sem_available(void *ctx) {
+    return ((SemaphoreHandle_t)ctx)->count > 0;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait) {
+    pthread_mutex_lock(&sem->lock);
+    bool taken = host_wait(&sem->cond, &sem->lock, ticks_to_wait, host_sem_available, sem);
+    if (taken) {
+        sem->count--;
+        sem->holder = xTaskGetCurrentTaskHandle();
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return taken ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    BaseType_t ret = pdFALSE;
+    pthread_mutex_lock(&sem->lock);
+    if (sem->count < sem->max_count) {
+        sem->count++;
+        sem->holder = NULL;
+        ret = pdTRUE;
+        pthread_cond_signal(&sem->cond);
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ret;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks_to_wait) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&sem->lock);
+    if (sem->holder == self && sem->depth > 0) {
+        sem->depth++;
+        pthread_mutex_unlock(&sem->lock);
+        return pdTRUE;
+    }
+    bool taken = host_wait(&sem->cond, &sem->lock, ticks_to_wait, host_sem_available, sem);
+    if (taken) {
+        sem->count--;
+        sem->holder = self;
+        sem->depth = 1;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return taken ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem) {
+    BaseType_t ret = pdFALSE;
+    pthread_mutex_lock(&sem->lock);
+    if (sem->holder == xTaskGetCurrentTaskHandle() && sem->depth > 0) {
+        if (--sem->depth == 0) {
+            sem->holder = NULL;
+            sem->count++;
+            pthread_cond_signal(&sem->cond);
+        }
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ret;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    QueueHandle_t queue = host_sem_init(calloc(1, sizeof(struct QueueDefinition)), HOST_QUEUE, length, 0);
+    if (queue == NULL) {
+        return NULL;
+    }
+    queue->items = malloc((size_t)length * item_size);
+    if (queue->items == NULL) {
+        vSemaphoreDelete(queue);
+        return NULL;
+    }
+    queue->item_size = item_size;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    free(queue->items);
+    vSemaphoreDelete(queue);
+}
+
+static bool host_queue_has_space(void *ctx) {
+    QueueHandle_t queue = (QueueHandle_t)ctx;
+    return queue->count < queue->max_count;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait) {
+    pthread_mutex_lock(&queue->lock);
+    bool sent = host_wait(&queue->cond, &queue->lock, ticks_to_wait, host_queue_has_space, queue);
+    if (sent) {
+        UBaseType_t tail = (queue->head + queue->count) % queue->max_count;
+        memcpy(queue->items + (size_t)tail * queue->item_size, item, queue->item_size);
+        queue->count++;
+        // Senders and receivers share the condition.
+        pthread_cond_broadcast(&queue->cond);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return sent ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks_to_wait) {
+    pthread_mutex_lock(&queue->lock);
+    bool received = host_wait(&queue->cond, &queue->lock, ticks_to_wait, host_sem_available, queue);
+    if (received) {
+        memcpy(item, queue->items + (size_t)queue->head * queue->item_size, queue->item_size);
+        queue->head = (queue->head + 1) % queue->max_count;
+        queue->count--;
+        pthread_cond_broadcast(&queue->cond);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return received ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->head = 0;
+    queue->count = 0;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
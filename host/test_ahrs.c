@@ -0,0 +1,126 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "esp_log.h"
+#include "mpu6886.h"
+#include "ahrs.h"
+
+/*
+    Ahrs_Benchmark() on a recording of known motion: the board tumbles
+    about all three axes for a minute at 200 Hz with sensor noise, a gyro
+    bias and timestamp jitter. The fixed-point filter must stay within
+    TEST_MAX_DIVERGENCE_DEG of the float reference, with and without
+    bias estimation; the float filter must follow the true tilt, or the
+    recording exercises nothing.
+*/
+
+#define TEST_RATE_HZ (200)
+#define TEST_SECONDS (60)
+#define TEST_MAX_DIVERGENCE_DEG (0.5f)
+#define TEST_MAX_TILT_ERROR_DEG (5.0f)
+
+static uint32_t test_seed = 1;
+
+static int32_t test_noise(int32_t range) {
+    test_seed = test_seed * 1103515245 + 12345;
+    return (int32_t)((test_seed >> 8) % (2 * (uint32_t)range + 1)) - range;
+}
+
+static int16_t test_counts(float value, float res, int32_t noise) {
+    float counts = value / res + (float)test_noise(noise);
+    return (int16_t)fmaxf(-32768.0f, fminf(32767.0f, roundf(counts)));
+}
+
+static void test_rotate(float q[4], const float w[3], float dt) {
+    float qw = q[0], qx = q[1], qy = q[2], qz = q[3];
+    q[0] += 0.5f * dt * (-qx * w[0] - qy * w[1] - qz * w[2]);
+    q[1] += 0.5f * dt * (qw * w[0] + qy * w[2] - qz * w[1]);
+    q[2] += 0.5f * dt * (qw * w[1] - qx * w[2] + qz * w[0]);
+    q[3] += 0.5f * dt * (qw * w[2] + qx * w[1] - qy * w[0]);
+    float norm = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    for (int i = 0; i < 4; i++) {
+        q[i] /= norm;
+    }
+}
+
+/* Synthesizes the recording; truth gets the attitude at the last frame. */
+static void test_record(mpu6886_frame_t *frames, uint32_t count, ahrs_quat_t *truth) {
+    const float pi = 3.14159265358979f;
+    const float deg = pi / 180.0f;
+    float acc_res, gyro_res;
+    MPU6886_GetResolution(&acc_res, &gyro_res);
+    float q[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+    int64_t timestamp_us = 1000000;
+    for (uint32_t i = 0; i < count; i++) {
+        float t = (float)i / TEST_RATE_HZ;
+        float w[3] = {
+            60.0f * deg * sinf(2.0f * pi * 0.30f * t),
+            45.0f * deg * sinf(2.0f * pi * 0.17f * t + 1.0f),
+            90.0f * deg * sinf(2.0f * pi * 0.05f * t),
+        };
+        test_rotate(q, w, 1.0f / TEST_RATE_HZ);
+        // Gravity in the body frame, in g.
+        float g[3] = {
+            2.0f * (q[1] * q[3] - q[0] * q[2]),
+            2.0f * (q[0] * q[1] + q[2] * q[3]),
+            q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3],
+        };
+        timestamp_us += 1000000 / TEST_RATE_HZ + test_noise(200);
+        frames[i].timestamp_us = timestamp_us;
+        frames[i].temp = 326 * 3;
+        for (int axis = 0; axis < 3; axis++) {
+            frames[i].accel[axis] = test_counts(g[axis], acc_res, 40);
+            frames[i].gyro[axis] = test_counts(w[axis] / deg + 0.5f, gyro_res, 8);
+        }
+    }
+    truth->w = q[0];
+    truth->x = q[1];
+    truth->y = q[2];
+    truth->z = q[3];
+}
+
+static int test_run(const mpu6886_frame_t *frames, uint32_t count, const ahrs_quat_t *truth, float kp, float ki) {
+    ahrs_bench_t bench;
+    Ahrs_Benchmark(frames, count, kp, ki, &bench);
+
+    ahrs_float_t ref;
+    ahrs_quat_t quat;
+    ahrs_euler_t euler, truth_euler;
+    Ahrs_FloatInit(&ref, kp, ki);
+    for (uint32_t i = 0; i < count; i++) {
+        Ahrs_FloatUpdate(&ref, &frames[i]);
+    }
+    Ahrs_FloatGetQuat(&ref, &quat);
+    Ahrs_QuatToEuler(&quat, &euler);
+    Ahrs_QuatToEuler(truth, &truth_euler);
+    float tilt_error = fmaxf(fabsf(euler.roll - truth_euler.roll), fabsf(euler.pitch - truth_euler.pitch));
+
+    int ok = (bench.max_error_deg <= TEST_MAX_DIVERGENCE_DEG && tilt_error <= TEST_MAX_TILT_ERROR_DEG);
+    printf("%s: kp %.2f ki %.2f, %u frames: float %.2f us, fixed %.2f us, divergence max %.3f deg, final %.3f deg, tilt error %.2f deg\n",
+           ok ? "ok" : "FAIL", kp, ki, bench.frames, bench.float_us, bench.fixed_us,
+           bench.max_error_deg, bench.final_error_deg, tilt_error);
+    return ok ? 0 : 1;
+}
+
+int main(void) {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    // Sets the full-scale ranges the filters take their scale from.
+    if (MPU6886_Init() != 0) {
+        printf("FAIL: MPU6886_Init()\n");
+        return 1;
+    }
+
+    const uint32_t count = TEST_RATE_HZ * TEST_SECONDS;
+    mpu6886_frame_t *frames = malloc(count * sizeof(mpu6886_frame_t));
+    if (frames == NULL) {
+        return 1;
+    }
+    ahrs_quat_t truth;
+    test_record(frames, count, &truth);
+
+    int failed = test_run(frames, count, &truth, AHRS_DEFAULT_KP, AHRS_DEFAULT_KI);
+    failed += test_run(frames, count, &truth, AHRS_DEFAULT_KP, 0.1f);
+    free(frames);
+    return (failed == 0) ? 0 : 1;
+}
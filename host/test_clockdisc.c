@@ -0,0 +1,32 @@
+#include <stdio.h>
+
+#include "clockdisc.h"
+
+/*
+    ClockDisc_Simulate() over the oscillators the CONFIG_CLOCKDISC_SIM_DEMO
+    block in main.c runs: every sync interval the discipline picks must
+    keep the prediction error within the budget it was given.
+*/
+
+#define TEST_DAYS (30)
+#define TEST_MAX_ERROR_MS (100)
+
+int main(void) {
+    // drift, wander per hour (ppb), reading jitter (us)
+    static const int32_t oscillators[][3] = {
+        { 20000, 0, 5000 }, { -35000, 0, 5000 }, { 20000, 300, 5000 }, { 5000, 100, 20000 },
+    };
+    int failed = 0;
+    for (unsigned i = 0; i < sizeof(oscillators) / sizeof(oscillators[0]); i++) {
+        clockdisc_sim_t sim;
+        ClockDisc_Simulate(oscillators[i][0], oscillators[i][1], oscillators[i][2], TEST_DAYS, TEST_MAX_ERROR_MS, &sim);
+        int ok = (sim.syncs > 0 && sim.max_error_us <= (uint32_t)TEST_MAX_ERROR_MS * 1000);
+        printf("%s: %d ppb, wander %d ppb/h, jitter %d us: %u syncs, mean %u s apart, max error %u us, estimate %d ppb\n",
+               ok ? "ok" : "FAIL", oscillators[i][0], oscillators[i][1], oscillators[i][2],
+               sim.syncs, sim.mean_interval_s, sim.max_error_us, sim.freq_ppb);
+        if (!ok) {
+            failed++;
+        }
+    }
+    return (failed == 0) ? 0 : 1;
+}
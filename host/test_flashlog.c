@@ -0,0 +1,141 @@
+#include <stdio.h>
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "flashlog.h"
+#include "flashlog_part.h"
+
+/*
+    Power cuts in the flash log, made with flashlog_sim_tear_next_write():
+    a record write torn after three bytes and a segment header write torn
+    after its magic and sequence number, each followed by a remount. The torn record must be
+    counted as corrupt and skipped by range queries, appends must resume
+    after it, and a torn header must cost its segment but no records.
+*/
+
+#define TEST_START_S (1700000000)
+#define TEST_TORN (100)                                         // the record torn
+#define TEST_RECORDS_PER_SEGMENT ((FLASHLOG_SECTOR_SIZE - 16) / 8)
+
+static uint32_t test_time(uint32_t i) {
+    return TEST_START_S + i * 60;
+}
+
+static esp_err_t test_append(uint32_t i) {
+    flashlog_record_t record = {
+        .time_s = test_time(i),
+        .values = { 2300 + (int16_t)(i % 100), 4500 - (int16_t)(i % 100) },
+    };
+    return flashlog_append(&record);
+}
+
+static esp_err_t test_append_range(uint32_t first, uint32_t last) {
+    for (uint32_t i = first; i <= last; i++) {
+        esp_err_t err = test_append(i);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t test_remount(flashlog_stats_t *stats) {
+    flashlog_deinit();
+    esp_err_t err = flashlog_init();
+    flashlog_get_stats(stats);
+    return err;
+}
+
+/*
+    Reads [first, last] and checks it returns every record in it but the
+    torn one, in order and with its values.
+*/
+static int test_query(uint32_t first, uint32_t last) {
+    static flashlog_iter_t it;
+    flashlog_record_t record;
+    uint32_t expected = first, count = 0;
+    bool ok = (flashlog_iter_init(&it, test_time(first), test_time(last)) == ESP_OK);
+    while (ok && flashlog_iter_next(&it, &record)) {
+        if (expected == TEST_TORN) {
+            expected++;
+        }
+        ok = (record.time_s == test_time(expected) && record.values[0] == 2300 + (int16_t)(expected % 100));
+        expected++;
+        count++;
+    }
+    uint32_t want = last - first + 1 - ((first <= TEST_TORN && TEST_TORN <= last) ? 1 : 0);
+    ok = ok && (count == want);
+    printf("%s: query records %u..%u: %u of %u\n", ok ? "ok" : "FAIL", first, last, count, want);
+    return ok ? 0 : 1;
+}
+
+static int test_torn_record(void) {
+    flashlog_stats_t stats;
+    esp_err_t err = test_append_range(0, TEST_TORN - 1);
+    // dt_s and one value byte reach the flash; flags and crc stay erased.
+    flashlog_sim_tear_next_write(3);
+    esp_err_t torn = test_append(TEST_TORN);
+    if (err == ESP_OK) {
+        err = test_append(TEST_TORN + 1);
+    }
+    if (err == ESP_OK) {
+        err = test_remount(&stats);
+    }
+    int ok = (err == ESP_OK && torn != ESP_OK && stats.corrupt == 1 && stats.tail_records == TEST_TORN + 2
+              && stats.newest_s == test_time(TEST_TORN + 1));
+    printf("%s: torn record: append %s, after remount %u corrupt of %u tail records\n",
+           ok ? "ok" : "FAIL", esp_err_to_name(torn), stats.corrupt, stats.tail_records);
+    if (!ok) {
+        return 1;
+    }
+
+    err = test_append(TEST_TORN + 2);
+    flashlog_get_stats(&stats);
+    ok = (err == ESP_OK && stats.records == 1 && stats.newest_s == test_time(TEST_TORN + 2));
+    printf("%s: append after the torn record: %s\n", ok ? "ok" : "FAIL", esp_err_to_name(err));
+    int failed = ok ? 0 : 1;
+    failed += test_query(TEST_TORN - 2, TEST_TORN + 2);
+    // Starting on the torn record itself lands on the next one.
+    failed += test_query(TEST_TORN, TEST_TORN + 1);
+    return failed;
+}
+
+static int test_torn_header(void) {
+    flashlog_stats_t stats;
+    // Fill the first segment; the next append opens a new one.
+    uint32_t next = TEST_RECORDS_PER_SEGMENT;
+    esp_err_t err = test_append_range(TEST_TORN + 3, next - 1);
+    flashlog_sim_tear_next_write(8);
+    if (err == ESP_OK) {
+        err = test_append(next);
+    }
+    flashlog_get_stats(&stats);
+    int ok = (err == ESP_OK && stats.segments_retired == 1 && stats.segments_used == 2);
+    printf("%s: torn header: append %s, %u segments retired, %u used\n",
+           ok ? "ok" : "FAIL", esp_err_to_name(err), stats.segments_retired, stats.segments_used);
+    if (!ok) {
+        return 1;
+    }
+
+    err = test_remount(&stats);
+    if (err == ESP_OK) {
+        err = test_append(next + 1);
+    }
+    flashlog_get_stats(&stats);
+    ok = (err == ESP_OK && stats.segments_used == 2 && stats.corrupt == 0 && stats.newest_s == test_time(next + 1));
+    printf("%s: after remount: append %s, %u segments used, %u corrupt\n",
+           ok ? "ok" : "FAIL", esp_err_to_name(err), stats.segments_used, stats.corrupt);
+    return (ok ? 0 : 1) + test_query(0, next + 1);
+}
+
+int main(void) {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    if (flashlog_init() != ESP_OK || flashlog_format() != ESP_OK) {
+        printf("FAIL: flashlog_init()\n");
+        return 1;
+    }
+    int failed = test_torn_record();
+    failed += test_torn_header();
+    flashlog_deinit();
+    return (failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "vibration.h"
+
+/*
+    vibration_analyze() on synthetic windows at CONFIG_VIBRATION_RATE_HZ:
+    the band energies must match a direct DFT of the same Hann-windowed,
+    mean-removed samples, one band over every bin must add up to the rms
+    squared, as vibration.h promises, and a window must take well under
+    the hop it has to keep up with. The time is the host's; the board
+    reports its own in vibration_get_stats().
+*/
+
+#define TEST_RATE_HZ (CONFIG_VIBRATION_RATE_HZ)
+#define TEST_MAX_BAND_ERROR (1e-4)      // of the mean square
+#define TEST_MAX_SUM_ERROR (1e-4)
+#define TEST_TIMED_WINDOWS (2000)
+
+static float test_samples[3][VIBRATION_WINDOW];
+
+static uint32_t test_seed = 1;
+
+static float test_noise(float amplitude) {
+    test_seed = test_seed * 1103515245 + 12345;
+    return amplitude * ((float)((test_seed >> 8) & 0xffff) / 32768.0f - 1.0f);
+}
+
+/* Gravity and an off-bin tone on x, two tones on y, noise on z. */
+static void test_fill(void) {
+    const double pi = 3.14159265358979;
+    for (uint32_t n = 0; n < VIBRATION_WINDOW; n++) {
+        double t = (double)n / TEST_RATE_HZ;
+        test_samples[0][n] = (float)(1.0 + 0.5 * sin(2.0 * pi * 37.3 * t + 0.4));
+        test_samples[1][n] = (float)(0.2 * sin(2.0 * pi * 120.0 * t) + 0.1 * sin(2.0 * pi * 8.0 * t + 1.0));
+        test_samples[2][n] = 0.05f + test_noise(0.3f);
+    }
+}
+
+static double test_mean(const float *x) {
+    double mean = 0.0;
+    for (uint32_t n = 0; n < VIBRATION_WINDOW; n++) {
+        mean += x[n];
+    }
+    return mean / VIBRATION_WINDOW;
+}
+
+static double test_mean_square(const float *x) {
+    double mean = test_mean(x), sum_sq = 0.0;
+    for (uint32_t n = 0; n < VIBRATION_WINDOW; n++) {
+        sum_sq += (x[n] - mean) * (x[n] - mean);
+    }
+    return sum_sq / VIBRATION_WINDOW;
+}
+
+/* One-sided power of bin k the slow way, of the Hann-windowed, mean-removed samples. */
+static double test_dft_power(const float *x, uint32_t k) {
+    const double pi = 3.14159265358979;
+    double mean = test_mean(x);
+    double re = 0.0, im = 0.0, window_power = 0.0;
+    for (uint32_t n = 0; n < VIBRATION_WINDOW; n++) {
+        double w = 0.5 - 0.5 * cos(2.0 * pi * n / VIBRATION_WINDOW);
+        double v = (x[n] - mean) * w;
+        re += v * cos(2.0 * pi * k * n / VIBRATION_WINDOW);
+        im -= v * sin(2.0 * pi * k * n / VIBRATION_WINDOW);
+        window_power += w * w;
+    }
+    double power = (re * re + im * im) / (VIBRATION_WINDOW * window_power);
+    return (k == 0 || k == VIBRATION_WINDOW / 2) ? power : 2.0 * power;
+}
+
+static uint32_t test_bin(uint16_t edge_hz) {
+    uint32_t bin = ((uint32_t)edge_hz * VIBRATION_WINDOW + TEST_RATE_HZ / 2) / TEST_RATE_HZ;
+    return (bin > VIBRATION_WINDOW / 2 + 1) ? VIBRATION_WINDOW / 2 + 1 : bin;
+}
+
+static int test_bands(const uint16_t *edges, uint8_t count) {
+    vibration_features_t features;
+    if (vibration_set_bands(edges, count) != ESP_OK ||
+        vibration_analyze(test_samples, TEST_RATE_HZ, &features) != ESP_OK) {
+        printf("FAIL: vibration_analyze()\n");
+        return 1;
+    }
+    int failed = 0;
+    for (uint8_t axis = 0; axis < 3; axis++) {
+        // The DFT's share of each band, of the mean square.
+        double spectrum = 0.0;
+        for (uint32_t k = 0; k <= VIBRATION_WINDOW / 2; k++) {
+            spectrum += test_dft_power(test_samples[axis], k);
+        }
+        double mean_square = test_mean_square(test_samples[axis]);
+        double sum = 0.0, max_error = 0.0;
+        for (uint8_t b = 0; b < count - 1; b++) {
+            double expected = 0.0;
+            for (uint32_t k = test_bin(edges[b]); k < test_bin(edges[b + 1]); k++) {
+                expected += test_dft_power(test_samples[axis], k);
+            }
+            expected *= mean_square / spectrum;
+            max_error = fmax(max_error, fabs(features.band_energy[axis][b] - expected) / mean_square);
+            sum += features.band_energy[axis][b];
+        }
+        double rms_error = fabs((double)features.rms[axis] * features.rms[axis] - mean_square) / mean_square;
+        // Only bands over every bin have to add up to the mean square.
+        double sum_error = (test_bin(edges[count - 1]) > VIBRATION_WINDOW / 2) ? fabs(sum - mean_square) / mean_square : 0.0;
+        int ok = (max_error <= TEST_MAX_BAND_ERROR && rms_error <= TEST_MAX_SUM_ERROR && sum_error <= TEST_MAX_SUM_ERROR);
+        printf("%s: %u bands, axis %u: band error %.2e vs DFT, mean square %.5f G^2, rms^2 off by %.2e, bins sum off by %.2e\n",
+               ok ? "ok" : "FAIL", count - 1, axis, max_error, mean_square, rms_error, sum_error);
+        failed += ok ? 0 : 1;
+    }
+    return failed;
+}
+
+static int test_timing(void) {
+    vibration_features_t features;
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < TEST_TIMED_WINDOWS; i++) {
+        vibration_analyze(test_samples, TEST_RATE_HZ, &features);
+    }
+    double us = (double)(esp_timer_get_time() - start) / TEST_TIMED_WINDOWS;
+    double budget_us = 1e6 * VIBRATION_HOP / TEST_RATE_HZ;
+    int ok = (us < budget_us);
+    printf("%s: %u-sample window, 3 axes: %.2f us against %.0f us per hop at %u Hz (%.2f per mille)\n",
+           ok ? "ok" : "FAIL", VIBRATION_WINDOW, us, budget_us, TEST_RATE_HZ, us * 1000.0 / budget_us);
+    return ok ? 0 : 1;
+}
+
+int main(void) {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    test_fill();
+
+    static const uint16_t default_edges[] = { 0, 10, 50, 100, 200, 500 };
+    static const uint16_t all_edges[] = { 0, TEST_RATE_HZ };
+    int failed = test_bands(default_edges, sizeof(default_edges) / sizeof(default_edges[0]));
+    failed += test_bands(all_edges, sizeof(all_edges) / sizeof(all_edges[0]));
+    failed += test_timing();
+    return (failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,234 @@
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "driver/rtc_io.h"
+#include "driver/uart.h"
+
+#include "m5stick.h"
+#include "dutycycle.h"
+
+#if CONFIG_DUTY_CYCLE_SUPPORT
+static const char *TAG = "MY-DUTY";
+
+#define DUTYCYCLE_MAGIC (0x59545544)        // "DUTY"
+#define DUTYCYCLE_RTC_TIMER_MAX_S (255)     // PCF8563 timer in 1 Hz steps
+#define DUTYCYCLE_RTC_MIN_S (2)             // the 1 Hz timer's first step is partial
+#define DUTYCYCLE_BACKUP_WAKE_US (2000000)  // ESP32 timer behind the PCF8563
+#define DUTYCYCLE_MAX_SLEEP_S (23 * 3600)   // an hour/minute alarm is unambiguous
+
+/*
+    Kept in RTC slow memory through deep sleep. Due and wake times are on
+    the system clock, which keeps running in deep sleep, so they mean the
+    same after the reboot a wake-up is.
+*/
+typedef struct {
+    uint32_t magic;
+    uint8_t count;
+    uint8_t sleep;                      // dutycycle_sleep_t of the last sleep
+    int64_t due_us[DUTYCYCLE_MAX_JOBS];
+    int64_t wake_us;                    // planned wake, 0 before the first sleep
+    dutycycle_report_t report;
+    dutycycle_totals_t totals;
+} dutycycle_state_t;
+
+static RTC_DATA_ATTR dutycycle_state_t dutycycle_state;
+
+static int64_t dutycycle_now_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/*
+    A returned interval counts from now; the period keeps its phase from
+    the old due time unless that is already past (a run that was late by
+    a whole period) or too far ahead (the clock was stepped back).
+*/
+static void dutycycle_reschedule(int64_t *due_us, int64_t now_us, uint32_t next_s, uint32_t period_s) {
+    int64_t period_us = (int64_t)period_s * 1000000;
+    if (next_s > 0) {
+        *due_us = now_us + (int64_t)next_s * 1000000;
+        return ;
+    }
+    *due_us += period_us;
+    if (*due_us <= now_us || *due_us > now_us + period_us) {
+        *due_us = now_us + period_us;
+    }
+}
+
+#if CONFIG_DUTY_RTC_WAKE_GPIO >= 0
+static void dutycycle_rtc_disarm(void) {
+    PCF8563_SetTimerIRQ(-1);
+    PCF8563_SetAlarmIRQ(-1, -1, -1, -1);
+    PCF8563_ClearIRQ();
+}
+
+/*
+    Short sleeps use the PCF8563 countdown timer, which may fire up to a
+    second early. Longer ones use its alarm on the last whole minute
+    before the wake, since the minute-step timer is just as coarse at the
+    start; the scheduler sleeps off the remainder. Returns the wake time
+    programmed, 0 when the sleep is too short for the RTC.
+*/
+static int64_t dutycycle_rtc_arm(int64_t now_us, int64_t wake_us) {
+    int64_t sleep_s = (wake_us - now_us) / 1000000;
+    if (sleep_s < DUTYCYCLE_RTC_MIN_S) {
+        return 0;
+    }
+    dutycycle_rtc_disarm();
+    if (sleep_s <= DUTYCYCLE_RTC_TIMER_MAX_S) {
+        PCF8563_SetTimerIRQ((int16_t)sleep_s);
+        return wake_us;
+    }
+    time_t wake = (time_t)(wake_us / 1000000);
+    wake -= wake % 60;
+    struct tm tm;
+    localtime_r(&wake, &tm);
+    PCF8563_SetAlarmIRQ(tm.tm_min, tm.tm_hour, tm.tm_mday, -1);
+    return (int64_t)wake * 1000000;
+}
+#endif
+
+static const char *dutycycle_sleep_name(uint8_t sleep) {
+    static const char *names[] = { "light", "deep (timer)", "deep (RTC)" };
+    return (sleep < sizeof(names) / sizeof(names[0])) ? names[sleep] : "?";
+}
+
+static void dutycycle_log(const dutycycle_job_t *jobs, uint8_t count, const dutycycle_report_t *report) {
+    const dutycycle_totals_t *totals = &dutycycle_state.totals;
+    uint64_t span_ms = totals->awake_ms + totals->sleep_ms;
+    uint32_t duty_permille = (span_ms > 0) ? (uint32_t)(totals->awake_ms * 1000 / span_ms) : 1000;
+    ESP_LOGI(TAG, "cycle %u: wake cause %u, %d ms late, boot %u ms, awake %u ms, %s sleep %u ms, duty %u.%u%%",
+             report->cycle, report->wake_cause, report->wake_late_ms, report->boot_ms, report->awake_ms,
+             dutycycle_sleep_name(report->sleep), report->sleep_ms, duty_permille / 10, duty_permille % 10);
+    for (uint8_t i = 0; i < count; i++) {
+        if (report->jobs_run & (1 << i)) {
+            ESP_LOGI(TAG, "cycle %u: %s %u ms", report->cycle, jobs[i].name, report->job_ms[i]);
+        }
+    }
+}
+
+void dutycycle_run(const dutycycle_job_t *jobs, uint8_t count) {
+    dutycycle_state_t *state = &dutycycle_state;
+    if (count > DUTYCYCLE_MAX_JOBS) {
+        count = DUTYCYCLE_MAX_JOBS;
+    }
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    if (cause == ESP_SLEEP_WAKEUP_UNDEFINED || state->magic != DUTYCYCLE_MAGIC || state->count != count) {
+        // Cold boot: everything is due now.
+        memset(state, 0, sizeof(*state));
+        state->magic = DUTYCYCLE_MAGIC;
+        state->count = count;
+    }
+    // Nothing is shown between cycles.
+    Axp192_ScreenOnOff(0);
+
+    // The first cycle started at reset.
+    int64_t awake_start_us = 0;
+    uint32_t boot_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    while (1) {
+        dutycycle_report_t report = {
+            .cycle = state->totals.cycles + 1,
+            .wake_cause = cause,
+            .boot_ms = boot_ms,
+        };
+        int64_t now_us = dutycycle_now_us();
+        if (state->wake_us != 0) {
+            report.wake_late_ms = (int32_t)((now_us - state->wake_us) / 1000);
+        }
+#if CONFIG_DUTY_RTC_WAKE_GPIO >= 0
+        if (state->sleep == DUTYCYCLE_SLEEP_DEEP_RTC) {
+            // Release INT whichever source woke us.
+            dutycycle_rtc_disarm();
+        }
+#endif
+
+        for (uint8_t i = 0; i < count; i++) {
+            if (state->due_us[i] > now_us) {
+                continue;
+            }
+            int64_t start_us = esp_timer_get_time();
+            uint32_t next_s = jobs[i].run(jobs[i].arg);
+            report.job_ms[i] = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+            report.jobs_run |= 1 << i;
+            // A job may have set the clock.
+            now_us = dutycycle_now_us();
+            dutycycle_reschedule(&state->due_us[i], now_us, next_s, jobs[i].period_s);
+        }
+
+        int64_t wake_us = state->due_us[0];
+        for (uint8_t i = 1; i < count; i++) {
+            if (state->due_us[i] < wake_us) {
+                wake_us = state->due_us[i];
+            }
+        }
+        now_us = dutycycle_now_us();
+        if (wake_us > now_us + (int64_t)DUTYCYCLE_MAX_SLEEP_S * 1000000) {
+            wake_us = now_us + (int64_t)DUTYCYCLE_MAX_SLEEP_S * 1000000;
+        }
+        int64_t sleep_us = (wake_us > now_us) ? wake_us - now_us : 0;
+
+        esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+        report.sleep = (sleep_us >= (int64_t)CONFIG_DUTY_DEEP_SLEEP_MIN_MS * 1000) ? DUTYCYCLE_SLEEP_DEEP_TIMER : DUTYCYCLE_SLEEP_LIGHT;
+#if CONFIG_DUTY_RTC_WAKE_GPIO >= 0
+        if (report.sleep == DUTYCYCLE_SLEEP_DEEP_TIMER) {
+            int64_t rtc_wake_us = dutycycle_rtc_arm(now_us, wake_us);
+            if (rtc_wake_us != 0) {
+                // The ESP32 timer stays as a backup behind the programmed time.
+                report.sleep = DUTYCYCLE_SLEEP_DEEP_RTC;
+                wake_us = rtc_wake_us;
+                sleep_us = rtc_wake_us - now_us;
+                rtc_gpio_pullup_en(CONFIG_DUTY_RTC_WAKE_GPIO);
+                rtc_gpio_pulldown_dis(CONFIG_DUTY_RTC_WAKE_GPIO);
+                esp_sleep_enable_ext0_wakeup(CONFIG_DUTY_RTC_WAKE_GPIO, 0);
+            }
+        }
+#endif
+        int64_t timer_us = sleep_us + ((report.sleep == DUTYCYCLE_SLEEP_DEEP_RTC) ? DUTYCYCLE_BACKUP_WAKE_US : 0);
+        esp_sleep_enable_timer_wakeup((timer_us > 0) ? timer_us : 1);
+
+        report.awake_ms = (uint32_t)((esp_timer_get_time() - awake_start_us) / 1000);
+        report.sleep_ms = (uint32_t)(sleep_us / 1000);
+        state->wake_us = wake_us;
+        state->sleep = report.sleep;
+        state->report = report;
+        state->totals.cycles++;
+        state->totals.awake_ms += report.awake_ms;
+        state->totals.sleep_ms += report.sleep_ms;
+        if (report.sleep == DUTYCYCLE_SLEEP_LIGHT) {
+            state->totals.light_sleeps++;
+        } else {
+            state->totals.deep_sleeps++;
+        }
+        dutycycle_log(jobs, count, &report);
+        uart_wait_tx_idle_polling(CONFIG_ESP_CONSOLE_UART_NUM);
+
+        if (report.sleep != DUTYCYCLE_SLEEP_LIGHT) {
+            esp_deep_sleep_start();
+        }
+        if (sleep_us > 0) {
+            esp_light_sleep_start();
+        }
+        cause = esp_sleep_get_wakeup_cause();
+        awake_start_us = esp_timer_get_time();
+        boot_ms = 0;
+    }
+}
+
+void dutycycle_get_report(dutycycle_report_t *report, dutycycle_totals_t *totals) {
+    if (report != NULL) {
+        *report = dutycycle_state.report;
+    }
+    if (totals != NULL) {
+        *totals = dutycycle_state.totals;
+    }
+}
+#endif
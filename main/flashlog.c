@@ -0,0 +1,519 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "flashlog.h"
+#include "flashlog_part.h"
+
+#if CONFIG_FLASHLOG_SUPPORT
+#define FLASHLOG_MAGIC (0x31474C46)    // "FLG1"
+#define FLASHLOG_PAGE_SIZE (256)
+#define FLASHLOG_NONE UINT32_MAX
+
+static const char *TAG = "MY-FLOG";
+
+/*
+    On-flash layout. Records are 8 bytes after a 16-byte header, so none
+    crosses a 256-byte program page. A record that is all 0xFF has not
+    been written; flags is always 0 so a valid one never is.
+*/
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;               // 1, 2, ... in write order
+    uint32_t base_time_s;       // time of the first record
+    uint16_t erase_count;
+    uint8_t reserved;
+    uint8_t crc;
+} flashlog_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t dt_s;              // from base_time_s
+    int16_t values[FLASHLOG_CHANNELS];
+    uint8_t flags;
+    uint8_t crc;
+} flashlog_entry_t;
+
+#define FLASHLOG_FIRST_RECORD (sizeof(flashlog_header_t))
+#define FLASHLOG_RECORDS ((FLASHLOG_SECTOR_SIZE - FLASHLOG_FIRST_RECORD) / sizeof(flashlog_entry_t))
+
+_Static_assert(sizeof(flashlog_header_t) == 16, "header size");
+_Static_assert(sizeof(flashlog_entry_t) == 8, "record size");
+
+typedef enum {
+    FLASHLOG_SEG_FREE = 0,      // erased, torn or never written
+    FLASHLOG_SEG_USED,
+    FLASHLOG_SEG_RETIRED,       // erase or header write failed
+} flashlog_seg_state_t;
+
+/* The sparse index: one entry per segment, rebuilt at mount. */
+typedef struct {
+    uint32_t seq;
+    uint32_t base_time_s;
+    uint16_t erase_count;
+    uint8_t state;
+} flashlog_segment_t;
+
+static flashlog_segment_t *flashlog_segments;
+static uint32_t flashlog_count;
+static uint32_t flashlog_tail = FLASHLOG_NONE;
+static uint32_t flashlog_tail_offset;
+static uint32_t flashlog_next_seq;
+static uint32_t flashlog_last_time_s;
+static SemaphoreHandle_t flashlog_lock;
+static flashlog_stats_t flashlog_stats;
+
+static uint8_t flashlog_crc8(const uint8_t *data, size_t length) {
+    uint8_t crc = 0xFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+static bool flashlog_erased(const uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (data[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool flashlog_entry_valid(const flashlog_entry_t *entry) {
+    return entry->flags == 0 && flashlog_crc8((const uint8_t *)entry, sizeof(*entry) - 1) == entry->crc;
+}
+
+static uint32_t flashlog_segment_offset(uint32_t segment) {
+    return segment * FLASHLOG_SECTOR_SIZE;
+}
+
+/* Used segment with the smallest sequence number above seq. */
+static uint32_t flashlog_next_segment(uint32_t seq) {
+    uint32_t found = FLASHLOG_NONE;
+    for (uint32_t i = 0; i < flashlog_count; i++) {
+        const flashlog_segment_t *seg = &flashlog_segments[i];
+        if (seg->state == FLASHLOG_SEG_USED && seg->seq > seq
+            && (found == FLASHLOG_NONE || seg->seq < flashlog_segments[found].seq)) {
+            found = i;
+        }
+    }
+    return found;
+}
+
+static esp_err_t flashlog_rotate(uint32_t base_time_s) {
+    uint32_t next = (flashlog_tail == FLASHLOG_NONE) ? 0 : (flashlog_tail + 1) % flashlog_count;
+    for (uint32_t attempt = 0; attempt < flashlog_count; attempt++, next = (next + 1) % flashlog_count) {
+        flashlog_segment_t *seg = &flashlog_segments[next];
+        if (seg->state == FLASHLOG_SEG_RETIRED) {
+            continue;
+        }
+        // Ring order wears every segment evenly; the oldest data goes.
+        uint16_t erase_count = seg->erase_count + 1;
+        seg->state = FLASHLOG_SEG_FREE;
+        seg->seq = 0;
+        esp_err_t err = flashlog_part_erase(flashlog_segment_offset(next), FLASHLOG_SECTOR_SIZE);
+        if (err == ESP_OK) {
+            flashlog_stats.bytes_erased += FLASHLOG_SECTOR_SIZE;
+            flashlog_header_t header = {
+                .magic = FLASHLOG_MAGIC,
+                .seq = flashlog_next_seq,
+                .base_time_s = base_time_s,
+                .erase_count = erase_count,
+                .reserved = 0,
+            };
+            header.crc = flashlog_crc8((const uint8_t *)&header, sizeof(header) - 1);
+            err = flashlog_part_write(flashlog_segment_offset(next), &header, sizeof(header));
+            flashlog_stats.bytes_programmed += sizeof(header);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "segment %u retired (%s)", next, esp_err_to_name(err));
+            seg->state = FLASHLOG_SEG_RETIRED;
+            flashlog_stats.segments_retired++;
+            continue;
+        }
+        seg->state = FLASHLOG_SEG_USED;
+        seg->seq = flashlog_next_seq++;
+        seg->base_time_s = base_time_s;
+        seg->erase_count = erase_count;
+        flashlog_tail = next;
+        flashlog_tail_offset = FLASHLOG_FIRST_RECORD;
+        return ESP_OK;
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+/* Find the append position: the first unwritten record of the tail. */
+static void flashlog_scan_tail(void) {
+    const flashlog_segment_t *seg = &flashlog_segments[flashlog_tail];
+    uint32_t base = flashlog_segment_offset(flashlog_tail);
+    uint8_t page[FLASHLOG_PAGE_SIZE];
+    flashlog_last_time_s = seg->base_time_s;
+    flashlog_tail_offset = FLASHLOG_SECTOR_SIZE;
+
+    for (uint32_t page_start = 0; page_start < FLASHLOG_SECTOR_SIZE; page_start += FLASHLOG_PAGE_SIZE) {
+        if (flashlog_part_read(base + page_start, page, FLASHLOG_PAGE_SIZE) != ESP_OK) {
+            break;
+        }
+        uint32_t offset = (page_start == 0) ? FLASHLOG_FIRST_RECORD : 0;
+        for (; offset < FLASHLOG_PAGE_SIZE; offset += sizeof(flashlog_entry_t)) {
+            const flashlog_entry_t *entry = (const flashlog_entry_t *)&page[offset];
+            if (flashlog_erased(&page[offset], sizeof(*entry))) {
+                flashlog_tail_offset = page_start + offset;
+                return ;
+            }
+            flashlog_stats.tail_records++;
+            if (flashlog_entry_valid(entry)) {
+                flashlog_last_time_s = seg->base_time_s + entry->dt_s;
+            } else {
+                // Torn by a power cut; appends continue after it.
+                flashlog_stats.corrupt++;
+            }
+        }
+    }
+}
+
+esp_err_t flashlog_init(void) {
+    if (flashlog_segments != NULL) {
+        return ESP_OK;
+    }
+    int64_t start = esp_timer_get_time();
+    uint32_t size = 0;
+    esp_err_t err = flashlog_part_open(&size);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "no history partition (%s)", esp_err_to_name(err));
+        return err;
+    }
+    flashlog_count = size / FLASHLOG_SECTOR_SIZE;
+    if (flashlog_count < 2) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    flashlog_segments = calloc(flashlog_count, sizeof(flashlog_segment_t));
+    if (flashlog_segments == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (flashlog_lock == NULL) {
+        flashlog_lock = xSemaphoreCreateMutex();
+    }
+    memset(&flashlog_stats, 0, sizeof(flashlog_stats));
+
+    // Headers only: 16 bytes per segment.
+    flashlog_tail = FLASHLOG_NONE;
+    flashlog_next_seq = 1;
+    for (uint32_t i = 0; i < flashlog_count; i++) {
+        flashlog_header_t header;
+        if (flashlog_part_read(flashlog_segment_offset(i), &header, sizeof(header)) != ESP_OK) {
+            continue;
+        }
+        if (header.magic != FLASHLOG_MAGIC || header.seq == 0
+            || flashlog_crc8((const uint8_t *)&header, sizeof(header) - 1) != header.crc) {
+            continue;
+        }
+        flashlog_segment_t *seg = &flashlog_segments[i];
+        seg->state = FLASHLOG_SEG_USED;
+        seg->seq = header.seq;
+        seg->base_time_s = header.base_time_s;
+        seg->erase_count = header.erase_count;
+        if (flashlog_tail == FLASHLOG_NONE || header.seq > flashlog_segments[flashlog_tail].seq) {
+            flashlog_tail = i;
+        }
+    }
+    if (flashlog_tail != FLASHLOG_NONE) {
+        flashlog_next_seq = flashlog_segments[flashlog_tail].seq + 1;
+        flashlog_scan_tail();
+    }
+
+    flashlog_stats.mount_us = esp_timer_get_time() - start;
+    ESP_LOGI(TAG, "mounted %u segments in %u us, tail %d at %u, %u tail records",
+             flashlog_count, flashlog_stats.mount_us, (int)flashlog_tail, flashlog_tail_offset,
+             flashlog_stats.tail_records);
+    return ESP_OK;
+}
+
+void flashlog_deinit(void) {
+    if (flashlog_segments == NULL) {
+        return ;
+    }
+    xSemaphoreTake(flashlog_lock, portMAX_DELAY);
+    free(flashlog_segments);
+    flashlog_segments = NULL;
+    flashlog_tail = FLASHLOG_NONE;
+    xSemaphoreGive(flashlog_lock);
+}
+
+esp_err_t flashlog_format(void) {
+    if (flashlog_segments == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(flashlog_lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    for (uint32_t i = 0; i < flashlog_count && err == ESP_OK; i++) {
+        if (flashlog_segments[i].state == FLASHLOG_SEG_USED) {
+            err = flashlog_part_erase(flashlog_segment_offset(i), FLASHLOG_SECTOR_SIZE);
+            flashlog_stats.bytes_erased += FLASHLOG_SECTOR_SIZE;
+            flashlog_segments[i].erase_count++;
+        }
+        // Keep the wear counts; they are written back as segments are reused.
+        flashlog_segments[i].state = FLASHLOG_SEG_FREE;
+        flashlog_segments[i].seq = 0;
+    }
+    flashlog_tail = FLASHLOG_NONE;
+    flashlog_next_seq = 1;
+    xSemaphoreGive(flashlog_lock);
+    return err;
+}
+
+esp_err_t flashlog_append(const flashlog_record_t *record) {
+    if (flashlog_segments == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(flashlog_lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    if (flashlog_tail != FLASHLOG_NONE && record->time_s < flashlog_last_time_s) {
+        flashlog_stats.rejected++;
+        err = ESP_ERR_INVALID_ARG;
+    } else if (flashlog_tail == FLASHLOG_NONE
+        || flashlog_tail_offset + sizeof(flashlog_entry_t) > FLASHLOG_SECTOR_SIZE
+        || record->time_s - flashlog_segments[flashlog_tail].base_time_s > UINT16_MAX) {
+        err = flashlog_rotate(record->time_s);
+    }
+    if (err == ESP_OK) {
+        flashlog_entry_t entry = {
+            .dt_s = record->time_s - flashlog_segments[flashlog_tail].base_time_s,
+            .flags = 0,
+        };
+        memcpy(entry.values, record->values, sizeof(entry.values));
+        entry.crc = flashlog_crc8((const uint8_t *)&entry, sizeof(entry) - 1);
+        err = flashlog_part_write(flashlog_segment_offset(flashlog_tail) + flashlog_tail_offset, &entry, sizeof(entry));
+        // A failed write may have programmed part of the slot: never reuse it.
+        flashlog_tail_offset += sizeof(entry);
+        flashlog_stats.bytes_programmed += sizeof(entry);
+        if (err == ESP_OK) {
+            flashlog_last_time_s = record->time_s;
+            flashlog_stats.records++;
+        }
+    }
+    xSemaphoreGive(flashlog_lock);
+    return err;
+}
+
+/*
+    Read the record at offset of the iterator's segment through its page
+    buffer. fresh forces a re-read, for records appended since.
+*/
+static const flashlog_entry_t *flashlog_iter_entry(flashlog_iter_t *it, uint32_t offset, bool fresh) {
+    uint32_t address = flashlog_segment_offset(it->segment) + offset;
+    uint32_t page = address & ~(FLASHLOG_PAGE_SIZE - 1);
+    if (fresh || page != it->page_offset) {
+        if (flashlog_part_read(page, it->page, FLASHLOG_PAGE_SIZE) != ESP_OK) {
+            it->page_offset = FLASHLOG_NONE;
+            return NULL;
+        }
+        it->page_offset = page;
+    }
+    return (const flashlog_entry_t *)&it->page[address - page];
+}
+
+/*
+    Time of the record at index, or of the next readable one when it is
+    torn; UINT32_MAX past the last record. Ordered, so it can be bisected.
+*/
+static uint32_t flashlog_iter_time(flashlog_iter_t *it, uint32_t index) {
+    const flashlog_segment_t *seg = &flashlog_segments[it->segment];
+    for (; index < FLASHLOG_RECORDS; index++) {
+        const flashlog_entry_t *entry = flashlog_iter_entry(it, FLASHLOG_FIRST_RECORD + index * sizeof(flashlog_entry_t), false);
+        if (entry == NULL || flashlog_erased((const uint8_t *)entry, sizeof(*entry))) {
+            break;
+        }
+        if (flashlog_entry_valid(entry)) {
+            return seg->base_time_s + entry->dt_s;
+        }
+    }
+    return UINT32_MAX;
+}
+
+esp_err_t flashlog_iter_init(flashlog_iter_t *it, uint32_t from_s, uint32_t to_s) {
+    memset(it, 0, sizeof(*it));
+    it->page_offset = FLASHLOG_NONE;
+    it->done = true;
+    if (flashlog_segments == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(flashlog_lock, portMAX_DELAY);
+    // Index scan: the newest segment starting at or before from_s,
+    // else the oldest one.
+    uint32_t found = FLASHLOG_NONE;
+    for (uint32_t i = 0; i < flashlog_count; i++) {
+        const flashlog_segment_t *seg = &flashlog_segments[i];
+        if (seg->state != FLASHLOG_SEG_USED || seg->base_time_s > from_s) {
+            continue;
+        }
+        if (found == FLASHLOG_NONE || seg->seq > flashlog_segments[found].seq) {
+            found = i;
+        }
+    }
+    if (found == FLASHLOG_NONE) {
+        found = flashlog_next_segment(0);
+    }
+    if (found != FLASHLOG_NONE && from_s <= to_s) {
+        it->segment = found;
+        it->seq = flashlog_segments[found].seq;
+        it->to_s = to_s;
+        it->done = false;
+        // Bisect the segment for the first record at or after from_s.
+        uint32_t lo = 0, hi = FLASHLOG_RECORDS;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (flashlog_iter_time(it, mid) < from_s) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        it->offset = FLASHLOG_FIRST_RECORD + lo * sizeof(flashlog_entry_t);
+    }
+    xSemaphoreGive(flashlog_lock);
+    return ESP_OK;
+}
+
+bool flashlog_iter_next(flashlog_iter_t *it, flashlog_record_t *record) {
+    if (it->done || flashlog_segments == NULL) {
+        return false;
+    }
+    xSemaphoreTake(flashlog_lock, portMAX_DELAY);
+    bool found = false;
+    while (!it->done && !found) {
+        const flashlog_segment_t *seg = &flashlog_segments[it->segment];
+        if (seg->state != FLASHLOG_SEG_USED || seg->seq != it->seq) {
+            // Recycled under the iterator: go on with what is left.
+            uint32_t next = flashlog_next_segment(it->seq);
+            it->done = (next == FLASHLOG_NONE);
+            it->segment = next;
+            it->seq = it->done ? 0 : flashlog_segments[next].seq;
+            it->offset = FLASHLOG_FIRST_RECORD;
+            continue;
+        }
+        const flashlog_entry_t *entry = NULL;
+        if (it->offset + sizeof(flashlog_entry_t) <= FLASHLOG_SECTOR_SIZE) {
+            entry = flashlog_iter_entry(it, it->offset, false);
+            if (entry != NULL && flashlog_erased((const uint8_t *)entry, sizeof(*entry)) && it->segment == flashlog_tail) {
+                entry = flashlog_iter_entry(it, it->offset, true);
+            }
+        }
+        if (entry == NULL || flashlog_erased((const uint8_t *)entry, sizeof(*entry))) {
+            uint32_t next = flashlog_next_segment(it->seq);
+            it->done = (next == FLASHLOG_NONE);
+            it->segment = next;
+            it->seq = it->done ? 0 : flashlog_segments[next].seq;
+            it->offset = FLASHLOG_FIRST_RECORD;
+            continue;
+        }
+        it->offset += sizeof(flashlog_entry_t);
+        if (!flashlog_entry_valid(entry)) {
+            flashlog_stats.corrupt++;
+            continue;
+        }
+        uint32_t time_s = seg->base_time_s + entry->dt_s;
+        if (time_s > it->to_s) {
+            it->done = true;
+            break;
+        }
+        record->time_s = time_s;
+        memcpy(record->values, entry->values, sizeof(record->values));
+        found = true;
+    }
+    xSemaphoreGive(flashlog_lock);
+    return found;
+}
+
+void flashlog_get_stats(flashlog_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (flashlog_segments == NULL) {
+        return ;
+    }
+    xSemaphoreTake(flashlog_lock, portMAX_DELAY);
+    *stats = flashlog_stats;
+    stats->segments = flashlog_count - flashlog_stats.segments_retired;
+    stats->newest_s = (flashlog_tail == FLASHLOG_NONE) ? 0 : flashlog_last_time_s;
+    bool first = true;
+    for (uint32_t i = 0; i < flashlog_count; i++) {
+        const flashlog_segment_t *seg = &flashlog_segments[i];
+        if (seg->state != FLASHLOG_SEG_USED) {
+            continue;
+        }
+        stats->segments_used++;
+        if (first || seg->erase_count < stats->erase_min) {
+            stats->erase_min = seg->erase_count;
+        }
+        if (first || seg->erase_count > stats->erase_max) {
+            stats->erase_max = seg->erase_count;
+        }
+        first = false;
+    }
+    xSemaphoreGive(flashlog_lock);
+}
+
+#if CONFIG_FLASHLOG_SIM
+esp_err_t flashlog_benchmark(uint32_t records, flashlog_bench_t *result) {
+    memset(result, 0, sizeof(*result));
+    esp_err_t err = flashlog_init();
+    if (err == ESP_OK) {
+        err = flashlog_format();
+    }
+    if (err != ESP_OK || records == 0) {
+        return (err != ESP_OK) ? err : ESP_ERR_INVALID_ARG;
+    }
+
+    const uint32_t start_s = 1700000000;
+    flashlog_stats_t before, after;
+    flashlog_get_stats(&before);
+    flashlog_record_t record;
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < records; i++) {
+        record.time_s = start_s + i * 60;
+        record.values[0] = 2300 + (int16_t)(i % 200) - 100;
+        record.values[1] = 4500 + (int16_t)(i % 37) * 10;
+        if ((err = flashlog_append(&record)) != ESP_OK) {
+            return err;
+        }
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    flashlog_get_stats(&after);
+    uint64_t logical = (uint64_t)records * sizeof(flashlog_record_t);
+    result->records = records;
+    result->append_per_s = (elapsed > 0) ? (uint32_t)((uint64_t)records * 1000000 / elapsed) : 0;
+    result->program_permille = (uint32_t)((after.bytes_programmed - before.bytes_programmed) * 1000 / logical);
+    result->erase_permille = (uint32_t)((after.bytes_erased - before.bytes_erased) * 1000 / logical);
+
+    flashlog_deinit();
+    if ((err = flashlog_init()) != ESP_OK) {
+        return err;
+    }
+    flashlog_get_stats(&after);
+    result->mount_us = after.mount_us;
+
+    // One day, ending at the last record.
+    uint32_t last_s = start_s + (records - 1) * 60;
+    uint32_t from_s = (last_s > start_s + 86400) ? last_s - 86400 : start_s;
+    flashlog_iter_t *it = malloc(sizeof(flashlog_iter_t));
+    if (it == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    start = esp_timer_get_time();
+    flashlog_iter_init(it, from_s, last_s);
+    while (flashlog_iter_next(it, &record)) {
+        result->query_records++;
+    }
+    elapsed = esp_timer_get_time() - start;
+    result->query_per_s = (elapsed > 0) ? (uint32_t)((uint64_t)result->query_records * 1000000 / elapsed) : 0;
+    free(it);
+    return ESP_OK;
+}
+#endif
+#endif
@@ -0,0 +1,94 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "flashlog_part.h"
+
+#if CONFIG_FLASHLOG_SUPPORT
+#if CONFIG_FLASHLOG_SIM
+static uint8_t *flashlog_sim_image;
+static uint32_t flashlog_sim_size;
+static size_t flashlog_sim_tear = SIZE_MAX;
+
+void flashlog_sim_tear_next_write(size_t bytes) {
+    flashlog_sim_tear = bytes;
+}
+
+esp_err_t flashlog_part_open(uint32_t *size) {
+    // Allocated once and kept, so a remount sees what was written.
+    if (flashlog_sim_image == NULL) {
+        flashlog_sim_size = CONFIG_FLASHLOG_SIM_SIZE_KB * 1024;
+        flashlog_sim_image = malloc(flashlog_sim_size);
+        if (flashlog_sim_image == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        memset(flashlog_sim_image, 0xFF, flashlog_sim_size);
+    }
+    *size = flashlog_sim_size;
+    return ESP_OK;
+}
+
+esp_err_t flashlog_part_read(uint32_t offset, void *data, size_t length) {
+    if (offset + length > flashlog_sim_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(data, &flashlog_sim_image[offset], length);
+    return ESP_OK;
+}
+
+esp_err_t flashlog_part_write(uint32_t offset, const void *data, size_t length) {
+    if (offset + length > flashlog_sim_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    size_t programmed = (length < flashlog_sim_tear) ? length : flashlog_sim_tear;
+    const uint8_t *src = data;
+    for (size_t i = 0; i < programmed; i++) {
+        flashlog_sim_image[offset + i] &= src[i];
+    }
+    if (programmed < length) {
+        flashlog_sim_tear = SIZE_MAX;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t flashlog_part_erase(uint32_t offset, size_t length) {
+    if ((offset % FLASHLOG_SECTOR_SIZE) != 0 || (length % FLASHLOG_SECTOR_SIZE) != 0
+        || offset + length > flashlog_sim_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(&flashlog_sim_image[offset], 0xFF, length);
+    return ESP_OK;
+}
+#else
+#include "esp_partition.h"
+
+// Data subtype of the "history" entry in partitions.csv.
+#define FLASHLOG_PARTITION_SUBTYPE (0x40)
+
+static const esp_partition_t *flashlog_partition;
+
+esp_err_t flashlog_part_open(uint32_t *size) {
+    if (flashlog_partition == NULL) {
+        flashlog_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, FLASHLOG_PARTITION_SUBTYPE, "history");
+        if (flashlog_partition == NULL) {
+            return ESP_ERR_NOT_FOUND;
+        }
+    }
+    *size = flashlog_partition->size;
+    return ESP_OK;
+}
+
+esp_err_t flashlog_part_read(uint32_t offset, void *data, size_t length) {
+    return esp_partition_read(flashlog_partition, offset, data, length);
+}
+
+esp_err_t flashlog_part_write(uint32_t offset, const void *data, size_t length) {
+    return esp_partition_write(flashlog_partition, offset, data, length);
+}
+
+esp_err_t flashlog_part_erase(uint32_t offset, size_t length) {
+    return esp_partition_erase_range(flashlog_partition, offset, length);
+}
+#endif
+#endif
@@ -0,0 +1,374 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "history.h"
+
+#if CONFIG_HISTORY_SUPPORT
+#define HISTORY_RAW_SLOTS CONFIG_HISTORY_RAW_SLOTS
+#define HISTORY_MID_SLOTS CONFIG_HISTORY_MID_SLOTS
+#define HISTORY_LONG_SLOTS CONFIG_HISTORY_LONG_SLOTS
+// Marks an empty raw bucket; inserted values are clamped above it.
+#define HISTORY_EMPTY INT16_MIN
+// Shortest time history_benchmark() reads a tier for.
+#define HISTORY_BENCH_QUERY_US (10000)
+
+static const char *TAG = "MY-HIST";
+
+/*
+    One ring of buckets. The raw tier only has mean[] (the value); the
+    aggregate tiers add count[], min[] and max[]. The bucket being
+    filled keeps its running sum so its slot is always up to date.
+*/
+typedef struct {
+    uint32_t period_s;
+    uint32_t slots;
+    uint32_t head;              // bucket number of the newest slot
+    bool started;
+    uint32_t open_count;
+    int32_t open_sum[HISTORY_CHANNELS];
+    uint16_t *count;
+    int16_t *mean[HISTORY_CHANNELS];
+    int16_t *min[HISTORY_CHANNELS];
+    int16_t *max[HISTORY_CHANNELS];
+} history_tier_t;
+
+/* Struct of arrays: each field of a tier is one contiguous array. */
+struct _history_t {
+    history_tier_t tier[HISTORY_TIERS];
+    SemaphoreHandle_t lock;
+    StaticSemaphore_t lock_buffer;
+    uint32_t rejected;
+    int16_t raw[HISTORY_CHANNELS][HISTORY_RAW_SLOTS];
+    uint16_t mid_count[HISTORY_MID_SLOTS];
+    int16_t mid_mean[HISTORY_CHANNELS][HISTORY_MID_SLOTS];
+    int16_t mid_min[HISTORY_CHANNELS][HISTORY_MID_SLOTS];
+    int16_t mid_max[HISTORY_CHANNELS][HISTORY_MID_SLOTS];
+    uint16_t long_count[HISTORY_LONG_SLOTS];
+    int16_t long_mean[HISTORY_CHANNELS][HISTORY_LONG_SLOTS];
+    int16_t long_min[HISTORY_CHANNELS][HISTORY_LONG_SLOTS];
+    int16_t long_max[HISTORY_CHANNELS][HISTORY_LONG_SLOTS];
+};
+
+static history_t history_store;
+static bool history_ready;
+
+static void history_setup(history_t *history) {
+    history_tier_t *raw = &history->tier[0];
+    history_tier_t *mid = &history->tier[1];
+    history_tier_t *lng = &history->tier[2];
+    raw->period_s = CONFIG_HISTORY_RAW_PERIOD_S;
+    raw->slots = HISTORY_RAW_SLOTS;
+    mid->period_s = CONFIG_HISTORY_MID_PERIOD_S;
+    mid->slots = HISTORY_MID_SLOTS;
+    mid->count = history->mid_count;
+    lng->period_s = CONFIG_HISTORY_LONG_PERIOD_S;
+    lng->slots = HISTORY_LONG_SLOTS;
+    lng->count = history->long_count;
+    for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++) {
+        raw->mean[ch] = history->raw[ch];
+        mid->mean[ch] = history->mid_mean[ch];
+        mid->min[ch] = history->mid_min[ch];
+        mid->max[ch] = history->mid_max[ch];
+        lng->mean[ch] = history->long_mean[ch];
+        lng->min[ch] = history->long_min[ch];
+        lng->max[ch] = history->long_max[ch];
+    }
+    history->lock = xSemaphoreCreateMutexStatic(&history->lock_buffer);
+}
+
+static bool history_slot_empty(const history_tier_t *tier, uint32_t slot) {
+    return (tier->count != NULL) ? (tier->count[slot] == 0) : (tier->mean[0][slot] == HISTORY_EMPTY);
+}
+
+static void history_slot_clear(history_tier_t *tier, uint32_t slot) {
+    if (tier->count != NULL) {
+        tier->count[slot] = 0;
+    } else {
+        for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++) {
+            tier->mean[ch][slot] = HISTORY_EMPTY;
+        }
+    }
+}
+
+static uint32_t history_tier_oldest(const history_tier_t *tier) {
+    return (tier->head >= tier->slots) ? tier->head - tier->slots + 1 : 0;
+}
+
+static int16_t history_mean(int32_t sum, uint32_t count) {
+    int32_t half = (int32_t)(count / 2);
+    return (int16_t)((sum + ((sum < 0) ? -half : half)) / (int32_t)count);
+}
+
+static void history_tier_insert(history_tier_t *tier, uint32_t time_s, const int16_t *values) {
+    uint32_t bucket = time_s / tier->period_s;
+    if (!tier->started || bucket > tier->head) {
+        // Open a new bucket; the ones skipped over are gaps.
+        uint32_t gap = tier->started ? bucket - tier->head : tier->slots;
+        if (gap > tier->slots) {
+            gap = tier->slots;
+        }
+        for (uint32_t i = gap; i > 0; i--) {
+            history_slot_clear(tier, (bucket - i + 1) % tier->slots);
+        }
+        tier->head = bucket;
+        tier->started = true;
+        tier->open_count = 0;
+        memset(tier->open_sum, 0, sizeof(tier->open_sum));
+    } else if (bucket < tier->head) {
+        return ;
+    }
+
+    uint32_t slot = bucket % tier->slots;
+    tier->open_count++;
+    for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++) {
+        tier->open_sum[ch] += values[ch];
+        tier->mean[ch][slot] = history_mean(tier->open_sum[ch], tier->open_count);
+        if (tier->min[ch] == NULL) {
+            continue;
+        }
+        if (tier->open_count == 1 || values[ch] < tier->min[ch][slot]) {
+            tier->min[ch][slot] = values[ch];
+        }
+        if (tier->open_count == 1 || values[ch] > tier->max[ch][slot]) {
+            tier->max[ch][slot] = values[ch];
+        }
+    }
+    if (tier->count != NULL) {
+        tier->count[slot] = (tier->open_count > UINT16_MAX) ? UINT16_MAX : tier->open_count;
+    }
+}
+
+static void history_clear_locked(history_t *history) {
+    for (uint8_t t = 0; t < HISTORY_TIERS; t++) {
+        history->tier[t].started = false;
+        history->tier[t].head = 0;
+        history->tier[t].open_count = 0;
+        for (uint32_t slot = 0; slot < history->tier[t].slots; slot++) {
+            history_slot_clear(&history->tier[t], slot);
+        }
+    }
+}
+
+history_t *history_get(void) {
+    return history_ready ? &history_store : NULL;
+}
+
+esp_err_t history_init(void) {
+    if (history_ready) {
+        return ESP_OK;
+    }
+    history_setup(&history_store);
+    history_clear_locked(&history_store);
+    history_ready = true;
+    ESP_LOGI(TAG, "history: %us x %u, %us x %u, %us x %u, %u bytes",
+             CONFIG_HISTORY_RAW_PERIOD_S, HISTORY_RAW_SLOTS, CONFIG_HISTORY_MID_PERIOD_S, HISTORY_MID_SLOTS,
+             CONFIG_HISTORY_LONG_PERIOD_S, HISTORY_LONG_SLOTS, (unsigned)sizeof(history_t));
+    return ESP_OK;
+}
+
+void history_insert(history_t *history, uint32_t time_s, const int32_t values[HISTORY_CHANNELS]) {
+    int16_t clamped[HISTORY_CHANNELS];
+    for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++) {
+        int32_t v = values[ch];
+        clamped[ch] = (v > INT16_MAX) ? INT16_MAX : (v <= HISTORY_EMPTY) ? HISTORY_EMPTY + 1 : v;
+    }
+
+    xSemaphoreTake(history->lock, portMAX_DELAY);
+    history_tier_t *raw = &history->tier[0];
+    uint32_t bucket = time_s / raw->period_s;
+    if (raw->started && bucket < raw->head) {
+        if (raw->head - bucket < raw->slots) {
+            history->rejected++;
+            xSemaphoreGive(history->lock);
+            return ;
+        }
+        ESP_LOGW(TAG, "clock stepped back %us, history cleared", (raw->head - bucket) * raw->period_s);
+        history_clear_locked(history);
+    }
+    for (uint8_t t = 0; t < HISTORY_TIERS; t++) {
+        history_tier_insert(&history->tier[t], time_s, clamped);
+    }
+    xSemaphoreGive(history->lock);
+}
+
+void history_clear(history_t *history) {
+    xSemaphoreTake(history->lock, portMAX_DELAY);
+    history_clear_locked(history);
+    xSemaphoreGive(history->lock);
+}
+
+void history_tier_info(history_t *history, uint8_t tier, history_tier_info_t *info) {
+    memset(info, 0, sizeof(*info));
+    if (tier >= HISTORY_TIERS) {
+        return ;
+    }
+    xSemaphoreTake(history->lock, portMAX_DELAY);
+    const history_tier_t *t = &history->tier[tier];
+    info->period_s = t->period_s;
+    info->slots = t->slots;
+    if (t->started) {
+        info->oldest_s = history_tier_oldest(t) * t->period_s;
+        info->newest_s = t->head * t->period_s;
+    }
+    xSemaphoreGive(history->lock);
+}
+
+static int8_t history_iter_init_locked(history_iter_t *it, history_t *history, uint8_t channel, int8_t tier, uint32_t from_s, uint32_t to_s) {
+    memset(it, 0, sizeof(*it));
+    if (channel >= HISTORY_CHANNELS || tier >= HISTORY_TIERS || from_s > to_s) {
+        return -1;
+    }
+    if (tier == HISTORY_TIER_AUTO) {
+        // Finest tier reaching back to from_s, else the longest one.
+        tier = HISTORY_TIERS - 1;
+        for (uint8_t t = 0; t < HISTORY_TIERS; t++) {
+            const history_tier_t *candidate = &history->tier[t];
+            if (candidate->started && history_tier_oldest(candidate) * candidate->period_s <= from_s) {
+                tier = t;
+                break;
+            }
+        }
+    }
+    const history_tier_t *t = &history->tier[tier];
+    if (!t->started) {
+        return -1;
+    }
+    uint32_t first = from_s / t->period_s;
+    uint32_t last = to_s / t->period_s;
+    uint32_t oldest = history_tier_oldest(t);
+    if (first < oldest) {
+        first = oldest;
+    }
+    if (last > t->head) {
+        last = t->head;
+    }
+    if (first > last) {
+        return -1;
+    }
+    it->history = history;
+    it->channel = channel;
+    it->tier = tier;
+    it->bucket = first;
+    it->last = last;
+    return tier;
+}
+
+static bool history_iter_next_locked(history_iter_t *it, history_point_t *point) {
+    if (it->history == NULL) {
+        return false;
+    }
+    const history_tier_t *t = &it->history->tier[it->tier];
+    uint32_t oldest = history_tier_oldest(t);
+    if (it->bucket < oldest) {
+        // The ring moved on under the iterator.
+        it->bucket = oldest;
+    }
+    while (it->bucket <= it->last) {
+        uint32_t bucket = it->bucket++;
+        uint32_t slot = bucket % t->slots;
+        if (history_slot_empty(t, slot)) {
+            continue;
+        }
+        point->time_s = bucket * t->period_s;
+        point->mean = t->mean[it->channel][slot];
+        if (t->count != NULL) {
+            point->min = t->min[it->channel][slot];
+            point->max = t->max[it->channel][slot];
+            point->count = t->count[slot];
+        } else {
+            point->min = point->mean;
+            point->max = point->mean;
+            point->count = 1;
+        }
+        return true;
+    }
+    return false;
+}
+
+int8_t history_iter_init(history_iter_t *it, history_t *history, uint8_t channel, int8_t tier, uint32_t from_s, uint32_t to_s) {
+    xSemaphoreTake(history->lock, portMAX_DELAY);
+    int8_t used = history_iter_init_locked(it, history, channel, tier, from_s, to_s);
+    xSemaphoreGive(history->lock);
+    return used;
+}
+
+bool history_iter_next(history_iter_t *it, history_point_t *point) {
+    if (it->history == NULL) {
+        return false;
+    }
+    xSemaphoreTake(it->history->lock, portMAX_DELAY);
+    bool found = history_iter_next_locked(it, point);
+    xSemaphoreGive(it->history->lock);
+    return found;
+}
+
+size_t history_query(history_t *history, uint8_t channel, int8_t tier, uint32_t from_s, uint32_t to_s,
+                     history_point_t *points, size_t max_points) {
+    history_iter_t it;
+    size_t found = 0;
+    xSemaphoreTake(history->lock, portMAX_DELAY);
+    if (history_iter_init_locked(&it, history, channel, tier, from_s, to_s) >= 0) {
+        while (found < max_points && history_iter_next_locked(&it, &points[found])) {
+            found++;
+        }
+    }
+    xSemaphoreGive(history->lock);
+    return found;
+}
+
+esp_err_t history_benchmark(uint32_t inserts, history_bench_t *result) {
+    memset(result, 0, sizeof(*result));
+    if (inserts == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    history_t *history = calloc(1, sizeof(history_t));
+    if (history == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    history_setup(history);
+    history_clear_locked(history);
+
+    // Synthetic readings one raw period apart, from a fixed epoch.
+    const uint32_t start_s = 1700000000;
+    int32_t values[HISTORY_CHANNELS];
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < inserts; i++) {
+        values[HISTORY_TEMPERATURE] = 2300 + (int32_t)(i % 200) - 100;
+        values[HISTORY_HUMIDITY] = 4500 + (int32_t)(i % 37) * 10;
+        history_insert(history, start_s + i * CONFIG_HISTORY_RAW_PERIOD_S, values);
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    result->inserts = inserts;
+    result->insert_ns = (uint32_t)(elapsed * 1000 / inserts);
+
+    history_point_t points[64];
+    for (uint8_t t = 0; t < HISTORY_TIERS; t++) {
+        history_tier_info_t info;
+        history_tier_info(history, t, &info);
+        uint64_t total = 0;
+        start = esp_timer_get_time();
+        // Whole tiers read in microseconds; repeat for a measurable time.
+        do {
+            uint32_t from = info.oldest_s;
+            size_t found;
+            result->query_points[t] = 0;
+            while ((found = history_query(history, HISTORY_TEMPERATURE, t, from, info.newest_s, points, 64)) > 0) {
+                result->query_points[t] += found;
+                from = points[found - 1].time_s + info.period_s;
+            }
+            total += result->query_points[t];
+            elapsed = esp_timer_get_time() - start;
+        } while (elapsed < HISTORY_BENCH_QUERY_US && result->query_points[t] > 0);
+        result->query_points_per_s[t] = (elapsed > 0) ? (uint32_t)(total * 1000000 / elapsed) : 0;
+    }
+
+    vSemaphoreDelete(history->lock);
+    free(history);
+    return ESP_OK;
+}
+#endif
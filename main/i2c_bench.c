@@ -0,0 +1,125 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "m5stick.h"
+#include "i2c_device.h"
+#include "i2c_sim.h"
+#include "i2c_bench.h"
+
+#if CONFIG_I2C_SIM_BENCHMARK
+
+static const char *TAG = "MY-BENCH";
+
+#define SHT3X_ADDR (0x44)
+
+/*
+    One simulated second of the tasks in main.c: vLoopClockTask reads the
+    RTC every second, vLoopUnitEnv2Task and mpu6886_task sample every 5 s,
+    and vLoopRtcTask writes the RTC every 10 minutes. The SHT3x is driven
+    through a private device so the ENV task's own instance is untouched;
+    its measurement wait is not replayed, only the bus traffic.
+*/
+static void i2c_bench_second(uint32_t second, I2CDevice_t sht3x) {
+#if CONFIG_SOFTWARE_RTC_SUPPORT
+    rtc_date_t rtcdate;
+    PCF8563_GetTime(&rtcdate);
+    if (second % 600 == 0) {
+        PCF8563_SetTime(&rtcdate);
+    }
+#endif
+
+    if (second % 5 != 0) {
+        return ;
+    }
+
+    if (sht3x != NULL) {
+        uint8_t cmd[2] = { 0x2C, 0x06 };
+        uint8_t data[6];
+        if (i2c_write_bytes(sht3x, I2C_NO_REG, cmd, 2) == ESP_OK) {
+            i2c_read_bytes(sht3x, I2C_NO_REG, data, 6);
+        }
+    }
+
+#if CONFIG_SOFTWARE_MPU6886_SUPPORT
+    float ax, ay, az;
+    MPU6886_GetAccelData(&ax, &ay, &az);
+#endif
+}
+
+static void i2c_bench_count(I2CDevice_t i2c_device, esp_err_t err, void *arg) {
+    if (err != ESP_OK) {
+        (*(uint32_t *)arg)++;
+    }
+}
+
+/*
+    The same SHT3x traffic through the bus worker: the command is queued
+    without waiting and the read behind it blocks, so each pair shares
+    one bus acquisition.
+*/
+static void i2c_bench_async(uint32_t seconds, I2CDevice_t sht3x) {
+    static uint8_t cmd[2] = { 0x2C, 0x06 };
+    uint8_t data[6];
+    uint32_t failed = 0;
+    uint32_t pairs = 0;
+    int64_t start = esp_timer_get_time();
+    for (uint32_t second = 0; second < seconds; second += 5) {
+        if (i2c_submit(sht3x, I2C_OP_WRITE, I2C_NO_REG, cmd, 2, i2c_bench_count, &failed) != ESP_OK
+            || i2c_submit_wait(sht3x, I2C_OP_READ, I2C_NO_REG, data, 6, pdMS_TO_TICKS(100)) != ESP_OK) {
+            failed++;
+        }
+        pairs++;
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    ESP_LOGI(TAG, "async: %u SHT3x pairs in %lld us, %lld us per pair, %u failed",
+        pairs, (long long)elapsed, (long long)(elapsed / (pairs ? pairs : 1)), failed);
+}
+
+void i2c_bench_run(void) {
+    const uint32_t seconds = CONFIG_I2C_SIM_BENCHMARK_SECONDS;
+    I2CDevice_t sht3x = NULL;
+#if CONFIG_SOFTWARE_UNIT_ENV2_SUPPORT
+    sht3x = i2c_malloc_device(I2C_NUM_0, PORT_A_SDA_PIN, PORT_A_SCL_PIN, PORT_A_I2C_STANDARD_BAUD, SHT3X_ADDR);
+    i2c_device_set_name(sht3x, "SHT3X-BENCH");
+#endif
+
+    i2c_stats_reset();
+    i2c_reset_cmd_pool_stats();
+    i2c_sim_reset_stats();
+    int64_t start = esp_timer_get_time();
+    for (uint32_t second = 0; second < seconds; second++) {
+        i2c_bench_second(second, sht3x);
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+
+    i2c_sim_stats_t sim;
+    i2c_sim_get_stats(&sim);
+    ESP_LOGI(TAG, "%u s replayed in %lld us: %u xfers, %u bytes, %u faults",
+        seconds, (long long)elapsed, sim.transactions, sim.bytes, sim.faults);
+    if (sim.transactions > 0) {
+        ESP_LOGI(TAG, "load: %u.%02u xfers/s, bus %llu us/s; capacity %llu xfers/s of bus time",
+            sim.transactions / seconds, (sim.transactions * 100 / seconds) % 100,
+            (unsigned long long)(sim.bus_time_us / seconds),
+            (unsigned long long)((uint64_t)sim.transactions * 1000000 / (sim.bus_time_us ? sim.bus_time_us : 1)));
+        ESP_LOGI(TAG, "driver: %lld us per xfer including bus time", (long long)(elapsed / sim.transactions));
+    }
+    i2c_cmd_pool_stats_t pool;
+    i2c_get_cmd_pool_stats(&pool);
+    uint32_t allocs_x100 = pool.heap_allocs * 100 / (pool.transactions ? pool.transactions : 1);
+    ESP_LOGI(TAG, "cmd links (pool of %u): %u xfers, %u pool hits, %u heap fallbacks, %u templates; %u.%02u allocs per xfer, %u slots in use max",
+        CONFIG_I2C_DEVICE_CMD_POOL_SIZE, pool.transactions, pool.pool_hits, pool.heap_allocs, pool.template_runs,
+        allocs_x100 / 100, allocs_x100 % 100, pool.in_use_max);
+    i2c_stats_dump();
+
+    if (sht3x != NULL) {
+        i2c_bench_async(seconds, sht3x);
+    }
+    i2c_free_device(sht3x);
+}
+#endif
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+#if CONFIG_DUTY_CYCLE_SUPPORT
+/*
+    Duty-cycle scheduler: instead of running every task forever, run the
+    jobs that are due, work out when the next one is, and sleep until
+    then. Short gaps are slept in light sleep; longer ones in deep sleep,
+    woken by the PCF8563 when its INT line reaches a GPIO and by the
+    ESP32 sleep timer otherwise. Due times and the cycle reports live in
+    RTC memory, so they survive deep sleep; a cold boot starts over with
+    every job due at once.
+*/
+#define DUTYCYCLE_MAX_JOBS (4)
+
+/*
+    Runs when the job is due. Returns the seconds until it is due again,
+    or 0 to keep its period.
+*/
+typedef uint32_t (*dutycycle_job_fn_t)(void *arg);
+
+typedef struct {
+    const char *name;
+    uint32_t period_s;
+    dutycycle_job_fn_t run;
+    void *arg;
+} dutycycle_job_t;
+
+typedef enum {
+    DUTYCYCLE_SLEEP_LIGHT = 0,
+    DUTYCYCLE_SLEEP_DEEP_TIMER,     // ESP32 sleep timer
+    DUTYCYCLE_SLEEP_DEEP_RTC,       // PCF8563 timer or alarm, ESP32 timer as backup
+} dutycycle_sleep_t;
+
+/* One wake-to-sleep cycle, all times in ms. */
+typedef struct {
+    uint32_t cycle;
+    uint32_t wake_cause;            // esp_sleep_wakeup_cause_t
+    int32_t wake_late_ms;           // system time at wake minus the planned wake; includes boot
+    uint32_t boot_ms;               // reset to the scheduler, 0 after a light sleep
+    uint32_t job_ms[DUTYCYCLE_MAX_JOBS];
+    uint32_t awake_ms;              // reset or wake to sleep entry
+    uint32_t sleep_ms;              // planned
+    uint8_t jobs_run;               // bit per job that was due
+    uint8_t sleep;                  // dutycycle_sleep_t
+} dutycycle_report_t;
+
+typedef struct {
+    uint32_t cycles;
+    uint32_t deep_sleeps;
+    uint32_t light_sleeps;
+    uint64_t awake_ms;
+    uint64_t sleep_ms;
+} dutycycle_totals_t;
+
+/*
+    Run the jobs forever; does not return. The job list must be the same
+    on every boot: due times are matched to jobs by position.
+*/
+void dutycycle_run(const dutycycle_job_t *jobs, uint8_t count);
+
+/* The last completed cycle and the totals since cold boot. */
+void dutycycle_get_report(dutycycle_report_t *report, dutycycle_totals_t *totals);
+#endif
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#if CONFIG_FLASHLOG_SUPPORT
+/*
+    Append-only sensor log on the "history" data partition. The
+    partition is cut into erase-sector sized segments written in ring
+    order; each starts with a header (sequence number, base time, erase
+    count) followed by fixed 8-byte records. Segment base times form a
+    sparse in-RAM index, and records inside a segment are ordered, so a
+    range lookup is an index scan plus a binary search in one segment.
+*/
+#define FLASHLOG_CHANNELS (2)   // 0.01 degC, 0.01 %RH, as in history.h
+
+typedef struct {
+    uint32_t time_s;
+    int16_t values[FLASHLOG_CHANNELS];
+} flashlog_record_t;
+
+typedef struct {
+    uint32_t segments;          // usable segments in the partition
+    uint32_t segments_used;     // holding records
+    uint32_t segments_retired;  // skipped after a failed erase or write
+    uint32_t newest_s;          // time of the last record, 0 when empty
+    uint32_t records;           // appended since mount
+    uint32_t rejected;          // older than the last record
+    uint32_t corrupt;           // torn records skipped while reading
+    uint64_t bytes_programmed;  // headers and records since mount
+    uint64_t bytes_erased;
+    uint16_t erase_min;         // wear over the used segments
+    uint16_t erase_max;
+    uint32_t mount_us;
+    uint32_t tail_records;      // records scanned in the tail at mount
+} flashlog_stats_t;
+
+typedef struct {
+    uint32_t segment;           // physical segment being read
+    uint32_t seq;               // its sequence number when entered
+    uint32_t offset;            // byte offset of the next record in it
+    uint32_t to_s;
+    bool done;
+    uint32_t page_offset;       // partition offset of page[], or UINT32_MAX
+    uint8_t page[256];          // one flash page of records
+} flashlog_iter_t;
+
+typedef struct {
+    uint32_t records;
+    uint32_t append_per_s;
+    uint32_t query_records;     // records returned by a one-day range query
+    uint32_t query_per_s;
+    uint32_t mount_us;          // remount after the appends
+    uint32_t program_permille;  // flash bytes programmed per logical byte
+    uint32_t erase_permille;    // flash bytes erased per logical byte
+} flashlog_bench_t;
+
+/*
+    Mount the log: read every segment header to rebuild the index, then
+    scan only the newest segment for the append position. A record torn
+    by a power cut is skipped, not repaired.
+*/
+esp_err_t flashlog_init(void);
+
+void flashlog_deinit(void);
+
+/* Erase every segment. */
+esp_err_t flashlog_format(void);
+
+/*
+    Records must come in time order; older ones are rejected with
+    ESP_ERR_INVALID_ARG. The oldest segment is recycled once the
+    partition is full.
+*/
+esp_err_t flashlog_append(const flashlog_record_t *record);
+
+/* Position it on the first record at or after from_s. */
+esp_err_t flashlog_iter_init(flashlog_iter_t *it, uint32_t from_s, uint32_t to_s);
+
+bool flashlog_iter_next(flashlog_iter_t *it, flashlog_record_t *record);
+
+void flashlog_get_stats(flashlog_stats_t *stats);
+
+#if CONFIG_FLASHLOG_SIM
+/*
+    Format, append records one minute apart, remount and query a day.
+    Only on the emulated partition: it wipes the log.
+*/
+esp_err_t flashlog_benchmark(uint32_t records, flashlog_bench_t *result);
+#endif
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#if CONFIG_FLASHLOG_SUPPORT
+/*
+    Raw access to the log partition. On the device this is the
+    "history" data partition; with CONFIG_FLASHLOG_SIM it is a RAM image
+    with NOR semantics (erase to 0xFF, writes can only clear bits), so
+    the log and its recovery can run without touching flash. The host
+    build keeps the same image in a file (host/port/flashlog_part_file.c).
+*/
+#define FLASHLOG_SECTOR_SIZE (4096)
+
+esp_err_t flashlog_part_open(uint32_t *size);
+
+esp_err_t flashlog_part_read(uint32_t offset, void *data, size_t length);
+
+esp_err_t flashlog_part_write(uint32_t offset, const void *data, size_t length);
+
+esp_err_t flashlog_part_erase(uint32_t offset, size_t length);
+
+#if CONFIG_FLASHLOG_SIM
+/*
+    Make the next write program only its first bytes and fail, as a
+    power cut in the middle of it would.
+*/
+void flashlog_sim_tear_next_write(size_t bytes);
+#endif
+#endif
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#if CONFIG_HISTORY_SUPPORT
+/*
+    Fixed-memory, multi-resolution history of the ENV readings. Every
+    sample goes into all tiers at once: the raw tier keeps one value per
+    CONFIG_HISTORY_RAW_PERIOD_S, the others keep min/max/mean/count per
+    bucket. Tiers are rings indexed by bucket number (time / period), so
+    inserting is O(1) per tier and there is no roll-up pass.
+*/
+#define HISTORY_TIERS (3)
+#define HISTORY_TIER_AUTO (-1)
+
+typedef enum {
+    HISTORY_TEMPERATURE = 0,    // 0.01 degC
+    HISTORY_HUMIDITY,           // 0.01 %RH
+    HISTORY_CHANNELS
+} history_channel_t;
+
+/* One bucket; for the raw tier min == max == mean. */
+typedef struct {
+    uint32_t time_s;            // bucket start, epoch seconds
+    int16_t min;
+    int16_t max;
+    int16_t mean;
+    uint16_t count;             // samples in the bucket
+} history_point_t;
+
+typedef struct {
+    uint32_t period_s;
+    uint32_t slots;
+    uint32_t oldest_s;          // start of the oldest bucket kept, 0 while empty
+    uint32_t newest_s;
+} history_tier_info_t;
+
+typedef struct _history_t history_t;
+
+/*
+    Walks one tier from old to new, skipping empty buckets. Safe against
+    concurrent inserts: buckets overwritten while walking are skipped.
+*/
+typedef struct {
+    history_t *history;
+    uint8_t channel;
+    uint8_t tier;
+    uint32_t bucket;            // next bucket number to visit
+    uint32_t last;              // last bucket number in range
+} history_iter_t;
+
+typedef struct {
+    uint32_t inserts;
+    uint32_t insert_ns;         // per insert, all tiers and channels
+    uint32_t query_points[HISTORY_TIERS];
+    uint32_t query_points_per_s[HISTORY_TIERS];
+} history_bench_t;
+
+/* The store fed by the ENV task; NULL until history_init(). */
+history_t *history_get(void);
+
+esp_err_t history_init(void);
+
+/*
+    Add one reading of every channel taken at time_s. Readings older
+    than the newest raw bucket are dropped; a clock step back further
+    than the raw tier covers clears the store.
+*/
+void history_insert(history_t *history, uint32_t time_s, const int32_t values[HISTORY_CHANNELS]);
+
+void history_clear(history_t *history);
+
+void history_tier_info(history_t *history, uint8_t tier, history_tier_info_t *info);
+
+/*
+    Position it on [from_s, to_s] of tier, or with HISTORY_TIER_AUTO on
+    the finest tier that still reaches back to from_s. Returns the tier
+    used, or -1 for an empty range.
+*/
+int8_t history_iter_init(history_iter_t *it, history_t *history, uint8_t channel, int8_t tier, uint32_t from_s, uint32_t to_s);
+
+bool history_iter_next(history_iter_t *it, history_point_t *point);
+
+/* Copies up to max_points buckets of a range; returns how many. */
+size_t history_query(history_t *history, uint8_t channel, int8_t tier, uint32_t from_s, uint32_t to_s,
+                     history_point_t *points, size_t max_points);
+
+/*
+    Fill a scratch store (allocated for the run) with inserts readings
+    spaced one raw period apart, then read every tier back in full, over
+    and over for at least 10 ms per tier.
+*/
+esp_err_t history_benchmark(uint32_t inserts, history_bench_t *result);
+#endif
@@ -0,0 +1,10 @@
+#pragma once
+
+#if CONFIG_I2C_SIM_BENCHMARK
+/*
+    Replay CONFIG_I2C_SIM_BENCHMARK_SECONDS of the application's I2C
+    traffic on the simulated bus, back to back, and log the bus time and
+    transaction rate it needs.
+*/
+void i2c_bench_run(void);
+#endif
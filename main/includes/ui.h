@@ -44,5 +44,9 @@ void ui_button_label_update(bool state);
 void ui_wifi_label_update(bool state);
 #endif
 
+#if CONFIG_VIBRATION_SUPPORT
+void ui_vibration_update(int32_t rms_mg);
+#endif
+
 void ui_init();
 #endif
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "mpu6886.h"
+
+#if CONFIG_VIBRATION_SUPPORT
+#define VIBRATION_WINDOW CONFIG_VIBRATION_WINDOW
+#define VIBRATION_HOP CONFIG_VIBRATION_HOP
+#define VIBRATION_MAX_BANDS (8)
+
+/*
+    Features of one window of accelerometer samples, per axis, in G.
+    The mean (gravity) is removed first, so the band energies of one
+    axis add up to its rms squared.
+*/
+typedef struct {
+    int64_t timestamp_us;       // last sample of the window
+    float rms[3];
+    float peak_to_peak[3];
+    float crest[3];             // peak / rms
+    float band_energy[3][VIBRATION_MAX_BANDS];  // G^2
+    uint8_t bands;
+} vibration_features_t;
+
+typedef struct {
+    uint32_t frames;            // samples fed in
+    uint32_t windows;           // windows processed
+    uint32_t dropped;           // feature vectors the consumer did not take in time
+    uint32_t process_us_avg;    // per window, all three axes
+    uint32_t process_us_max;
+    uint32_t load_permille;     // processing time over wall time since start
+} vibration_stats_t;
+
+/*
+    Band edges in Hz, ascending; count edges make count - 1 bands.
+    Only while stopped. The default is CONFIG_VIBRATION_BAND_EDGES_HZ.
+*/
+esp_err_t vibration_set_bands(const uint16_t *edges_hz, uint8_t count);
+
+/*
+    Streams the MPU6886 FIFO at rate_hz and runs the feature extraction
+    on every VIBRATION_HOP new samples over the last VIBRATION_WINDOW.
+*/
+esp_err_t vibration_start(uint16_t rate_hz);
+
+void vibration_stop(void);
+
+/*
+    Runs the feature extraction on one window of samples, in G, oldest
+    first, as if streamed at rate_hz; for tests and benchmarks of the
+    kernels. Only while stopped: it shares the pipeline's buffers.
+*/
+esp_err_t vibration_analyze(const float samples[3][VIBRATION_WINDOW], uint16_t rate_hz, vibration_features_t *features);
+
+/* Takes the next feature vector, waiting up to ticks_to_wait. */
+bool vibration_receive(vibration_features_t *features, TickType_t ticks_to_wait);
+
+void vibration_get_stats(vibration_stats_t *stats);
+#endif
@@ -31,4 +31,5 @@ EventGroupHandle_t wifi_event_group;
 
 //bool wifi_isConnected(void);
 esp_err_t wifi_isConnected(void);
-void initialise_wifi(void);
\ No newline at end of file
+void initialise_wifi(void);
+void wifi_stop(void);
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -9,6 +10,7 @@
 #include "freertos/queue.h"
 
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "m5stick.h"
 
 #if CONFIG_SOFTWARE_WIFI_SUPPORT
@@ -23,6 +25,37 @@
 #include "esp_sntp.h"
 #endif
 
+#if CONFIG_CLOCKDISC_SIM_DEMO
+#include "clockdisc.h"
+#endif
+
+#if CONFIG_I2C_SIM_BENCHMARK
+#include "i2c_bench.h"
+#endif
+
+#if CONFIG_MPU6886_AHRS_DEMO
+#include "ahrs.h"
+#endif
+
+#if CONFIG_VIBRATION_SUPPORT
+#include "vibration.h"
+#endif
+
+#if CONFIG_HISTORY_SUPPORT
+#include <time.h>
+#include "history.h"
+#endif
+
+#if CONFIG_FLASHLOG_SUPPORT
+#include <time.h>
+#include "esp_attr.h"
+#include "flashlog.h"
+#endif
+
+#if CONFIG_DUTY_CYCLE_SUPPORT
+#include "dutycycle.h"
+#endif
+
 #if ( CONFIG_SOFTWARE_UNIT_ENV2_SUPPORT \
     || CONFIG_SOFTWARE_UNIT_SK6812_SUPPORT )
 #include "m5unit.h"
@@ -124,10 +157,26 @@ static void button_task(void* pvParameters) {
 
 #if CONFIG_SOFTWARE_RTC_SUPPORT
 TaskHandle_t xRtc;
-TaskHandle_t xClock;
 static bool g_timeInitialized = false;
 const char servername[] = "ntp.jst.mfeed.ad.jp";
 
+static void boot_times_log(void)
+{
+    static const char *sources[] = { "none", "RTC", "NTP" };
+    m5stick_boot_t boot;
+    timesvc_stats_t stats;
+    M5Stick_GetBootTimes(&boot);
+    TimeSvc_GetStats(&stats);
+    ESP_LOGI(TAG, "boot: init at %u ms, pmu +%u, rtc +%u (%s), display +%u, rest +%u",
+             (uint32_t)(boot.start_us / 1000), (uint32_t)((boot.pmu_us - boot.start_us) / 1000),
+             (uint32_t)((boot.rtc_us - boot.pmu_us) / 1000), esp_err_to_name(boot.rtc_err),
+             (uint32_t)((boot.display_us - boot.rtc_us) / 1000), (uint32_t)((boot.done_us - boot.display_us) / 1000));
+    // 0 ms: not reached yet
+    ESP_LOGI(TAG, "boot: time from %s, valid at %u ms, second edge at %u ms, NTP at %u ms",
+             sources[stats.source], (uint32_t)(stats.valid_us / 1000),
+             (uint32_t)(stats.edge_sync_us / 1000), (uint32_t)(stats.ntp_us / 1000));
+}
+
 static void time_sync_notification_cb(struct timeval *tv)
 {
     ESP_LOGI(TAG, "Notification of a time synchronization event");
@@ -139,10 +188,6 @@ void vLoopRtcTask(void *pvParametes)
     //PCF8563
     ESP_LOGI(TAG, "start vLoopRtcTask. TaskDelayTime");
 
-    // Set timezone to Japan Standard Time
-    setenv("TZ", "JST-9", 1);
-    tzset();
-
     ESP_LOGI(TAG, "ServerName:%s", servername);
     sntp_setservername(0, servername);
     sntp_set_time_sync_notification_cb(time_sync_notification_cb);
@@ -169,73 +214,283 @@ void vLoopRtcTask(void *pvParametes)
         sprintf(str1,"NTP Update : %04d/%02d/%02d %02d:%02d", timeinfo.tm_year+1900, timeinfo.tm_mon+1, timeinfo.tm_mday, timeinfo.tm_hour, timeinfo.tm_min);
         ESP_LOGI(TAG, "%s", str1);
 
-        rtc_date_t rtcdate;
-        rtcdate.year = timeinfo.tm_year+1900;
-        rtcdate.month = timeinfo.tm_mon+1;
-        rtcdate.day = timeinfo.tm_mday;
-        rtcdate.hour = timeinfo.tm_hour;
-        rtcdate.minute = timeinfo.tm_min;
-        rtcdate.second = timeinfo.tm_sec;
-        PCF8563_SetTime(&rtcdate);
+        // Spaced by how well the clocks are known to keep time.
+        uint32_t next_s = TimeSvc_NtpSynced();
+        static bool first_sync = true;
+        if (first_sync) {
+            boot_times_log();
+            first_sync = false;
+        }
 
         g_timeInitialized = false;
         sntp_stop();
 
-        vTaskDelay( pdMS_TO_TICKS(600000) );
+        while (next_s > 0) {
+            uint32_t wait_s = (next_s > 3600) ? 3600 : next_s;
+            vTaskDelay( pdMS_TO_TICKS(wait_s * 1000) );
+            next_s -= wait_s;
+        }
     }
 }
 
-void vLoopClockTask(void *pvParametes)
+#if CONFIG_DUTY_CYCLE_SUPPORT && CONFIG_SOFTWARE_WIFI_SUPPORT
+// Wi-Fi is up only for as long as one sync takes.
+static uint32_t duty_ntp_job(void *arg)
 {
-    //PCF8563
-    ESP_LOGI(TAG, "start vLoopClockTask.");
- 
-    // Set timezone to Japan Standard Time
-    setenv("TZ", "JST-9", 1);
-    tzset();
+    int64_t deadline_us = esp_timer_get_time() + CONFIG_DUTY_NTP_TIMEOUT_S * 1000000LL;
+    uint32_t next_s = 0;
+    initialise_wifi();
+    EventBits_t bits = xEventGroupWaitBits(wifi_event_group, CONNECTED_BIT, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(CONFIG_DUTY_NTP_TIMEOUT_S * 1000));
+    if (bits & CONNECTED_BIT) {
+        g_timeInitialized = false;
+        sntp_setservername(0, servername);
+        sntp_set_time_sync_notification_cb(time_sync_notification_cb);
+        sntp_init();
+        while (!g_timeInitialized && esp_timer_get_time() < deadline_us) {
+            vTaskDelay( pdMS_TO_TICKS(100) );
+        }
+        sntp_stop();
+        if (g_timeInitialized) {
+            next_s = TimeSvc_NtpSynced();
+        }
+        g_timeInitialized = false;
+    }
+    wifi_stop();
+    if (next_s == 0) {
+        ESP_LOGW(TAG, "NTP sync failed, retrying in %u s", CONFIG_DUTY_NTP_RETRY_S);
+    }
+    return next_s;
+}
+#endif
 
-    while (1) {
-        rtc_date_t rtcdate;
-        PCF8563_GetTime(&rtcdate);
-        char str1[30] = {0};
-        sprintf(str1,"%04d/%02d/%02d %02d:%02d:%02d", rtcdate.year, rtcdate.month, rtcdate.day, rtcdate.hour, rtcdate.minute, rtcdate.second);
+#if !CONFIG_DUTY_CYCLE_SUPPORT
+static void clock_tick(time_t now, void *arg)
+{
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
+    char str1[30] = {0};
+    strftime(str1, sizeof(str1), "%Y/%m/%d %H:%M:%S", &timeinfo);
 #if CONFIG_SOFTWARE_UI_SUPPORT
-        ui_datetime_set(str1);
+    ui_datetime_set(str1);
 #endif
-
-        vTaskDelay( pdMS_TO_TICKS(990) );
-    }
 }
 #endif
+#endif
 
 #if CONFIG_SOFTWARE_UNIT_ENV2_SUPPORT
 TaskHandle_t xUnitEnv2;
+#if CONFIG_FLASHLOG_SUPPORT
+#define UNIT_ENV2_CLOCK_SET_S (1577836800)  // 2020-01-01, earlier means not synced yet
+#endif
+
+static void unit_env2_log(sht3x_t **sensors, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        sht3x_stats_t stats;
+        Sht3x_GetStats(sensors[i], &stats);
+        // Sign apart, or -0.50 would print as 0.50.
+        int32_t centi_t = Sht3x_GetCentiTemperature(sensors[i]);
+        ESP_LOGI(TAG, "sht3x[%u] temperature:%s%d.%02d, humidity:%d.%02d (samples %u, dropped %u, invalid %u, not ready %u)", i,
+                 (centi_t < 0) ? "-" : "", abs(centi_t) / 100, abs(centi_t) % 100,
+                 Sht3x_GetCentiHumidity(sensors[i]) / 100, Sht3x_GetCentiHumidity(sensors[i]) % 100,
+                 stats.samples, stats.dropped, stats.invalid, stats.not_ready);
+    }
+}
+
+static void unit_env2_record(sht3x_t *sensor) {
+#if CONFIG_SOFTWARE_UI_SUPPORT
+    ui_temperature_update( Sht3x_GetIntTemperature(sensor) );
+    ui_humidity_update( Sht3x_GetIntHumidity(sensor) );
+#endif
+#if CONFIG_HISTORY_SUPPORT
+    int32_t values[HISTORY_CHANNELS] = {
+        [HISTORY_TEMPERATURE] = Sht3x_GetCentiTemperature(sensor),
+        [HISTORY_HUMIDITY] = Sht3x_GetCentiHumidity(sensor),
+    };
+    history_insert(history_get(), (uint32_t)time(NULL), values);
+#endif
+#if CONFIG_FLASHLOG_SUPPORT
+    // Only once the clock is set: the log must stay in time order.
+    // Kept through deep sleep, which restarts the app.
+    static RTC_DATA_ATTR uint32_t logged_s;
+    uint32_t now_s = (uint32_t)time(NULL);
+    if (now_s >= UNIT_ENV2_CLOCK_SET_S && now_s - logged_s >= CONFIG_FLASHLOG_PERIOD_S) {
+        flashlog_record_t record = {
+            .time_s = now_s,
+            .values = { Sht3x_GetCentiTemperature(sensor), Sht3x_GetCentiHumidity(sensor) },
+        };
+        if (flashlog_append(&record) == ESP_OK) {
+            logged_s = now_s;
+        }
+    }
+#endif
+}
+
+#if CONFIG_FLASHLOG_RESTORE_HISTORY
+// Replay the span the long tier can hold, so the history survives a reboot.
+static void unit_env2_restore_history(void) {
+    flashlog_stats_t stats;
+    flashlog_get_stats(&stats);
+    uint32_t span_s = CONFIG_HISTORY_LONG_PERIOD_S * CONFIG_HISTORY_LONG_SLOTS;
+    uint32_t from_s = (stats.newest_s > span_s) ? stats.newest_s - span_s : 0;
+    flashlog_iter_t *it = malloc(sizeof(flashlog_iter_t));
+    if (it == NULL || stats.newest_s == 0) {
+        free(it);
+        return ;
+    }
+    int64_t start = esp_timer_get_time();
+    uint32_t restored = 0;
+    flashlog_record_t record;
+    flashlog_iter_init(it, from_s, stats.newest_s);
+    while (flashlog_iter_next(it, &record)) {
+        int32_t values[HISTORY_CHANNELS] = {
+            [HISTORY_TEMPERATURE] = record.values[0],
+            [HISTORY_HUMIDITY] = record.values[1],
+        };
+        history_insert(history_get(), record.time_s, values);
+        restored++;
+    }
+    free(it);
+    ESP_LOGI(TAG, "history: %u records restored from flash in %u ms", restored,
+             (uint32_t)((esp_timer_get_time() - start) / 1000));
+}
+#endif
+
+static const sht3x_config_t unit_env2_config = {
+    .i2c_num = I2C_NUM_0,
+    .sda = PORT_A_SDA_PIN,
+    .scl = PORT_A_SCL_PIN,
+    .baud = PORT_A_I2C_STANDARD_BAUD,
+    .addr = SHT3X_ADDR_DEFAULT,
+    .hub_channel = CONFIG_UNIT_ENV2_HUB_CHANNEL,
+    .hub_addr = SHT3X_HUB_ADDR,
+    .name = "SHT3X",
+};
+
+#if CONFIG_DUTY_CYCLE_SUPPORT
+static uint32_t duty_env_job(void *arg)
+{
+    // Set up again after every deep-sleep wake.
+    static sht3x_t *sensor;
+    if (sensor == NULL) {
+        sensor = Sht3x_Init(&unit_env2_config);
+        if (sensor == NULL) {
+            ESP_LOGE(TAG, "Sht3x_Init() failed");
+            return 0;
+        }
+    }
+    if (Sht3x_Read(sensor) == ESP_OK) {
+        unit_env2_record(sensor);
+        unit_env2_log(&sensor, 1);
+    } else {
+        ESP_LOGE(TAG, "Sht3x measurement failed");
+    }
+    return 0;
+}
+#endif
+
+#define UNIT_ENV2_RETRY_US (5000000)  // periodic start retry while a sensor is not running
+
+static void unit_env2_sleep_until(int64_t ready_us) {
+    // INT64_MAX: nothing is measuring, only a retry to wait for.
+    int64_t wait_us = (ready_us == INT64_MAX) ? UNIT_ENV2_RETRY_US : ready_us - esp_timer_get_time();
+    vTaskDelay((wait_us > 1000) ? pdMS_TO_TICKS(wait_us / 1000) + 1 : 1);
+}
+
 void vLoopUnitEnv2Task(void *pvParametes)
 {
     ESP_LOGI(TAG, "start I2C Sht3x");
-    esp_err_t ret = ESP_OK;
-    ret = Sht3x_Init(I2C_NUM_0, PORT_A_SDA_PIN, PORT_A_SCL_PIN, PORT_A_I2C_STANDARD_BAUD);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Sht3x_I2CInit Error");
-        return;
+    sht3x_config_t config = unit_env2_config;
+    sht3x_t *sensors[2];
+    uint8_t count = 0;
+    sensors[count++] = Sht3x_Init(&config);
+#if CONFIG_UNIT_ENV2_SECOND_SENSOR
+    config.addr = SHT3X_ADDR_ALT;
+    config.name = "SHT3X-45";
+    sensors[count++] = Sht3x_Init(&config);
+#endif
+    for (uint8_t i = 0; i < count; i++) {
+        if (sensors[i] == NULL) {
+            ESP_LOGE(TAG, "Sht3x_Init() failed for sensor %u", i);
+            vTaskDelete(NULL);
+        }
     }
     ESP_LOGI(TAG, "Sht3x_Init() is OK!");
+#if CONFIG_UNIT_ENV2_SHT3X_SINGLE_SHOT
+    TickType_t last_wake = xTaskGetTickCount();
     while (1) {
-        ret = Sht3x_Read();
-        if (ret == ESP_OK) {
-            vTaskDelay( pdMS_TO_TICKS(100) );
-            ESP_LOGI(TAG, "temperature:%f, humidity:%f", Sht3x_GetTemperature(), Sht3x_GetHumidity());
-#if CONFIG_SOFTWARE_UI_SUPPORT
-            ui_temperature_update( Sht3x_GetIntTemperature() );
-            ui_humidity_update( Sht3x_GetIntHumidity() );
-#endif
+        // All conversions run in parallel; sleep through them, then collect.
+        Sht3x_TriggerAll(sensors, count);
+        int64_t ready_us;
+        while ((ready_us = Sht3x_NextReadyAt(sensors, count)) != INT64_MAX) {
+            unit_env2_sleep_until(ready_us);
+            Sht3x_PollAll(sensors, count);
+        }
+        if (Sht3x_GetState(sensors[0]) == SHT3X_STATE_DONE) {
+            unit_env2_record(sensors[0]);
         } else {
-            ESP_LOGE(TAG, "Sht3x_Read() is error code:%d", ret);
-            vTaskDelay( pdMS_TO_TICKS(10000) );
+            ESP_LOGE(TAG, "Sht3x measurement failed");
         }
+        unit_env2_log(sensors, count);
 
-        vTaskDelay( pdMS_TO_TICKS(5000) );
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(5000));
+    }
+#else
+#if CONFIG_UNIT_ENV2_SHT3X_PERIODIC_0_5
+    const sht3x_rate_t rate = SHT3X_PERIODIC_0_5_MPS;
+#elif CONFIG_UNIT_ENV2_SHT3X_PERIODIC_1
+    const sht3x_rate_t rate = SHT3X_PERIODIC_1_MPS;
+#elif CONFIG_UNIT_ENV2_SHT3X_PERIODIC_2
+    const sht3x_rate_t rate = SHT3X_PERIODIC_2_MPS;
+#elif CONFIG_UNIT_ENV2_SHT3X_PERIODIC_4
+    const sht3x_rate_t rate = SHT3X_PERIODIC_4_MPS;
+#elif CONFIG_UNIT_ENV2_SHT3X_PERIODIC_10
+    const sht3x_rate_t rate = SHT3X_PERIODIC_10_MPS;
+#else
+    const sht3x_rate_t rate = SHT3X_PERIODIC_ART;
+#endif
+    // A sensor whose start failed is IDLE and out of Sht3x_NextReadyAt();
+    // it is retried every UNIT_ENV2_RETRY_US.
+    int64_t retry_us = 0;
+    int64_t last_log_us = 0;
+    while (1) {
+        if (esp_timer_get_time() >= retry_us) {
+            retry_us = esp_timer_get_time() + UNIT_ENV2_RETRY_US;
+            for (uint8_t i = 0; i < count; i++) {
+                if (Sht3x_GetState(sensors[i]) != SHT3X_STATE_IDLE) {
+                    continue;
+                }
+                esp_err_t ret = Sht3x_StartPeriodic(sensors[i], rate);
+                if (ret != ESP_OK) {
+                    ESP_LOGE(TAG, "sht3x[%u] Sht3x_StartPeriodic() is error code:%d", i, ret);
+                }
+            }
+        }
+        int64_t ready_us = Sht3x_NextReadyAt(sensors, count);
+        unit_env2_sleep_until((ready_us < retry_us) ? ready_us : retry_us);
+        uint8_t fresh = Sht3x_PollAll(sensors, count);
+        for (uint8_t i = 0; i < count; i++) {
+            if (Sht3x_GetState(sensors[i]) == SHT3X_STATE_ERROR) {
+                ESP_LOGE(TAG, "sht3x[%u] periodic samples stopped, restarting", i);
+                if (Sht3x_StartPeriodic(sensors[i], rate) != ESP_OK) {
+                    // Left IDLE by the break; the retry above picks it up.
+                    retry_us = esp_timer_get_time() + UNIT_ENV2_RETRY_US;
+                }
+            }
+        }
+        if (fresh == 0) {
+            continue;
+        }
+        if (Sht3x_GetState(sensors[0]) == SHT3X_STATE_DONE) {
+            unit_env2_record(sensors[0]);
+        }
+        int64_t now = esp_timer_get_time();
+        if (now - last_log_us >= 5000000) {
+            last_log_us = now;
+            unit_env2_log(sensors, count);
+        }
     }
+#endif
 }
 #endif
 
@@ -244,6 +499,165 @@ TaskHandle_t xMPU6886;
 static void mpu6886_task(void* pvParameters) {
     ESP_LOGI(TAG, "start mpu6886_task");
 
+#if CONFIG_MPU6886_CALIBRATE_AT_START
+    mpu6886_calibration_t calibration;
+    if (MPU6886_Calibrate(300, &calibration) != ESP_OK) {
+        ESP_LOGE(TAG, "MPU6886_Calibrate() failed");
+    }
+#endif
+
+#if CONFIG_MPU6886_JITTER_DEMO
+    static const char *mode_names[] = { "poll", "data-ready" };
+    mpu6886_acq_mode_t mode = MPU6886_ACQ_POLL;
+    mpu6886_frame_t frame;
+    while (1) {
+        if (MPU6886_AcquireStart(mode, 200) == ESP_OK) {
+            for (int i = 0; i < 100; i++) {
+                while (MPU6886_StreamRead(&frame)) {
+                }
+                vTaskDelay(pdMS_TO_TICKS(100));
+            }
+            MPU6886_AcquireStop();
+            mpu6886_jitter_stats_t jitter;
+            MPU6886_GetJitterStats(&jitter);
+            ESP_LOGI(TAG, "MPU6886 %s: %u samples, interval %u..%u us, mean %.1f us, stddev %.1f us, %u missed, %u timeouts",
+                mode_names[mode], jitter.samples, jitter.min_us, jitter.max_us,
+                jitter.mean_us, jitter.stddev_us, jitter.missed, jitter.timeouts);
+        } else {
+            ESP_LOGE(TAG, "MPU6886_AcquireStart(%s) failed", mode_names[mode]);
+            vTaskDelay(pdMS_TO_TICKS(10000));
+        }
+        mode = (mode == MPU6886_ACQ_POLL) ? MPU6886_ACQ_DATA_READY : MPU6886_ACQ_POLL;
+    }
+#elif CONFIG_MPU6886_AHRS_DEMO
+    const uint32_t record_frames = 2000;
+    mpu6886_frame_t *frames = malloc(record_frames * sizeof(mpu6886_frame_t));
+    if (frames == NULL
+        || (MPU6886_AcquireStart(MPU6886_ACQ_DATA_READY, 200) != ESP_OK
+            && MPU6886_AcquireStart(MPU6886_ACQ_POLL, 200) != ESP_OK)) {
+        ESP_LOGE(TAG, "MPU6886 AHRS demo failed to start");
+        free(frames);
+        vTaskDelete(NULL);
+    }
+    uint32_t recorded = 0;
+    while (recorded < record_frames) {
+        while (recorded < record_frames && MPU6886_StreamRead(&frames[recorded])) {
+            recorded++;
+        }
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    ahrs_bench_t bench;
+    Ahrs_Benchmark(frames, recorded, AHRS_DEFAULT_KP, AHRS_DEFAULT_KI, &bench);
+    free(frames);
+    ESP_LOGI(TAG, "AHRS %u frames: float %.2f us, fixed %.2f us per update, divergence max %.3f deg, final %.3f deg",
+        bench.frames, bench.float_us, bench.fixed_us, bench.max_error_deg, bench.final_error_deg);
+
+    ahrs_fixed_t ahrs;
+    Ahrs_FixedInit(&ahrs, AHRS_DEFAULT_KP, AHRS_DEFAULT_KI);
+    mpu6886_frame_t frame;
+    ahrs_quat_t quat;
+    ahrs_euler_t euler;
+    uint32_t ticks = 0;
+    while (1) {
+        while (MPU6886_StreamRead(&frame)) {
+            Ahrs_FixedUpdate(&ahrs, &frame);
+        }
+        if (++ticks % 50 == 0) {
+            Ahrs_FixedGetQuat(&ahrs, &quat);
+            Ahrs_QuatToEuler(&quat, &euler);
+            ESP_LOGI(TAG, "AHRS roll %.1f, pitch %.1f, yaw %.1f", euler.roll, euler.pitch, euler.yaw);
+        }
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+#elif CONFIG_MPU6886_WOM_DEMO
+    mpu6886_wom_config_t wom = { .threshold_mg = 80, .wake_rate_hz = 10, .stream_rate_hz = 200 };
+    mpu6886_frame_t frame;
+    // Reference current with the IMU fully powered and streaming.
+    if (MPU6886_StreamStart(200, 4) != ESP_OK) {
+        ESP_LOGE(TAG, "MPU6886_StreamStart() failed");
+        vTaskDelete(NULL);
+    }
+    float full_ma = Axp192_GetBatCurrentAvg(10000);
+    MPU6886_StreamStop();
+    if (MPU6886_WomStart(&wom) != ESP_OK) {
+        ESP_LOGE(TAG, "MPU6886_WomStart() failed");
+        vTaskDelete(NULL);
+    }
+    float wom_ma = Axp192_GetBatCurrentAvg(10000);
+    ESP_LOGI(TAG, "MPU6886 battery current: streaming %.1f mA, wake-on-motion %.1f mA", full_ma, wom_ma);
+
+    mpu6886_wom_event_t event;
+    while (1) {
+        esp_err_t err = MPU6886_WomWait(&event, 60000);
+        if (err == ESP_ERR_TIMEOUT) {
+            continue;
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "MPU6886_WomWait() failed");
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            MPU6886_WomStart(&wom);
+            continue;
+        }
+        ESP_LOGI(TAG, "MPU6886 motion on axes 0x%x, streaming", event.axes);
+        uint32_t frames = 0;
+        for (int i = 0; i < 50; i++) {
+            while (MPU6886_StreamRead(&frame)) {
+                frames++;
+            }
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+        MPU6886_StreamStop();
+        ESP_LOGI(TAG, "MPU6886 %u frames, back to wake-on-motion", frames);
+        MPU6886_WomStart(&wom);
+    }
+#elif CONFIG_VIBRATION_SUPPORT
+    if (vibration_start(CONFIG_VIBRATION_RATE_HZ) != ESP_OK) {
+        ESP_LOGE(TAG, "vibration_start() failed");
+        vTaskDelete(NULL);
+    }
+    // Only feature vectors leave this task; raw samples stay in the pipeline.
+    vibration_features_t features;
+    int64_t last_log_us = 0;
+    while (1) {
+        if (!vibration_receive(&features, portMAX_DELAY)) {
+            continue;
+        }
+#if CONFIG_SOFTWARE_UI_SUPPORT
+        float rms = sqrtf(features.rms[0] * features.rms[0] + features.rms[1] * features.rms[1]
+                          + features.rms[2] * features.rms[2]);
+        ui_vibration_update((int32_t)(rms * 1000.0f));
+#endif
+        if (features.timestamp_us - last_log_us >= 5000000) {
+            last_log_us = features.timestamp_us;
+            vibration_stats_t stats;
+            vibration_get_stats(&stats);
+            ESP_LOGI(TAG, "VIB rms %.3f/%.3f/%.3f G, p-p z %.3f G, crest z %.2f, %u windows, %u us/window (max %u), load %u.%u%%, %u dropped",
+                features.rms[0], features.rms[1], features.rms[2], features.peak_to_peak[2], features.crest[2],
+                stats.windows, stats.process_us_avg, stats.process_us_max,
+                stats.load_permille / 10, stats.load_permille % 10, stats.dropped);
+        }
+    }
+#elif CONFIG_MPU6886_STREAM_RATE_HZ > 0
+    // Drain every 20 ms worth of samples; consume the ring each 100 ms.
+    uint16_t watermark = (CONFIG_MPU6886_STREAM_RATE_HZ + 49) / 50;
+    if (MPU6886_StreamStart(CONFIG_MPU6886_STREAM_RATE_HZ, watermark) != ESP_OK) {
+        ESP_LOGE(TAG, "MPU6886_StreamStart() failed");
+        vTaskDelete(NULL);
+    }
+    mpu6886_frame_t frame;
+    uint32_t ticks = 0;
+    while (1) {
+        while (MPU6886_StreamRead(&frame)) {
+        }
+        if (++ticks % 50 == 0) {
+            mpu6886_stream_stats_t stats;
+            MPU6886_StreamGetStats(&stats);
+            ESP_LOGI(TAG, "MPU6886 stream %.1f Hz, %u frames, %u drains, %u overflows, %u dropped",
+                stats.rate_hz, stats.frames, stats.drains, stats.fifo_overflows, stats.ring_drops);
+        }
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+#else
     float ax, ay, az;
     while (1) {
         MPU6886_GetAccelData(&ax, &ay, &az);
@@ -251,6 +665,7 @@ static void mpu6886_task(void* pvParameters) {
 
         vTaskDelay(pdMS_TO_TICKS(5000));
     }
+#endif
     vTaskDelete(NULL); // Should never get to here...
 }
 #endif
@@ -401,13 +816,20 @@ void app_main()
     esp_log_level_set("MY-MAIN", ESP_LOG_INFO);
     esp_log_level_set("MY-UI", ESP_LOG_INFO);
     esp_log_level_set("MY-WIFI", ESP_LOG_INFO);
+    esp_log_level_set("MY-VIB", ESP_LOG_INFO);
 
     M5Stick_Init();
 
-#if CONFIG_SOFTWARE_UI_SUPPORT
+#if CONFIG_I2C_SIM_BENCHMARK
+    esp_log_level_set("MY-BENCH", ESP_LOG_INFO);
+    esp_log_level_set("I2C-DEVICE", ESP_LOG_INFO);
+    i2c_bench_run();
+#endif
+
+#if CONFIG_SOFTWARE_UI_SUPPORT && !CONFIG_DUTY_CYCLE_SUPPORT
     ui_init();
 #endif
-#if CONFIG_SOFTWARE_WIFI_SUPPORT
+#if CONFIG_SOFTWARE_WIFI_SUPPORT && !CONFIG_DUTY_CYCLE_SUPPORT
     initialise_wifi();
 #endif
 
@@ -416,16 +838,72 @@ void app_main()
     xTaskCreatePinnedToCore(&button_task, "button_task", 4096 * 1, NULL, 2, &xButton, 1);
 #endif
 
-#if CONFIG_SOFTWARE_RTC_SUPPORT
+#if CONFIG_CLOCKDISC_SIM_DEMO
+    // drift, wander per hour (ppb), reading jitter (us)
+    static const int32_t oscillators[][3] = {
+        { 20000, 0, 5000 }, { -35000, 0, 5000 }, { 20000, 300, 5000 }, { 5000, 100, 20000 },
+    };
+    for (uint8_t i = 0; i < sizeof(oscillators) / sizeof(oscillators[0]); i++) {
+        clockdisc_sim_t sim;
+        ClockDisc_Simulate(oscillators[i][0], oscillators[i][1], oscillators[i][2], 30, CONFIG_CLOCKDISC_MAX_ERROR_MS, &sim);
+        ESP_LOGI(TAG, "clockdisc: %d ppb, wander %d ppb/h, jitter %d us: %u syncs, mean %u s apart, max error %u us, estimate %d ppb",
+                 oscillators[i][0], oscillators[i][1], oscillators[i][2], sim.syncs, sim.mean_interval_s, sim.max_error_us, sim.freq_ppb);
+    }
+#endif
+
+#if CONFIG_SOFTWARE_RTC_SUPPORT && !CONFIG_DUTY_CYCLE_SUPPORT
+    // clock: M5Stick_Init() restored the time if the RTC had it
+    TimeSvc_Init(clock_tick, NULL);
+    boot_times_log();
 #if CONFIG_SOFTWARE_WIFI_SUPPORT
     // rtc
     xTaskCreatePinnedToCore(&vLoopRtcTask, "rtc_task", 4096 * 1, NULL, 2, &xRtc, 1);
 #endif
-    // clock
-    xTaskCreatePinnedToCore(&vLoopClockTask, "clock_task", 4096 * 1, NULL, 2, &xClock, 1);
 #endif
 
 #if CONFIG_SOFTWARE_UNIT_ENV2_SUPPORT
+#if CONFIG_HISTORY_SUPPORT
+    esp_log_level_set("MY-HIST", ESP_LOG_INFO);
+    history_init();
+#if CONFIG_HISTORY_BENCHMARK
+    history_bench_t bench;
+    if (history_benchmark(86400 / CONFIG_HISTORY_RAW_PERIOD_S, &bench) == ESP_OK) {
+        ESP_LOGI(TAG, "history: %u inserts at %u ns, query %u/%u/%u points/s (raw/mid/long)",
+                 bench.inserts, bench.insert_ns, bench.query_points_per_s[0],
+                 bench.query_points_per_s[1], bench.query_points_per_s[2]);
+    }
+#endif
+#endif
+#if CONFIG_FLASHLOG_SUPPORT
+    esp_log_level_set("MY-FLOG", ESP_LOG_INFO);
+#if CONFIG_FLASHLOG_BENCHMARK
+    flashlog_bench_t flashlog_bench;
+    if (flashlog_benchmark(CONFIG_FLASHLOG_SIM_SIZE_KB * 1024 / 8, &flashlog_bench) == ESP_OK) {
+        ESP_LOGI(TAG, "flashlog: %u appends at %u/s, query %u records at %u/s, remount %u us, programmed %u.%03u erased %u.%03u bytes per byte",
+                 flashlog_bench.records, flashlog_bench.append_per_s, flashlog_bench.query_records,
+                 flashlog_bench.query_per_s, flashlog_bench.mount_us,
+                 flashlog_bench.program_permille / 1000, flashlog_bench.program_permille % 1000,
+                 flashlog_bench.erase_permille / 1000, flashlog_bench.erase_permille % 1000);
+    }
+    flashlog_format();
+#endif
+    if (flashlog_init() == ESP_OK) {
+#if CONFIG_FLASHLOG_RESTORE_HISTORY
+        unit_env2_restore_history();
+#endif
+    }
+#endif
+#if CONFIG_DUTY_CYCLE_SUPPORT
+    // The jobs run between sleeps; nothing below is started.
+    static const dutycycle_job_t jobs[] = {
+        { "env", CONFIG_DUTY_ENV_PERIOD_S, duty_env_job, NULL },
+#if CONFIG_SOFTWARE_WIFI_SUPPORT
+        { "ntp", CONFIG_DUTY_NTP_RETRY_S, duty_ntp_job, NULL },
+#endif
+    };
+    esp_log_level_set("MY-DUTY", ESP_LOG_INFO);
+    dutycycle_run(jobs, sizeof(jobs) / sizeof(jobs[0]));
+#endif
     // UNIT ENV2
     xTaskCreatePinnedToCore(&vLoopUnitEnv2Task, "unit_env2_task", 4096 * 1, NULL, 2, &xUnitEnv2, 1);
 #endif
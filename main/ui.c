@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
@@ -78,6 +79,10 @@ static lv_obj_t *datetime_txtlabel;
 static lv_obj_t *button_label;
 #endif
 
+#if CONFIG_VIBRATION_SUPPORT
+static lv_obj_t *vibration_label;
+#endif
+
 static char *TAG = "MY-UI";
 
 #if CONFIG_SOFTWARE_WIFI_SUPPORT
@@ -168,6 +173,13 @@ void ui_temperature_update(int32_t value){
 }
 #endif
 
+#if CONFIG_VIBRATION_SUPPORT
+void ui_vibration_update(int32_t rms_mg){
+    xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
+    lv_label_set_text_fmt(vibration_label, "VIB %d mG", rms_mg);
+    xSemaphoreGive(xGuiSemaphore);
+}
+#endif
 
 void ui_init() {
     xSemaphoreTake(xGuiSemaphore, portMAX_DELAY);
@@ -238,8 +250,14 @@ void ui_init() {
 
 
 #if CONFIG_SOFTWARE_RTC_SUPPORT
-    char str1[30] = {0};
-    sprintf(str1,"%04d/%02d/%02d %02d:%02d:%02d", 2022, 1, 1, 12, 0, 0);
+    // Restored from the RTC at boot when it was valid.
+    char str1[30] = "----/--/-- --:--:--";
+    time_t now = time(NULL);
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
+    if (timeinfo.tm_year + 1900 >= 2020) {
+        strftime(str1, sizeof(str1), "%Y/%m/%d %H:%M:%S", &timeinfo);
+    }
 
     datetime_txtlabel = lv_label_create(active_screen, NULL);
     lv_label_set_align(datetime_txtlabel, LV_LABEL_ALIGN_LEFT);
@@ -247,6 +265,12 @@ void ui_init() {
     lv_obj_align(datetime_txtlabel, NULL, LV_ALIGN_IN_TOP_LEFT, 0, 0);
 #endif
 
+#if CONFIG_VIBRATION_SUPPORT
+    vibration_label = lv_label_create(active_screen, NULL);
+    lv_label_set_text(vibration_label, "VIB -");
+    lv_obj_align(vibration_label, NULL, LV_ALIGN_IN_BOTTOM_LEFT, 0, 0);
+#endif
+
     xSemaphoreGive(xGuiSemaphore);
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,400 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "vibration.h"
+
+#if CONFIG_VIBRATION_SUPPORT
+#define VIBRATION_HALF (VIBRATION_WINDOW / 2)
+
+#if (VIBRATION_WINDOW & (VIBRATION_WINDOW - 1)) != 0
+#error "CONFIG_VIBRATION_WINDOW must be a power of two"
+#endif
+
+static const char *TAG = "MY-VIB";
+
+/*
+    Everything the pipeline touches is allocated here, sized by the
+    window; processing a window does no allocation.
+*/
+static float vibration_input[3][VIBRATION_WINDOW];
+static uint32_t vibration_input_pos;
+static uint32_t vibration_input_fill;
+static uint32_t vibration_since_window;
+static int64_t vibration_last_us;
+
+static float vibration_work[VIBRATION_WINDOW];
+static float vibration_re[VIBRATION_HALF];
+static float vibration_im[VIBRATION_HALF];
+static float vibration_power[VIBRATION_HALF + 1];
+static float vibration_hann[VIBRATION_WINDOW];
+static float vibration_cos[VIBRATION_HALF];
+static float vibration_sin[VIBRATION_HALF];
+static uint16_t vibration_bitrev[VIBRATION_HALF];
+static float vibration_power_scale;
+static bool vibration_tables_ready;
+
+static uint16_t vibration_edges_hz[VIBRATION_MAX_BANDS + 1];
+static uint8_t vibration_band_count;
+static uint16_t vibration_band_bins[VIBRATION_MAX_BANDS + 1];
+
+static float vibration_acc_res;
+static vibration_features_t vibration_features;
+static QueueHandle_t vibration_queue;
+static TaskHandle_t vibration_task_handle;
+static volatile bool vibration_running;
+static uint16_t vibration_rate_hz;
+
+static vibration_stats_t vibration_stats;
+static uint64_t vibration_process_us_total;
+static int64_t vibration_start_us;
+static portMUX_TYPE vibration_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void vibration_tables_init(void) {
+    const float two_pi = 6.28318530718f;
+    float window_power = 0.0f;
+    for (uint32_t n = 0; n < VIBRATION_WINDOW; n++) {
+        vibration_hann[n] = 0.5f - 0.5f * cosf(two_pi * n / VIBRATION_WINDOW);
+        window_power += vibration_hann[n] * vibration_hann[n];
+    }
+    // Angles 2*pi*k/N serve both the N/2-point FFT (even k) and the
+    // real-spectrum split (all k).
+    for (uint32_t k = 0; k < VIBRATION_HALF; k++) {
+        vibration_cos[k] = cosf(two_pi * k / VIBRATION_WINDOW);
+        vibration_sin[k] = sinf(two_pi * k / VIBRATION_WINDOW);
+    }
+    uint32_t bits = 0;
+    while ((1U << bits) < VIBRATION_HALF) {
+        bits++;
+    }
+    for (uint32_t i = 0; i < VIBRATION_HALF; i++) {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        vibration_bitrev[i] = r;
+    }
+    // One-sided power normalized so the bins sum to the window's
+    // Hann-weighted mean square.
+    vibration_power_scale = 1.0f / ((float)VIBRATION_WINDOW * window_power);
+    vibration_tables_ready = true;
+}
+
+/* In-place radix-2 FFT of VIBRATION_HALF complex points. */
+static void vibration_fft(float *re, float *im) {
+    for (uint32_t i = 0; i < VIBRATION_HALF; i++) {
+        uint32_t j = vibration_bitrev[i];
+        if (j > i) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (uint32_t len = 2; len <= VIBRATION_HALF; len <<= 1) {
+        uint32_t half = len >> 1;
+        uint32_t step = (VIBRATION_WINDOW / len);
+        for (uint32_t i = 0; i < VIBRATION_HALF; i += len) {
+            for (uint32_t j = 0; j < half; j++) {
+                float wr = vibration_cos[j * step];
+                float wi = -vibration_sin[j * step];
+                uint32_t a = i + j;
+                uint32_t b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+/*
+    Real FFT of N samples: even and odd samples are packed into one
+    N/2-point complex FFT and split apart afterwards, then squared into
+    the one-sided power spectrum.
+*/
+static void vibration_power_spectrum(const float *x) {
+    for (uint32_t k = 0; k < VIBRATION_HALF; k++) {
+        vibration_re[k] = x[2 * k] * vibration_hann[2 * k];
+        vibration_im[k] = x[2 * k + 1] * vibration_hann[2 * k + 1];
+    }
+    vibration_fft(vibration_re, vibration_im);
+
+    float dc = vibration_re[0] + vibration_im[0];
+    float nyquist = vibration_re[0] - vibration_im[0];
+    vibration_power[0] = dc * dc * vibration_power_scale;
+    vibration_power[VIBRATION_HALF] = nyquist * nyquist * vibration_power_scale;
+    for (uint32_t k = 1; k < VIBRATION_HALF; k++) {
+        float zr = vibration_re[k], zi = vibration_im[k];
+        float cr = vibration_re[VIBRATION_HALF - k], ci = -vibration_im[VIBRATION_HALF - k];
+        float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+        float tr = 0.5f * (zi - ci), ti = -0.5f * (zr - cr);
+        float c = vibration_cos[k], s = vibration_sin[k];
+        float xr = er + c * tr + s * ti;
+        float xi = ei + c * ti - s * tr;
+        vibration_power[k] = 2.0f * (xr * xr + xi * xi) * vibration_power_scale;
+    }
+}
+
+static void vibration_window(uint8_t axis) {
+    // Oldest sample first.
+    uint32_t start = vibration_input_pos;
+    for (uint32_t n = 0; n < VIBRATION_WINDOW; n++) {
+        vibration_work[n] = vibration_input[axis][(start + n) & (VIBRATION_WINDOW - 1)];
+    }
+
+    float sum = 0.0f;
+    float min = vibration_work[0], max = vibration_work[0];
+    for (uint32_t n = 0; n < VIBRATION_WINDOW; n++) {
+        float v = vibration_work[n];
+        sum += v;
+        if (v < min) {
+            min = v;
+        }
+        if (v > max) {
+            max = v;
+        }
+    }
+    float mean = sum / VIBRATION_WINDOW;
+    float sum_sq = 0.0f;
+    float peak = 0.0f;
+    for (uint32_t n = 0; n < VIBRATION_WINDOW; n++) {
+        float v = vibration_work[n] - mean;
+        vibration_work[n] = v;
+        sum_sq += v * v;
+        if (fabsf(v) > peak) {
+            peak = fabsf(v);
+        }
+    }
+    float rms = sqrtf(sum_sq / VIBRATION_WINDOW);
+    vibration_features.rms[axis] = rms;
+    vibration_features.peak_to_peak[axis] = max - min;
+    vibration_features.crest[axis] = (rms > 0.0f) ? peak / rms : 0.0f;
+
+    vibration_power_spectrum(vibration_work);
+    // The bins add up to the Hann-weighted mean square, which favours the
+    // middle of the window; rescale so the bands split the rms squared.
+    float total = 0.0f;
+    for (uint32_t k = 0; k <= VIBRATION_HALF; k++) {
+        total += vibration_power[k];
+    }
+    float scale = (total > 0.0f) ? (rms * rms) / total : 0.0f;
+    for (uint8_t b = 0; b < vibration_band_count; b++) {
+        float energy = 0.0f;
+        for (uint32_t k = vibration_band_bins[b]; k < vibration_band_bins[b + 1]; k++) {
+            energy += vibration_power[k];
+        }
+        vibration_features.band_energy[axis][b] = energy * scale;
+    }
+}
+
+static void vibration_process(const mpu6886_frame_t *frame) {
+    for (uint8_t axis = 0; axis < 3; axis++) {
+        vibration_input[axis][vibration_input_pos] = (float)frame->accel[axis] * vibration_acc_res;
+    }
+    vibration_input_pos = (vibration_input_pos + 1) & (VIBRATION_WINDOW - 1);
+    vibration_last_us = frame->timestamp_us;
+    vibration_stats.frames++;
+    if (vibration_input_fill < VIBRATION_WINDOW) {
+        vibration_input_fill++;
+    }
+    if (++vibration_since_window < VIBRATION_HOP || vibration_input_fill < VIBRATION_WINDOW) {
+        return ;
+    }
+    vibration_since_window = 0;
+
+    int64_t start = esp_timer_get_time();
+    vibration_features.timestamp_us = vibration_last_us;
+    vibration_features.bands = vibration_band_count;
+    for (uint8_t axis = 0; axis < 3; axis++) {
+        vibration_window(axis);
+    }
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+
+    bool sent = (xQueueSend(vibration_queue, &vibration_features, 0) == pdTRUE);
+
+    portENTER_CRITICAL(&vibration_lock);
+    vibration_stats.windows++;
+    vibration_stats.dropped += sent ? 0 : 1;
+    vibration_process_us_total += elapsed;
+    if (elapsed > vibration_stats.process_us_max) {
+        vibration_stats.process_us_max = elapsed;
+    }
+    portEXIT_CRITICAL(&vibration_lock);
+}
+
+static void vibration_task(void *pvParameters) {
+    mpu6886_frame_t frame;
+    while (vibration_running) {
+        while (MPU6886_StreamRead(&frame)) {
+            vibration_process(&frame);
+        }
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    vibration_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+static uint8_t vibration_parse_edges(const char *text, uint16_t *edges) {
+    uint8_t count = 0;
+    while (*text != '\0' && count <= VIBRATION_MAX_BANDS) {
+        char *end;
+        long value = strtol(text, &end, 10);
+        if (end == text) {
+            break;
+        }
+        edges[count++] = (uint16_t)value;
+        text = (*end == ',') ? end + 1 : end;
+    }
+    return count;
+}
+
+esp_err_t vibration_set_bands(const uint16_t *edges_hz, uint8_t count) {
+    if (vibration_task_handle != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (edges_hz == NULL || count < 2 || count > VIBRATION_MAX_BANDS + 1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (uint8_t i = 1; i < count; i++) {
+        if (edges_hz[i] <= edges_hz[i - 1]) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    memcpy(vibration_edges_hz, edges_hz, count * sizeof(uint16_t));
+    vibration_band_count = count - 1;
+    return ESP_OK;
+}
+
+/* Tables and the default bands, once; both outlive a stop. */
+static esp_err_t vibration_prepare(void) {
+    if (!vibration_tables_ready) {
+        vibration_tables_init();
+    }
+    if (vibration_band_count == 0) {
+        uint16_t edges[VIBRATION_MAX_BANDS + 1];
+        uint8_t count = vibration_parse_edges(CONFIG_VIBRATION_BAND_EDGES_HZ, edges);
+        if (vibration_set_bands(edges, count) != ESP_OK) {
+            ESP_LOGE(TAG, "bad CONFIG_VIBRATION_BAND_EDGES_HZ");
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    return ESP_OK;
+}
+
+static void vibration_set_rate(uint16_t rate_hz) {
+    vibration_rate_hz = rate_hz;
+    for (uint8_t b = 0; b <= vibration_band_count; b++) {
+        uint32_t bin = ((uint32_t)vibration_edges_hz[b] * VIBRATION_WINDOW + rate_hz / 2) / rate_hz;
+        vibration_band_bins[b] = (bin > VIBRATION_HALF + 1) ? VIBRATION_HALF + 1 : bin;
+    }
+}
+
+esp_err_t vibration_start(uint16_t rate_hz) {
+    if (vibration_task_handle != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = vibration_prepare();
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (vibration_queue == NULL) {
+        vibration_queue = xQueueCreate(CONFIG_VIBRATION_QUEUE_LEN, sizeof(vibration_features_t));
+        if (vibration_queue == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    err = MPU6886_StreamStart(rate_hz, (rate_hz + 49) / 50);
+    if (err != ESP_OK) {
+        return err;
+    }
+    // The divider only yields 1 kHz / n; bins follow the real rate.
+    vibration_set_rate(1000 / (1000 / rate_hz));
+    float gyro_res;
+    MPU6886_GetResolution(&vibration_acc_res, &gyro_res);
+
+    vibration_input_pos = 0;
+    vibration_input_fill = 0;
+    vibration_since_window = 0;
+    portENTER_CRITICAL(&vibration_lock);
+    memset(&vibration_stats, 0, sizeof(vibration_stats));
+    vibration_process_us_total = 0;
+    vibration_start_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&vibration_lock);
+    xQueueReset(vibration_queue);
+
+    vibration_running = true;
+    if (xTaskCreatePinnedToCore(vibration_task, "vibration_task", 4096, NULL, 3, &vibration_task_handle, 1) != pdPASS) {
+        vibration_running = false;
+        vibration_task_handle = NULL;
+        MPU6886_StreamStop();
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "%u Hz, window %u, hop %u, %u bands", vibration_rate_hz, VIBRATION_WINDOW, VIBRATION_HOP, vibration_band_count);
+    return ESP_OK;
+}
+
+void vibration_stop(void) {
+    if (vibration_task_handle == NULL) {
+        return ;
+    }
+    vibration_running = false;
+    while (vibration_task_handle != NULL) {
+        vTaskDelay(1);
+    }
+    MPU6886_StreamStop();
+}
+
+esp_err_t vibration_analyze(const float samples[3][VIBRATION_WINDOW], uint16_t rate_hz, vibration_features_t *features) {
+    if (samples == NULL || features == NULL || rate_hz == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // The pipeline's buffers are reused; the task must not be running.
+    if (vibration_task_handle != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = vibration_prepare();
+    if (err != ESP_OK) {
+        return err;
+    }
+    vibration_set_rate(rate_hz);
+    memcpy(vibration_input, samples, sizeof(vibration_input));
+    vibration_input_pos = 0;
+    vibration_features.timestamp_us = 0;
+    vibration_features.bands = vibration_band_count;
+    for (uint8_t axis = 0; axis < 3; axis++) {
+        vibration_window(axis);
+    }
+    *features = vibration_features;
+    return ESP_OK;
+}
+
+bool vibration_receive(vibration_features_t *features, TickType_t ticks_to_wait) {
+    if (vibration_queue == NULL || features == NULL) {
+        return false;
+    }
+    return xQueueReceive(vibration_queue, features, ticks_to_wait) == pdTRUE;
+}
+
+void vibration_get_stats(vibration_stats_t *stats) {
+    if (stats == NULL) {
+        return ;
+    }
+    portENTER_CRITICAL(&vibration_lock);
+    *stats = vibration_stats;
+    uint64_t total = vibration_process_us_total;
+    int64_t elapsed = esp_timer_get_time() - vibration_start_us;
+    portEXIT_CRITICAL(&vibration_lock);
+
+    stats->process_us_avg = (stats->windows > 0) ? (uint32_t)(total / stats->windows) : 0;
+    stats->load_permille = (elapsed > 0) ? (uint32_t)(total * 1000 / (uint64_t)elapsed) : 0;
+}
+#endif
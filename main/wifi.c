@@ -23,7 +23,6 @@
 #include "esp_system.h"
 #include "esp_wifi.h"
 #include "esp_log.h"
-#include "nvs_flash.h"
 
 #include "m5stick.h"
 #include "wifi.h"
@@ -71,16 +70,14 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
 }
 
 void initialise_wifi(void){
-    ESP_LOGI(TAG, "initialise_wifi() start.");
-
-    // Initialize NVS
-    esp_err_t err = nvs_flash_init();
-    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        err = nvs_flash_init();
+    if (wifi_event_group != NULL) {
+        // Already set up, stopped by wifi_stop().
+        ESP_ERROR_CHECK(esp_wifi_start());
+        return;
     }
-    ESP_ERROR_CHECK(err);
+    ESP_LOGI(TAG, "initialise_wifi() start.");
 
+    // NVS, which the Wi-Fi driver keeps its state in, is up since M5Stick_Init().
     wifi_event_group = xEventGroupCreate();
 
     ESP_ERROR_CHECK(esp_netif_init());
@@ -107,4 +104,14 @@ void initialise_wifi(void){
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
-}
\ No newline at end of file
+}
+
+void wifi_stop(void){
+    if (wifi_event_group == NULL) {
+        return;
+    }
+    // The reconnect in the disconnect handler just fails while stopped.
+    esp_wifi_stop();
+    xEventGroupClearBits(wifi_event_group, CONNECTED_BIT);
+    xEventGroupSetBits(wifi_event_group, DISCONNECTED_BIT);
+}